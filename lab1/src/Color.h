@@ -2,6 +2,7 @@
 #include <glm/ext/vector_float3.hpp>
 #include <glm/glm.hpp>
 #include <string>
+#include "../utils/Profiler.h"
 
 class Color{
 public:
@@ -9,16 +10,19 @@ public:
     Color(): rgb(0.0f, 0.0f, 0.0f), cmyk(0.0f, 0.0f, 0.0f, 1.0f), hsv(0.0f, 0.0f, 0.0f) {}
 
     void setRGB(float r, float g, float b) {
+        Profiler::ScopedTimer timer("Color::setRGB");
         rgb = glm::vec3(r, g, b);
         cmyk = rgbToCmyk(rgb);
         hsv = rgbToHsv(rgb);
     }
     void setCMYK(float c, float m, float y, float k) {
+        Profiler::ScopedTimer timer("Color::setCMYK");
         cmyk = glm::vec4(c, m, y, k);
         rgb = cmykToRgb(cmyk);
         hsv = rgbToHsv(rgb);
     }
     void setHSV(float h, float s, float v) {
+        Profiler::ScopedTimer timer("Color::setHSV");
         hsv = glm::vec3(h, s, v);
         rgb = hsvToRgb(hsv);
         cmyk = rgbToCmyk(rgb);
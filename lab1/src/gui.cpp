@@ -1,4 +1,6 @@
 
+// Replaces operator new to count allocations for the overlay; must precede every include
+#define PROFILER_IMPLEMENTATION
 #include "gui.h"
 #include <iostream>
 #include <sstream>
@@ -9,6 +11,7 @@
 #include "render/rgbControls.h"
 #include "render/extraControls.h"
 #include "../utils/SystemInfo.h"
+#include "../utils/PerformanceOverlay.h"
 
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
@@ -100,6 +103,7 @@ void ColorConverterGUI::run() {
         ImGui::NewFrame();
         
         renderGUI();
+        PerformanceOverlay::render();
         
         ImGui::Render();
         glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
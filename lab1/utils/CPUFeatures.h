@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#include <intrin.h>
+#include <vector>
+#elif defined(__linux__)
+#include <fstream>
+#include <set>
+#include <utility>
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+// Structured CPU capabilities for choosing code paths at run time. SystemInfo::getCPUInfo() formats
+// the same data for people; this header has no GL dependency so command-line tools can use it too.
+namespace CPUFeatures {
+
+    struct Info {
+        std::string vendor;
+        std::string brand;
+
+        // Usable instruction sets: supported by the CPU and, for AVX state, enabled by the OS
+        bool sse2 = false;
+        bool sse41 = false;
+        bool avx2 = false;
+        bool fma = false;
+        bool avx512bw = false;
+
+        int logicalCores = 0;
+        int physicalCores = 0;
+
+        // Bytes per core (L1, L2) or per package (L3); 0 when unknown
+        uint64_t l1DataCache = 0;
+        uint64_t l2Cache = 0;
+        uint64_t l3Cache = 0;
+    };
+
+    #if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    inline void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4]) {
+        #ifdef _MSC_VER
+            int values[4];
+            __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+            for (int i = 0; i < 4; i++) regs[i] = static_cast<unsigned int>(values[i]);
+        #else
+            __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+        #endif
+    }
+
+    // Register state the OS saves on context switches (XCR0)
+    inline uint64_t enabledStateComponents() {
+        #ifdef _MSC_VER
+            return _xgetbv(0);
+        #else
+            unsigned int low, high;
+            __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+            return (static_cast<uint64_t>(high) << 32) | low;
+        #endif
+    }
+
+    inline void detectInstructionSets(Info& info) {
+        unsigned int regs[4];
+        cpuid(0, 0, regs);
+        unsigned int maxLeaf = regs[0];
+        char vendor[13] = {0};
+        std::memcpy(vendor, &regs[1], 4);
+        std::memcpy(vendor + 4, &regs[3], 4);
+        std::memcpy(vendor + 8, &regs[2], 4);
+        info.vendor = vendor;
+
+        cpuid(0x80000000, 0, regs);
+        if (regs[0] >= 0x80000004) {
+            char brand[49] = {0};
+            for (unsigned int i = 0; i < 3; i++) {
+                cpuid(0x80000002 + i, 0, regs);
+                std::memcpy(brand + i * 16, regs, 16);
+            }
+            info.brand = brand;
+            size_t start = info.brand.find_first_not_of(' ');
+            info.brand = start == std::string::npos ? "" : info.brand.substr(start);
+        }
+
+        if (maxLeaf < 1) return;
+        cpuid(1, 0, regs);
+        unsigned int ecx1 = regs[2], edx1 = regs[3];
+        info.sse2 = (edx1 >> 26) & 1;
+        info.sse41 = (ecx1 >> 19) & 1;
+
+        bool osxsave = (ecx1 >> 27) & 1;
+        uint64_t xcr0 = osxsave ? enabledStateComponents() : 0;
+        // SSE and AVX registers, then the AVX-512 mask and upper registers
+        bool avxState = (xcr0 & 0x6) == 0x6;
+        bool avx512State = avxState && (xcr0 & 0xE0) == 0xE0;
+        bool avx = avxState && ((ecx1 >> 28) & 1);
+        info.fma = avx && ((ecx1 >> 12) & 1);
+
+        if (maxLeaf < 7) return;
+        cpuid(7, 0, regs);
+        unsigned int ebx7 = regs[1];
+        info.avx2 = avx && ((ebx7 >> 5) & 1);
+        info.avx512bw = avx512State && ((ebx7 >> 16) & 1) && ((ebx7 >> 30) & 1);
+    }
+    #else
+    inline void detectInstructionSets(Info&) {}
+    #endif
+
+    inline void detectTopology(Info& info) {
+        info.logicalCores = static_cast<int>(std::thread::hardware_concurrency());
+
+        #ifdef _WIN32
+            DWORD length = 0;
+            GetLogicalProcessorInformation(nullptr, &length);
+            std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> entries(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+            if (!entries.empty() && GetLogicalProcessorInformation(entries.data(), &length)) {
+                for (const auto& entry : entries) {
+                    if (entry.Relationship == RelationProcessorCore) {
+                        info.physicalCores++;
+                    } else if (entry.Relationship == RelationCache) {
+                        const CACHE_DESCRIPTOR& cache = entry.Cache;
+                        if (cache.Level == 1 && cache.Type == CacheData) info.l1DataCache = cache.Size;
+                        else if (cache.Level == 2) info.l2Cache = cache.Size;
+                        else if (cache.Level == 3) info.l3Cache = cache.Size;
+                    }
+                }
+            }
+        #elif defined(__linux__)
+            // Distinct (package, core) pairs
+            std::ifstream cpuinfo("/proc/cpuinfo");
+            std::set<std::pair<int, int>> cores;
+            std::string line;
+            int package = 0;
+            while (std::getline(cpuinfo, line)) {
+                size_t colon = line.find(':');
+                if (colon == std::string::npos) continue;
+                if (line.find("physical id") == 0) {
+                    package = std::atoi(line.c_str() + colon + 1);
+                } else if (line.find("core id") == 0) {
+                    cores.insert({package, std::atoi(line.c_str() + colon + 1)});
+                }
+            }
+            info.physicalCores = static_cast<int>(cores.size());
+
+            for (int index = 0; index < 8; index++) {
+                std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+                std::ifstream levelFile(dir + "level"), typeFile(dir + "type"), sizeFile(dir + "size");
+                int level = 0;
+                std::string type, size;
+                if (!(levelFile >> level) || !(typeFile >> type) || !(sizeFile >> size)) break;
+
+                uint64_t bytes = std::strtoull(size.c_str(), nullptr, 10);
+                if (size.back() == 'K') bytes <<= 10;
+                else if (size.back() == 'M') bytes <<= 20;
+
+                if (level == 1 && type == "Data") info.l1DataCache = bytes;
+                else if (level == 2) info.l2Cache = bytes;
+                else if (level == 3) info.l3Cache = bytes;
+            }
+        #endif
+
+        if (info.physicalCores <= 0) info.physicalCores = info.logicalCores;
+    }
+
+    inline const Info& get() {
+        static const Info info = [] {
+            Info detected;
+            detectInstructionSets(detected);
+            detectTopology(detected);
+            return detected;
+        }();
+        return info;
+    }
+
+    // "SSE2 SSE4.1 AVX2 FMA AVX-512BW", the usable ones only
+    inline std::string instructionSets(const Info& info) {
+        std::string text;
+        auto add = [&](bool present, const char* name) {
+            if (!present) return;
+            if (!text.empty()) text += ' ';
+            text += name;
+        };
+        add(info.sse2, "SSE2");
+        add(info.sse41, "SSE4.1");
+        add(info.avx2, "AVX2");
+        add(info.fma, "FMA");
+        add(info.avx512bw, "AVX-512BW");
+        return text.empty() ? "none detected" : text;
+    }
+}
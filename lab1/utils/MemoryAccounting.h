@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Process-wide count of the large buffers a program holds, current and peak bytes per category. The
+// owners report their own allocations; nothing here hooks the allocator, so the numbers cover only
+// what is reported, never the whole heap.
+//
+// An optional soft budget is enforced at points the program chooses: enforceBudget() asks the
+// registered eviction handlers to free memory until the total is back under the budget.
+namespace MemoryAccounting {
+
+    enum class Category {
+        // Pixel data of images not held by a cache
+        PixelBuffers,
+        // Texture storage as uploaded; drivers may pad rows or RGB texels
+        Textures,
+        // Results kept only to be reused: cached pipeline stages, histograms
+        AnalysisCaches,
+        // Scratch buffers that live for one operation
+        Temporaries,
+        // Undo steps held in memory
+        History,
+        // Pixels of image files mapped rather than read; the OS pages them in and out as needed
+        MappedFiles,
+        Count
+    };
+
+    struct Usage {
+        uint64_t current = 0;
+        uint64_t peak = 0;
+    };
+
+    inline std::atomic<uint64_t> currentBytes[static_cast<int>(Category::Count)] = {};
+    inline std::atomic<uint64_t> peakBytes[static_cast<int>(Category::Count)] = {};
+    inline std::atomic<uint64_t> totalBytes{0};
+    inline std::atomic<uint64_t> totalPeakBytes{0};
+    inline std::atomic<uint64_t> budgetBytes{0};
+
+    inline const char* name(Category category) {
+        switch (category) {
+        case Category::PixelBuffers: return "Pixel buffers";
+        case Category::Textures: return "Textures";
+        case Category::AnalysisCaches: return "Analysis caches";
+        case Category::Temporaries: return "Temporaries";
+        case Category::History: return "Undo history";
+        case Category::MappedFiles: return "Mapped files";
+        case Category::Count: break;
+        }
+        return "";
+    }
+
+    inline void raisePeak(std::atomic<uint64_t>& peak, uint64_t value) {
+        uint64_t seen = peak.load(std::memory_order_relaxed);
+        while (value > seen && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+    }
+
+    inline void add(Category category, uint64_t bytes) {
+        if (bytes == 0) return;
+        int index = static_cast<int>(category);
+        raisePeak(peakBytes[index], currentBytes[index].fetch_add(bytes, std::memory_order_relaxed) + bytes);
+        raisePeak(totalPeakBytes, totalBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    }
+
+    inline void release(Category category, uint64_t bytes) {
+        if (bytes == 0) return;
+        currentBytes[static_cast<int>(category)].fetch_sub(bytes, std::memory_order_relaxed);
+        totalBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    // Moves bytes already counted from one category to another, e.g. when a cache takes an image
+    inline void transfer(Category from, Category to, uint64_t bytes) {
+        if (bytes == 0) return;
+        currentBytes[static_cast<int>(from)].fetch_sub(bytes, std::memory_order_relaxed);
+        int index = static_cast<int>(to);
+        raisePeak(peakBytes[index], currentBytes[index].fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    }
+
+    inline Usage usage(Category category) {
+        int index = static_cast<int>(category);
+        return {currentBytes[index].load(std::memory_order_relaxed), peakBytes[index].load(std::memory_order_relaxed)};
+    }
+
+    inline Usage total() {
+        return {totalBytes.load(std::memory_order_relaxed), totalPeakBytes.load(std::memory_order_relaxed)};
+    }
+
+    // Starts the peaks over from the current values
+    inline void resetPeaks() {
+        for (int i = 0; i < static_cast<int>(Category::Count); i++) {
+            peakBytes[i].store(currentBytes[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        totalPeakBytes.store(totalBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    // Counts `bytes` under `category` for its scope, for scratch buffers:
+    //
+    //   std::vector<unsigned char> scratch(size);
+    //   MemoryAccounting::Scoped counted(MemoryAccounting::Category::Temporaries, scratch.size());
+    class Scoped {
+    public:
+        Scoped(Category category, uint64_t bytes) : category(category), bytes(bytes) {
+            add(category, bytes);
+        }
+        ~Scoped() { release(category, bytes); }
+
+        Scoped(const Scoped&) = delete;
+        Scoped& operator=(const Scoped&) = delete;
+
+    private:
+        Category category;
+        uint64_t bytes;
+    };
+
+    // Soft budget for the total; 0, the default, means none
+    inline void setBudget(uint64_t bytes) {
+        budgetBytes.store(bytes, std::memory_order_relaxed);
+    }
+
+    inline uint64_t budget() {
+        return budgetBytes.load(std::memory_order_relaxed);
+    }
+
+    // Bytes above the budget, 0 when under it or without one
+    inline uint64_t excess() {
+        uint64_t limit = budget();
+        uint64_t used = totalBytes.load(std::memory_order_relaxed);
+        return limit > 0 && used > limit ? used - limit : 0;
+    }
+
+    // A handler gets the number of bytes above the budget and returns how many it freed. Handlers
+    // run on the thread calling enforceBudget() and must not block on work in progress.
+    using EvictionHandler = std::function<uint64_t(uint64_t excess)>;
+
+    inline std::mutex handlersMutex;
+    inline std::vector<std::pair<int, EvictionHandler>> handlers;
+    inline int nextHandlerId = 1;
+
+    inline int addEvictionHandler(EvictionHandler handler) {
+        std::lock_guard<std::mutex> lock(handlersMutex);
+        handlers.emplace_back(nextHandlerId, std::move(handler));
+        return nextHandlerId++;
+    }
+
+    inline void removeEvictionHandler(int id) {
+        std::lock_guard<std::mutex> lock(handlersMutex);
+        handlers.erase(std::remove_if(handlers.begin(), handlers.end(),
+                                      [id](const auto& entry) { return entry.first == id; }), handlers.end());
+    }
+
+    // Runs the handlers in registration order while the total is over the budget; returns the bytes
+    // they report as freed.
+    inline uint64_t enforceBudget() {
+        if (excess() == 0) return 0;
+        std::lock_guard<std::mutex> lock(handlersMutex);
+        uint64_t freed = 0;
+        for (auto& entry : handlers) {
+            uint64_t over = excess();
+            if (over == 0) break;
+            freed += entry.second(over);
+        }
+        return freed;
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "Profiler.h"
+#include "SystemInfo.h"
+#include "imgui.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+// Frame time history, time per operation call, texture upload time, allocations per frame, image
+// memory and MemoryAccounting totals, in a small window toggled with F3. Call render() once per frame between ImGui::NewFrame()
+// and ImGui::Render(); while the window is hidden it only checks the shortcut.
+namespace PerformanceOverlay {
+
+    const int kHistorySize = 240;
+
+    struct FrameHistory {
+        float frameMs[kHistorySize] = {};
+        float uploadMs[kHistorySize] = {};
+        float allocations[kHistorySize] = {};
+        int next = 0;
+        int count = 0;
+        Profiler::Clock::time_point lastFrame;
+    };
+
+    inline float average(const float* values, int count) {
+        float sum = 0.0f;
+        for (int i = 0; i < count; i++) sum += values[i];
+        return count ? sum / count : 0.0f;
+    }
+
+    // imageBytes < 0 leaves out the image memory line, for applications without images
+    inline void render(int64_t imageBytes = -1) {
+        static bool visible = false;
+        static FrameHistory history;
+
+        if (ImGui::IsKeyPressed(ImGuiKey_F3, false)) {
+            visible = !visible;
+            Profiler::setEnabled(visible);
+            history = FrameHistory();
+            history.lastFrame = Profiler::Clock::now();
+            Profiler::allocations.store(0, std::memory_order_relaxed);
+            Profiler::uploadNanoseconds.store(0, std::memory_order_relaxed);
+        }
+        if (!visible) return;
+
+        // The previous frame: from the last call to this one, with what was counted in between
+        auto now = Profiler::Clock::now();
+        int slot = history.next;
+        history.frameMs[slot] = std::chrono::duration<float, std::milli>(now - history.lastFrame).count();
+        history.uploadMs[slot] = Profiler::uploadNanoseconds.exchange(0, std::memory_order_relaxed) / 1e6f;
+        history.allocations[slot] = static_cast<float>(Profiler::allocations.exchange(0, std::memory_order_relaxed));
+        history.lastFrame = now;
+        history.next = (history.next + 1) % kHistorySize;
+        history.count = std::min(history.count + 1, kHistorySize);
+
+        ImGuiIO& io = ImGui::GetIO();
+        ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x - 20.0f, 40.0f), ImGuiCond_FirstUseEver, ImVec2(1.0f, 0.0f));
+        ImGui::SetNextWindowSize(ImVec2(460.0f, 0.0f), ImGuiCond_FirstUseEver);
+        ImGui::SetNextWindowBgAlpha(0.85f);
+        if (!ImGui::Begin("Performance (F3)", &visible, ImGuiWindowFlags_NoFocusOnAppearing)) {
+            ImGui::End();
+            if (!visible) Profiler::setEnabled(false);
+            return;
+        }
+
+        float frameAverage = average(history.frameMs, history.count);
+        float frameMax = *std::max_element(history.frameMs, history.frameMs + history.count);
+        ImGui::Text("Frame: %s (avg %s, max %s, %.0f fps)",
+                    SystemInfo::formatTimeElapsed(history.frameMs[slot]).c_str(),
+                    SystemInfo::formatTimeElapsed(frameAverage).c_str(),
+                    SystemInfo::formatTimeElapsed(frameMax).c_str(),
+                    frameAverage > 0.0f ? 1000.0f / frameAverage : 0.0f);
+        ImGui::PlotLines("##frames", history.frameMs, history.count, history.count == kHistorySize ? history.next : 0,
+                         nullptr, 0.0f, std::max(frameMax, 1000.0f / 30.0f), ImVec2(-1.0f, 60.0f));
+
+        ImGui::Text("Texture upload: %s this frame (avg %s)",
+                    SystemInfo::formatTimeElapsed(history.uploadMs[slot]).c_str(),
+                    SystemInfo::formatTimeElapsed(average(history.uploadMs, history.count)).c_str());
+        ImGui::Text("Allocations: %.0f this frame (avg %.1f)",
+                    history.allocations[slot], average(history.allocations, history.count));
+        if (imageBytes >= 0) {
+            ImGui::Text("Image memory: %s", SystemInfo::formatMemorySize(static_cast<uint64_t>(imageBytes)).c_str());
+        }
+        MemoryAccounting::Usage tracked = MemoryAccounting::total();
+        if (tracked.peak > 0) {
+            ImGui::Text("Tracked memory: %s (peak %s)", SystemInfo::formatMemorySize(tracked.current).c_str(),
+                        SystemInfo::formatMemorySize(tracked.peak).c_str());
+            for (int i = 0; i < static_cast<int>(MemoryAccounting::Category::Count); i++) {
+                auto category = static_cast<MemoryAccounting::Category>(i);
+                MemoryAccounting::Usage usage = MemoryAccounting::usage(category);
+                ImGui::TextDisabled("  %s: %s (peak %s)", MemoryAccounting::name(category),
+                                    SystemInfo::formatMemorySize(usage.current).c_str(),
+                                    SystemInfo::formatMemorySize(usage.peak).c_str());
+            }
+        }
+
+        ImGui::Separator();
+        ImGui::Text("Operations");
+        ImGui::SameLine(ImGui::GetContentRegionAvail().x - 40.0f);
+        if (ImGui::SmallButton("Reset")) Profiler::clearOperations();
+
+        auto operations = Profiler::operationSnapshot();
+        if (operations.empty()) {
+            ImGui::TextDisabled("No calls since the overlay was opened");
+        } else if (ImGui::BeginTable("##operations", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+            ImGui::TableSetupColumn("Call", ImGuiTableColumnFlags_WidthStretch, 3.0f);
+            ImGui::TableSetupColumn("Count");
+            ImGui::TableSetupColumn("Last");
+            ImGui::TableSetupColumn("Avg");
+            ImGui::TableSetupColumn("Max");
+            ImGui::TableHeadersRow();
+            for (const auto& [name, stats] : operations) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(name.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(stats.calls));
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(SystemInfo::formatTimeElapsed(stats.lastMs).c_str());
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(SystemInfo::formatTimeElapsed(stats.totalMs / stats.calls).c_str());
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(SystemInfo::formatTimeElapsed(stats.maxMs).c_str());
+            }
+            ImGui::EndTable();
+        }
+
+        ImGui::End();
+        // Closed with the title bar button
+        if (!visible) Profiler::setEnabled(false);
+    }
+}
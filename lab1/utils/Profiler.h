@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+
+// Measurements behind PerformanceOverlay: time per operation call, texture upload time and heap
+// allocations. Collection only runs while the overlay is open; otherwise every hook costs one relaxed
+// atomic load.
+//
+// Allocations are counted by replacing the global operator new. Define PROFILER_IMPLEMENTATION in
+// exactly one source file of the program before including this header.
+namespace Profiler {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct OperationStats {
+        uint64_t calls = 0;
+        double totalMs = 0.0;
+        double lastMs = 0.0;
+        double maxMs = 0.0;
+    };
+
+    inline std::atomic<bool> collecting{false};
+    inline std::atomic<uint64_t> allocations{0};
+    inline std::atomic<uint64_t> uploadNanoseconds{0};
+
+    inline std::mutex operationsMutex;
+    inline std::map<std::string, OperationStats> operations;
+
+    inline bool isEnabled() {
+        return collecting.load(std::memory_order_relaxed);
+    }
+
+    inline void setEnabled(bool enabled) {
+        collecting.store(enabled, std::memory_order_relaxed);
+    }
+
+    inline void recordOperation(const std::string& name, double milliseconds) {
+        std::lock_guard<std::mutex> lock(operationsMutex);
+        OperationStats& stats = operations[name];
+        stats.calls++;
+        stats.totalMs += milliseconds;
+        stats.lastMs = milliseconds;
+        if (milliseconds > stats.maxMs) stats.maxMs = milliseconds;
+    }
+
+    inline std::map<std::string, OperationStats> operationSnapshot() {
+        std::lock_guard<std::mutex> lock(operationsMutex);
+        return operations;
+    }
+
+    inline void clearOperations() {
+        std::lock_guard<std::mutex> lock(operationsMutex);
+        operations.clear();
+    }
+
+    // Times its scope as one call of an operation. Labels that are expensive to build can be set
+    // afterwards, only when isActive():
+    //
+    //   Profiler::ScopedTimer timer;
+    //   if (timer.isActive()) timer.setLabel(describe(stage));
+    class ScopedTimer {
+    public:
+        ScopedTimer() : active(isEnabled()) {
+            if (active) start = Clock::now();
+        }
+        explicit ScopedTimer(const char* name) : ScopedTimer() {
+            if (active) label = name;
+        }
+        ~ScopedTimer() {
+            if (!active) return;
+            recordOperation(label, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+        bool isActive() const { return active; }
+        void setLabel(std::string name) { label = std::move(name); }
+
+    private:
+        bool active;
+        Clock::time_point start;
+        std::string label;
+    };
+
+    // Adds its scope to the texture upload time of the current frame
+    class UploadTimer {
+    public:
+        UploadTimer() : active(isEnabled()) {
+            if (active) start = Clock::now();
+        }
+        ~UploadTimer() {
+            if (!active) return;
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            uploadNanoseconds.fetch_add(static_cast<uint64_t>(elapsed), std::memory_order_relaxed);
+        }
+
+        UploadTimer(const UploadTimer&) = delete;
+        UploadTimer& operator=(const UploadTimer&) = delete;
+
+    private:
+        bool active;
+        Clock::time_point start;
+    };
+}
+
+#ifdef PROFILER_IMPLEMENTATION
+// new[], the nothrow forms and delete[] forward to these two by default
+void* operator new(std::size_t size) {
+    if (Profiler::isEnabled()) Profiler::allocations.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    while (true) {
+        if (void* memory = std::malloc(size)) return memory;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+#endif
@@ -10,6 +10,8 @@
 #include <ctime>
 #include <vector>
 #include <chrono>
+#include "CPUFeatures.h"
+#include "MemoryAccounting.h"
 #ifdef _WIN32
 #include <windows.h>
 #include <intrin.h>
@@ -146,6 +148,15 @@ namespace SystemInfo {
                               std::string(sysName.release) + " " + std::string(sysName.version));
             }
         #endif
+
+        const CPUFeatures::Info& features = CPUFeatures::get();
+        info.push_back("Physical Cores: " + std::to_string(features.physicalCores));
+        info.push_back("Instruction Sets: " + CPUFeatures::instructionSets(features));
+        if (features.l1DataCache || features.l2Cache || features.l3Cache) {
+            info.push_back("Caches: L1d " + formatMemorySize(features.l1DataCache) +
+                           ", L2 " + formatMemorySize(features.l2Cache) +
+                           ", L3 " + formatMemorySize(features.l3Cache));
+        }
         
         return info;
     }
@@ -215,6 +226,20 @@ namespace SystemInfo {
                 if (!cached.empty()) info.push_back("Memory Cached:" + cached);
             }
         #endif
+
+        // What the program itself reports holding; nothing when it does not use MemoryAccounting
+        MemoryAccounting::Usage tracked = MemoryAccounting::total();
+        if (tracked.peak > 0) {
+            std::string line = "Tracked by Process: " + formatMemorySize(tracked.current) + " (peak " + formatMemorySize(tracked.peak) + ")";
+            if (MemoryAccounting::budget() > 0) line += ", budget " + formatMemorySize(MemoryAccounting::budget());
+            info.push_back(line);
+            for (int i = 0; i < static_cast<int>(MemoryAccounting::Category::Count); i++) {
+                auto category = static_cast<MemoryAccounting::Category>(i);
+                MemoryAccounting::Usage usage = MemoryAccounting::usage(category);
+                info.push_back(std::string("  ") + MemoryAccounting::name(category) + ": " + formatMemorySize(usage.current) +
+                               " (peak " + formatMemorySize(usage.peak) + ")");
+            }
+        }
         
         return info;
     }
@@ -0,0 +1,154 @@
+#include "BackgroundWorker.h"
+#include "Trace.h"
+#include <algorithm>
+#include <iostream>
+
+BackgroundWorker::BackgroundWorker(int threadCount) : nextId(1), stopping(false) {
+    for (int i = 0; i < std::max(1, threadCount); i++) {
+        threads.emplace_back(&BackgroundWorker::workerLoop, this);
+    }
+}
+
+BackgroundWorker::~BackgroundWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queued.clear();
+        for (auto& job : running) {
+            job->token.cancel();
+        }
+    }
+    wake.notify_all();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+uint64_t BackgroundWorker::submit(const std::string& key, const std::string& label, Work work, Completion onDone) {
+    auto job = std::make_shared<Job>();
+    job->key = key;
+    job->label = label;
+    job->work = std::move(work);
+    job->onDone = std::move(onDone);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelLocked(key);
+        job->id = nextId++;
+        queued.push_back(job);
+    }
+    wake.notify_one();
+    return job->id;
+}
+
+void BackgroundWorker::cancelLocked(const std::string& key) {
+    queued.erase(std::remove_if(queued.begin(), queued.end(),
+                                [&](const std::shared_ptr<Job>& job) { return job->key == key; }),
+                 queued.end());
+
+    for (auto& job : running) {
+        if (job->key == key) job->token.cancel();
+    }
+    finished.erase(std::remove_if(finished.begin(), finished.end(),
+                                  [&](const std::shared_ptr<Job>& job) { return job->key == key; }),
+                   finished.end());
+}
+
+void BackgroundWorker::cancel(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    cancelLocked(key);
+}
+
+void BackgroundWorker::cancelJob(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    queued.erase(std::remove_if(queued.begin(), queued.end(),
+                                [&](const std::shared_ptr<Job>& job) { return job->id == id; }),
+                 queued.end());
+    for (auto& job : running) {
+        if (job->id == id) job->token.cancel();
+    }
+}
+
+void BackgroundWorker::cancelAll() {
+    std::lock_guard<std::mutex> lock(mutex);
+    queued.clear();
+    finished.clear();
+    for (auto& job : running) {
+        job->token.cancel();
+    }
+}
+
+void BackgroundWorker::poll() {
+    std::vector<std::shared_ptr<Job>> done;
+    {
+        // Never wait for a worker: if one holds the lock right now, pick the results up next frame.
+        std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+        if (!lock.owns_lock()) return;
+        done.swap(finished);
+    }
+
+    for (auto& job : done) {
+        if (job->onDone && !job->token.isCancelled()) {
+            job->onDone();
+        }
+    }
+}
+
+std::vector<BackgroundWorker::JobStatus> BackgroundWorker::getStatus() const {
+    std::vector<JobStatus> status;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& job : running) {
+        status.push_back({job->id, job->label, job->token.getProgress(), true});
+    }
+    for (const auto& job : queued) {
+        status.push_back({job->id, job->label, 0.0f, false});
+    }
+    return status;
+}
+
+bool BackgroundWorker::hasJob(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto matches = [&](const std::shared_ptr<Job>& job) { return job->key == key; };
+    return std::any_of(queued.begin(), queued.end(), matches) ||
+           std::any_of(running.begin(), running.end(), matches) ||
+           std::any_of(finished.begin(), finished.end(), matches);
+}
+
+bool BackgroundWorker::isBusy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !queued.empty() || !running.empty() || !finished.empty();
+}
+
+void BackgroundWorker::workerLoop() {
+    Trace::setThreadName("background worker");
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !queued.empty(); });
+            if (stopping) return;
+
+            job = queued.front();
+            queued.pop_front();
+            running.push_back(job);
+        }
+
+        bool ok = false;
+        try {
+            Cancellation::Scope scope(&job->token);
+            ok = job->work();
+        } catch (const OperationCancelled&) {
+            ok = false;
+        } catch (const std::exception& e) {
+            std::cerr << "Background job '" << job->label << "' failed: " << e.what() << std::endl;
+            ok = false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        running.erase(std::find(running.begin(), running.end(), job));
+        if (ok && !job->token.isCancelled()) {
+            finished.push_back(job);
+        }
+    }
+}
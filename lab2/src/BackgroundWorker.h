@@ -0,0 +1,69 @@
+#pragma once
+#include "Cancellation.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs load/process/save jobs off the render thread. A job is a `work` function executed on a
+// worker thread and an `onDone` completion that poll() runs on the render thread, so results are
+// handed over without the frame ever waiting on a job.
+class BackgroundWorker {
+public:
+    using Work = std::function<bool()>;
+    using Completion = std::function<void()>;
+
+    struct JobStatus {
+        uint64_t id;
+        std::string label;
+        float progress;
+        bool running;
+    };
+
+    explicit BackgroundWorker(int threadCount = 2);
+    ~BackgroundWorker();
+
+    BackgroundWorker(const BackgroundWorker&) = delete;
+    BackgroundWorker& operator=(const BackgroundWorker&) = delete;
+
+    // Cancels queued and running jobs with the same key, then queues the new one.
+    uint64_t submit(const std::string& key, const std::string& label, Work work, Completion onDone);
+    void cancel(const std::string& key);
+    void cancelJob(uint64_t id);
+    void cancelAll();
+
+    // Runs completions of jobs that finished successfully; call once per frame on the render thread.
+    void poll();
+
+    std::vector<JobStatus> getStatus() const;
+    // True while a job with this key is queued, running or waiting for poll().
+    bool hasJob(const std::string& key) const;
+    bool isBusy() const;
+
+private:
+    struct Job {
+        uint64_t id;
+        std::string key;
+        std::string label;
+        CancellationToken token;
+        Work work;
+        Completion onDone;
+    };
+
+    void workerLoop();
+    void cancelLocked(const std::string& key);
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::shared_ptr<Job>> queued;
+    std::vector<std::shared_ptr<Job>> running;
+    std::vector<std::shared_ptr<Job>> finished;
+    std::vector<std::thread> threads;
+    uint64_t nextId;
+    bool stopping;
+};
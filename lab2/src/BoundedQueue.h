@@ -0,0 +1,55 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// Blocking FIFO with a fixed capacity for handing items between pipeline threads. The ring is
+// allocated once, so passing items along allocates nothing. Producers block while it is full,
+// which keeps a fast stage from running ahead of a slow one.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : items(capacity), head(0), count(0), closed(false) {}
+
+    // Blocks while full; returns false (dropping the item) once the queue is closed.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || count < items.size(); });
+        if (closed) return false;
+
+        items[(head + count) % items.size()] = std::move(item);
+        count++;
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Blocks while empty; returns false once the queue is closed and drained.
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || count > 0; });
+        if (count == 0) return false;
+
+        item = std::move(items[head]);
+        head = (head + 1) % items.size();
+        count--;
+        notFull.notify_one();
+        return true;
+    }
+
+    // Wakes every waiting thread; items already queued can still be popped.
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::vector<T> items;
+    size_t head;
+    size_t count;
+    bool closed;
+};
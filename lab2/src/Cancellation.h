@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <exception>
+#include <memory>
+
+class OperationCancelled : public std::exception {
+public:
+    const char* what() const noexcept override { return "operation cancelled"; }
+};
+
+// Shared between the thread that submitted a job and the thread running it.
+class CancellationToken {
+public:
+    CancellationToken() : state(std::make_shared<State>()) {}
+
+    void cancel() { state->cancelled.store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return state->cancelled.load(std::memory_order_relaxed); }
+
+    void setProgress(float progress) { state->progress.store(progress, std::memory_order_relaxed); }
+    float getProgress() const { return state->progress.load(std::memory_order_relaxed); }
+
+private:
+    struct State {
+        std::atomic<bool> cancelled{false};
+        std::atomic<float> progress{0.0f};
+    };
+    std::shared_ptr<State> state;
+};
+
+namespace Cancellation {
+
+    // Token of the job running on this thread, or nullptr outside background jobs
+    inline CancellationToken*& current() {
+        thread_local CancellationToken* token = nullptr;
+        return token;
+    }
+
+    // Called once per row by long loops: reports progress and unwinds with OperationCancelled
+    // when the job has been superseded. A no-op when no job is running on this thread.
+    inline void checkpoint(int done, int total) {
+        CancellationToken* token = current();
+        if (!token) return;
+        if (token->isCancelled()) throw OperationCancelled();
+        if (total > 0) token->setProgress(static_cast<float>(done) / total);
+    }
+
+    class Scope {
+    public:
+        explicit Scope(CancellationToken* token) : previous(current()) { current() = token; }
+        ~Scope() { current() = previous; }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        CancellationToken* previous;
+    };
+}
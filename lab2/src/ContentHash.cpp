@@ -0,0 +1,33 @@
+#include "ContentHash.h"
+#include <cstring>
+
+uint64_t ContentHash::bytes(const void* data, size_t size, uint64_t seed) {
+    const uint64_t prime = 0x9E3779B97F4A7C15ull;
+    uint64_t lanes[4] = {seed, seed ^ 0x452821E638D01377ull, seed ^ 0xBE5466CF34E90C6Cull, 0x243F6A8885A308D3ull};
+
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t word;
+            std::memcpy(&word, p + i + lane * 8, 8);
+            lanes[lane] = (lanes[lane] ^ word) * prime;
+            lanes[lane] ^= lanes[lane] >> 29;
+        }
+    }
+    uint64_t hash = size;
+    for (; i < size; i++) {
+        hash = (hash ^ p[i]) * prime;
+    }
+    for (uint64_t lane : lanes) {
+        hash = (hash ^ lane) * prime;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+uint64_t ContentHash::image(const Image& image) {
+    uint64_t shape = (static_cast<uint64_t>(image.getWidth()) << 36) ^ (static_cast<uint64_t>(image.getHeight()) << 8) ^
+                     static_cast<uint64_t>(image.getChannels());
+    return bytes(image.getData(), image.getByteSize(), shape);
+}
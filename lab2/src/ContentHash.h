@@ -0,0 +1,15 @@
+#pragma once
+#include "Image.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64-bit hashes for caches keyed by content: fast rather than cryptographic. Four independent lanes
+// keep hashing an image well ahead of any pass over its pixels.
+class ContentHash {
+public:
+    static uint64_t bytes(const void* data, size_t size, uint64_t seed = 0);
+    // Pixels and dimensions
+    static uint64_t image(const Image& image);
+    static uint64_t text(const std::string& text) { return bytes(text.data(), text.size()); }
+};
@@ -0,0 +1,282 @@
+#include "EditSession.h"
+#include "ThresholdProcessing.h"
+#include "../../lab1/utils/MemoryAccounting.h"
+#include <algorithm>
+#include <iostream>
+
+EditSession::EditSession()
+    : selectedNode(-1),
+      fullCache(std::make_shared<PipelineCache>()),
+      viewCache(std::make_shared<PipelineCache>()),
+      previewEnabled(true), previewActive(false), previewPending(false) {
+    // Over the memory budget the cached stages go, full resolution first; a cache busy with an
+    // evaluation is skipped until the next frame.
+    evictionHandler = MemoryAccounting::addEvictionHandler([this](uint64_t) {
+        uint64_t freed = fullCache->evict();
+        if (MemoryAccounting::excess() > 0) freed += viewCache->evict();
+        return freed;
+    });
+}
+
+EditSession::~EditSession() {
+    MemoryAccounting::removeEvictionHandler(evictionHandler);
+}
+
+void EditSession::poll() {
+    worker.poll();
+    MemoryAccounting::enforceBudget();
+}
+
+size_t EditSession::getImageMemory() const {
+    auto bytes = [](const Image& image) {
+        return image.getByteSize();
+    };
+    size_t total = bytes(originalView) + bytes(processedView) + bytes(previewView);
+    if (original) total += bytes(*original);
+    if (processed && processed != original) total += bytes(*processed);
+    if (previewSource && previewSource != original) total += bytes(*previewSource);
+    return total + fullCache->memoryUsage() + viewCache->memoryUsage() + history.getMemoryUsage();
+}
+
+Image EditSession::makeView(const Image& img) {
+    return Resampling::fitWithin(img, kViewMaxSide, kViewMaxSide, Resampling::Filter::Bilinear);
+}
+
+void EditSession::load(const std::string& filepath) {
+    // Whatever was queued for the previous image is stale now.
+    worker.cancelAll();
+
+    struct Loaded {
+        ImagePtr image;
+        Image view;
+        Analysis analysis;
+    };
+    auto loaded = std::make_shared<Loaded>();
+
+    worker.submit("load", "Loading", [filepath, loaded]() {
+        auto image = std::make_shared<Image>();
+        if (!image->load(filepath)) return false;
+
+        loaded->analysis.histogram = ThresholdProcessing::computeHistogram(*image);
+        loaded->analysis.otsuThreshold = ThresholdProcessing::calculateOtsuThreshold(loaded->analysis.histogram);
+        loaded->analysis.triangleThreshold = ThresholdProcessing::calculateTriangleThreshold(loaded->analysis.histogram);
+        loaded->view = makeView(*image);
+        loaded->image = std::move(image);
+        return true;
+    }, [this, filepath, loaded]() {
+        original = loaded->image;
+        processed = loaded->image;
+        previewSource = std::make_shared<Image>(loaded->view);
+        originalView = loaded->view;
+        processedView = std::move(loaded->view);
+        analysis = loaded->analysis;
+
+        // The stack is kept, so the same operations can be run on the next image
+        fullCache = std::make_shared<PipelineCache>();
+        viewCache = std::make_shared<PipelineCache>();
+        history.clear();
+        processedState = History::State();
+        discardPreview();
+        if (!pipeline.empty()) evaluateResult();
+
+        size_t lastSlash = filepath.find_last_of("/\\");
+        imageName = (lastSlash != std::string::npos) ? filepath.substr(lastSlash + 1) : filepath;
+    });
+}
+
+void EditSession::save(const std::string& filepath, int scalePercent, Resampling::Filter filter, const Image::SaveOptions& options) {
+    if (!processed) return;
+
+    // Saving commits a pending preview first, like pressing its Apply button would
+    if (previewPending) {
+        apply(previewNode);
+    }
+
+    ImagePtr source = original;
+    std::vector<PipelineNode> nodes = pipeline.getNodes();
+    auto cache = fullCache;
+
+    worker.submit("save", "Saving", [filepath, scalePercent, filter, options, source, nodes, cache]() {
+        ImagePtr full = Pipeline::evaluate(source, nodes, *cache);
+
+        bool saved;
+        if (scalePercent < 100) {
+            int width = std::max(1, full->getWidth() * scalePercent / 100);
+            int height = std::max(1, full->getHeight() * scalePercent / 100);
+            saved = Resampling::resize(*full, width, height, filter).save(filepath, options);
+        } else {
+            saved = full->save(filepath, options);
+        }
+
+        if (saved) {
+            std::cout << "Image saved successfully: " << filepath << std::endl;
+        } else {
+            std::cerr << "Failed to save image: " << filepath << std::endl;
+        }
+        return saved;
+    }, nullptr);
+}
+
+void EditSession::reset() {
+    if (!original) return;
+
+    pipeline.clear();
+    selectedNode = -1;
+    discardPreview();
+    evaluateResult();
+}
+
+void EditSession::undo() {
+    restore(true);
+}
+
+void EditSession::redo() {
+    restore(false);
+}
+
+void EditSession::restore(bool undo) {
+    if (!processed || worker.hasJob("apply")) return;
+
+    History::State state = processedState;
+    Image full, view;
+    bool restored = undo ? history.undo(state, *processed, processedView, full, view)
+                         : history.redo(state, *processed, processedView, full, view);
+    if (!restored) return;
+
+    processed = std::make_shared<Image>(std::move(full));
+    processedView = std::move(view);
+    processedState = state;
+    pipeline.setNodes(state.nodes);
+    selectedNode = state.selectedNode;
+    Pipeline::seed(original, pipeline.getNodes(), processed, *fullCache);
+    discardPreview();
+}
+
+std::vector<PipelineNode> EditSession::nodesWith(const PipelineNode& node) const {
+    std::vector<PipelineNode> nodes = pipeline.getNodes();
+    if (selectedNode >= 0 && selectedNode < static_cast<int>(nodes.size())) {
+        nodes[selectedNode] = node;
+    } else {
+        nodes.push_back(node);
+    }
+    return nodes;
+}
+
+void EditSession::preview(PipelineNode node) {
+    if (!previewEnabled || !previewSource) return;
+
+    previewNode = std::move(node);
+    previewPending = true;
+
+    ImagePtr source = previewSource;
+    std::vector<PipelineNode> nodes = nodesWith(previewNode);
+    auto cache = viewCache;
+    auto result = std::make_shared<Image>();
+
+    worker.submit("preview", "Preview", [source, nodes, cache, result]() {
+        *result = *Pipeline::evaluate(source, nodes, *cache);
+        return true;
+    }, [this, result]() {
+        previewView = std::move(*result);
+        previewActive = true;
+    });
+}
+
+void EditSession::apply(PipelineNode node) {
+    if (!original) return;
+
+    if (selectedNode >= 0 && selectedNode < static_cast<int>(pipeline.size())) {
+        pipeline.replace(selectedNode, std::move(node));
+    } else {
+        pipeline.append(std::move(node));
+    }
+    discardPreview();
+    evaluateResult();
+}
+
+void EditSession::evaluateResult() {
+    if (!original) return;
+
+    ImagePtr source = original;
+    ImagePtr previous = processed;
+    History::State state{pipeline.getNodes(), selectedNode};
+    auto cache = fullCache;
+
+    struct Evaluated {
+        ImagePtr image;
+        Image view;
+        History::Delta delta;
+    };
+    auto evaluated = std::make_shared<Evaluated>();
+
+    worker.submit("apply", "Processing", [source, previous, state, cache, evaluated]() {
+        evaluated->image = Pipeline::evaluate(source, state.nodes, *cache);
+        evaluated->view = makeView(*evaluated->image);
+        if (previous && previous != evaluated->image) {
+            evaluated->delta = History::encode(*evaluated->image, *previous);
+        }
+        return true;
+    }, [this, previous, state, evaluated]() {
+        if (previous && previous != evaluated->image) {
+            history.push(processedState, std::move(evaluated->delta),
+                         History::encode(evaluated->view, processedView));
+        }
+        processed = evaluated->image;
+        processedView = std::move(evaluated->view);
+        processedState = state;
+    });
+}
+
+void EditSession::discardPreview() {
+    worker.cancel("preview");
+    previewActive = false;
+    previewPending = false;
+}
+
+void EditSession::selectNode(int index) {
+    selectedNode = (index >= 0 && index < static_cast<int>(pipeline.size())) ? index : -1;
+    discardPreview();
+}
+
+void EditSession::removeNode(int index) {
+    if (index < 0 || index >= static_cast<int>(pipeline.size())) return;
+
+    pipeline.remove(index);
+    if (selectedNode == index) {
+        selectedNode = -1;
+    } else if (selectedNode > index) {
+        selectedNode--;
+    }
+    discardPreview();
+    evaluateResult();
+}
+
+void EditSession::setNodeEnabled(int index, bool enabled) {
+    if (index < 0 || index >= static_cast<int>(pipeline.size())) return;
+
+    pipeline.setEnabled(index, enabled);
+    discardPreview();
+    evaluateResult();
+}
+
+void EditSession::setPipeline(std::vector<PipelineNode> nodes) {
+    pipeline.setNodes(std::move(nodes));
+    selectedNode = -1;
+    discardPreview();
+    evaluateResult();
+}
+
+bool EditSession::editsOriginal() const {
+    int end = selectedNode >= 0 ? selectedNode : static_cast<int>(pipeline.size());
+    for (int i = 0; i < end; i++) {
+        if (pipeline.getNodes()[i].enabled) return false;
+    }
+    return true;
+}
+
+void EditSession::setPreviewEnabled(bool enabled) {
+    previewEnabled = enabled;
+    if (!enabled) {
+        discardPreview();
+    }
+}
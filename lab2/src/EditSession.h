@@ -0,0 +1,122 @@
+#pragma once
+#include "BackgroundWorker.h"
+#include "Histogram.h"
+#include "History.h"
+#include "Image.h"
+#include "Pipeline.h"
+#include "Resampling.h"
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The image being edited in the GUI. The result is the original run through a non-destructive
+// operation stack; loading, evaluating and saving run as background jobs, and the full-resolution
+// images are shared read-only with those jobs and swapped in by poll() once a job finishes. Only
+// the display-size views are ever turned into textures.
+class EditSession {
+public:
+    struct Analysis {
+        Histogram::Counts histogram = {0};
+        unsigned char otsuThreshold = 0;
+        unsigned char triangleThreshold = 0;
+    };
+
+    static const int kViewMaxSide = 1280;
+
+    EditSession();
+    ~EditSession();
+    EditSession(const EditSession&) = delete;
+    EditSession& operator=(const EditSession&) = delete;
+
+    // Hands finished jobs over to the session; call once per frame on the render thread.
+    void poll();
+
+    void load(const std::string& filepath);
+    void save(const std::string& filepath, int scalePercent, Resampling::Filter filter, const Image::SaveOptions& options);
+    // Clears the operation stack.
+    void reset();
+
+    // Undo and redo restore the stack together with its result; they wait for running jobs to finish.
+    bool canUndo() const { return history.canUndo() && !worker.hasJob("apply"); }
+    bool canRedo() const { return history.canRedo() && !worker.hasJob("apply"); }
+    void undo();
+    void redo();
+    const History& getHistory() const { return history; }
+    void setHistoryBudget(size_t bytes) { history.setMemoryBudget(bytes); }
+
+    // Shows the stack with `node` in place of the selected step (or appended) on the display-size
+    // view; a newer preview cancels the one still running.
+    void preview(PipelineNode node);
+    // Puts `node` in place of the selected step, or appends it, and re-evaluates at full resolution.
+    void apply(PipelineNode node);
+    void discardPreview();
+
+    const Pipeline& getPipeline() const { return pipeline; }
+    int getSelectedNode() const { return selectedNode; }
+    void selectNode(int index);
+    void removeNode(int index);
+    void setNodeEnabled(int index, bool enabled);
+    // Replaces the whole stack, e.g. with one loaded from a pipeline file; undone like any other edit.
+    void setPipeline(std::vector<PipelineNode> nodes);
+    // True when the step being edited has no enabled steps in front of it.
+    bool editsOriginal() const;
+
+    void cancelJob(uint64_t id) { worker.cancelJob(id); }
+    std::vector<BackgroundWorker::JobStatus> getJobStatus() const { return worker.getStatus(); }
+
+    bool hasImage() const { return original != nullptr; }
+    bool hasResult() const { return processed != nullptr; }
+    int getWidth() const { return original ? original->getWidth() : 0; }
+    int getHeight() const { return original ? original->getHeight() : 0; }
+    const std::string& getImageName() const { return imageName; }
+    const Analysis& getAnalysis() const { return analysis; }
+
+    const Image& getOriginalView() const { return originalView; }
+    const Image& getProcessedView() const { return processedView; }
+    const Image& getPreviewView() const { return previewView; }
+    // Pixel bytes held by the session: images, views, cached pipeline stages and undo history. The
+    // result is also the last cached stage, so it is counted twice; this is an upper bound.
+    size_t getImageMemory() const;
+    bool isPreviewActive() const { return previewActive; }
+
+    bool isPreviewEnabled() const { return previewEnabled; }
+    void setPreviewEnabled(bool enabled);
+
+private:
+    using ImagePtr = std::shared_ptr<const Image>;
+
+    std::vector<PipelineNode> nodesWith(const PipelineNode& node) const;
+    void evaluateResult();
+    void restore(bool undo);
+    static Image makeView(const Image& img);
+
+    ImagePtr original;
+    ImagePtr processed;
+    ImagePtr previewSource;
+    Image originalView;
+    Image processedView;
+    Image previewView;
+    Analysis analysis;
+    std::string imageName;
+
+    Pipeline pipeline;
+    int selectedNode;
+    // Cached stages at full and at display resolution, shared with the jobs evaluating them.
+    std::shared_ptr<PipelineCache> fullCache;
+    std::shared_ptr<PipelineCache> viewCache;
+
+    History history;
+    // The stack that produced `processed`
+    History::State processedState;
+
+    bool previewEnabled;
+    bool previewActive;
+    bool previewPending;
+    PipelineNode previewNode;
+
+    // Registration with MemoryAccounting, dropping the cached stages over the budget
+    int evictionHandler;
+
+    BackgroundWorker worker;
+};
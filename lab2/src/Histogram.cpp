@@ -1,12 +1,16 @@
 #include "Histogram.h"
+#include "Cancellation.h"
+#include "Trace.h"
 #include <algorithm>
 #include <cmath>
 
-std::array<int, 256> Histogram::compute(const Image& img, int channel) {
-    std::array<int, 256> hist = {0};
+Histogram::Counts Histogram::compute(const Image& img, int channel) {
+    Trace::Zone zone("Histogram::compute");
+    Counts hist = {0};
 
     if (channel == -1) {
         for (int y = 0; y < img.getHeight(); y++) {
+            Cancellation::checkpoint(y, img.getHeight());
             for (int x = 0; x < img.getWidth(); x++) {
                 glm::vec3 rgb = img.getPixelRGB(x, y);
                 int lum = static_cast<int>((0.299f * rgb.r + 0.587f * rgb.g + 0.114f * rgb.b) * 255);
@@ -16,6 +20,7 @@ std::array<int, 256> Histogram::compute(const Image& img, int channel) {
         }
     } else {
         for (int y = 0; y < img.getHeight(); y++) {
+            Cancellation::checkpoint(y, img.getHeight());
             for (int x = 0; x < img.getWidth(); x++) {
                 unsigned char val = img.getPixel(x, y, channel);
                 hist[val]++;
@@ -26,40 +31,46 @@ std::array<int, 256> Histogram::compute(const Image& img, int channel) {
     return hist;
 }
 
-std::array<int, 256> Histogram::computeLuminance(const Image& img) {
+Histogram::Counts Histogram::computeLuminance(const Image& img) {
+    Trace::Zone zone("Histogram::computeLuminance");
     return compute(img, -1);
 }
 
+std::array<unsigned char, 256> Histogram::equalizationLUT(const Counts& hist) {
+    Counts cdf = {0};
+    cdf[0] = hist[0];
+    for (int i = 1; i < 256; i++) {
+        cdf[i] = cdf[i-1] + hist[i];
+    }
+
+    uint64_t cdfMin = cdf[0];
+    for (int i = 0; i < 256; i++) {
+        if (cdf[i] > 0) {
+            cdfMin = cdf[i];
+            break;
+        }
+    }
+
+    uint64_t totalPixels = cdf[255];
+    std::array<unsigned char, 256> lut;
+
+    for (int i = 0; i < 256; i++) {
+        lut[i] = static_cast<unsigned char>(
+            std::round((static_cast<float>(cdf[i] - cdfMin) / static_cast<float>(totalPixels - cdfMin)) * 255.0f)
+        );
+    }
+    return lut;
+}
+
 Image Histogram::equalizeRGB(const Image& img) {
+    Trace::Zone zone("Histogram::equalizeRGB");
     Image result = img.clone();
 
     for (int c = 0; c < std::min(3, img.getChannels()); c++) {
-        auto hist = compute(img, c);
-
-        std::array<int, 256> cdf = {0};
-        cdf[0] = hist[0];
-        for (int i = 1; i < 256; i++) {
-            cdf[i] = cdf[i-1] + hist[i];
-        }
-
-        int cdfMin = cdf[0];
-        for (int i = 0; i < 256; i++) {
-            if (cdf[i] > 0) {
-                cdfMin = cdf[i];
-                break;
-            }
-        }
-        
-        int totalPixels = img.getWidth() * img.getHeight();
-        std::array<unsigned char, 256> lut;
-        
-        for (int i = 0; i < 256; i++) {
-            lut[i] = static_cast<unsigned char>(
-                std::round(((cdf[i] - cdfMin) / static_cast<float>(totalPixels - cdfMin)) * 255.0f)
-            );
-        }
+        auto lut = equalizationLUT(compute(img, c));
 
         for (int y = 0; y < img.getHeight(); y++) {
+            Cancellation::checkpoint(y, img.getHeight());
             for (int x = 0; x < img.getWidth(); x++) {
                 unsigned char oldVal = img.getPixel(x, y, c);
                 result.setPixel(x, y, c, lut[oldVal]);
@@ -72,11 +83,13 @@ Image Histogram::equalizeRGB(const Image& img) {
 }
 
 Image Histogram::equalizeHSV(const Image& img) {
+    Trace::Zone zone("Histogram::equalizeHSV");
     Image result = img.clone();
 
-    std::array<int, 256> hist = {0};
+    Counts hist = {0};
     
     for (int y = 0; y < img.getHeight(); y++) {
+        Cancellation::checkpoint(y, img.getHeight());
         for (int x = 0; x < img.getWidth(); x++) {
             glm::vec3 rgb = img.getPixelRGB(x, y);
             glm::vec3 hsv = RGBtoHSV(rgb);
@@ -86,13 +99,13 @@ Image Histogram::equalizeHSV(const Image& img) {
         }
     }
 
-    std::array<int, 256> cdf = {0};
+    Counts cdf = {0};
     cdf[0] = hist[0];
     for (int i = 1; i < 256; i++) {
         cdf[i] = cdf[i-1] + hist[i];
     }
 
-    int cdfMin = cdf[0];
+    uint64_t cdfMin = cdf[0];
     for (int i = 0; i < 256; i++) {
         if (cdf[i] > 0) {
             cdfMin = cdf[i];
@@ -100,16 +113,17 @@ Image Histogram::equalizeHSV(const Image& img) {
         }
     }
     
-    int totalPixels = img.getWidth() * img.getHeight();
+    uint64_t totalPixels = static_cast<uint64_t>(img.getWidth()) * img.getHeight();
     std::array<unsigned char, 256> lut;
     
     for (int i = 0; i < 256; i++) {
         lut[i] = static_cast<unsigned char>(
-            std::round(((cdf[i] - cdfMin) / static_cast<float>(totalPixels - cdfMin)) * 255.0f)
+            std::round((static_cast<float>(cdf[i] - cdfMin) / static_cast<float>(totalPixels - cdfMin)) * 255.0f)
         );
     }
 
     for (int y = 0; y < img.getHeight(); y++) {
+        Cancellation::checkpoint(y, img.getHeight());
         for (int x = 0; x < img.getWidth(); x++) {
             glm::vec3 rgb = img.getPixelRGB(x, y);
             glm::vec3 hsv = RGBtoHSV(rgb);
@@ -128,13 +142,14 @@ Image Histogram::equalizeHSV(const Image& img) {
 }
 
 Image Histogram::linearContrast(const Image& img, float minPercentile, float maxPercentile) {
+    Trace::Zone zone("Histogram::linearContrast");
     auto hist = computeLuminance(img);
     
-    int totalPixels = img.getWidth() * img.getHeight();
-    int minCount = static_cast<int>(totalPixels * minPercentile / 100.0f);
-    int maxCount = static_cast<int>(totalPixels * maxPercentile / 100.0f);
+    uint64_t totalPixels = static_cast<uint64_t>(img.getWidth()) * img.getHeight();
+    uint64_t minCount = static_cast<uint64_t>(std::max(0.0f, totalPixels * minPercentile / 100.0f));
+    uint64_t maxCount = static_cast<uint64_t>(std::max(0.0f, totalPixels * maxPercentile / 100.0f));
 
-    int cumSum = 0;
+    uint64_t cumSum = 0;
     unsigned char minVal = 0, maxVal = 255;
     
     for (int i = 0; i < 256; i++) {
@@ -148,7 +163,7 @@ Image Histogram::linearContrast(const Image& img, float minPercentile, float max
     cumSum = 0;
     for (int i = 255; i >= 0; i--) {
         cumSum += hist[i];
-        if (cumSum >= totalPixels - maxCount) {
+        if (cumSum + maxCount >= totalPixels) {
             maxVal = i;
             break;
         }
@@ -158,6 +173,7 @@ Image Histogram::linearContrast(const Image& img, float minPercentile, float max
 }
 
 Image Histogram::linearContrastManual(const Image& img, unsigned char minIn, unsigned char maxIn) {
+    Trace::Zone zone("Histogram::linearContrastManual");
     Image result = img.clone();
     
     if (minIn >= maxIn) {
@@ -167,6 +183,7 @@ Image Histogram::linearContrastManual(const Image& img, unsigned char minIn, uns
     float scale = 255.0f / (maxIn - minIn);
     
     for (int y = 0; y < img.getHeight(); y++) {
+        Cancellation::checkpoint(y, img.getHeight());
         for (int x = 0; x < img.getWidth(); x++) {
             for (int c = 0; c < std::min(3, img.getChannels()); c++) {
                 unsigned char val = img.getPixel(x, y, c);
@@ -2,12 +2,18 @@
 #include "Image.h"
 #include <vector>
 #include <array>
+#include <cstdint>
 
 class Histogram {
 public:
-    static std::array<int, 256> compute(const Image& img, int channel = -1);
-    static std::array<int, 256> computeLuminance(const Image& img);
+    // Pixels per value, in 64 bits so that counts and their sums hold for images of any size
+    using Counts = std::array<uint64_t, 256>;
 
+    static Counts compute(const Image& img, int channel = -1);
+    static Counts computeLuminance(const Image& img);
+
+    // Maps values so that their cumulative distribution becomes linear
+    static std::array<unsigned char, 256> equalizationLUT(const Counts& hist);
     static Image equalizeRGB(const Image& img);
     static Image equalizeHSV(const Image& img);
 
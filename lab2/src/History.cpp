@@ -0,0 +1,428 @@
+#include "History.h"
+#include "Parallel.h"
+#include "../../lab1/utils/MemoryAccounting.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+namespace {
+    const int kMaxBands = 64;
+    // Equal bytes needed to end a literal run; shorter matches are cheaper to keep as literals.
+    const size_t kMinZeroRun = 8;
+
+    void writeVarint(std::vector<unsigned char>& out, size_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<unsigned char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<unsigned char>(value));
+    }
+
+    size_t readVarint(const unsigned char*& in) {
+        size_t value = 0;
+        int shift = 0;
+        while (*in & 0x80) {
+            value |= static_cast<size_t>(*in++ & 0x7F) << shift;
+            shift += 7;
+        }
+        value |= static_cast<size_t>(*in++) << shift;
+        return value;
+    }
+
+    // Encodes `to` XOR `from` (or `to` alone when there is no `from`) as alternating
+    // [zero run length][literal length][literal bytes] records.
+    template <bool HasBase>
+    void encodeBand(const unsigned char* from, const unsigned char* to, size_t size, std::vector<unsigned char>& out) {
+        auto same = [&](size_t i) { return HasBase ? from[i] == to[i] : to[i] == 0; };
+
+        size_t i = 0;
+        while (i < size) {
+            size_t zeroEnd = i;
+            if (HasBase) {
+                while (zeroEnd + 8 <= size && std::memcmp(from + zeroEnd, to + zeroEnd, 8) == 0) zeroEnd += 8;
+            }
+            while (zeroEnd < size && same(zeroEnd)) zeroEnd++;
+
+            size_t literalEnd = zeroEnd;
+            size_t equal = 0;
+            while (literalEnd < size) {
+                if (same(literalEnd)) {
+                    if (++equal >= kMinZeroRun) break;
+                } else {
+                    equal = 0;
+                }
+                literalEnd++;
+            }
+            literalEnd = (literalEnd < size) ? literalEnd + 1 - kMinZeroRun : size - equal;
+
+            writeVarint(out, zeroEnd - i);
+            writeVarint(out, literalEnd - zeroEnd);
+            for (size_t k = zeroEnd; k < literalEnd; k++) {
+                out.push_back(HasBase ? from[k] ^ to[k] : to[k]);
+            }
+            i = literalEnd;
+        }
+    }
+
+    void decodeBand(const std::vector<unsigned char>& band, const unsigned char* base, unsigned char* out, size_t size) {
+        const unsigned char* in = band.data();
+        const unsigned char* end = in + band.size();
+        size_t pos = 0;
+        while (in < end && pos < size) {
+            size_t zeroRun = std::min(readVarint(in), size - pos);
+            if (base) {
+                std::memcpy(out + pos, base + pos, zeroRun);
+            } else {
+                std::memset(out + pos, 0, zeroRun);
+            }
+            pos += zeroRun;
+
+            size_t literal = std::min(readVarint(in), size - pos);
+            if (base) {
+                for (size_t k = 0; k < literal; k++) {
+                    out[pos + k] = base[pos + k] ^ in[k];
+                }
+            } else {
+                std::memcpy(out + pos, in, literal);
+            }
+            in += literal;
+            pos += literal;
+        }
+
+        // Records stop at the last change; the rest is unchanged
+        if (pos < size) {
+            if (base) {
+                std::memcpy(out + pos, base + pos, size - pos);
+            } else {
+                std::memset(out + pos, 0, size - pos);
+            }
+        }
+    }
+
+    // Offsets past 2 GB, which long cannot hold on Windows
+    bool seek(FILE* file, int64_t offset) {
+#ifdef _WIN32
+        return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+        return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+    }
+
+    int64_t spillBytes(const std::vector<size_t>& sizes) {
+        int64_t total = 0;
+        for (size_t size : sizes) {
+            total += static_cast<int64_t>(size);
+        }
+        return total;
+    }
+
+    int bandCount(int height) {
+        return std::max(1, std::min(kMaxBands, height));
+    }
+
+    // Byte range of a band; bands are whole rows so they split the same way on every machine
+    void bandRange(int band, int bands, int height, size_t rowBytes, size_t& begin, size_t& size) {
+        int rowsPerBand = (height + bands - 1) / bands;
+        int firstRow = std::min(height, band * rowsPerBand);
+        int lastRow = std::min(height, firstRow + rowsPerBand);
+        begin = static_cast<size_t>(firstRow) * rowBytes;
+        size = static_cast<size_t>(lastRow - firstRow) * rowBytes;
+    }
+}
+
+size_t History::Delta::byteSize() const {
+    size_t total = 0;
+    for (const auto& band : bands) {
+        total += band.size();
+    }
+    return total;
+}
+
+History::History(size_t memoryBudget)
+    : memoryBudget(memoryBudget), memoryUsage(0), reportedUsage(0), spilledBytes(0), spillFile(nullptr), spillEnd(0) {}
+
+History::~History() {
+    MemoryAccounting::release(MemoryAccounting::Category::History, reportedUsage);
+    closeSpillFile();
+}
+
+History::Delta History::encode(const Image& from, const Image& to) {
+    Delta delta;
+    delta.width = to.getWidth();
+    delta.height = to.getHeight();
+    delta.channels = to.getChannels();
+    delta.snapshot = from.getWidth() != to.getWidth() || from.getHeight() != to.getHeight() ||
+                     from.getChannels() != to.getChannels() || !from.getData();
+    if (!to.getData()) return delta;
+
+    size_t rowBytes = static_cast<size_t>(delta.width) * delta.channels;
+    int bands = bandCount(delta.height);
+    delta.bands.resize(bands);
+
+    parallelFor(0, bands, [&](int bandBegin, int bandEnd) {
+        for (int b = bandBegin; b < bandEnd; b++) {
+            size_t begin, size;
+            bandRange(b, bands, delta.height, rowBytes, begin, size);
+            if (delta.snapshot) {
+                encodeBand<false>(nullptr, to.getData() + begin, size, delta.bands[b]);
+            } else {
+                encodeBand<true>(from.getData() + begin, to.getData() + begin, size, delta.bands[b]);
+            }
+            delta.bands[b].shrink_to_fit();
+        }
+    }, 1);
+
+    return delta;
+}
+
+Image History::apply(const Image& img, const Delta& delta) {
+    if (delta.bands.empty()) return Image(delta.width, delta.height, delta.channels);
+
+    // Every byte is decoded, so the buffer is not zero-filled first
+    Image result;
+    result.resize(delta.width, delta.height, delta.channels);
+    if (!result.getData()) return result;
+
+    const unsigned char* base = delta.snapshot ? nullptr : img.getData();
+    size_t rowBytes = static_cast<size_t>(delta.width) * delta.channels;
+    int bands = static_cast<int>(delta.bands.size());
+
+    parallelFor(0, bands, [&](int bandBegin, int bandEnd) {
+        for (int b = bandBegin; b < bandEnd; b++) {
+            size_t begin, size;
+            bandRange(b, bands, delta.height, rowBytes, begin, size);
+            decodeBand(delta.bands[b], base ? base + begin : nullptr, result.getData() + begin, size);
+        }
+    }, 1);
+
+    result.updateTexture();
+    return result;
+}
+
+void History::push(State previous, Delta fullDelta, Delta viewDelta) {
+    for (auto& step : redoSteps) {
+        release(step);
+    }
+    redoSteps.clear();
+
+    Step step;
+    step.state = std::move(previous);
+    step.full = std::move(fullDelta);
+    step.view = std::move(viewDelta);
+    memoryUsage += step.full.byteSize() + step.view.byteSize();
+    undoSteps.push_back(std::move(step));
+
+    while (undoSteps.size() > kMaxSteps) {
+        release(undoSteps.front());
+        undoSteps.pop_front();
+    }
+    enforceBudget();
+    reportUsage();
+}
+
+bool History::undo(State& state, const Image& full, const Image& view, Image& outFull, Image& outView) {
+    return step(undoSteps, redoSteps, state, full, view, outFull, outView);
+}
+
+bool History::redo(State& state, const Image& full, const Image& view, Image& outFull, Image& outView) {
+    return step(redoSteps, undoSteps, state, full, view, outFull, outView);
+}
+
+bool History::step(std::deque<Step>& from, std::deque<Step>& to, State& state,
+                   const Image& full, const Image& view, Image& outFull, Image& outView) {
+    if (from.empty()) return false;
+
+    Step step = std::move(from.back());
+    from.pop_back();
+    if (step.spilled && !restore(step)) {
+        std::cerr << "Failed to read history step back from the spill file" << std::endl;
+        from.push_back(std::move(step));
+        return false;
+    }
+    memoryUsage -= step.full.byteSize() + step.view.byteSize();
+
+    Image newFull = apply(full, step.full);
+    Image newView = apply(view, step.view);
+
+    // An XOR delta leads back the same way; a snapshot has to be replaced by one of the image we leave
+    if (step.full.snapshot) step.full = encode(newFull, full);
+    if (step.view.snapshot) step.view = encode(newView, view);
+
+    std::swap(state, step.state);
+    outFull = std::move(newFull);
+    outView = std::move(newView);
+
+    memoryUsage += step.full.byteSize() + step.view.byteSize();
+    to.push_back(std::move(step));
+    enforceBudget();
+    reportUsage();
+    return true;
+}
+
+void History::clear() {
+    undoSteps.clear();
+    redoSteps.clear();
+    memoryUsage = 0;
+    spilledBytes = 0;
+    closeSpillFile();
+    reportUsage();
+}
+
+void History::setMemoryBudget(size_t bytes) {
+    memoryBudget = bytes;
+    enforceBudget();
+    reportUsage();
+}
+
+void History::enforceBudget() {
+    // Oldest undo steps go first, then the redo steps furthest away
+    for (auto& step : undoSteps) {
+        if (memoryUsage <= memoryBudget) return;
+        if (!step.spilled) spill(step);
+    }
+    for (auto& step : redoSteps) {
+        if (memoryUsage <= memoryBudget) return;
+        if (!step.spilled) spill(step);
+    }
+
+    // Without a spill file the oldest steps are dropped instead
+    while (memoryUsage > memoryBudget && !undoSteps.empty()) {
+        release(undoSteps.front());
+        undoSteps.pop_front();
+    }
+    while (memoryUsage > memoryBudget && !redoSteps.empty()) {
+        release(redoSteps.front());
+        redoSteps.pop_front();
+    }
+}
+
+void History::reportUsage() {
+    using MemoryAccounting::Category;
+    if (memoryUsage > reportedUsage) {
+        MemoryAccounting::add(Category::History, memoryUsage - reportedUsage);
+    } else {
+        MemoryAccounting::release(Category::History, reportedUsage - memoryUsage);
+    }
+    reportedUsage = memoryUsage;
+}
+
+bool History::spill(Step& step) {
+    if (!spillFile) {
+        spillFile = std::tmpfile();
+        if (!spillFile) return false;
+    }
+
+    std::vector<size_t> sizes;
+    for (Delta* delta : {&step.full, &step.view}) {
+        for (const auto& band : delta->bands) {
+            sizes.push_back(band.size());
+        }
+    }
+    int64_t total = spillBytes(sizes);
+    int64_t offset = allocateSpill(total);
+    bool written = seek(spillFile, offset);
+    for (Delta* delta : {&step.full, &step.view}) {
+        for (const auto& band : delta->bands) {
+            if (!written) break;
+            written = band.empty() || fwrite(band.data(), 1, band.size(), spillFile) == band.size();
+        }
+    }
+    if (!written || fflush(spillFile) != 0) {
+        freeSpill(offset, total);
+        return false;
+    }
+
+    size_t bytes = step.full.byteSize() + step.view.byteSize();
+    for (Delta* delta : {&step.full, &step.view}) {
+        for (auto& band : delta->bands) {
+            std::vector<unsigned char>().swap(band);
+        }
+    }
+    step.spilled = true;
+    step.spillOffset = offset;
+    step.spillSizes = std::move(sizes);
+    memoryUsage -= bytes;
+    spilledBytes += bytes;
+    return true;
+}
+
+bool History::restore(Step& step) {
+    if (!spillFile || !seek(spillFile, step.spillOffset)) return false;
+
+    size_t index = 0;
+    size_t bytes = 0;
+    for (Delta* delta : {&step.full, &step.view}) {
+        for (auto& band : delta->bands) {
+            band.resize(step.spillSizes[index++]);
+            if (!band.empty() && fread(band.data(), 1, band.size(), spillFile) != band.size()) return false;
+            bytes += band.size();
+        }
+    }
+
+    step.spilled = false;
+    step.spillSizes.clear();
+    memoryUsage += bytes;
+    spilledBytes -= bytes;
+    freeSpill(step.spillOffset, static_cast<int64_t>(bytes));
+    return true;
+}
+
+void History::release(Step& step) {
+    if (step.spilled) {
+        int64_t bytes = spillBytes(step.spillSizes);
+        spilledBytes -= static_cast<size_t>(bytes);
+        freeSpill(step.spillOffset, bytes);
+    } else {
+        memoryUsage -= step.full.byteSize() + step.view.byteSize();
+    }
+}
+
+int64_t History::allocateSpill(int64_t bytes) {
+    for (auto it = spillFree.begin(); it != spillFree.end(); ++it) {
+        if (it->second < bytes) continue;
+        int64_t offset = it->first;
+        int64_t rest = it->second - bytes;
+        spillFree.erase(it);
+        if (rest > 0) spillFree[offset + bytes] = rest;
+        return offset;
+    }
+    int64_t offset = spillEnd;
+    spillEnd += bytes;
+    return offset;
+}
+
+void History::freeSpill(int64_t offset, int64_t bytes) {
+    if (bytes <= 0) return;
+
+    // Merge with the free neighbours on both sides
+    auto next = spillFree.lower_bound(offset);
+    if (next != spillFree.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            bytes += prev->second;
+            spillFree.erase(prev);
+        }
+    }
+    if (next != spillFree.end() && offset + bytes == next->first) {
+        bytes += next->second;
+        spillFree.erase(next);
+    }
+
+    if (offset + bytes == spillEnd) {
+        spillEnd = offset;
+    } else {
+        spillFree[offset] = bytes;
+    }
+    if (spillEnd == 0) closeSpillFile();
+}
+
+void History::closeSpillFile() {
+    if (spillFile) {
+        fclose(spillFile);
+        spillFile = nullptr;
+    }
+    spillEnd = 0;
+    spillFree.clear();
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "Image.h"
+#include "Pipeline.h"
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+
+// Undo/redo for the edit session. A step stores the operation stack on its far side and the
+// difference between the two results as a run-length encoded XOR delta, which turns one result into
+// the other in either direction. Steps beyond the memory budget are spilled to a temporary file.
+class History {
+public:
+    struct State {
+        std::vector<PipelineNode> nodes;
+        int selectedNode = -1;
+    };
+
+    // XOR of two equally sized images (or a plain snapshot when the sizes differ), split into bands
+    // that are encoded and decoded in parallel.
+    struct Delta {
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        bool snapshot = false;
+        std::vector<std::vector<unsigned char>> bands;
+
+        size_t byteSize() const;
+    };
+
+    static const size_t kDefaultBudget = 256ull * 1024 * 1024;
+    static const size_t kMaxSteps = 200;
+
+    explicit History(size_t memoryBudget = kDefaultBudget);
+    ~History();
+
+    History(const History&) = delete;
+    History& operator=(const History&) = delete;
+
+    static Delta encode(const Image& from, const Image& to);
+    // Returns `img` with the delta applied, i.e. the image on the other side of the step.
+    static Image apply(const Image& img, const Delta& delta);
+
+    // Records a step back to `previous`; `fullDelta` and `viewDelta` lead from the new result to
+    // the previous one. Clears the redo steps.
+    void push(State previous, Delta fullDelta, Delta viewDelta);
+
+    bool canUndo() const { return !undoSteps.empty(); }
+    bool canRedo() const { return !redoSteps.empty(); }
+    size_t undoCount() const { return undoSteps.size(); }
+    size_t redoCount() const { return redoSteps.size(); }
+
+    // Steps back (or forward) from the current `full` and `view`: `state` is swapped with the
+    // stored one and the results on the other side of the step are written to `outFull`/`outView`.
+    bool undo(State& state, const Image& full, const Image& view, Image& outFull, Image& outView);
+    bool redo(State& state, const Image& full, const Image& view, Image& outFull, Image& outView);
+    void clear();
+
+    void setMemoryBudget(size_t bytes);
+    size_t getMemoryBudget() const { return memoryBudget; }
+    size_t getMemoryUsage() const { return memoryUsage; }
+    size_t getSpilledBytes() const { return spilledBytes; }
+
+private:
+    struct Step {
+        State state;
+        Delta full;
+        Delta view;
+        // Location of the encoded bands in the spill file; the bands are empty while spilled
+        bool spilled = false;
+        int64_t spillOffset = 0;
+        std::vector<size_t> spillSizes;
+    };
+
+    bool step(std::deque<Step>& from, std::deque<Step>& to, State& state,
+              const Image& full, const Image& view, Image& outFull, Image& outView);
+    void enforceBudget();
+    // Brings MemoryAccounting up to date with memoryUsage
+    void reportUsage();
+    bool spill(Step& step);
+    bool restore(Step& step);
+    void release(Step& step);
+    // Ranges of the spill file: freed ones are reused before the file grows, and the file is
+    // closed, which deletes it, once nothing is left in it.
+    int64_t allocateSpill(int64_t bytes);
+    void freeSpill(int64_t offset, int64_t bytes);
+    void closeSpillFile();
+
+    std::deque<Step> undoSteps;
+    std::deque<Step> redoSteps;
+    size_t memoryBudget;
+    size_t memoryUsage;
+    size_t reportedUsage;
+    size_t spilledBytes;
+    FILE* spillFile;
+    int64_t spillEnd;
+    // Free ranges below spillEnd by offset
+    std::map<int64_t, int64_t> spillFree;
+};
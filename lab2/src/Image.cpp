@@ -1,35 +1,173 @@
 #include "Image.h"
+#include "MappedFile.h"
+#include "Png.h"
+#include "Pnm.h"
+#include "Qoi.h"
+#include "Trace.h"
 #include <iostream>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <filesystem>
 #include <algorithm>
+#include <atomic>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include "../../lab1/utils/MemoryAccounting.h"
+#include "../../lab1/utils/Profiler.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
 
+// Headless builds (command-line tools) link no GL; images there never have textures.
+#ifndef LAB2_HEADLESS
 #include <glad/glad.h>
+#endif
 
-Image::Image() : width(0), height(0), channels(0), data(nullptr), textureID(0) {}
+namespace {
+    using MemoryAccounting::Category;
+    using Format = Image::SaveOptions::Format;
 
-Image::Image(int w, int h, int c) : width(w), height(h), channels(c), textureID(0) {
-    data = new unsigned char[width * height * channels];
-    std::memset(data, 0, width * height * channels);
-    createTexture();
+    // Raw files: this magic, then width, height and channels as little-endian 32-bit numbers, then
+    // the pixels row by row. The header keeps the pixels 16-byte aligned for mapping.
+    const char kRawMagic[4] = {'L', '2', 'R', 'W'};
+    const size_t kRawHeaderBytes = 16;
+
+    // Size of a buffer for new dimensions; throws rather than wrapping around to a small one
+    size_t pixelBytes(int width, int height, int channels) {
+        size_t bytes = 0;
+        if (!Image::byteSize(width, height, channels, bytes)) {
+            throw std::overflow_error("image size " + std::to_string(width) + "x" + std::to_string(height) + "x" +
+                                      std::to_string(channels) + " does not fit in memory");
+        }
+        return bytes;
+    }
+
+    uint64_t nextGeneration() {
+        static std::atomic<uint64_t> counter{0};
+        return ++counter;
+    }
+
+    // Every pixel buffer goes through these two, so MemoryAccounting sees all of them
+    unsigned char* allocatePixels(size_t bytes) {
+        unsigned char* pixels = new unsigned char[bytes];
+        MemoryAccounting::add(Category::PixelBuffers, bytes);
+        return pixels;
+    }
+
+    void freePixels(unsigned char* pixels, size_t bytes) {
+        if (!pixels) return;
+        delete[] pixels;
+        MemoryAccounting::release(Category::PixelBuffers, bytes);
+    }
+
+    // Size and pixel offset of a binary 8-bit PNM file; false for any other file
+    bool readPnmLayout(const std::string& filepath, Pnm::Header& header, uint64_t& offset) {
+        FILE* file = std::fopen(filepath.c_str(), "rb");
+        if (!file) return false;
+        bool ok = false;
+        try {
+            ok = Pnm::readHeader(file, header);
+        } catch (const std::runtime_error&) {
+        }
+        // Headers are a few dozen bytes, well within what ftell reports
+        long position = ok ? std::ftell(file) : -1;
+        std::fclose(file);
+        if (position < 0) return false;
+        offset = static_cast<uint64_t>(position);
+        return true;
+    }
+
+    // Whether the file has `bytes` pixel bytes after `offset`, checked before sizing a buffer by a
+    // header that may be lying
+    bool fileHolds(const std::string& filepath, uint64_t offset, size_t bytes) {
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(filepath, ec);
+        return !ec && size >= offset && size - offset >= bytes;
+    }
+
+    bool readRawLayout(const std::string& filepath, int& width, int& height, int& channels) {
+        unsigned char header[kRawHeaderBytes];
+        FILE* file = std::fopen(filepath.c_str(), "rb");
+        if (!file) return false;
+        bool ok = std::fread(header, 1, kRawHeaderBytes, file) == kRawHeaderBytes &&
+                  std::memcmp(header, kRawMagic, sizeof(kRawMagic)) == 0;
+        std::fclose(file);
+        if (!ok) return false;
+
+        uint32_t fields[3];
+        for (int i = 0; i < 3; i++) {
+            const unsigned char* p = header + 4 + 4 * i;
+            fields[i] = uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+            if (fields[i] > INT_MAX) return false;
+        }
+        width = static_cast<int>(fields[0]);
+        height = static_cast<int>(fields[1]);
+        channels = static_cast<int>(fields[2]);
+        size_t bytes;
+        return channels >= 1 && channels <= 4 && Image::byteSize(width, height, channels, bytes);
+    }
+
+    bool writeRaw(FILE* file, const Image& image) {
+        unsigned char header[kRawHeaderBytes] = {};
+        std::memcpy(header, kRawMagic, sizeof(kRawMagic));
+        const uint32_t fields[3] = {static_cast<uint32_t>(image.getWidth()), static_cast<uint32_t>(image.getHeight()),
+                                    static_cast<uint32_t>(image.getChannels())};
+        for (int i = 0; i < 3; i++) {
+            for (int b = 0; b < 4; b++) header[4 + 4 * i + b] = static_cast<unsigned char>(fields[i] >> (8 * b));
+        }
+        size_t size = image.getByteSize();
+        return std::fwrite(header, 1, kRawHeaderBytes, file) == kRawHeaderBytes &&
+               std::fwrite(image.getData(), 1, size, file) == size;
+    }
+
+    std::string lowercaseExtension(const std::string& filepath) {
+        size_t dot = filepath.find_last_of('.');
+        size_t slash = filepath.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return "";
+        std::string extension = filepath.substr(dot);
+        for (char& c : extension) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return extension;
+    }
+}
+
+Image::Image()
+    : width(0), height(0), channels(0), data(nullptr), storage(Storage::Allocated), textureID(0), textureDirty(false), textureBytes(0),
+      generation(nextGeneration()) {}
+
+Image::Image(int w, int h, int c)
+    : width(w), height(h), channels(c), storage(Storage::Allocated), textureID(0), textureDirty(true), textureBytes(0),
+      generation(nextGeneration()) {
+    data = allocatePixels(pixelBytes(w, h, c));
+    std::memset(data, 0, getByteSize());
+}
+
+bool Image::byteSize(int w, int h, int c, size_t& bytes) {
+    if (w < 0 || h < 0 || c < 0) return false;
+    const size_t limit = std::numeric_limits<size_t>::max();
+    size_t stride = static_cast<size_t>(w);
+    if (c != 0 && stride > limit / static_cast<size_t>(c)) return false;
+    stride *= static_cast<size_t>(c);
+    if (h != 0 && stride > limit / static_cast<size_t>(h)) return false;
+    bytes = stride * static_cast<size_t>(h);
+    return true;
 }
 
 Image::~Image() {
-    delete[] data;
+    releasePixels();
     deleteTexture();
 }
 
 Image::Image(const Image& other)
-    : width(other.width), height(other.height), channels(other.channels), textureID(0) {
+    : width(other.width), height(other.height), channels(other.channels), storage(Storage::Allocated),
+      textureID(0), textureDirty(true), textureBytes(0), generation(nextGeneration()) {
     if (other.data) {
-        data = new unsigned char[width * height * channels];
-        std::memcpy(data, other.data, width * height * channels);
-        createTexture();
-        updateTexture();
+        data = allocatePixels(getByteSize());
+        std::memcpy(data, other.data, getByteSize());
     } else {
         data = nullptr;
     }
@@ -37,7 +175,7 @@ Image::Image(const Image& other)
 
 Image& Image::operator=(const Image& other) {
     if (this != &other) {
-        delete[] data;
+        releasePixels();
         deleteTexture();
 
         width = other.width;
@@ -45,82 +183,306 @@ Image& Image::operator=(const Image& other) {
         channels = other.channels;
 
         if (other.data) {
-            data = new unsigned char[width * height * channels];
-            std::memcpy(data, other.data, width * height * channels);
-            createTexture();
-            updateTexture();
+            data = allocatePixels(getByteSize());
+            std::memcpy(data, other.data, getByteSize());
+            textureDirty = true;
         } else {
             data = nullptr;
-            textureID = 0;
         }
+        generation = nextGeneration();
     }
     return *this;
 }
 
 Image::Image(Image&& other) noexcept
     : width(other.width), height(other.height), channels(other.channels),
-      data(other.data), textureID(other.textureID) {
+      data(other.data), storage(other.storage), mapping(std::move(other.mapping)),
+      textureID(other.textureID), textureDirty(other.textureDirty), textureBytes(other.textureBytes),
+      generation(other.generation) {
     other.data = nullptr;
+    other.storage = Storage::Allocated;
     other.textureID = 0;
+    other.textureBytes = 0;
     other.width = 0;
     other.height = 0;
     other.channels = 0;
+    other.generation = nextGeneration();
 }
 
 Image& Image::operator=(Image&& other) noexcept {
     if (this != &other) {
-        delete[] data;
+        releasePixels();
         deleteTexture();
 
         width = other.width;
         height = other.height;
         channels = other.channels;
         data = other.data;
+        storage = other.storage;
+        mapping = std::move(other.mapping);
         textureID = other.textureID;
+        textureDirty = other.textureDirty;
+        textureBytes = other.textureBytes;
+        generation = other.generation;
 
         other.data = nullptr;
+        other.storage = Storage::Allocated;
         other.textureID = 0;
+        other.textureBytes = 0;
         other.width = 0;
         other.height = 0;
         other.channels = 0;
+        other.generation = nextGeneration();
     }
     return *this;
 }
 
 bool Image::load(const std::string& filepath) {
-    if (data) {
-        delete[] data;
-        data = nullptr;
+    Trace::Zone zone("Image::load");
+    Profiler::ScopedTimer timer("Image::load");
+    Pnm::Header header;
+    uint64_t offset = 0;
+    if (readPnmLayout(filepath, header, offset) && mapRaw(filepath, header.width, header.height, header.channels, offset)) {
+        return true;
+    }
+    int rawWidth, rawHeight, rawChannels;
+    if (readRawLayout(filepath, rawWidth, rawHeight, rawChannels) &&
+        mapRaw(filepath, rawWidth, rawHeight, rawChannels, kRawHeaderBytes)) {
+        return true;
+    }
+    releasePixels();
+    if (FILE* file = std::fopen(filepath.c_str(), "rb")) {
+        bool decoded = false;
+        try {
+            decoded = Qoi::read(file, *this);
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Failed to load image: " << filepath << ": " << e.what() << std::endl;
+            std::fclose(file);
+            return false;
+        }
+        std::fclose(file);
+        if (decoded) return true;
     }
     
     data = stbi_load(filepath.c_str(), &width, &height, &channels, 0);
     
     if (!data) {
         std::cerr << "Failed to load image: " << filepath << std::endl;
+        width = height = channels = 0;
         return false;
     }
+    storage = Storage::Decoded;
+    MemoryAccounting::add(Category::PixelBuffers, getByteSize());
     
-    createTexture();
     updateTexture();
     
     return true;
 }
 
-bool Image::save(const std::string& filepath) {
+bool Image::read(const std::string& filepath, std::string* error) {
+    Trace::Zone zone("Image::read");
+    Profiler::ScopedTimer timer("Image::read");
+    auto fail = [&](const std::string& reason) {
+        if (error) {
+            *error = reason;
+        } else {
+            std::cerr << "Failed to load image: " << filepath << ": " << reason << std::endl;
+        }
+        return false;
+    };
+    // Writing into a mapping would only fill copy-on-write pages
+    if (storage == Storage::Mapped) releasePixels();
+
+    Pnm::Header header;
+    uint64_t offset = 0;
+    bool pnm = readPnmLayout(filepath, header, offset);
+    size_t bytes = 0;
+    if (pnm && (!byteSize(header.width, header.height, header.channels, bytes) || !fileHolds(filepath, offset, bytes))) {
+        return fail("truncated PNM frame");
+    }
+    FILE* file = std::fopen(filepath.c_str(), "rb");
+    if (!file) return fail(std::strerror(errno));
+    bool decoded = false;
+    try {
+        Pnm::Format format;
+        decoded = pnm ? Pnm::read(file, *this, format) : Qoi::read(file, *this);
+    } catch (const std::runtime_error& e) {
+        std::fclose(file);
+        return fail(e.what());
+    }
+    std::fclose(file);
+    if (decoded) {
+        updateTexture();
+        return true;
+    }
+
+    int w, h, c;
+    if (readRawLayout(filepath, w, h, c)) {
+        if (w <= 0 || h <= 0) return fail("unsupported image size");
+        byteSize(w, h, c, bytes);
+        if (!fileHolds(filepath, kRawHeaderBytes, bytes)) return fail("truncated raw image");
+        file = std::fopen(filepath.c_str(), "rb");
+        if (!file) return fail(std::strerror(errno));
+        resize(w, h, c);
+        bool complete = std::fseek(file, static_cast<long>(kRawHeaderBytes), SEEK_SET) == 0 &&
+                        std::fread(data, 1, bytes, file) == bytes;
+        std::fclose(file);
+        return complete ? true : fail("truncated raw image");
+    }
+
+    unsigned char* pixels = stbi_load(filepath.c_str(), &w, &h, &c, 0);
+    if (!pixels) return fail(stbi_failure_reason());
+    // stb allocates its own buffer; the pixels are copied so this image keeps (or sizes) its buffer
+    resize(w, h, c);
+    std::memcpy(data, pixels, getByteSize());
+    stbi_image_free(pixels);
+    updateTexture();
+    return true;
+}
+
+bool Image::info(const std::string& filepath, int& w, int& h, int& c) {
+    Pnm::Header header;
+    uint64_t offset = 0;
+    if (readPnmLayout(filepath, header, offset)) {
+        w = header.width;
+        h = header.height;
+        c = header.channels;
+        return true;
+    }
+    if (readRawLayout(filepath, w, h, c)) return true;
+    if (FILE* file = std::fopen(filepath.c_str(), "rb")) {
+        bool qoi = false;
+        try {
+            qoi = Qoi::readHeader(file, w, h, c);
+        } catch (const std::runtime_error&) {
+        }
+        std::fclose(file);
+        if (qoi) return true;
+    }
+    return stbi_info(filepath.c_str(), &w, &h, &c) != 0;
+}
+
+bool Image::map(const std::string& filepath) {
+    Pnm::Header header;
+    uint64_t offset = 0;
+    if (!readPnmLayout(filepath, header, offset)) {
+        std::cerr << "Not a binary 8-bit PGM/PPM/PAM image: " << filepath << std::endl;
+        return false;
+    }
+    return mapRaw(filepath, header.width, header.height, header.channels, offset);
+}
+
+bool Image::mapRaw(const std::string& filepath, int w, int h, int c, uint64_t offset) {
+    Trace::Zone zone("Image::map");
+    if (w <= 0 || h <= 0 || c <= 0) {
+        std::cerr << "Unsupported image size " << w << "x" << h << "x" << c << ": " << filepath << std::endl;
+        return false;
+    }
+    size_t bytes = 0;
+    if (!byteSize(w, h, c, bytes)) {
+        std::cerr << "Image too large to map " << w << "x" << h << "x" << c << ": " << filepath << std::endl;
+        return false;
+    }
+    std::shared_ptr<MappedFile> file = MappedFile::open(filepath);
+    if (!file || file->size() < offset || file->size() - offset < bytes) {
+        std::cerr << "Failed to map image: " << filepath << std::endl;
+        return false;
+    }
+
+    releasePixels();
+    width = w;
+    height = h;
+    channels = c;
+    data = file->data() + offset;
+    storage = Storage::Mapped;
+    mapping = std::move(file);
+    MemoryAccounting::add(Category::MappedFiles, bytes);
+    updateTexture();
+    return true;
+}
+
+bool Image::save(const std::string& filepath) const {
+    return save(filepath, SaveOptions());
+}
+
+bool Image::save(const std::string& filepath, const SaveOptions& options) const {
     if (!data) return false;
-    
-    return stbi_write_png(filepath.c_str(), width, height, channels, data, width * channels);
+    Trace::Zone zone("Image::save");
+    Profiler::ScopedTimer timer("Image::save");
+
+    Format format = options.format == Format::Auto ? formatFor(filepath) : options.format;
+    // Written next to the target and renamed over it: truncating the target in place would pull
+    // the pages from under any image still mapping it, this one included when saved to its own path
+    static std::atomic<unsigned> saveCount{0};
+    const std::string partial = filepath + ".part" + std::to_string(saveCount++);
+    FILE* file = std::fopen(partial.c_str(), "wb");
+    if (!file) return false;
+
+    bool saved = false;
+    switch (format) {
+    case Format::Auto:
+    case Format::PNG: {
+        Png::Options png;
+        png.level = options.pngLevel;
+        png.filter = static_cast<Png::Filter>(options.pngFilter);
+        png.threads = options.threads;
+        saved = Png::write(file, *this, png);
+        break;
+    }
+    case Format::PNM: {
+        Pnm::Format pnm;
+        pnm.kind = channels == 1 ? Pnm::Kind::PGM : channels == 3 ? Pnm::Kind::PPM : Pnm::Kind::PAM;
+        if (lowercaseExtension(filepath) == ".pam") pnm.kind = Pnm::Kind::PAM;
+        saved = Pnm::write(file, *this, pnm);
+        break;
+    }
+    case Format::QOI:
+        saved = Qoi::write(file, *this);
+        break;
+    case Format::Raw:
+        saved = writeRaw(file, *this);
+        break;
+    }
+
+    if (std::fclose(file) != 0) saved = false;
+    std::error_code ec;
+    if (saved) {
+        std::filesystem::rename(partial, filepath, ec);
+        saved = !ec;
+    }
+    // No half-written files left behind
+    if (!saved) std::remove(partial.c_str());
+    return saved;
+}
+
+Image::SaveOptions::Format Image::formatFor(const std::string& filepath) {
+    std::string extension = lowercaseExtension(filepath);
+    if (extension == ".pgm" || extension == ".ppm" || extension == ".pnm" || extension == ".pam") return Format::PNM;
+    if (extension == ".qoi") return Format::QOI;
+    if (extension == ".raw") return Format::Raw;
+    return Format::PNG;
+}
+
+const char* Image::extension(SaveOptions::Format format, int channels) {
+    switch (format) {
+    case Format::PNM: return channels == 1 ? ".pgm" : channels == 3 ? ".ppm" : ".pam";
+    case Format::QOI: return ".qoi";
+    case Format::Raw: return ".raw";
+    case Format::Auto:
+    case Format::PNG: break;
+    }
+    return ".png";
 }
 
 void Image::setPixel(int x, int y, int channel, unsigned char value) {
     if (x >= 0 && x < width && y >= 0 && y < height && channel >= 0 && channel < channels) {
-        data[(y * width + x) * channels + channel] = value;
+        data[(static_cast<size_t>(y) * width + x) * channels + channel] = value;
     }
 }
 
 unsigned char Image::getPixel(int x, int y, int channel) const {
     if (x >= 0 && x < width && y >= 0 && y < height && channel >= 0 && channel < channels) {
-        return data[(y * width + x) * channels + channel];
+        return data[(static_cast<size_t>(y) * width + x) * channels + channel];
     }
     return 0;
 }
@@ -151,26 +513,56 @@ void Image::setPixelRGB(int x, int y, const glm::vec3& rgb) {
 
 Image Image::clone() const {
     Image img(width, height, channels);
-    std::memcpy(img.data, data, width * height * channels);
-    img.updateTexture();
+    std::memcpy(img.data, data, getByteSize());
     return img;
 }
 
 void Image::copyFrom(const Image& other) {
     if (width != other.width || height != other.height || channels != other.channels) {
-        delete[] data;
+        releasePixels();
         width = other.width;
         height = other.height;
         channels = other.channels;
-        data = new unsigned char[width * height * channels];
+        data = allocatePixels(getByteSize());
     }
-    std::memcpy(data, other.data, width * height * channels);
+    std::memcpy(data, other.data, getByteSize());
     updateTexture();
 }
 
-void Image::createTexture() {
-    if (textureID) deleteTexture();
-    
+void Image::resize(int w, int h, int c) {
+    size_t bytes = pixelBytes(w, h, c);
+    if (!data || getByteSize() != bytes) {
+        releasePixels();
+        data = allocatePixels(bytes);
+    }
+    width = w;
+    height = h;
+    channels = c;
+    updateTexture();
+}
+
+void Image::releasePixels() {
+    size_t bytes = getByteSize();
+    switch (storage) {
+    case Storage::Allocated:
+        freePixels(data, bytes);
+        break;
+    case Storage::Decoded:
+        // stb_image allocates with malloc, so its buffers cannot go to delete[]
+        stbi_image_free(data);
+        MemoryAccounting::release(Category::PixelBuffers, bytes);
+        break;
+    case Storage::Mapped:
+        mapping.reset();
+        MemoryAccounting::release(Category::MappedFiles, bytes);
+        break;
+    }
+    data = nullptr;
+    storage = Storage::Allocated;
+}
+
+void Image::createTexture() const {
+#ifndef LAB2_HEADLESS
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_2D, textureID);
     
@@ -178,23 +570,49 @@ void Image::createTexture() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+#endif
 }
 
 void Image::deleteTexture() {
+#ifndef LAB2_HEADLESS
     if (textureID) {
         glDeleteTextures(1, &textureID);
         textureID = 0;
+        MemoryAccounting::release(Category::Textures, textureBytes);
+        textureBytes = 0;
     }
+#endif
 }
 
 void Image::updateTexture() {
-    if (!data || !textureID) return;
-    
+    textureDirty = true;
+    generation = nextGeneration();
+}
+
+unsigned int Image::getTextureID() const {
+    if (textureDirty && data) {
+        if (!textureID) createTexture();
+        uploadTexture();
+        textureDirty = false;
+    }
+    return textureID;
+}
+
+void Image::uploadTexture() const {
+#ifndef LAB2_HEADLESS
+    Trace::Zone zone("Image::uploadTexture");
+    Profiler::UploadTimer timer;
     glBindTexture(GL_TEXTURE_2D, textureID);
     
     GLenum format = GL_RGB;
     if (channels == 1) format = GL_RED;
     else if (channels == 4) format = GL_RGBA;
     
+    // Proxy widths are arbitrary, so RGB rows are generally not 4-byte aligned.
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+    MemoryAccounting::release(Category::Textures, textureBytes);
+    textureBytes = getByteSize();
+    MemoryAccounting::add(Category::Textures, textureBytes);
+#endif
 }
\ No newline at end of file
@@ -1,10 +1,29 @@
 #pragma once
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 #include <glm/glm.hpp>
 
+class MappedFile;
+
 class Image {
 public:
+    // Output format and the size/speed trade-off of save(). PNG is smallest and slowest to write;
+    // QOI is lossless at a fraction of the time; PNM/PAM and raw write the pixels as they are.
+    struct SaveOptions {
+        // Auto picks by extension: .pgm/.ppm/.pnm/.pam, .qoi and .raw, PNG for anything else
+        enum class Format { Auto, PNG, PNM, QOI, Raw };
+        enum class PngFilter { Adaptive, None, Sub, Up, Average, Paeth };
+
+        Format format = Format::Auto;
+        // 0 stores the pixels uncompressed, 1 is fastest and 9 smallest
+        int pngLevel = 6;
+        PngFilter pngFilter = PngFilter::Adaptive;
+        // Bands of rows PNG encodes at once; 0 uses every hardware thread
+        int threads = 0;
+    };
+
     Image();
     Image(int width, int height, int channels);
     ~Image();
@@ -14,12 +33,41 @@ public:
     Image(Image&& other) noexcept;
     Image& operator=(Image&& other) noexcept;
 
+    // Binary 8-bit PGM/PPM/PAM and raw files are mapped (see map()); other formats are decoded into
+    // memory.
     bool load(const std::string& filepath);
-    bool save(const std::string& filepath);
+    // Decodes into this image's own buffer, reusing it when the byte size matches as resize() does,
+    // where load() would map the file or let the decoder allocate. Formats stb_image decodes are
+    // copied in from its buffer. Reports failures in `error`, or on stderr when it is null.
+    bool read(const std::string& filepath, std::string* error = nullptr);
+    // Size the file loads at, from its header alone
+    static bool info(const std::string& filepath, int& width, int& height, int& channels);
+    bool save(const std::string& filepath) const;
+    bool save(const std::string& filepath, const SaveOptions& options) const;
+    static SaveOptions::Format formatFor(const std::string& filepath);
+    // Extension save() gives each format, with the dot
+    static const char* extension(SaveOptions::Format format, int channels);
+
+    // Uses the pixels of a binary 8-bit PGM/PPM/PAM file in place instead of reading them: pages come
+    // from the page cache on first access, and the first write to a page copies that page privately,
+    // never changing the file. Operations writing to another image copy nothing. The file must not
+    // be truncated while mapped.
+    bool map(const std::string& filepath);
+    // The same for dumps of `width` x `height` x `channels` bytes starting at `offset`, such as the
+    // pixels of the raw files save() writes after their 16-byte header
+    bool mapRaw(const std::string& filepath, int width, int height, int channels, uint64_t offset = 0);
+    bool isMapped() const { return storage == Storage::Mapped; }
     
     int getWidth() const { return width; }
     int getHeight() const { return height; }
     int getChannels() const { return channels; }
+    // Bytes per row and in the whole image, in 64 bits: images past 2 GB are fine as long as each
+    // dimension fits an int. Every image was sized through byteSize(), so these cannot overflow.
+    size_t getStride() const { return static_cast<size_t>(width) * channels; }
+    size_t getByteSize() const { return getStride() * height; }
+    // Bytes of a `width` x `height` x `channels` image; false for negative dimensions or a size that
+    // does not fit size_t. Check dimensions read from files with this before sizing anything by them.
+    static bool byteSize(int width, int height, int channels, size_t& bytes);
     unsigned char* getData() { return data; }
     const unsigned char* getData() const { return data; }
     
@@ -31,17 +79,36 @@ public:
     
     Image clone() const;
     void copyFrom(const Image& other);
+    // Changes the dimensions, keeping the buffer when the byte size is unchanged; the contents are
+    // undefined afterwards. Lets streaming code reuse one image per frame slot.
+    void resize(int width, int height, int channels);
     
-    unsigned int getTextureID() const { return textureID; }
+    // Textures are created and uploaded lazily by getTextureID(), so images can be built and
+    // processed on worker threads; only the render thread may ask for the texture.
+    unsigned int getTextureID() const;
     void updateTexture();
+    // Changes whenever the pixels may have: on updateTexture(), resize() and assignment. Values are
+    // never reused, so unlike the buffer address it tells a reloaded image from the one before it.
+    uint64_t getGeneration() const { return generation; }
 
 private:
+    // Who frees `data`: new[] here, stb_image for decoded files, or the file mapping
+    enum class Storage { Allocated, Decoded, Mapped };
+
     int width;
     int height;
     int channels;
     unsigned char* data;
-    unsigned int textureID;
+    Storage storage;
+    std::shared_ptr<MappedFile> mapping;
+    mutable unsigned int textureID;
+    mutable bool textureDirty;
+    // Size of the texture storage last uploaded, for MemoryAccounting
+    mutable size_t textureBytes;
+    uint64_t generation;
     
-    void createTexture();
+    void releasePixels();
+    void createTexture() const;
     void deleteTexture();
+    void uploadTexture() const;
 };
\ No newline at end of file
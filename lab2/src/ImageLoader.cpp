@@ -0,0 +1,132 @@
+#include "ImageLoader.h"
+#include "Trace.h"
+#include <algorithm>
+#include <deque>
+#include <exception>
+
+// Idle images, kept for the next file of the same byte size
+class ImageLoader::Pool {
+public:
+    explicit Pool(size_t capacity) : capacity(capacity) {}
+
+    // An idle image whose buffer fits `bytes` exactly, else the oldest idle one, else a new one
+    std::unique_ptr<Image> take(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (idle.empty()) return std::make_unique<Image>();
+
+        auto fit = std::find_if(idle.begin(), idle.end(), [bytes](const std::unique_ptr<Image>& image) {
+            return image->getByteSize() == bytes;
+        });
+        if (fit == idle.end()) fit = idle.begin();
+        std::unique_ptr<Image> image = std::move(*fit);
+        idle.erase(fit);
+        return image;
+    }
+
+    void give(std::unique_ptr<Image> image) {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(std::move(image));
+        if (idle.size() > capacity) idle.pop_front();
+    }
+
+private:
+    std::mutex mutex;
+    std::deque<std::unique_ptr<Image>> idle;
+    size_t capacity;
+};
+
+ImageLoader::ImageLoader(std::vector<std::string> files, int threadCount, int prefetch)
+    : paths(std::move(files)), claimed(0), delivered(0), stopping(false) {
+    threadCount = std::max(1, threadCount);
+    // Fewer slots than threads would leave threads idle
+    size_t slotCount = static_cast<size_t>(std::max(prefetch, threadCount));
+    slots.resize(slotCount);
+    ready.assign(slotCount, false);
+    // Every slot plus the images the consumer is working on
+    pool = std::make_shared<Pool>(slotCount * 2);
+
+    for (int i = 0; i < threadCount; i++) {
+        threads.emplace_back(&ImageLoader::workerLoop, this);
+    }
+}
+
+ImageLoader::~ImageLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+bool ImageLoader::next(Item& item) {
+    Trace::Zone zone("ImageLoader::next");
+    std::unique_lock<std::mutex> lock(mutex);
+    if (delivered >= paths.size()) return false;
+
+    size_t slot = delivered % slots.size();
+    changed.wait(lock, [this, slot] { return ready[slot]; });
+    item = std::move(slots[slot]);
+    slots[slot] = Item();
+    ready[slot] = false;
+    delivered++;
+    lock.unlock();
+    // Frees a slot for the workers
+    changed.notify_all();
+    return true;
+}
+
+void ImageLoader::workerLoop() {
+    Trace::setThreadName("loader");
+    while (true) {
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] {
+                return stopping || claimed >= paths.size() || claimed < delivered + slots.size();
+            });
+            if (stopping || claimed >= paths.size()) return;
+            index = claimed++;
+        }
+
+        Item item = loadFile(index);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slots[index % slots.size()] = std::move(item);
+            ready[index % slots.size()] = true;
+        }
+        changed.notify_all();
+    }
+}
+
+ImageLoader::Item ImageLoader::loadFile(size_t index) {
+    Trace::Zone zone("ImageLoader::loadFile");
+    Item item;
+    item.index = index;
+    item.path = paths[index];
+
+    // The header says which pooled buffer fits; unknown sizes take any
+    int width = 0, height = 0, channels = 0;
+    size_t bytes = 0;
+    if (!Image::info(item.path, width, height, channels) || !Image::byteSize(width, height, channels, bytes)) {
+        bytes = 0;
+    }
+
+    try {
+        std::unique_ptr<Image> image = pool->take(bytes);
+        if (image->read(item.path, &item.error)) {
+            std::shared_ptr<Pool> owner = pool;
+            item.image = std::shared_ptr<Image>(image.release(), [owner](Image* returned) {
+                owner->give(std::unique_ptr<Image>(returned));
+            });
+        } else {
+            pool->give(std::move(image));
+        }
+    } catch (const std::exception& e) {
+        item.error = e.what();
+    }
+    return item;
+}
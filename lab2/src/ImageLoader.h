@@ -0,0 +1,54 @@
+#pragma once
+#include "Image.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Decodes a list of image files on several threads, a bounded number of files ahead of the consumer,
+// which takes them in list order. Each file is probed from its header first and decoded into a pooled
+// image of that size; images return to the pool when the consumer drops them, so a run of same-sized
+// files stops allocating pixel memory once the pool is warm. Formats stb_image decodes still pass
+// through a buffer of its own, which is copied and freed.
+class ImageLoader {
+public:
+    struct Item {
+        // Position in the file list
+        size_t index = 0;
+        std::string path;
+        // Null when the file could not be loaded, with the reason in `error`
+        std::shared_ptr<Image> image;
+        std::string error;
+    };
+
+    // `threads` files decode at once; at most `prefetch` files are loading or waiting for next().
+    ImageLoader(std::vector<std::string> paths, int threads, int prefetch);
+    // Waits for the files being decoded and drops the rest; images already returned stay valid.
+    ~ImageLoader();
+
+    ImageLoader(const ImageLoader&) = delete;
+    ImageLoader& operator=(const ImageLoader&) = delete;
+
+    // Blocks until the next file in list order is loaded; false once every file has been returned.
+    bool next(Item& item);
+
+private:
+    class Pool;
+
+    void workerLoop();
+    Item loadFile(size_t index);
+
+    std::vector<std::string> paths;
+    std::shared_ptr<Pool> pool;
+    std::mutex mutex;
+    std::condition_variable changed;
+    // Ring of `prefetch` slots; file i goes to slot i % prefetch
+    std::vector<Item> slots;
+    std::vector<bool> ready;
+    size_t claimed;
+    size_t delivered;
+    bool stopping;
+    std::vector<std::thread> threads;
+};
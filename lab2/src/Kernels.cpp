@@ -0,0 +1,376 @@
+#include "Kernels.h"
+#include "../../lab1/utils/CPUFeatures.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LAB2_X86 1
+#include <immintrin.h>
+#endif
+
+// Per-function instruction sets, so one file holds every variant and the rest of the build stays at the
+// baseline. MSVC accepts the intrinsics without it.
+#if defined(__GNUC__) || defined(__clang__)
+#define LAB2_TARGET(isa) __attribute__((target(isa)))
+#else
+#define LAB2_TARGET(isa)
+#endif
+
+namespace {
+    using ISA = Kernels::ISA;
+
+    enum class Bitwise { And, Or, Xor };
+
+    template <Bitwise Op>
+    unsigned char bitwise(unsigned char a, unsigned char b) {
+        if constexpr (Op == Bitwise::And) return a & b;
+        else if constexpr (Op == Bitwise::Or) return a | b;
+        else return a ^ b;
+    }
+
+    template <Bitwise Op>
+    void bitwiseScalar(const unsigned char* a, const unsigned char* b, unsigned char* out, size_t count) {
+        for (size_t i = 0; i < count; i++) out[i] = bitwise<Op>(a[i], b[i]);
+    }
+
+    // Same weights and order of operations as Image::getPixelRGB followed by the weighted sum in
+    // ThresholdProcessing; the vector variants repeat them lane by lane.
+    struct IntensityWeights {
+        float r[256], g[256], b[256];
+    };
+
+    const IntensityWeights& intensityWeights() {
+        static const IntensityWeights weights = [] {
+            IntensityWeights w;
+            for (int v = 0; v < 256; v++) {
+                w.r[v] = 0.299f * (v / 255.0f);
+                w.g[v] = 0.587f * (v / 255.0f);
+                w.b[v] = 0.114f * (v / 255.0f);
+            }
+            return w;
+        }();
+        return weights;
+    }
+
+    void intensityScalar(const unsigned char* pixels, int channels, unsigned char* out, size_t count) {
+        const IntensityWeights& w = intensityWeights();
+        for (size_t i = 0; i < count; i++) {
+            const unsigned char* p = pixels + i * channels;
+            int value = static_cast<int>((w.r[p[0]] + w.g[p[1]] + w.b[p[2]]) * 255);
+            out[i] = static_cast<unsigned char>(std::clamp(value, 0, 255));
+        }
+    }
+
+    void thresholdScalar(const unsigned char* in, unsigned char* out, size_t count, unsigned char threshold) {
+        for (size_t i = 0; i < count; i++) out[i] = in[i] >= threshold ? 255 : 0;
+    }
+
+    template <int Channels>
+    void broadcastPixels(const unsigned char* values, unsigned char* pixels, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            for (int c = 0; c < Channels; c++) pixels[i * Channels + c] = values[i];
+        }
+    }
+
+    void broadcastScalar(const unsigned char* values, int channels, unsigned char* pixels, size_t count) {
+        switch (channels) {
+        case 1: std::memcpy(pixels, values, count); break;
+        case 2: broadcastPixels<2>(values, pixels, count); break;
+        case 3: broadcastPixels<3>(values, pixels, count); break;
+        case 4: broadcastPixels<4>(values, pixels, count); break;
+        default:
+            for (size_t i = 0; i < count; i++) std::memset(pixels + i * channels, values[i], channels);
+            break;
+        }
+    }
+
+#ifdef LAB2_X86
+    template <Bitwise Op>
+    LAB2_TARGET("sse2") void bitwiseSSE2(const unsigned char* a, const unsigned char* b, unsigned char* out, size_t count) {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            __m128i r;
+            if constexpr (Op == Bitwise::And) r = _mm_and_si128(x, y);
+            else if constexpr (Op == Bitwise::Or) r = _mm_or_si128(x, y);
+            else r = _mm_xor_si128(x, y);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), r);
+        }
+        bitwiseScalar<Op>(a + i, b + i, out + i, count - i);
+    }
+
+    template <Bitwise Op>
+    LAB2_TARGET("avx2") void bitwiseAVX2(const unsigned char* a, const unsigned char* b, unsigned char* out, size_t count) {
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            __m256i r;
+            if constexpr (Op == Bitwise::And) r = _mm256_and_si256(x, y);
+            else if constexpr (Op == Bitwise::Or) r = _mm256_or_si256(x, y);
+            else r = _mm256_xor_si256(x, y);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), r);
+        }
+        bitwiseScalar<Op>(a + i, b + i, out + i, count - i);
+    }
+
+    template <Bitwise Op>
+    LAB2_TARGET("avx512f,avx512bw") void bitwiseAVX512(const unsigned char* a, const unsigned char* b, unsigned char* out, size_t count) {
+        size_t i = 0;
+        for (; i + 64 <= count; i += 64) {
+            __m512i x = _mm512_loadu_si512(a + i);
+            __m512i y = _mm512_loadu_si512(b + i);
+            __m512i r;
+            if constexpr (Op == Bitwise::And) r = _mm512_and_si512(x, y);
+            else if constexpr (Op == Bitwise::Or) r = _mm512_or_si512(x, y);
+            else r = _mm512_xor_si512(x, y);
+            _mm512_storeu_si512(out + i, r);
+        }
+        bitwiseScalar<Op>(a + i, b + i, out + i, count - i);
+    }
+
+    // pshufb masks gathering channel `channel` of four pixels into the low byte of four 32-bit lanes.
+    // Four pixels fit the 16 shuffled bytes only up to 4 channels.
+    LAB2_TARGET("sse4.1") __m128i channelMask(int channel, int channels) {
+        alignas(16) unsigned char mask[16];
+        std::memset(mask, 0x80, sizeof(mask));
+        for (int k = 0; k < 4; k++) mask[k * 4] = static_cast<unsigned char>(channel + k * channels);
+        return _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+    }
+
+    LAB2_TARGET("sse4.1") void intensitySSE41(const unsigned char* pixels, int channels, unsigned char* out, size_t count) {
+        if (channels > 4) {
+            intensityScalar(pixels, channels, out, count);
+            return;
+        }
+        const __m128i maskR = channelMask(0, channels), maskG = channelMask(1, channels), maskB = channelMask(2, channels);
+        const __m128 scale = _mm_set1_ps(255.0f);
+        const __m128 wr = _mm_set1_ps(0.299f), wg = _mm_set1_ps(0.587f), wb = _mm_set1_ps(0.114f);
+        // The 16-byte load reaches past the four pixels when they have 3 channels
+        const size_t loadPixels = (16 + channels - 1) / channels;
+
+        size_t i = 0;
+        for (; i + std::max<size_t>(4, loadPixels) <= count; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i * channels));
+            __m128 r = _mm_mul_ps(wr, _mm_div_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(v, maskR)), scale));
+            __m128 g = _mm_mul_ps(wg, _mm_div_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(v, maskG)), scale));
+            __m128 b = _mm_mul_ps(wb, _mm_div_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(v, maskB)), scale));
+            __m128i value = _mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(_mm_add_ps(r, g), b), scale));
+            // Saturating packs clamp to 0..255 like the scalar code
+            value = _mm_packus_epi16(_mm_packs_epi32(value, value), value);
+            int packed = _mm_cvtsi128_si32(value);
+            std::memcpy(out + i, &packed, 4);
+        }
+        intensityScalar(pixels + i * channels, channels, out + i, count - i);
+    }
+
+    LAB2_TARGET("avx2") void intensityAVX2(const unsigned char* pixels, int channels, unsigned char* out, size_t count) {
+        if (channels > 4) {
+            intensityScalar(pixels, channels, out, count);
+            return;
+        }
+        const __m256i maskR = _mm256_broadcastsi128_si256(channelMask(0, channels));
+        const __m256i maskG = _mm256_broadcastsi128_si256(channelMask(1, channels));
+        const __m256i maskB = _mm256_broadcastsi128_si256(channelMask(2, channels));
+        const __m256 scale = _mm256_set1_ps(255.0f);
+        const __m256 wr = _mm256_set1_ps(0.299f), wg = _mm256_set1_ps(0.587f), wb = _mm256_set1_ps(0.114f);
+        // Pixels 0-3 go to the low lane and 4-7 to the high one; each lane loads 16 bytes
+        const size_t loadPixels = 4 + (16 + channels - 1) / channels;
+
+        size_t i = 0;
+        for (; i + std::max<size_t>(8, loadPixels) <= count; i += 8) {
+            const unsigned char* p = pixels + i * channels;
+            __m256i v = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 4 * channels)), 1);
+            __m256 r = _mm256_mul_ps(wr, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_shuffle_epi8(v, maskR)), scale));
+            __m256 g = _mm256_mul_ps(wg, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_shuffle_epi8(v, maskG)), scale));
+            __m256 b = _mm256_mul_ps(wb, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_shuffle_epi8(v, maskB)), scale));
+            __m256i value = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(r, g), b), scale));
+            // Packing works per lane: bytes 0-3 of each lane hold that lane's four pixels
+            value = _mm256_packus_epi16(_mm256_packs_epi32(value, value), value);
+            int low = _mm_cvtsi128_si32(_mm256_castsi256_si128(value));
+            int high = _mm_cvtsi128_si32(_mm256_extracti128_si256(value, 1));
+            std::memcpy(out + i, &low, 4);
+            std::memcpy(out + i + 4, &high, 4);
+        }
+        intensityScalar(pixels + i * channels, channels, out + i, count - i);
+    }
+
+    // Unsigned x >= t exactly when max(x, t) == x
+    LAB2_TARGET("sse2") void thresholdSSE2(const unsigned char* in, unsigned char* out, size_t count, unsigned char threshold) {
+        const __m128i t = _mm_set1_epi8(static_cast<char>(threshold));
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_cmpeq_epi8(_mm_max_epu8(x, t), x));
+        }
+        thresholdScalar(in + i, out + i, count - i, threshold);
+    }
+
+    LAB2_TARGET("avx2") void thresholdAVX2(const unsigned char* in, unsigned char* out, size_t count, unsigned char threshold) {
+        const __m256i t = _mm256_set1_epi8(static_cast<char>(threshold));
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_cmpeq_epi8(_mm256_max_epu8(x, t), x));
+        }
+        thresholdScalar(in + i, out + i, count - i, threshold);
+    }
+
+    LAB2_TARGET("avx512f,avx512bw") void thresholdAVX512(const unsigned char* in, unsigned char* out, size_t count, unsigned char threshold) {
+        const __m512i t = _mm512_set1_epi8(static_cast<char>(threshold));
+        size_t i = 0;
+        for (; i + 64 <= count; i += 64) {
+            __m512i x = _mm512_loadu_si512(in + i);
+            _mm512_storeu_si512(out + i, _mm512_movm_epi8(_mm512_cmpge_epu8_mask(x, t)));
+        }
+        thresholdScalar(in + i, out + i, count - i, threshold);
+    }
+#endif
+
+    template <typename Fn>
+    void use(Kernels::Kernel<Fn>& kernel, Fn fn, ISA isa) {
+        kernel.fn = fn;
+        kernel.isa = isa;
+    }
+}
+
+Kernels::Table Kernels::forISA(ISA isa) {
+    Table table;
+    table.isa = isa;
+    use(table.bitwiseAnd, &bitwiseScalar<Bitwise::And>, ISA::Scalar);
+    use(table.bitwiseOr, &bitwiseScalar<Bitwise::Or>, ISA::Scalar);
+    use(table.bitwiseXor, &bitwiseScalar<Bitwise::Xor>, ISA::Scalar);
+    use(table.intensity, &intensityScalar, ISA::Scalar);
+    use(table.threshold, &thresholdScalar, ISA::Scalar);
+    use(table.broadcast, &broadcastScalar, ISA::Scalar);
+
+#ifdef LAB2_X86
+    if (isa >= ISA::SSE2) {
+        use(table.bitwiseAnd, &bitwiseSSE2<Bitwise::And>, ISA::SSE2);
+        use(table.bitwiseOr, &bitwiseSSE2<Bitwise::Or>, ISA::SSE2);
+        use(table.bitwiseXor, &bitwiseSSE2<Bitwise::Xor>, ISA::SSE2);
+        use(table.threshold, &thresholdSSE2, ISA::SSE2);
+    }
+    if (isa >= ISA::SSE41) {
+        use(table.intensity, &intensitySSE41, ISA::SSE41);
+    }
+    if (isa >= ISA::AVX2) {
+        use(table.bitwiseAnd, &bitwiseAVX2<Bitwise::And>, ISA::AVX2);
+        use(table.bitwiseOr, &bitwiseAVX2<Bitwise::Or>, ISA::AVX2);
+        use(table.bitwiseXor, &bitwiseAVX2<Bitwise::Xor>, ISA::AVX2);
+        use(table.intensity, &intensityAVX2, ISA::AVX2);
+        use(table.threshold, &thresholdAVX2, ISA::AVX2);
+    }
+    if (isa >= ISA::AVX512BW) {
+        use(table.bitwiseAnd, &bitwiseAVX512<Bitwise::And>, ISA::AVX512BW);
+        use(table.bitwiseOr, &bitwiseAVX512<Bitwise::Or>, ISA::AVX512BW);
+        use(table.bitwiseXor, &bitwiseAVX512<Bitwise::Xor>, ISA::AVX512BW);
+        use(table.threshold, &thresholdAVX512, ISA::AVX512BW);
+    }
+#endif
+    return table;
+}
+
+namespace {
+    // Tables for every ISA, built once so select() can hand out stable references
+    const Kernels::Table& tableFor(ISA isa) {
+        static const std::array<Kernels::Table, 5> tables = {
+            Kernels::forISA(ISA::Scalar), Kernels::forISA(ISA::SSE2), Kernels::forISA(ISA::SSE41),
+            Kernels::forISA(ISA::AVX2), Kernels::forISA(ISA::AVX512BW)
+        };
+        return tables[static_cast<size_t>(isa)];
+    }
+
+    std::atomic<const Kernels::Table*>& activeTable() {
+        static std::atomic<const Kernels::Table*> table{[] {
+            ISA best = Kernels::supported().back();
+            if (const char* forced = std::getenv("LAB2_FORCE_ISA")) {
+                ISA requested;
+                if (!Kernels::parse(forced, requested)) {
+                    std::cerr << "LAB2_FORCE_ISA: unknown instruction set \"" << forced << "\", using " << Kernels::name(best) << std::endl;
+                } else if (requested > best) {
+                    std::cerr << "LAB2_FORCE_ISA: " << Kernels::name(requested) << " is not available, using " << Kernels::name(best) << std::endl;
+                } else {
+                    best = requested;
+                }
+            }
+            return &tableFor(best);
+        }()};
+        return table;
+    }
+
+    std::atomic<int> threadCount{1};
+}
+
+const Kernels::Table& Kernels::active() {
+    return *activeTable().load(std::memory_order_acquire);
+}
+
+void Kernels::select(ISA isa) {
+    activeTable().store(&tableFor(isa), std::memory_order_release);
+}
+
+int Kernels::threads() {
+    return threadCount.load(std::memory_order_relaxed);
+}
+
+void Kernels::setThreads(int count) {
+    threadCount.store(std::max(1, count), std::memory_order_relaxed);
+}
+
+std::vector<Kernels::ISA> Kernels::supported() {
+    std::vector<ISA> isas = {ISA::Scalar};
+#ifdef LAB2_X86
+    // Each level assumes the ones below it
+    const CPUFeatures::Info& cpu = CPUFeatures::get();
+    if (!cpu.sse2) return isas;
+    isas.push_back(ISA::SSE2);
+    if (!cpu.sse41) return isas;
+    isas.push_back(ISA::SSE41);
+    if (!cpu.avx2) return isas;
+    isas.push_back(ISA::AVX2);
+    if (!cpu.avx512bw) return isas;
+    isas.push_back(ISA::AVX512BW);
+#endif
+    return isas;
+}
+
+std::string Kernels::name(ISA isa) {
+    switch (isa) {
+    case ISA::Scalar: return "scalar";
+    case ISA::SSE2: return "sse2";
+    case ISA::SSE41: return "sse4.1";
+    case ISA::AVX2: return "avx2";
+    case ISA::AVX512BW: return "avx512bw";
+    }
+    return "";
+}
+
+bool Kernels::parse(const std::string& text, ISA& isa) {
+    std::string lower = text;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    for (ISA candidate : {ISA::Scalar, ISA::SSE2, ISA::SSE41, ISA::AVX2, ISA::AVX512BW}) {
+        if (name(candidate) == lower) {
+            isa = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string Kernels::describe(const Table& table) {
+    return "bitwiseAnd " + name(table.bitwiseAnd.isa) +
+           ", bitwiseOr " + name(table.bitwiseOr.isa) +
+           ", bitwiseXor " + name(table.bitwiseXor.isa) +
+           ", intensity " + name(table.intensity.isa) +
+           ", threshold " + name(table.threshold.isa) +
+           ", broadcast " + name(table.broadcast.isa);
+}
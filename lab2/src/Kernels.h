@@ -0,0 +1,96 @@
+#pragma once
+#include "Cancellation.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Inner loops with variants per instruction set. The best variant the CPU runs is chosen once, on the
+// first call to active(); LAB2_FORCE_ISA=scalar|sse2|sse4.1|avx2|avx512bw caps the choice so every
+// path can be tested on one machine. All variants of a kernel produce identical bytes.
+class Kernels {
+public:
+    enum class ISA { Scalar, SSE2, SSE41, AVX2, AVX512BW };
+
+    // out[i] = a[i] op b[i]
+    using BinaryFn = void (*)(const unsigned char* a, const unsigned char* b, unsigned char* out, size_t count);
+    // ThresholdProcessing intensity of `count` pixels with 3 or more channels, bit for bit; the vector
+    // variants handle 3 and 4 and hand wider pixels to the scalar one
+    using IntensityFn = void (*)(const unsigned char* pixels, int channels, unsigned char* out, size_t count);
+    // out[i] = in[i] >= threshold ? 255 : 0
+    using ThresholdFn = void (*)(const unsigned char* in, unsigned char* out, size_t count, unsigned char threshold);
+    // Every channel of pixel i set to values[i]
+    using BroadcastFn = void (*)(const unsigned char* values, int channels, unsigned char* pixels, size_t count);
+
+    template <typename Fn>
+    struct Kernel {
+        Fn fn = nullptr;
+        // Instruction set of the variant actually used; at most the table's
+        ISA isa = ISA::Scalar;
+
+        template <typename... Args>
+        void operator()(Args... args) const { fn(args...); }
+    };
+
+    struct Table {
+        ISA isa = ISA::Scalar;
+        Kernel<BinaryFn> bitwiseAnd;
+        Kernel<BinaryFn> bitwiseOr;
+        Kernel<BinaryFn> bitwiseXor;
+        Kernel<IntensityFn> intensity;
+        Kernel<ThresholdFn> threshold;
+        Kernel<BroadcastFn> broadcast;
+    };
+
+    static const Table& active();
+    // Best variant of every kernel up to `isa`; only call with an ISA from supported()
+    static Table forISA(ISA isa);
+    // Makes forISA(isa) the active table, for comparing variants; not while operations run
+    static void select(ISA isa);
+
+    // Threads one operation splits its rows over. The default of 1 keeps every operation on its
+    // calling thread, which suits the tools that already process one image per pool thread.
+    static int threads();
+    static void setThreads(int count);
+
+    // Calls func(rowBegin, rowEnd) for bands of [0, rows) on up to threads() threads. Every band
+    // runs under the caller's cancellation token; the first exception thrown by any band is rethrown
+    // here once all of them have finished.
+    template <typename Func>
+    static void forRows(int rows, Func func);
+
+    // Instruction sets this build has kernels for and the CPU runs, from scalar up
+    static std::vector<ISA> supported();
+    static std::string name(ISA isa);
+    static bool parse(const std::string& text, ISA& isa);
+    // "bitwiseAnd avx512bw, intensity avx2, ..." for logs
+    static std::string describe(const Table& table);
+};
+
+template <typename Func>
+void Kernels::forRows(int rows, Func func) {
+    const int minRows = 16;
+    int count = threads();
+    if (count <= 1 || rows < 2 * minRows) {
+        func(0, rows);
+        return;
+    }
+
+    CancellationToken* token = Cancellation::current();
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    int bandRows = std::max(minRows, (rows + count - 1) / count);
+    parallelFor(0, rows, [&](int rowBegin, int rowEnd) {
+        Cancellation::Scope scope(token);
+        try {
+            func(rowBegin, rowEnd);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = std::current_exception();
+        }
+    }, bandRows, count);
+    if (error) std::rethrow_exception(error);
+}
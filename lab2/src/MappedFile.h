@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// A whole file mapped into memory privately: pages are read from the page cache on first access,
+// and a write copies just the page written, never reaching the file.
+class MappedFile {
+public:
+    // nullptr when the file cannot be opened or mapped, or is empty
+    static std::shared_ptr<MappedFile> open(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    unsigned char* data() const { return base; }
+    uint64_t size() const { return length; }
+
+private:
+    MappedFile() = default;
+
+    unsigned char* base = nullptr;
+    uint64_t length = 0;
+#ifdef _WIN32
+    void* mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,432 @@
+#include "Morphology.h"
+#include "Cancellation.h"
+#include "Kernels.h"
+#include "../../lab1/utils/MemoryAccounting.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+struct MinOp {
+    template <typename T> T operator()(T a, T b) const { return a < b ? a : b; }
+};
+
+struct MaxOp {
+    template <typename T> T operator()(T a, T b) const { return a > b ? a : b; }
+};
+
+struct AndOp {
+    uint64_t operator()(uint64_t a, uint64_t b) const { return a & b; }
+};
+
+struct OrOp {
+    uint64_t operator()(uint64_t a, uint64_t b) const { return a | b; }
+};
+
+// Output row i of `dstRows` combines input rows [i - lo, i - lo + k - 1]; rows outside the
+// `srcRows` input rows read as `fill`. Rows are split into blocks of k: a suffix scan inside the
+// current block and a running prefix over the next block give every output with three op() calls
+// per element.
+template <typename T, typename Op>
+void vanHerkVertical(const T* src, T* dst, size_t rowLen, int srcRows, int dstRows, int k, int lo, T fill, Op op) {
+    if (k <= 1) {
+        std::memcpy(dst, src, rowLen * dstRows * sizeof(T));
+        return;
+    }
+
+    std::vector<T> fillRow(rowLen, fill);
+    std::vector<T> suffix(rowLen * k);
+    std::vector<T> prefix(rowLen);
+
+    auto row = [&](long j) -> const T* {
+        long r = j - lo;
+        return (r >= 0 && r < srcRows) ? src + r * rowLen : fillRow.data();
+    };
+
+    for (long base = 0; base < dstRows; base += k) {
+        std::memcpy(&suffix[(k - 1) * rowLen], row(base + k - 1), rowLen * sizeof(T));
+        for (int t = k - 2; t >= 0; t--) {
+            const T* in = row(base + t);
+            const T* next = &suffix[(t + 1) * rowLen];
+            T* out = &suffix[t * rowLen];
+            for (size_t x = 0; x < rowLen; x++) {
+                out[x] = op(in[x], next[x]);
+            }
+        }
+
+        std::memcpy(dst + base * rowLen, suffix.data(), rowLen * sizeof(T));
+        std::memcpy(prefix.data(), row(base + k), rowLen * sizeof(T));
+
+        for (int t = 1; t < k && base + t < dstRows; t++) {
+            const T* s = &suffix[t * rowLen];
+            T* out = dst + (base + t) * rowLen;
+            for (size_t x = 0; x < rowLen; x++) {
+                out[x] = op(s[x], prefix[x]);
+            }
+
+            const T* in = row(base + k + t);
+            for (size_t x = 0; x < rowLen; x++) {
+                prefix[x] = op(prefix[x], in[x]);
+            }
+        }
+    }
+}
+
+// Same scheme along a single line; `line` holds n samples, `out` receives `count` results.
+template <typename Op>
+void vanHerkLine(const unsigned char* line, unsigned char* out, int n, int count, int k, int lo, unsigned char fill,
+                 Op op, std::vector<unsigned char>& padded, std::vector<unsigned char>& suffix) {
+    int blocks = (std::max(n + lo, count + k - 1) + k - 1) / k;
+    int paddedLen = blocks * k;
+    padded.assign(paddedLen, fill);
+    suffix.resize(paddedLen);
+
+    for (int i = 0; i < n; i++) {
+        padded[i + lo] = line[i];
+    }
+
+    for (int b = 0; b < blocks; b++) {
+        int end = b * k + k - 1;
+        suffix[end] = padded[end];
+        for (int j = end - 1; j >= b * k; j--) {
+            suffix[j] = op(padded[j], suffix[j + 1]);
+        }
+    }
+
+    unsigned char prefix = fill;
+    for (int i = 0; i < count; i++) {
+        int j = i + k - 1;
+        prefix = (j % k == 0) ? padded[j] : op(prefix, padded[j]);
+        out[i] = (i % k == 0) ? suffix[i] : op(suffix[i], prefix);
+    }
+}
+
+// dst bit x = src bit (x + s); bits past the end read as `fill`.
+void shiftTowardsLow(const uint64_t* src, uint64_t* dst, int words, int s, uint64_t fill) {
+    int q = s / 64;
+    int r = s % 64;
+    for (int i = 0; i < words; i++) {
+        uint64_t lo = (i + q < words) ? src[i + q] : fill;
+        uint64_t hi = (i + q + 1 < words) ? src[i + q + 1] : fill;
+        dst[i] = r ? (lo >> r) | (hi << (64 - r)) : lo;
+    }
+}
+
+// dst bit x = src bit (x - s); bits before the start read as `fill`.
+void shiftTowardsHigh(const uint64_t* src, uint64_t* dst, int words, int s, uint64_t fill) {
+    int q = s / 64;
+    int r = s % 64;
+    for (int i = 0; i < words; i++) {
+        uint64_t cur = (i >= q) ? src[i - q] : fill;
+        uint64_t prev = (i >= q + 1) ? src[i - q - 1] : fill;
+        dst[i] = r ? (cur << r) | (prev >> (64 - r)) : cur;
+    }
+}
+
+// Combines bits [x - lo, x - lo + k - 1] of one packed row. The row is first shifted right by lo into
+// a slightly wider buffer, then runs are built by doubling, so a 101-pixel element costs seven
+// shift+op passes over the row words.
+template <typename Op>
+void horizontalRun(const uint64_t* src, uint64_t* dst, int words, int width, int k, int lo, uint64_t fill, Op op,
+                   std::vector<uint64_t>& run, std::vector<uint64_t>& acc, std::vector<uint64_t>& tmp) {
+    int extWords = (width + lo + 63) / 64;
+    tmp.assign(extWords, fill);
+    std::copy(src, src + words, tmp.begin());
+
+    int tailBits = width % 64;
+    uint64_t tailMask = tailBits ? (~0ULL << tailBits) : 0;
+    tmp[words - 1] = (tmp[words - 1] & ~tailMask) | (fill & tailMask);
+
+    run.resize(extWords);
+    acc.resize(extWords);
+    shiftTowardsHigh(tmp.data(), run.data(), extWords, lo, fill);
+
+    int accLen = 0;
+    int runLen = 1;
+    int remaining = k;
+    while (remaining) {
+        if (remaining & 1) {
+            if (accLen == 0) {
+                acc = run;
+            } else {
+                shiftTowardsLow(run.data(), tmp.data(), extWords, accLen, fill);
+                for (int i = 0; i < extWords; i++) acc[i] = op(acc[i], tmp[i]);
+            }
+            accLen += runLen;
+        }
+        remaining >>= 1;
+        if (remaining) {
+            shiftTowardsLow(run.data(), tmp.data(), extWords, runLen, fill);
+            for (int i = 0; i < extWords; i++) run[i] = op(run[i], tmp[i]);
+            runLen *= 2;
+        }
+    }
+
+    std::copy(acc.begin(), acc.begin() + words, dst);
+    dst[words - 1] &= ~tailMask;
+}
+
+}
+
+BinaryMask::BinaryMask() : width(0), height(0), wordsPerRow(0) {}
+
+BinaryMask::BinaryMask(int w, int h)
+    : width(w), height(h), wordsPerRow((w + 63) / 64),
+      words(static_cast<size_t>((w + 63) / 64) * h, 0) {}
+
+BinaryMask BinaryMask::fromImage(const Image& img, unsigned char threshold) {
+    BinaryMask mask(img.getWidth(), img.getHeight());
+    const unsigned char* data = img.getData();
+    int channels = img.getChannels();
+
+    for (int y = 0; y < mask.height; y++) {
+        const unsigned char* src = data + static_cast<size_t>(y) * mask.width * channels;
+        uint64_t* row = mask.getRow(y);
+        for (int x = 0; x < mask.width; x++) {
+            if (src[x * channels] >= threshold) {
+                row[x / 64] |= 1ULL << (x % 64);
+            }
+        }
+    }
+
+    return mask;
+}
+
+Image BinaryMask::toImage(int channels) const {
+    Image result(width, height, channels);
+    unsigned char* data = result.getData();
+
+    for (int y = 0; y < height; y++) {
+        const uint64_t* row = getRow(y);
+        unsigned char* dst = data + static_cast<size_t>(y) * width * channels;
+        for (int x = 0; x < width; x++) {
+            unsigned char value = ((row[x / 64] >> (x % 64)) & 1) ? 255 : 0;
+            for (int c = 0; c < channels; c++) {
+                dst[x * channels + c] = value;
+            }
+        }
+    }
+
+    result.updateTexture();
+    return result;
+}
+
+bool BinaryMask::get(int x, int y) const {
+    if (x < 0 || x >= width || y < 0 || y >= height) return false;
+    return (getRow(y)[x / 64] >> (x % 64)) & 1;
+}
+
+void BinaryMask::set(int x, int y, bool value) {
+    if (x < 0 || x >= width || y < 0 || y >= height) return;
+    uint64_t bit = 1ULL << (x % 64);
+    if (value) {
+        getRow(y)[x / 64] |= bit;
+    } else {
+        getRow(y)[x / 64] &= ~bit;
+    }
+}
+
+Image Morphology::grayscale(const Image& img, int kernelWidth, int kernelHeight, bool isErosion) {
+    int width = img.getWidth();
+    int height = img.getHeight();
+    int channels = img.getChannels();
+    Image result(width, height, channels);
+    if (!img.getData() || width == 0 || height == 0) return result;
+
+    kernelWidth = std::max(1, kernelWidth);
+    kernelHeight = std::max(1, kernelHeight);
+
+    // Erosion anchors at the element centre; dilation uses the reflected element so open/close are proper.
+    int loX = isErosion ? kernelWidth / 2 : kernelWidth - 1 - kernelWidth / 2;
+    int loY = isErosion ? kernelHeight / 2 : kernelHeight - 1 - kernelHeight / 2;
+    unsigned char fill = isErosion ? 255 : 0;
+
+    size_t rowLen = static_cast<size_t>(width) * channels;
+    std::vector<unsigned char> horizontal(rowLen * height);
+    MemoryAccounting::Scoped counted(MemoryAccounting::Category::Temporaries, horizontal.size());
+    std::vector<unsigned char> line(width), out(width), padded, suffix;
+
+    const unsigned char* src = img.getData();
+    for (int y = 0; y < height; y++) {
+        Cancellation::checkpoint(y, height);
+        const unsigned char* srcRow = src + y * rowLen;
+        unsigned char* dstRow = horizontal.data() + y * rowLen;
+        for (int c = 0; c < channels; c++) {
+            for (int x = 0; x < width; x++) line[x] = srcRow[x * channels + c];
+
+            if (isErosion) {
+                vanHerkLine(line.data(), out.data(), width, width, kernelWidth, loX, fill, MinOp(), padded, suffix);
+            } else {
+                vanHerkLine(line.data(), out.data(), width, width, kernelWidth, loX, fill, MaxOp(), padded, suffix);
+            }
+
+            for (int x = 0; x < width; x++) dstRow[x * channels + c] = out[x];
+        }
+    }
+
+    if (isErosion) {
+        vanHerkVertical(horizontal.data(), result.getData(), rowLen, height, height, kernelHeight, loY, fill, MinOp());
+    } else {
+        vanHerkVertical(horizontal.data(), result.getData(), rowLen, height, height, kernelHeight, loY, fill, MaxOp());
+    }
+
+    result.updateTexture();
+    return result;
+}
+
+TiledImage Morphology::grayscale(const TiledImage& img, int kernelWidth, int kernelHeight, bool isErosion) {
+    int channels = img.getChannels();
+    int size = img.getTileSize();
+    TiledImage result(img.getWidth(), img.getHeight(), channels, size);
+    if (img.getByteSize() == 0) return result;
+
+    kernelWidth = std::max(1, kernelWidth);
+    kernelHeight = std::max(1, kernelHeight);
+
+    int loX = isErosion ? kernelWidth / 2 : kernelWidth - 1 - kernelWidth / 2;
+    int loY = isErosion ? kernelHeight / 2 : kernelHeight - 1 - kernelHeight / 2;
+    unsigned char fill = isErosion ? 255 : 0;
+
+    // The horizontal pass runs along whole rows, each gathered from its tiles with the columns the
+    // elements reach beyond the image as `fill`, and leaves its results in tiles; the vertical pass
+    // then reads one tile at a time with the rows reaching above and below it.
+    int width = img.getWidth();
+    int tilesX = img.getTilesX();
+    int lineWidth = width + kernelWidth - 1;
+    int outWidth = tilesX * size;
+    size_t tileStride = result.getTileStride();
+    TiledImage horizontal(width, img.getHeight(), channels, size);
+    MemoryAccounting::Scoped counted(MemoryAccounting::Category::Temporaries, horizontal.getByteSize());
+
+    Kernels::forRows(img.getTilesY(), [&](int tileBegin, int tileEnd) {
+        std::vector<unsigned char> line(lineWidth, fill), out(outWidth), padded, suffix;
+        int rowBegin = tileBegin * size;
+        int rowEnd = std::min(img.getHeight(), tileEnd * size);
+        for (int y = rowBegin; y < rowEnd; y++) {
+            Cancellation::checkpoint(y - rowBegin, rowEnd - rowBegin);
+            size_t offsetY = (y % size) * tileStride;
+            for (int c = 0; c < channels; c++) {
+                for (int tileX = 0; tileX < tilesX; tileX++) {
+                    const unsigned char* src = img.getTile(tileX, y / size) + offsetY + c;
+                    unsigned char* dst = line.data() + loX + tileX * size;
+                    int count = std::min(size, width - tileX * size);
+                    for (int x = 0; x < count; x++) dst[x] = src[x * channels];
+                }
+
+                // The halo is already in the line, so no offset of its own
+                if (isErosion) {
+                    vanHerkLine(line.data(), out.data(), lineWidth, outWidth, kernelWidth, 0, fill, MinOp(), padded, suffix);
+                } else {
+                    vanHerkLine(line.data(), out.data(), lineWidth, outWidth, kernelWidth, 0, fill, MaxOp(), padded, suffix);
+                }
+
+                for (int tileX = 0; tileX < tilesX; tileX++) {
+                    unsigned char* dst = horizontal.getTile(tileX, y / size) + offsetY + c;
+                    const unsigned char* src = out.data() + tileX * size;
+                    for (int x = 0; x < size; x++) dst[x * channels] = src[x];
+                }
+            }
+        }
+    });
+
+    int haloRows = size + kernelHeight - 1;
+    Kernels::forRows(img.getTilesY(), [&](int tileBegin, int tileEnd) {
+        std::vector<unsigned char> window(tileStride * haloRows);
+        for (int tileY = tileBegin; tileY < tileEnd; tileY++) {
+            Cancellation::checkpoint(tileY - tileBegin, tileEnd - tileBegin);
+            for (int tileX = 0; tileX < tilesX; tileX++) {
+                horizontal.readRegion(tileX * size, tileY * size - loY, size, haloRows, fill, window.data());
+                unsigned char* tile = result.getTile(tileX, tileY);
+                if (isErosion) {
+                    vanHerkVertical(window.data(), tile, tileStride, haloRows, size, kernelHeight, 0, fill, MinOp());
+                } else {
+                    vanHerkVertical(window.data(), tile, tileStride, haloRows, size, kernelHeight, 0, fill, MaxOp());
+                }
+            }
+        }
+    });
+
+    return result;
+}
+
+BinaryMask Morphology::binary(const BinaryMask& mask, int kernelWidth, int kernelHeight, bool isErosion) {
+    int width = mask.getWidth();
+    int height = mask.getHeight();
+    int words = mask.getWordsPerRow();
+    BinaryMask result(width, height);
+    if (width == 0 || height == 0) return result;
+
+    kernelWidth = std::max(1, kernelWidth);
+    kernelHeight = std::max(1, kernelHeight);
+
+    int loX = isErosion ? kernelWidth / 2 : kernelWidth - 1 - kernelWidth / 2;
+    int loY = isErosion ? kernelHeight / 2 : kernelHeight - 1 - kernelHeight / 2;
+    uint64_t fill = isErosion ? ~0ULL : 0ULL;
+
+    BinaryMask horizontal(width, height);
+    std::vector<uint64_t> run, acc, tmp;
+    for (int y = 0; y < height; y++) {
+        Cancellation::checkpoint(y, height);
+        if (isErosion) {
+            horizontalRun(mask.getRow(y), horizontal.getRow(y), words, width, kernelWidth, loX, fill, AndOp(), run, acc, tmp);
+        } else {
+            horizontalRun(mask.getRow(y), horizontal.getRow(y), words, width, kernelWidth, loX, fill, OrOp(), run, acc, tmp);
+        }
+    }
+
+    if (isErosion) {
+        vanHerkVertical(horizontal.getRow(0), result.getRow(0), words, height, height, kernelHeight, loY, fill, AndOp());
+    } else {
+        vanHerkVertical(horizontal.getRow(0), result.getRow(0), words, height, height, kernelHeight, loY, fill, OrOp());
+    }
+
+    return result;
+}
+
+Image Morphology::erode(const Image& img, int kernelWidth, int kernelHeight) {
+    return grayscale(img, kernelWidth, kernelHeight, true);
+}
+
+Image Morphology::dilate(const Image& img, int kernelWidth, int kernelHeight) {
+    return grayscale(img, kernelWidth, kernelHeight, false);
+}
+
+Image Morphology::open(const Image& img, int kernelWidth, int kernelHeight) {
+    return dilate(erode(img, kernelWidth, kernelHeight), kernelWidth, kernelHeight);
+}
+
+Image Morphology::close(const Image& img, int kernelWidth, int kernelHeight) {
+    return erode(dilate(img, kernelWidth, kernelHeight), kernelWidth, kernelHeight);
+}
+
+TiledImage Morphology::erode(const TiledImage& img, int kernelWidth, int kernelHeight) {
+    return grayscale(img, kernelWidth, kernelHeight, true);
+}
+
+TiledImage Morphology::dilate(const TiledImage& img, int kernelWidth, int kernelHeight) {
+    return grayscale(img, kernelWidth, kernelHeight, false);
+}
+
+TiledImage Morphology::open(const TiledImage& img, int kernelWidth, int kernelHeight) {
+    return dilate(erode(img, kernelWidth, kernelHeight), kernelWidth, kernelHeight);
+}
+
+TiledImage Morphology::close(const TiledImage& img, int kernelWidth, int kernelHeight) {
+    return erode(dilate(img, kernelWidth, kernelHeight), kernelWidth, kernelHeight);
+}
+
+BinaryMask Morphology::erode(const BinaryMask& mask, int kernelWidth, int kernelHeight) {
+    return binary(mask, kernelWidth, kernelHeight, true);
+}
+
+BinaryMask Morphology::dilate(const BinaryMask& mask, int kernelWidth, int kernelHeight) {
+    return binary(mask, kernelWidth, kernelHeight, false);
+}
+
+BinaryMask Morphology::open(const BinaryMask& mask, int kernelWidth, int kernelHeight) {
+    return dilate(erode(mask, kernelWidth, kernelHeight), kernelWidth, kernelHeight);
+}
+
+BinaryMask Morphology::close(const BinaryMask& mask, int kernelWidth, int kernelHeight) {
+    return erode(dilate(mask, kernelWidth, kernelHeight), kernelWidth, kernelHeight);
+}
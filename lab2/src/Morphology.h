@@ -0,0 +1,56 @@
+#pragma once
+#include "Image.h"
+#include "TiledImage.h"
+#include <cstdint>
+#include <vector>
+
+class BinaryMask {
+public:
+    BinaryMask();
+    BinaryMask(int width, int height);
+
+    static BinaryMask fromImage(const Image& img, unsigned char threshold = 128);
+    Image toImage(int channels = 1) const;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getWordsPerRow() const { return wordsPerRow; }
+
+    uint64_t* getRow(int y) { return words.data() + static_cast<size_t>(y) * wordsPerRow; }
+    const uint64_t* getRow(int y) const { return words.data() + static_cast<size_t>(y) * wordsPerRow; }
+
+    bool get(int x, int y) const;
+    void set(int x, int y, bool value);
+
+private:
+    int width;
+    int height;
+    int wordsPerRow;
+    std::vector<uint64_t> words;
+};
+
+// Rectangular structuring elements, van Herk/Gil-Werman: cost per pixel does not depend on element size.
+class Morphology {
+public:
+    static Image erode(const Image& img, int kernelWidth, int kernelHeight);
+    static Image dilate(const Image& img, int kernelWidth, int kernelHeight);
+    static Image open(const Image& img, int kernelWidth, int kernelHeight);
+    static Image close(const Image& img, int kernelWidth, int kernelHeight);
+
+    // Tile by tile, each read with a halo as wide as the element, so the vertical pass stays in cache
+    // however wide the image; tiles are spread over Kernels::threads(). Same bytes as the Image forms.
+    static TiledImage erode(const TiledImage& img, int kernelWidth, int kernelHeight);
+    static TiledImage dilate(const TiledImage& img, int kernelWidth, int kernelHeight);
+    static TiledImage open(const TiledImage& img, int kernelWidth, int kernelHeight);
+    static TiledImage close(const TiledImage& img, int kernelWidth, int kernelHeight);
+
+    static BinaryMask erode(const BinaryMask& mask, int kernelWidth, int kernelHeight);
+    static BinaryMask dilate(const BinaryMask& mask, int kernelWidth, int kernelHeight);
+    static BinaryMask open(const BinaryMask& mask, int kernelWidth, int kernelHeight);
+    static BinaryMask close(const BinaryMask& mask, int kernelWidth, int kernelHeight);
+
+private:
+    static Image grayscale(const Image& img, int kernelWidth, int kernelHeight, bool isErosion);
+    static TiledImage grayscale(const TiledImage& img, int kernelWidth, int kernelHeight, bool isErosion);
+    static BinaryMask binary(const BinaryMask& mask, int kernelWidth, int kernelHeight, bool isErosion);
+};
@@ -0,0 +1,170 @@
+#include "Operations.h"
+#include "Histogram.h"
+#include "Morphology.h"
+#include "PointOperations.h"
+#include "ThresholdProcessing.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    unsigned char toByte(float value) {
+        return static_cast<unsigned char>(std::clamp(static_cast<int>(value), 0, 255));
+    }
+
+    float argOr(const std::vector<float>& args, size_t index, float fallback) {
+        return index < args.size() ? args[index] : fallback;
+    }
+
+    std::string describe(const std::string& name, const std::vector<float>& args) {
+        std::ostringstream label;
+        label << name;
+        for (float arg : args) {
+            label << ' ' << arg;
+        }
+        return label.str();
+    }
+
+    Image morphology(const Image& img, const std::string& name, int width, int height) {
+        bool mask = name.size() > 4 && name.compare(name.size() - 4, 4, "Mask") == 0;
+        std::string op = mask ? name.substr(0, name.size() - 4) : name;
+
+        if (mask) {
+            BinaryMask bits = BinaryMask::fromImage(img);
+            if (op == "erode") bits = Morphology::erode(bits, width, height);
+            else if (op == "dilate") bits = Morphology::dilate(bits, width, height);
+            else if (op == "open") bits = Morphology::open(bits, width, height);
+            else bits = Morphology::close(bits, width, height);
+            return bits.toImage(img.getChannels());
+        }
+
+        if (op == "erode") return Morphology::erode(img, width, height);
+        if (op == "dilate") return Morphology::dilate(img, width, height);
+        if (op == "open") return Morphology::open(img, width, height);
+        return Morphology::close(img, width, height);
+    }
+}
+
+const std::vector<Operations::Info>& Operations::list() {
+    static const std::vector<Info> operations = {
+        {"linearContrast", 0, 2, "linearContrast [minPercentile=2] [maxPercentile=98]"},
+        {"contrast", 2, 4, "contrast minIn maxIn [minOut=0] [maxOut=255]"},
+        {"brightnessContrast", 2, 2, "brightnessContrast brightness contrast"},
+        {"gamma", 1, 1, "gamma value"},
+        {"log", 0, 1, "log [c=1]"},
+        {"power", 1, 2, "power exponent [c=1]"},
+        {"invert", 0, 0, "invert"},
+        {"clip", 2, 2, "clip min max"},
+        {"quantize", 1, 1, "quantize levels"},
+        {"equalizeRGB", 0, 0, "equalizeRGB"},
+        {"equalizeHSV", 0, 0, "equalizeHSV"},
+        {"otsu", 0, 0, "otsu"},
+        {"triangle", 0, 0, "triangle"},
+        {"threshold", 1, 1, "threshold value"},
+        {"doubleThreshold", 2, 2, "doubleThreshold low high"},
+        {"erode", 2, 2, "erode width height"},
+        {"dilate", 2, 2, "dilate width height"},
+        {"open", 2, 2, "open width height"},
+        {"close", 2, 2, "close width height"},
+        {"erodeMask", 2, 2, "erodeMask width height"},
+        {"dilateMask", 2, 2, "dilateMask width height"},
+        {"openMask", 2, 2, "openMask width height"},
+        {"closeMask", 2, 2, "closeMask width height"},
+    };
+    return operations;
+}
+
+const Operations::Info* Operations::find(const std::string& name) {
+    for (const auto& info : list()) {
+        if (name == info.name) return &info;
+    }
+    return nullptr;
+}
+
+PipelineNode Operations::create(const std::string& name, const std::vector<float>& args) {
+    const Info* info = find(name);
+    if (!info) {
+        throw std::invalid_argument("unknown operation '" + name + "'");
+    }
+    int count = static_cast<int>(args.size());
+    if (count < info->minArgs || count > info->maxArgs) {
+        throw std::invalid_argument("wrong number of arguments for '" + name + "', usage: " + info->usage);
+    }
+
+    std::string label = describe(name, args);
+
+    if (name == "linearContrast") {
+        float minP = argOr(args, 0, 2.0f), maxP = argOr(args, 1, 98.0f);
+        return PipelineNode::fromOperation(label, [minP, maxP](const Image& img) {
+            return PointOperations::linearContrast(img, minP, maxP);
+        });
+    }
+    if (name == "contrast") {
+        return PipelineNode::fromLUT(label, PointOperations::linearContrastLUT(
+            toByte(args[0]), toByte(args[1]), toByte(argOr(args, 2, 0.0f)), toByte(argOr(args, 3, 255.0f))));
+    }
+    if (name == "brightnessContrast") {
+        return PipelineNode::fromLUT(label, PointOperations::brightnessContrastLUT(args[0], args[1]));
+    }
+    if (name == "gamma") {
+        return PipelineNode::fromLUT(label, PointOperations::gammaLUT(args[0]));
+    }
+    if (name == "log") {
+        return PipelineNode::fromLUT(label, PointOperations::logarithmicLUT(argOr(args, 0, 1.0f)));
+    }
+    if (name == "power") {
+        return PipelineNode::fromLUT(label, PointOperations::powerLUT(args[0], argOr(args, 1, 1.0f)));
+    }
+    if (name == "invert") {
+        return PipelineNode::fromLUT(label, PointOperations::invertLUT());
+    }
+    if (name == "clip") {
+        return PipelineNode::fromLUT(label, PointOperations::clipLUT(toByte(args[0]), toByte(args[1])));
+    }
+    if (name == "quantize") {
+        return PipelineNode::fromLUT(label, PointOperations::quantizeLUT(static_cast<int>(args[0])));
+    }
+    if (name == "equalizeRGB") {
+        return PipelineNode::fromOperation(label, Histogram::equalizeRGB);
+    }
+    if (name == "equalizeHSV") {
+        return PipelineNode::fromOperation(label, Histogram::equalizeHSV);
+    }
+    if (name == "otsu") {
+        return PipelineNode::fromOperation(label, ThresholdProcessing::otsuThreshold);
+    }
+    if (name == "triangle") {
+        return PipelineNode::fromOperation(label, ThresholdProcessing::triangleThreshold);
+    }
+    if (name == "threshold") {
+        unsigned char threshold = toByte(args[0]);
+        return PipelineNode::fromOperation(label, [threshold](const Image& img) {
+            return ThresholdProcessing::fixedThreshold(img, threshold);
+        });
+    }
+    if (name == "doubleThreshold") {
+        unsigned char low = toByte(args[0]), high = toByte(args[1]);
+        return PipelineNode::fromOperation(label, [low, high](const Image& img) {
+            return ThresholdProcessing::doubleThreshold(img, low, high);
+        });
+    }
+
+    int width = std::max(1, static_cast<int>(args[0]));
+    int height = std::max(1, static_cast<int>(args[1]));
+    return PipelineNode::fromOperation(label, [name, width, height](const Image& img) {
+        return morphology(img, name, width, height);
+    });
+}
+
+Operations::TiledOperation Operations::createTiled(const std::string& name, const std::vector<float>& args) {
+    if ((name != "erode" && name != "dilate" && name != "open" && name != "close") || args.size() != 2) return {};
+
+    int width = std::max(1, static_cast<int>(args[0]));
+    int height = std::max(1, static_cast<int>(args[1]));
+    return [name, width, height](const TiledImage& img) {
+        if (name == "erode") return Morphology::erode(img, width, height);
+        if (name == "dilate") return Morphology::dilate(img, width, height);
+        if (name == "open") return Morphology::open(img, width, height);
+        return Morphology::close(img, width, height);
+    };
+}
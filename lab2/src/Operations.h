@@ -0,0 +1,29 @@
+#pragma once
+#include "Pipeline.h"
+#include "TiledImage.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+// Processing operations by name with numeric arguments, e.g. "gamma 0.8", for tools that build
+// an operation chain from text instead of GUI controls.
+class Operations {
+public:
+    struct Info {
+        const char* name;
+        int minArgs;
+        int maxArgs;
+        const char* usage;
+    };
+
+    static const std::vector<Info>& list();
+    static const Info* find(const std::string& name);
+
+    // Throws std::invalid_argument for an unknown name or a wrong number of arguments.
+    static PipelineNode create(const std::string& name, const std::vector<float>& args);
+
+    using TiledOperation = std::function<TiledImage(const TiledImage&)>;
+    // The same operation on a TiledImage for those that have that form (grayscale erode, dilate,
+    // open, close), empty for the rest. Expects arguments create() accepted.
+    static TiledOperation createTiled(const std::string& name, const std::vector<float>& args);
+};
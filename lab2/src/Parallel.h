@@ -0,0 +1,38 @@
+#pragma once
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+inline int hardwareThreads() {
+    unsigned int n = std::thread::hardware_concurrency();
+    return n ? static_cast<int>(n) : 1;
+}
+
+// Splits [begin, end) into one contiguous chunk per hardware thread (at most maxThreads) and calls
+// func(chunkBegin, chunkEnd). Ranges shorter than minChunk per thread run inline on the caller.
+template <typename Func>
+inline void parallelFor(int begin, int end, Func func, int minChunk = 16, int maxThreads = hardwareThreads()) {
+    int count = end - begin;
+    if (count <= 0) return;
+
+    int threads = std::min(maxThreads, std::max(1, count / std::max(1, minChunk)));
+    if (threads <= 1) {
+        func(begin, end);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    int chunk = (count + threads - 1) / threads;
+    for (int t = 1; t < threads; t++) {
+        int chunkBegin = begin + t * chunk;
+        int chunkEnd = std::min(end, chunkBegin + chunk);
+        if (chunkBegin >= chunkEnd) break;
+        workers.emplace_back(func, chunkBegin, chunkEnd);
+    }
+    func(begin, std::min(end, begin + chunk));
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
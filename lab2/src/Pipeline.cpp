@@ -0,0 +1,220 @@
+#include "Pipeline.h"
+#include "../../lab1/utils/MemoryAccounting.h"
+#include "../../lab1/utils/Profiler.h"
+#include <atomic>
+
+namespace {
+    uint64_t nextNodeId() {
+        static std::atomic<uint64_t> counter{1};
+        return counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t combineKey(uint64_t key, uint64_t id) {
+        // FNV-1a over the 8 bytes of the id
+        for (int i = 0; i < 8; i++) {
+            key ^= (id >> (i * 8)) & 0xFF;
+            key *= 1099511628211ULL;
+        }
+        return key;
+    }
+
+    // Name of a stage for the performance overlay, e.g. "LUT: Gamma 1.20, Invert" for fused value maps
+    std::string stageLabel(const std::vector<PipelineNode>& nodes, size_t begin, size_t end) {
+        if (!nodes[begin].pointwise) return nodes[begin].label;
+        std::string label = "LUT:";
+        for (size_t j = begin; j < end; j++) {
+            if (!nodes[j].enabled) continue;
+            label += (label.size() > 4 ? ", " : " ") + nodes[j].label;
+        }
+        return label;
+    }
+}
+
+PipelineNode PipelineNode::fromOperation(const std::string& label, Operation operation) {
+    PipelineNode node;
+    node.label = label;
+    node.operation = std::move(operation);
+    node.id = nextNodeId();
+    return node;
+}
+
+PipelineNode PipelineNode::fromLUT(const std::string& label, const PointOperations::LUT& lut) {
+    PipelineNode node;
+    node.label = label;
+    node.pointwise = true;
+    node.lut = lut;
+    node.operation = [lut](const Image& img) { return PointOperations::applyLUT(img, lut); };
+    node.id = nextNodeId();
+    return node;
+}
+
+PipelineCache::~PipelineCache() {
+    using MemoryAccounting::Category;
+    MemoryAccounting::transfer(Category::AnalysisCaches, Category::PixelBuffers, bytes.load(std::memory_order_relaxed));
+}
+
+void PipelineCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    source.reset();
+    replaceStages({});
+}
+
+size_t PipelineCache::evict() {
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock()) return 0;
+    size_t freed = bytes.load(std::memory_order_relaxed);
+    replaceStages({});
+    return freed;
+}
+
+void PipelineCache::replaceStages(std::vector<Entry> entries) {
+    // The old entries go only after the accounting has handed their images back to pixel buffers
+    std::vector<Entry> old = std::move(stages);
+    stages = std::move(entries);
+    updateMemoryUsage();
+}
+
+void PipelineCache::updateMemoryUsage() {
+    size_t total = 0;
+    for (const auto& entry : stages) {
+        total += entry.image->getByteSize();
+    }
+    // The images were counted as pixel buffers when they were made; while cached they count here
+    using MemoryAccounting::Category;
+    size_t previous = bytes.exchange(total, std::memory_order_relaxed);
+    if (total > previous) {
+        MemoryAccounting::transfer(Category::PixelBuffers, Category::AnalysisCaches, total - previous);
+    } else {
+        MemoryAccounting::transfer(Category::AnalysisCaches, Category::PixelBuffers, previous - total);
+    }
+}
+
+void Pipeline::append(PipelineNode node) {
+    nodes.push_back(std::move(node));
+}
+
+void Pipeline::replace(size_t index, PipelineNode node) {
+    if (index >= nodes.size()) return;
+    node.enabled = nodes[index].enabled;
+    nodes[index] = std::move(node);
+}
+
+void Pipeline::remove(size_t index) {
+    if (index >= nodes.size()) return;
+    nodes.erase(nodes.begin() + index);
+}
+
+void Pipeline::setEnabled(size_t index, bool enabled) {
+    if (index >= nodes.size()) return;
+    nodes[index].enabled = enabled;
+}
+
+void Pipeline::clear() {
+    nodes.clear();
+}
+
+std::vector<Pipeline::Stage> Pipeline::planStages(const std::vector<PipelineNode>& nodes) {
+    std::vector<Stage> stages;
+    uint64_t key = 14695981039346656037ULL;
+    size_t i = 0;
+
+    while (i < nodes.size()) {
+        if (!nodes[i].enabled) {
+            i++;
+            continue;
+        }
+
+        // A stage is either one ordinary node or a run of enabled pointwise nodes
+        size_t end = i + 1;
+        key = combineKey(key, nodes[i].id);
+        if (nodes[i].pointwise) {
+            while (end < nodes.size() && (!nodes[end].enabled || nodes[end].pointwise)) {
+                if (nodes[end].enabled) key = combineKey(key, nodes[end].id);
+                end++;
+            }
+        }
+
+        stages.push_back({i, end, key});
+        i = end;
+    }
+    return stages;
+}
+
+std::shared_ptr<const Image> Pipeline::evaluate(const std::shared_ptr<const Image>& source,
+                                                const std::vector<PipelineNode>& nodes,
+                                                PipelineCache& cache) {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (cache.source != source) {
+        cache.source = source;
+        cache.replaceStages({});
+    }
+
+    std::vector<Stage> stages = planStages(nodes);
+
+    // Keys chain over all earlier stages, so the deepest cached stage implies everything before it
+    std::vector<PipelineCache::Entry> kept;
+    std::shared_ptr<const Image> current = source;
+    size_t first = 0;
+    for (size_t s = stages.size(); s-- > 0 && first == 0;) {
+        for (const auto& entry : cache.stages) {
+            if (entry.key == stages[s].key) {
+                current = entry.image;
+                first = s + 1;
+                break;
+            }
+        }
+    }
+    for (const auto& entry : cache.stages) {
+        for (size_t s = 0; s < first; s++) {
+            if (entry.key == stages[s].key) kept.push_back(entry);
+        }
+    }
+    cache.replaceStages(std::move(kept));
+
+    for (size_t s = first; s < stages.size(); s++) {
+        current = std::make_shared<const Image>(runStage(*current, nodes, stages[s]));
+        cache.stages.push_back({stages[s].key, current});
+    }
+    cache.updateMemoryUsage();
+
+    return current;
+}
+
+Image Pipeline::run(const Image& source, const std::vector<PipelineNode>& nodes) {
+    std::vector<Stage> stages = planStages(nodes);
+    if (stages.empty()) return source;
+
+    Image current = runStage(source, nodes, stages[0]);
+    for (size_t s = 1; s < stages.size(); s++) {
+        current = runStage(current, nodes, stages[s]);
+    }
+    return current;
+}
+
+Image Pipeline::runStage(const Image& input, const std::vector<PipelineNode>& nodes, const Stage& stage) {
+    Profiler::ScopedTimer timer;
+    if (timer.isActive()) timer.setLabel(stageLabel(nodes, stage.begin, stage.end));
+
+    if (!nodes[stage.begin].pointwise) {
+        return nodes[stage.begin].operation(input);
+    }
+
+    PointOperations::LUT lut = nodes[stage.begin].lut;
+    for (size_t j = stage.begin + 1; j < stage.end; j++) {
+        if (nodes[j].enabled) lut = PointOperations::composeLUT(lut, nodes[j].lut);
+    }
+    return PointOperations::applyLUT(input, lut);
+}
+
+void Pipeline::seed(const std::shared_ptr<const Image>& source, const std::vector<PipelineNode>& nodes,
+                    const std::shared_ptr<const Image>& result, PipelineCache& cache) {
+    std::vector<Stage> stages = planStages(nodes);
+
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    cache.source = source;
+    std::vector<PipelineCache::Entry> entries;
+    if (!stages.empty()) {
+        entries.push_back({stages.back().key, result});
+    }
+    cache.replaceStages(std::move(entries));
+}
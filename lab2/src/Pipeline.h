@@ -0,0 +1,103 @@
+#pragma once
+#include "Image.h"
+#include "PointOperations.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// One step of the operation stack. Per-pixel value maps carry their LUT so that adjacent ones can be
+// fused into a single pass; everything else is an arbitrary image-to-image operation.
+struct PipelineNode {
+    using Operation = std::function<Image(const Image&)>;
+
+    std::string label;
+    Operation operation;
+    bool pointwise = false;
+    PointOperations::LUT lut = {};
+    bool enabled = true;
+    // Unique per node and parameter set; cached results are keyed by it.
+    uint64_t id = 0;
+
+    static PipelineNode fromOperation(const std::string& label, Operation operation);
+    static PipelineNode fromLUT(const std::string& label, const PointOperations::LUT& lut);
+};
+
+// Intermediate results of one pipeline evaluated on one source image, keyed by stage.
+// The cached stages count as MemoryAccounting analysis caches rather than pixel buffers.
+class PipelineCache {
+public:
+    PipelineCache() = default;
+    ~PipelineCache();
+    PipelineCache(const PipelineCache&) = delete;
+    PipelineCache& operator=(const PipelineCache&) = delete;
+
+    void clear();
+    // Drops the cached stages unless an evaluation is running; returns the bytes no longer cached.
+    // For memory pressure, where waiting for the evaluation is not an option.
+    size_t evict();
+    // Pixel bytes of the cached stage results, not counting the source. Does not wait for a running
+    // evaluation, which holds the cache for its whole duration.
+    size_t memoryUsage() const { return bytes.load(std::memory_order_relaxed); }
+
+private:
+    friend class Pipeline;
+
+    struct Entry {
+        uint64_t key;
+        std::shared_ptr<const Image> image;
+    };
+
+    // Called with the mutex held whenever `stages` changed
+    void updateMemoryUsage();
+    // Swaps in new stages and updates the accounting before the old ones are released
+    void replaceStages(std::vector<Entry> entries);
+
+    std::mutex mutex;
+    std::shared_ptr<const Image> source;
+    std::vector<Entry> stages;
+    std::atomic<size_t> bytes{0};
+};
+
+class Pipeline {
+public:
+    const std::vector<PipelineNode>& getNodes() const { return nodes; }
+    size_t size() const { return nodes.size(); }
+    bool empty() const { return nodes.empty(); }
+
+    void setNodes(std::vector<PipelineNode> newNodes) { nodes = std::move(newNodes); }
+    void append(PipelineNode node);
+    void replace(size_t index, PipelineNode node);
+    void remove(size_t index);
+    void setEnabled(size_t index, bool enabled);
+    void clear();
+
+    // Evaluates `nodes` on `source`, reusing the cached stages in front of the first one whose nodes
+    // changed. Runs of enabled pointwise nodes form a single stage applied with one fused LUT.
+    // Safe to call from worker threads with a copy of the node list.
+    static std::shared_ptr<const Image> evaluate(const std::shared_ptr<const Image>& source,
+                                                 const std::vector<PipelineNode>& nodes,
+                                                 PipelineCache& cache);
+
+    // Evaluates without a cache; each intermediate result is released once the next one is done.
+    static Image run(const Image& source, const std::vector<PipelineNode>& nodes);
+
+    // Records `result` as the output of `nodes`, e.g. for a state restored from history, so that
+    // the next evaluation continues from it instead of starting over.
+    static void seed(const std::shared_ptr<const Image>& source, const std::vector<PipelineNode>& nodes,
+                     const std::shared_ptr<const Image>& result, PipelineCache& cache);
+
+private:
+    struct Stage {
+        size_t begin;
+        size_t end;
+        uint64_t key;
+    };
+    static std::vector<Stage> planStages(const std::vector<PipelineNode>& nodes);
+    static Image runStage(const Image& input, const std::vector<PipelineNode>& nodes, const Stage& stage);
+
+    std::vector<PipelineNode> nodes;
+};
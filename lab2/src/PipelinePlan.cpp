@@ -0,0 +1,482 @@
+#include "PipelinePlan.h"
+#include "Cancellation.h"
+#include "Histogram.h"
+#include "Kernels.h"
+#include "Operations.h"
+#include "Strips.h"
+#include "ThresholdProcessing.h"
+#include "TiledImage.h"
+#include "Trace.h"
+#include "../../lab1/utils/MemoryAccounting.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    using Hist = Histogram::Counts;
+    using LUT = PointOperations::LUT;
+
+    // Row buffers of the calling thread, which only grow: repeated runs on images of one size allocate
+    // nothing once the first run has sized them
+    struct RowScratch {
+        std::vector<unsigned char> mapped;
+        std::vector<unsigned char> values;
+    };
+
+    RowScratch& rowScratch(int width, int channels) {
+        thread_local RowScratch scratch;
+        size_t rowSize = static_cast<size_t>(width) * channels;
+        if (scratch.mapped.size() < rowSize) scratch.mapped.resize(rowSize);
+        if (scratch.values.size() < static_cast<size_t>(width)) scratch.values.resize(width);
+        return scratch;
+    }
+
+    // ThresholdProcessing intensities of one row of applyLUT(img, lut). Colour rows go through
+    // `mapped`, a row's worth of bytes, so the intensity kernel sees contiguous pixels.
+    void rowIntensityThrough(const unsigned char* row, int width, int channels, const LUT& lut,
+                             unsigned char* mapped, unsigned char* out) {
+        if (channels < 3) {
+            for (int x = 0; x < width; x++) {
+                out[x] = lut[row[x * channels]];
+            }
+            return;
+        }
+        size_t rowSize = static_cast<size_t>(width) * channels;
+        for (size_t i = 0; i < rowSize; i++) {
+            mapped[i] = lut[row[i]];
+        }
+        Kernels::active().intensity(mapped, channels, out, static_cast<size_t>(width));
+    }
+
+    // Intensity histogram of applyLUT(img, lut) without writing that image anywhere
+    Hist histogramThrough(const Image& img, const LUT& lut) {
+        Trace::Zone zone("PipelinePlan::histogram");
+        Hist hist = {0};
+        int width = img.getWidth();
+        int channels = img.getChannels();
+        size_t rowSize = img.getStride();
+        std::mutex histMutex;
+        Kernels::forRows(img.getHeight(), [&](int rowBegin, int rowEnd) {
+            Hist bandHist = {0};
+            RowScratch& scratch = rowScratch(width, channels);
+            const unsigned char* values = scratch.values.data();
+            for (int y = rowBegin; y < rowEnd; y++) {
+                Cancellation::checkpoint(y - rowBegin, rowEnd - rowBegin);
+                rowIntensityThrough(img.getData() + y * rowSize, width, channels, lut, scratch.mapped.data(),
+                                    scratch.values.data());
+                for (int x = 0; x < width; x++) {
+                    bandHist[values[x]]++;
+                }
+            }
+            std::lock_guard<std::mutex> lock(histMutex);
+            for (int i = 0; i < 256; i++) hist[i] += bandHist[i];
+        });
+        return hist;
+    }
+
+    // fixedThreshold(applyLUT(img, lut), threshold) in a single pass; `result` may be `img`
+    void thresholdThrough(const Image& img, const LUT& lut, unsigned char threshold, Image& result) {
+        Trace::Zone zone("PipelinePlan::threshold");
+        if (&result != &img) {
+            result.resize(img.getWidth(), img.getHeight(), img.getChannels());
+        }
+        const Kernels::Table& kernels = Kernels::active();
+        int width = img.getWidth();
+        int channels = img.getChannels();
+        size_t rowSize = img.getStride();
+        Kernels::forRows(img.getHeight(), [&](int rowBegin, int rowEnd) {
+            RowScratch& scratch = rowScratch(width, channels);
+            unsigned char* values = scratch.values.data();
+            for (int y = rowBegin; y < rowEnd; y++) {
+                Cancellation::checkpoint(y - rowBegin, rowEnd - rowBegin);
+                // The row is read completely before it is overwritten when working in place
+                rowIntensityThrough(img.getData() + y * rowSize, width, channels, lut, scratch.mapped.data(), values);
+                kernels.threshold(values, values, static_cast<size_t>(width), threshold);
+                kernels.broadcast(values, channels, result.getData() + y * rowSize, static_cast<size_t>(width));
+            }
+        });
+        result.updateTexture();
+    }
+
+    // Histogram of the values after `lut`, from the histogram before it
+    Hist remap(const Hist& hist, const LUT& lut) {
+        Hist result = {0};
+        for (int v = 0; v < 256; v++) {
+            result[lut[v]] += hist[v];
+        }
+        return result;
+    }
+
+    LUT thresholdLUT(unsigned char threshold) {
+        LUT lut;
+        for (int v = 0; v < 256; v++) {
+            lut[v] = v >= threshold ? 255 : 0;
+        }
+        return lut;
+    }
+
+    // Intensity histogram after thresholding a multi-channel image with intensity histogram `hist`:
+    // every pixel is black or white in all channels
+    Hist thresholdedHistogram(const Hist& hist, unsigned char threshold, int channels) {
+        unsigned char white = 255;
+        if (channels >= 3) {
+            const unsigned char whitePixel[3] = {255, 255, 255};
+            Kernels::active().intensity(whitePixel, 3, &white, 1);
+        }
+        Hist thresholded = {0};
+        for (int v = 0; v < 256; v++) {
+            thresholded[v >= threshold ? white : 0] += hist[v];
+        }
+        return thresholded;
+    }
+
+    // One step of a streamed plan, applied to every strip in place
+    struct StripStep {
+        enum class Type { Map, Threshold, Operation };
+        Type type;
+        LUT lut;
+        unsigned char threshold;
+        const PipelineNode::Operation* operation;
+    };
+
+    void applySteps(const std::vector<StripStep>& steps, Image& strip) {
+        for (const StripStep& step : steps) {
+            switch (step.type) {
+            case StripStep::Type::Map:
+                PointOperations::applyLUT(strip, step.lut, strip);
+                break;
+            case StripStep::Type::Threshold:
+                thresholdThrough(strip, step.lut, step.threshold, strip);
+                break;
+            case StripStep::Type::Operation:
+                strip = (*step.operation)(strip);
+                break;
+            }
+        }
+    }
+}
+
+PipelinePlan PipelinePlan::compile(const std::vector<PipelineScript::Step>& steps, int tileSize) {
+    PipelinePlan plan;
+    plan.tileSize = std::max(0, tileSize);
+
+    for (const auto& step : steps) {
+        Pass pass;
+        pass.label = PipelineScript::format(step);
+
+        if (step.name == "linearContrast") {
+            pass.kind = Kind::Stretch;
+            pass.minPercentile = step.args.size() > 0 ? step.args[0] : 2.0f;
+            pass.maxPercentile = step.args.size() > 1 ? step.args[1] : 98.0f;
+        } else if (step.name == "otsu") {
+            pass.kind = Kind::Otsu;
+        } else if (step.name == "triangle") {
+            pass.kind = Kind::Triangle;
+        } else if (step.name == "equalizeRGB") {
+            pass.kind = Kind::Equalize;
+        } else {
+            PipelineNode node = Operations::create(step.name, step.args);
+            Operations::TiledOperation tiled = plan.tileSize ? Operations::createTiled(step.name, step.args) : nullptr;
+            if (tiled && !plan.passes.empty() && plan.passes.back().kind == Kind::Tiled) {
+                Pass& previous = plan.passes.back();
+                previous.tiled.push_back(std::move(tiled));
+                previous.label += ", " + pass.label;
+                continue;
+            } else if (tiled) {
+                pass.kind = Kind::Tiled;
+                pass.tiled.push_back(std::move(tiled));
+            } else if (!node.pointwise) {
+                pass.kind = Kind::Operation;
+                pass.operation = std::move(node.operation);
+                pass.rowLocal = step.name == "threshold" || step.name == "doubleThreshold";
+            } else if (!plan.passes.empty() && plan.passes.back().kind == Kind::LUT) {
+                Pass& previous = plan.passes.back();
+                previous.lut = PointOperations::composeLUT(previous.lut, node.lut);
+                previous.label += ", " + pass.label;
+                continue;
+            } else {
+                pass.kind = Kind::LUT;
+                pass.lut = node.lut;
+            }
+        }
+
+        plan.passes.push_back(std::move(pass));
+    }
+
+    for (const auto& step : steps) {
+        const std::string& name = step.name;
+        bool mask = name.size() > 4 && name.compare(name.size() - 4, 4, "Mask") == 0;
+        if (mask || name == "otsu" || name == "triangle" || name == "threshold" || name == "doubleThreshold") {
+            plan.gray = true;
+        }
+    }
+
+    return plan;
+}
+
+Image PipelinePlan::run(const Image& source) const {
+    Image result;
+    run(source, result);
+    return result;
+}
+
+void PipelinePlan::run(const Image& source, Image& result) const {
+    run(source, result, nullptr);
+}
+
+bool PipelinePlan::usesHistogram(int channels) const {
+    for (const Pass& pass : passes) {
+        if (pass.kind == Kind::Stretch || pass.kind == Kind::Otsu || pass.kind == Kind::Triangle) return true;
+        // Colour images are equalized per channel, without the intensity histogram
+        if (pass.kind == Kind::Equalize && channels == 1) return true;
+    }
+    return false;
+}
+
+void PipelinePlan::run(const Image& source, Image& result, SourceHistogram* sourceHistogram) const {
+    Trace::Zone zone("PipelinePlan::run");
+    const LUT identity = PointOperations::identityLUT();
+    const int channels = source.getChannels();
+
+    // Once anything was written, the intermediate image lives in `result`. That may be `source`
+    // itself, so whether the pixels are still the source's is tracked apart from `current`.
+    const Image* current = &source;
+    bool sourceUntouched = true;
+    // Value map not yet applied to `current`. The histogram, while known, is that of the mapped image.
+    LUT pending = identity;
+    Hist hist = {0};
+    bool histKnown = false;
+    if (sourceHistogram && sourceHistogram->known) {
+        hist = sourceHistogram->counts;
+        histKnown = true;
+    }
+
+    auto replace = [&](Image next) {
+        result = std::move(next);
+        current = &result;
+        sourceUntouched = false;
+    };
+
+    auto mapValues = [&](const LUT& lut) {
+        // With one value per pixel the intensity is the value itself, so the histogram follows the LUT
+        if (histKnown && channels < 3) {
+            hist = remap(hist, lut);
+        } else {
+            histKnown = false;
+        }
+        pending = PointOperations::composeLUT(pending, lut);
+    };
+
+    auto flush = [&]() {
+        if (pending == identity) return;
+        PointOperations::applyLUT(*current, pending, result);
+        current = &result;
+        sourceUntouched = false;
+        pending = identity;
+    };
+
+    auto histogram = [&]() -> const Hist& {
+        if (!histKnown) {
+            hist = histogramThrough(*current, pending);
+            histKnown = true;
+            if (sourceHistogram && sourceUntouched && pending == identity) {
+                sourceHistogram->counts = hist;
+                sourceHistogram->known = true;
+            }
+        }
+        return hist;
+    };
+
+    for (const Pass& pass : passes) {
+        switch (pass.kind) {
+        case Kind::LUT:
+            mapValues(pass.lut);
+            break;
+
+        case Kind::Stretch:
+            mapValues(PointOperations::percentileContrastLUT(histogram(), pass.minPercentile, pass.maxPercentile));
+            break;
+
+        case Kind::Equalize:
+            if (channels == 1) {
+                mapValues(Histogram::equalizationLUT(histogram()));
+            } else {
+                flush();
+                replace(Histogram::equalizeRGB(*current));
+                histKnown = false;
+            }
+            break;
+
+        case Kind::Otsu:
+        case Kind::Triangle: {
+            unsigned char threshold = pass.kind == Kind::Otsu
+                ? ThresholdProcessing::calculateOtsuThreshold(histogram())
+                : ThresholdProcessing::calculateTriangleThreshold(histogram());
+            if (channels == 1) {
+                mapValues(thresholdLUT(threshold));
+                break;
+            }
+
+            thresholdThrough(*current, pending, threshold, result);
+            current = &result;
+            sourceUntouched = false;
+            pending = identity;
+            hist = thresholdedHistogram(hist, threshold, channels);
+            break;
+        }
+
+        case Kind::Operation:
+            flush();
+            replace(pass.operation(*current));
+            histKnown = false;
+            break;
+
+        case Kind::Tiled: {
+            flush();
+            TiledImage tiles = TiledImage::fromImage(*current, tileSize);
+            MemoryAccounting::Scoped counted(MemoryAccounting::Category::Temporaries, tiles.getByteSize());
+            for (const auto& operation : pass.tiled) {
+                tiles = operation(tiles);
+            }
+            tiles.toImage(result);
+            current = &result;
+            sourceUntouched = false;
+            histKnown = false;
+            break;
+        }
+        }
+    }
+
+    flush();
+    if (sourceUntouched && &result != &source) {
+        result.copyFrom(source);
+    }
+}
+
+std::string PipelinePlan::unstreamableStep(int channels) const {
+    for (const Pass& pass : passes) {
+        if ((pass.kind == Kind::Operation && !pass.rowLocal) || pass.kind == Kind::Tiled ||
+            (pass.kind == Kind::Equalize && channels != 1)) {
+            return pass.label;
+        }
+    }
+    return "";
+}
+
+void PipelinePlan::runStrips(StripReader& in, StripWriter& out, int stripRows) const {
+    Trace::Zone zone("PipelinePlan::runStrips");
+    const int channels = in.getChannels();
+    std::string blocked = unstreamableStep(channels);
+    if (!blocked.empty()) {
+        throw std::invalid_argument("'" + blocked + "' needs the whole image and cannot run on strips");
+    }
+
+    // Same bookkeeping as run(), except that the work done so far is a list of steps to repeat on
+    // every strip instead of an image
+    const LUT identity = PointOperations::identityLUT();
+    std::vector<StripStep> steps;
+    LUT pending = identity;
+    Hist hist = {0};
+    bool histKnown = false;
+    bool started = false;
+    Image strip;
+
+    auto nextPass = [&]() {
+        if (started) in.rewind();
+        started = true;
+    };
+
+    auto mapValues = [&](const LUT& lut) {
+        if (histKnown && channels < 3) {
+            hist = remap(hist, lut);
+        } else {
+            histKnown = false;
+        }
+        pending = PointOperations::composeLUT(pending, lut);
+    };
+
+    auto flush = [&]() {
+        if (pending == identity) return;
+        steps.push_back({StripStep::Type::Map, pending, 0, nullptr});
+        pending = identity;
+    };
+
+    auto histogram = [&]() -> const Hist& {
+        if (histKnown) return hist;
+        nextPass();
+        hist = {0};
+        while (in.read(strip, stripRows) > 0) {
+            applySteps(steps, strip);
+            Hist counts = histogramThrough(strip, pending);
+            for (int v = 0; v < 256; v++) hist[v] += counts[v];
+        }
+        histKnown = true;
+        return hist;
+    };
+
+    for (const Pass& pass : passes) {
+        switch (pass.kind) {
+        case Kind::LUT:
+            mapValues(pass.lut);
+            break;
+
+        case Kind::Stretch:
+            mapValues(PointOperations::percentileContrastLUT(histogram(), pass.minPercentile, pass.maxPercentile));
+            break;
+
+        case Kind::Equalize:
+            mapValues(Histogram::equalizationLUT(histogram()));
+            break;
+
+        case Kind::Otsu:
+        case Kind::Triangle: {
+            unsigned char threshold = pass.kind == Kind::Otsu
+                ? ThresholdProcessing::calculateOtsuThreshold(histogram())
+                : ThresholdProcessing::calculateTriangleThreshold(histogram());
+            if (channels == 1) {
+                mapValues(thresholdLUT(threshold));
+                break;
+            }
+            steps.push_back({StripStep::Type::Threshold, pending, threshold, nullptr});
+            pending = identity;
+            hist = thresholdedHistogram(hist, threshold, channels);
+            break;
+        }
+
+        case Kind::Operation:
+            flush();
+            steps.push_back({StripStep::Type::Operation, identity, 0, &pass.operation});
+            histKnown = false;
+            break;
+
+        case Kind::Tiled:
+            // Refused by unstreamableStep() above
+            break;
+        }
+    }
+    flush();
+
+    nextPass();
+    while (in.read(strip, stripRows) > 0) {
+        applySteps(steps, strip);
+        out.write(strip);
+    }
+    out.finish();
+}
+
+std::vector<std::string> PipelinePlan::describe() const {
+    std::vector<std::string> lines;
+    for (const Pass& pass : passes) {
+        switch (pass.kind) {
+        case Kind::LUT: lines.push_back("LUT: " + pass.label); break;
+        case Kind::Stretch: lines.push_back("histogram LUT: " + pass.label); break;
+        case Kind::Equalize: lines.push_back("histogram LUT: " + pass.label); break;
+        case Kind::Otsu:
+        case Kind::Triangle: lines.push_back("histogram threshold: " + pass.label); break;
+        case Kind::Operation: lines.push_back("image: " + pass.label); break;
+        case Kind::Tiled: lines.push_back("tiles of " + std::to_string(tileSize) + ": " + pass.label); break;
+        }
+    }
+    return lines;
+}
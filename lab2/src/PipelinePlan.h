@@ -0,0 +1,84 @@
+#pragma once
+#include "Image.h"
+#include "Pipeline.h"
+#include "PipelineScript.h"
+#include "Histogram.h"
+#include "Operations.h"
+#include "PointOperations.h"
+#include <array>
+#include <string>
+#include <vector>
+
+class StripReader;
+class StripWriter;
+
+// Compiled form of a PipelineScript for batch runs. Consecutive value maps are folded into one LUT
+// at compile time, and the histogram-driven steps (linearContrast, otsu, triangle, equalizeRGB)
+// share one intensity histogram while running: it is carried through LUTs where that is exact and
+// otherwise collected by reading through the pending LUT, so the intermediate image is never
+// written just to be measured.
+//
+// With a tile size, runs of neighbourhood steps that have a TiledImage form (grayscale morphology)
+// become one pass that converts the image to tiles once, applies them all there and converts back
+// only when a step without that form, or the end of the plan, needs the scanline layout again.
+class PipelinePlan {
+public:
+    // `tileSize` 0 keeps every step on scanline images
+    static PipelinePlan compile(const std::vector<PipelineScript::Step>& steps, int tileSize = 0);
+
+    Image run(const Image& source) const;
+    // Same, writing into `result` and reusing its buffer: plans made of value maps and
+    // histogram-driven steps allocate nothing once `result` has the right size and a first run on
+    // the calling thread has sized its row buffers. That holds with Kernels::threads() at 1, the
+    // default; more band threads are started for every pass. Other steps (morphology, equalizeHSV,
+    // ...) still produce a new image each. `result` may be `source`.
+    void run(const Image& source, Image& result) const;
+
+    // Intensity histogram of a source image, for callers that see the same image repeatedly
+    struct SourceHistogram {
+        Histogram::Counts counts = {};
+        bool known = false;
+    };
+    // Uses `sourceHistogram` instead of measuring the source when it is known, and fills it in
+    // when the run had to measure it.
+    void run(const Image& source, Image& result, SourceHistogram* sourceHistogram) const;
+    // Whether running on images with `channels` channels measures the intensity histogram
+    bool usesHistogram(int channels) const;
+
+    // Runs the plan over an image too large for memory, `stripRows` rows at a time, writing each
+    // strip as soon as it is done, so memory stays at a few strips whatever the image size. Every
+    // histogram the plan measures costs one more read of the input, which must then be seekable.
+    // Throws std::invalid_argument for plans that are not streamable().
+    void runStrips(StripReader& in, StripWriter& out, int stripRows) const;
+    // Empty when runStrips() takes the plan for images with `channels` channels, otherwise the first
+    // step that needs the whole image at once (morphology, equalizeHSV, equalizeRGB on colour)
+    std::string unstreamableStep(int channels) const;
+
+    // One line per pass, e.g. "LUT: gamma 0.8, invert"
+    std::vector<std::string> describe() const;
+    size_t passCount() const { return passes.size(); }
+    bool empty() const { return passes.empty(); }
+    // True when the result depends on intensity alone (a threshold or binary mask step), so colour
+    // information does not survive it.
+    bool producesGray() const { return gray; }
+
+private:
+    enum class Kind { LUT, Stretch, Otsu, Triangle, Equalize, Operation, Tiled };
+
+    struct Pass {
+        Kind kind;
+        std::string label;
+        PointOperations::LUT lut = {};
+        float minPercentile = 0.0f;
+        float maxPercentile = 0.0f;
+        PipelineNode::Operation operation;
+        // Applied in order to one TiledImage
+        std::vector<Operations::TiledOperation> tiled;
+        // Each output row depends on the same input row only (threshold, doubleThreshold)
+        bool rowLocal = false;
+    };
+
+    std::vector<Pass> passes;
+    bool gray = false;
+    int tileSize = 0;
+};
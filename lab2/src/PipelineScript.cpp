@@ -0,0 +1,189 @@
+#include "PipelineScript.h"
+#include "Operations.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+    const char* const kUnicodeArrow = "\xE2\x86\x92";
+
+    // Splits a line at "->" and the unicode arrow; comments are already stripped.
+    std::vector<std::string> splitSteps(const std::string& line) {
+        std::vector<std::string> parts;
+        size_t start = 0;
+        size_t pos = 0;
+        while (pos < line.size()) {
+            size_t arrowLength = 0;
+            if (line.compare(pos, 2, "->") == 0) arrowLength = 2;
+            else if (line.compare(pos, 3, kUnicodeArrow) == 0) arrowLength = 3;
+
+            if (arrowLength) {
+                parts.push_back(line.substr(start, pos - start));
+                pos += arrowLength;
+                start = pos;
+            } else {
+                pos++;
+            }
+        }
+        parts.push_back(line.substr(start));
+        return parts;
+    }
+
+    bool inRange(float value, float min, float max) {
+        return value >= min && value <= max;
+    }
+
+    bool isMorphology(const std::string& name) {
+        for (const char* op : {"erode", "dilate", "open", "close"}) {
+            if (name.compare(0, std::strlen(op), op) == 0) return true;
+        }
+        return false;
+    }
+}
+
+std::vector<PipelineScript::Step> PipelineScript::parse(const std::string& text, std::vector<Error>& errors) {
+    std::vector<Step> steps;
+    std::istringstream input(text);
+    std::string line;
+    int lineNumber = 0;
+
+    while (std::getline(input, line)) {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+
+        std::vector<std::string> parts = splitSteps(line);
+        for (size_t p = 0; p < parts.size(); p++) {
+            std::string part = parts[p];
+            for (char& c : part) {
+                if (c == ':' || c == ',' || c == '\t' || c == '\r') c = ' ';
+            }
+
+            std::istringstream tokens(part);
+            Step step;
+            step.line = lineNumber;
+            if (!(tokens >> step.name)) {
+                // Blank lines are fine, an arrow without a step on one side is not
+                if (parts.size() > 1) errors.push_back({lineNumber, "missing step around '->'"});
+                continue;
+            }
+
+            bool numeric = true;
+            std::string token;
+            while (tokens >> token) {
+                char* end = nullptr;
+                float value = std::strtof(token.c_str(), &end);
+                if (end == token.c_str() || *end != '\0') {
+                    errors.push_back({lineNumber, "'" + token + "' is not a number in '" + step.name + "'"});
+                    numeric = false;
+                    break;
+                }
+                step.args.push_back(value);
+            }
+            if (!numeric) continue;
+
+            std::string problem = validate(step);
+            if (!problem.empty()) {
+                errors.push_back({lineNumber, problem});
+                continue;
+            }
+            steps.push_back(std::move(step));
+        }
+    }
+
+    return steps;
+}
+
+std::vector<PipelineScript::Step> PipelineScript::load(const std::string& filepath, std::vector<Error>& errors) {
+    std::ifstream file(filepath);
+    if (!file) {
+        errors.push_back({0, "cannot open " + filepath});
+        return {};
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    return parse(text.str(), errors);
+}
+
+bool PipelineScript::save(const std::string& filepath, const std::vector<Step>& steps) {
+    std::ofstream file(filepath);
+    if (!file) return false;
+    file << format(steps);
+    return static_cast<bool>(file);
+}
+
+std::string PipelineScript::validate(const Step& step) {
+    const Operations::Info* info = Operations::find(step.name);
+    if (!info) {
+        return "unknown operation '" + step.name + "'";
+    }
+    int count = static_cast<int>(step.args.size());
+    if (count < info->minArgs || count > info->maxArgs) {
+        return "wrong number of arguments for '" + step.name + "', usage: " + info->usage;
+    }
+
+    const std::string& name = step.name;
+    const std::vector<float>& a = step.args;
+    for (float value : a) {
+        if (!std::isfinite(value)) return "arguments of '" + name + "' must be finite numbers";
+    }
+
+    if (name == "linearContrast") {
+        float minP = count > 0 ? a[0] : 2.0f;
+        float maxP = count > 1 ? a[1] : 98.0f;
+        if (!inRange(minP, 0, 100) || !inRange(maxP, 0, 100) || minP >= maxP) {
+            return "linearContrast percentiles must satisfy 0 <= min < max <= 100";
+        }
+    } else if (name == "gamma" || name == "power") {
+        if (a[0] <= 0) return name + " must be positive";
+    } else if (name == "log") {
+        if (count > 0 && a[0] <= 0) return "log factor must be positive";
+    } else if (name == "quantize") {
+        if (!inRange(a[0], 2, 256)) return "quantize levels must be between 2 and 256";
+    } else if (name == "contrast" || name == "clip" || name == "threshold" || name == "doubleThreshold") {
+        for (float value : a) {
+            if (!inRange(value, 0, 255)) return name + " values must be between 0 and 255";
+        }
+        if ((name == "clip" || name == "doubleThreshold") && a[0] > a[1]) {
+            return name + " needs the lower value first";
+        }
+    } else if (isMorphology(name)) {
+        if (!inRange(a[0], 1, 255) || !inRange(a[1], 1, 255)) {
+            return name + " size must be between 1 and 255";
+        }
+    }
+    return "";
+}
+
+std::string PipelineScript::format(const Step& step) {
+    std::ostringstream text;
+    text << step.name;
+    for (float arg : step.args) {
+        text << ' ' << arg;
+    }
+    return text.str();
+}
+
+std::string PipelineScript::format(const std::vector<Step>& steps) {
+    std::string text;
+    for (const auto& step : steps) {
+        text += format(step) + "\n";
+    }
+    return text;
+}
+
+std::string PipelineScript::describe(const Error& error) {
+    if (error.line <= 0) return error.message;
+    return "line " + std::to_string(error.line) + ": " + error.message;
+}
+
+std::vector<PipelineNode> PipelineScript::toNodes(const std::vector<Step>& steps) {
+    std::vector<PipelineNode> nodes;
+    nodes.reserve(steps.size());
+    for (const auto& step : steps) {
+        nodes.push_back(Operations::create(step.name, step.args));
+    }
+    return nodes;
+}
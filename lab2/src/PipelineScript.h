@@ -0,0 +1,41 @@
+#pragma once
+#include "Pipeline.h"
+#include <string>
+#include <vector>
+
+// Text description of an operation chain, one step per line or several separated by "->":
+//
+//   # comments run to the end of the line
+//   linearContrast 2 98 -> gamma 0.8
+//   otsu
+//
+// Step names and arguments are those of Operations::list(); "gamma:0.8" is accepted as well.
+class PipelineScript {
+public:
+    struct Step {
+        std::string name;
+        std::vector<float> args;
+        int line = 0;
+    };
+
+    struct Error {
+        int line;
+        std::string message;
+    };
+
+    // Parses and validates `text`. Every problem found is added to `errors` and its step skipped,
+    // so the caller can report all of them at once.
+    static std::vector<Step> parse(const std::string& text, std::vector<Error>& errors);
+    static std::vector<Step> load(const std::string& filepath, std::vector<Error>& errors);
+    static bool save(const std::string& filepath, const std::vector<Step>& steps);
+
+    // Empty when the step is valid, otherwise what is wrong with it
+    static std::string validate(const Step& step);
+
+    static std::string format(const Step& step);
+    static std::string format(const std::vector<Step>& steps);
+    static std::string describe(const Error& error);
+
+    // Editable stack nodes for the GUI; the steps must be valid.
+    static std::vector<PipelineNode> toNodes(const std::vector<Step>& steps);
+};
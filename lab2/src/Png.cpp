@@ -0,0 +1,630 @@
+#include "Png.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include "../../lab1/utils/MemoryAccounting.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <vector>
+
+namespace {
+    const size_t kMinBandBytes = 1 << 20;
+    // Keeps positions within int32 and the scratch of one band bounded
+    const size_t kMaxBandBytes = 64 << 20;
+    const size_t kWindow = 32768;
+    // Tokens per deflate block; each block gets codes fitted to its own statistics
+    const size_t kBlockTokens = 16384;
+    const int kHashBits = 15;
+
+    struct Level {
+        // Candidates tried per position, and the match length that ends the search early
+        int chain;
+        size_t nice;
+        // Also indexes the positions inside matches, finding more matches at some cost in speed
+        bool insertAll;
+    };
+
+    const Level kLevels[10] = {
+        {0, 0, false}, {1, 16, false}, {2, 32, false}, {4, 32, false}, {8, 64, true},
+        {16, 128, true}, {32, 128, true}, {64, 258, true}, {256, 258, true}, {1024, 258, true},
+    };
+
+    const int kLengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    const int kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    const int kDistanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                   513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    const int kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7,
+                                    8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    uint32_t reverseBits(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; i++) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        return reversed;
+    }
+
+    // A Huffman code, bit-reversed for the LSB-first stream
+    struct Code {
+        std::array<uint16_t, 288> code{};
+        std::array<uint8_t, 288> bits{};
+    };
+
+    void canonicalCode(const uint8_t* lengths, int count, Code& code) {
+        int perLength[16] = {};
+        for (int s = 0; s < count; s++) perLength[lengths[s]]++;
+        perLength[0] = 0;
+        int next[16] = {};
+        int value = 0;
+        for (int bits = 1; bits < 16; bits++) {
+            value = (value + perLength[bits - 1]) << 1;
+            next[bits] = value;
+        }
+        for (int s = 0; s < count; s++) {
+            code.bits[s] = lengths[s];
+            code.code[s] = lengths[s] ? static_cast<uint16_t>(reverseBits(next[lengths[s]]++, lengths[s])) : 0;
+        }
+    }
+
+    // The fixed codes of deflate and the symbol lookups for match lengths and distances
+    struct Tables {
+        Code fixedLiterals;
+        Code fixedDistances;
+        std::array<uint8_t, 259> lengthSymbol;
+        // zlib's layout: distances below 256 directly, longer ones by their 128s
+        std::array<uint8_t, 512> distanceSymbol;
+        std::array<uint32_t, 256> crc;
+
+        Tables() {
+            uint8_t lengths[288];
+            for (int s = 0; s < 288; s++) lengths[s] = s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8;
+            canonicalCode(lengths, 288, fixedLiterals);
+            std::fill(lengths, lengths + 30, 5);
+            canonicalCode(lengths, 30, fixedDistances);
+
+            for (int symbol = 0; symbol < 30; symbol++) {
+                int first = kDistanceBase[symbol] - 1;
+                for (int d = first; d < first + (1 << kDistanceExtra[symbol]); d++) {
+                    distanceSymbol[d < 256 ? d : 256 + (d >> 7)] = static_cast<uint8_t>(symbol);
+                }
+            }
+            for (int length = 3; length <= 258; length++) {
+                int symbol = 28;
+                while (kLengthBase[symbol] > length) symbol--;
+                lengthSymbol[length] = static_cast<uint8_t>(symbol);
+            }
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                crc[n] = c;
+            }
+        }
+
+        int distanceSymbolOf(size_t distance) const {
+            size_t d = distance - 1;
+            return distanceSymbol[d < 256 ? d : 256 + (d >> 7)];
+        }
+    };
+
+    const Tables& tables() {
+        static const Tables instance;
+        return instance;
+    }
+
+    class BitWriter {
+    public:
+        explicit BitWriter(std::vector<unsigned char>& out) : out(out) {}
+
+        void put(uint32_t value, int count) {
+            bits |= static_cast<uint64_t>(value) << pending;
+            pending += count;
+            while (pending >= 8) {
+                out.push_back(static_cast<unsigned char>(bits));
+                bits >>= 8;
+                pending -= 8;
+            }
+        }
+
+        void align() {
+            if (pending > 0) out.push_back(static_cast<unsigned char>(bits));
+            bits = 0;
+            pending = 0;
+        }
+
+        // Whole bytes; only after align()
+        void putBytes(const unsigned char* data, size_t size) {
+            out.insert(out.end(), data, data + size);
+        }
+
+    private:
+        std::vector<unsigned char>& out;
+        uint64_t bits = 0;
+        int pending = 0;
+    };
+
+    uint32_t hash3(const unsigned char* p) {
+        uint32_t value = p[0] | (p[1] << 8) | (p[2] << 16);
+        return (value * 2654435761u) >> (32 - kHashBits);
+    }
+
+    // A literal byte when distance is 0, otherwise a match
+    struct Token {
+        uint16_t value;
+        uint16_t distance;
+    };
+
+    // Code lengths of a Huffman code for `frequencies`, none longer than `limit`. Rare symbols are
+    // made more frequent until the tree is shallow enough, which costs little in practice.
+    void buildLengths(const uint32_t* frequencies, int count, int limit, uint8_t* lengths) {
+        std::vector<uint32_t> weights(frequencies, frequencies + count);
+        // Decoders reject a code of a single symbol, so there are always two
+        int used = static_cast<int>(std::count_if(weights.begin(), weights.end(), [](uint32_t w) { return w > 0; }));
+        for (int s = 0; s < count && used < 2; s++) {
+            if (weights[s] == 0) {
+                weights[s] = 1;
+                used++;
+            }
+        }
+
+        std::vector<int> parent(2 * count);
+        while (true) {
+            using Node = std::pair<uint64_t, int>;
+            std::priority_queue<Node, std::vector<Node>, std::greater<Node>> heap;
+            for (int s = 0; s < count; s++) {
+                if (weights[s] > 0) heap.push({weights[s], s});
+            }
+            std::fill(parent.begin(), parent.end(), -1);
+            int next = count;
+            while (heap.size() > 1) {
+                Node a = heap.top();
+                heap.pop();
+                Node b = heap.top();
+                heap.pop();
+                parent[a.second] = parent[b.second] = next;
+                heap.push({a.first + b.first, next++});
+            }
+
+            int deepest = 0;
+            for (int s = 0; s < count; s++) {
+                int depth = 0;
+                if (weights[s] > 0) {
+                    for (int node = s; parent[node] >= 0; node = parent[node]) depth++;
+                }
+                lengths[s] = static_cast<uint8_t>(depth);
+                deepest = std::max(deepest, depth);
+            }
+            if (deepest <= limit) return;
+            for (auto& weight : weights) {
+                if (weight > 0) weight = (weight >> 1) | 1;
+            }
+        }
+    }
+
+    void putTokens(BitWriter& out, const std::vector<Token>& tokens, const Code& literals, const Code& distances) {
+        const Tables& t = tables();
+        for (const Token& token : tokens) {
+            if (token.distance == 0) {
+                out.put(literals.code[token.value], literals.bits[token.value]);
+                continue;
+            }
+            int symbol = t.lengthSymbol[token.value];
+            out.put(literals.code[257 + symbol], literals.bits[257 + symbol]);
+            out.put(token.value - kLengthBase[symbol], kLengthExtra[symbol]);
+            int distanceSymbol = t.distanceSymbolOf(token.distance);
+            out.put(distances.code[distanceSymbol], distances.bits[distanceSymbol]);
+            out.put(token.distance - kDistanceBase[distanceSymbol], kDistanceExtra[distanceSymbol]);
+        }
+        out.put(literals.code[256], literals.bits[256]);
+    }
+
+    // Stored (uncompressed) blocks, as level 0 writes them
+    void storeBlocks(BitWriter& out, const unsigned char* data, size_t size) {
+        for (size_t offset = 0; offset < size; offset += 65535) {
+            size_t length = std::min<size_t>(65535, size - offset);
+            out.put(0, 3);
+            out.align();
+            const unsigned char header[4] = {static_cast<unsigned char>(length), static_cast<unsigned char>(length >> 8),
+                                             static_cast<unsigned char>(~length), static_cast<unsigned char>(~length >> 8)};
+            out.putBytes(header, 4);
+            out.putBytes(data + offset, length);
+        }
+    }
+
+    // One non-final block for `tokens`, which encode `raw`: with codes fitted to them, the fixed
+    // codes or stored, whichever is smallest
+    void writeBlock(BitWriter& out, const std::vector<Token>& tokens, const unsigned char* raw, size_t rawSize) {
+        const Tables& t = tables();
+        uint32_t literalCounts[286] = {};
+        uint32_t distanceCounts[30] = {};
+        uint64_t extraBits = 0;
+        for (const Token& token : tokens) {
+            if (token.distance == 0) {
+                literalCounts[token.value]++;
+                continue;
+            }
+            int symbol = t.lengthSymbol[token.value];
+            int distanceSymbol = t.distanceSymbolOf(token.distance);
+            literalCounts[257 + symbol]++;
+            distanceCounts[distanceSymbol]++;
+            extraBits += kLengthExtra[symbol] + kDistanceExtra[distanceSymbol];
+        }
+        literalCounts[256] = 1;
+
+        uint8_t literalLengths[286];
+        uint8_t distanceLengths[30];
+        buildLengths(literalCounts, 286, 15, literalLengths);
+        buildLengths(distanceCounts, 30, 15, distanceLengths);
+        int literalCount = 286;
+        while (literalCount > 257 && literalLengths[literalCount - 1] == 0) literalCount--;
+        int distanceCount = 30;
+        while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0) distanceCount--;
+        uint8_t lengths[286 + 30];
+        std::copy(literalLengths, literalLengths + literalCount, lengths);
+        std::copy(distanceLengths, distanceLengths + distanceCount, lengths + literalCount);
+        int total = literalCount + distanceCount;
+
+        // The code lengths themselves, run-length coded: 16 repeats the previous length 3-6 times,
+        // 17 and 18 stand for 3-10 and 11-138 zeros
+        struct Run { uint8_t symbol; uint8_t extra; };
+        std::vector<Run> runs;
+        for (int i = 0; i < total;) {
+            uint8_t length = lengths[i];
+            int run = 1;
+            while (i + run < total && lengths[i + run] == length) run++;
+            i += run;
+            if (length == 0) {
+                while (run >= 11) { int n = std::min(run, 138); runs.push_back({18, static_cast<uint8_t>(n - 11)}); run -= n; }
+                if (run >= 3) { runs.push_back({17, static_cast<uint8_t>(run - 3)}); run = 0; }
+            } else {
+                runs.push_back({length, 0});
+                run--;
+                while (run >= 3) { int n = std::min(run, 6); runs.push_back({16, static_cast<uint8_t>(n - 3)}); run -= n; }
+            }
+            while (run-- > 0) runs.push_back({length, 0});
+        }
+        static const int kRunExtra[19] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7};
+        static const int kRunOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+        uint32_t runCounts[19] = {};
+        for (const Run& run : runs) runCounts[run.symbol]++;
+        uint8_t runLengths[19];
+        buildLengths(runCounts, 19, 7, runLengths);
+        int runCodeCount = 19;
+        while (runCodeCount > 4 && runLengths[kRunOrder[runCodeCount - 1]] == 0) runCodeCount--;
+
+        uint64_t dynamicBits = 3 + 14 + 3 * runCodeCount + extraBits;
+        for (const Run& run : runs) dynamicBits += runLengths[run.symbol] + kRunExtra[run.symbol];
+        uint64_t fixedBits = 3 + extraBits;
+        for (int s = 0; s < 286; s++) {
+            dynamicBits += static_cast<uint64_t>(literalCounts[s]) * literalLengths[s];
+            fixedBits += static_cast<uint64_t>(literalCounts[s]) * t.fixedLiterals.bits[s];
+        }
+        for (int s = 0; s < 30; s++) {
+            dynamicBits += static_cast<uint64_t>(distanceCounts[s]) * distanceLengths[s];
+            fixedBits += static_cast<uint64_t>(distanceCounts[s]) * 5;
+        }
+        uint64_t storedBits = (rawSize + 5 * ((rawSize + 65534) / 65535)) * 8 + 7;
+
+        if (storedBits <= dynamicBits && storedBits <= fixedBits) {
+            storeBlocks(out, raw, rawSize);
+        } else if (fixedBits <= dynamicBits) {
+            out.put(0, 1);
+            out.put(1, 2);
+            putTokens(out, tokens, t.fixedLiterals, t.fixedDistances);
+        } else {
+            out.put(0, 1);
+            out.put(2, 2);
+            out.put(literalCount - 257, 5);
+            out.put(distanceCount - 1, 5);
+            out.put(runCodeCount - 4, 4);
+            for (int i = 0; i < runCodeCount; i++) out.put(runLengths[kRunOrder[i]], 3);
+            Code runCode;
+            canonicalCode(runLengths, 19, runCode);
+            for (const Run& run : runs) {
+                out.put(runCode.code[run.symbol], runCode.bits[run.symbol]);
+                out.put(run.extra, kRunExtra[run.symbol]);
+            }
+            Code literals, distances;
+            canonicalCode(literalLengths, 286, literals);
+            canonicalCode(distanceLengths, 30, distances);
+            putTokens(out, tokens, literals, distances);
+        }
+    }
+
+    // Greedy LZ77 with hash chains, written as a block every kBlockTokens tokens
+    void compress(const unsigned char* data, size_t size, const Level& level, BitWriter& out) {
+        std::vector<int32_t> head(size_t(1) << kHashBits, -1);
+        std::vector<int32_t> previous(kWindow, -1);
+        auto insert = [&](size_t position) {
+            uint32_t h = hash3(data + position);
+            previous[position & (kWindow - 1)] = head[h];
+            head[h] = static_cast<int32_t>(position);
+        };
+
+        std::vector<Token> tokens;
+        tokens.reserve(kBlockTokens);
+        size_t blockStart = 0;
+        size_t i = 0;
+        while (i < size) {
+            size_t bestLength = 0;
+            size_t bestDistance = 0;
+            if (i + 3 <= size) {
+                size_t maxLength = std::min<size_t>(258, size - i);
+                int32_t candidate = head[hash3(data + i)];
+                for (int chain = level.chain; candidate >= 0 && chain > 0; chain--) {
+                    size_t distance = i - static_cast<size_t>(candidate);
+                    if (distance > kWindow) break;
+                    const unsigned char* a = data + candidate;
+                    const unsigned char* b = data + i;
+                    if (a[bestLength] == b[bestLength]) {
+                        size_t length = 0;
+                        while (length < maxLength && a[length] == b[length]) length++;
+                        if (length > bestLength) {
+                            bestLength = length;
+                            bestDistance = distance;
+                            if (length >= level.nice || length == maxLength) break;
+                        }
+                    }
+                    int32_t next = previous[candidate & (kWindow - 1)];
+                    if (next >= candidate) break;
+                    candidate = next;
+                }
+                insert(i);
+            }
+
+            if (bestLength >= 3) {
+                tokens.push_back({static_cast<uint16_t>(bestLength), static_cast<uint16_t>(bestDistance)});
+                if (level.insertAll) {
+                    for (size_t k = i + 1; k < i + bestLength && k + 3 <= size; k++) insert(k);
+                }
+                i += bestLength;
+            } else {
+                tokens.push_back({data[i], 0});
+                i++;
+            }
+
+            if (tokens.size() == kBlockTokens || i == size) {
+                writeBlock(out, tokens, data + blockStart, i - blockStart);
+                tokens.clear();
+                blockStart = i;
+            }
+        }
+    }
+
+    // Deflate data for one band, ending on a byte boundary so the next band can follow it directly
+    void deflateBand(const unsigned char* data, size_t size, int level, std::vector<unsigned char>& out) {
+        BitWriter bits(out);
+        if (level == 0) {
+            storeBlocks(bits, data, size);
+            return;
+        }
+        compress(data, size, kLevels[level], bits);
+        // Sync flush: an empty stored block
+        bits.put(0, 3);
+        bits.align();
+        const unsigned char flush[4] = {0x00, 0x00, 0xFF, 0xFF};
+        bits.putBytes(flush, 4);
+    }
+
+    uint32_t adler32(const unsigned char* data, size_t size) {
+        uint32_t a = 1, b = 0;
+        while (size > 0) {
+            // The largest run that cannot overflow 32 bits before the modulo
+            size_t run = std::min<size_t>(size, 5552);
+            for (size_t i = 0; i < run; i++) {
+                a += data[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+            data += run;
+            size -= run;
+        }
+        return (b << 16) | a;
+    }
+
+    // Checksum of two blocks from the checksums of each, as zlib's adler32_combine
+    uint32_t combineAdler32(uint32_t first, uint32_t second, size_t secondLength) {
+        const uint32_t base = 65521;
+        uint32_t remainder = static_cast<uint32_t>(secondLength % base);
+        uint32_t sum1 = first & 0xFFFF;
+        uint32_t sum2 = static_cast<uint32_t>((static_cast<uint64_t>(remainder) * sum1) % base);
+        sum1 += (second & 0xFFFF) + base - 1;
+        sum2 += (first >> 16) + (second >> 16) + base - remainder;
+        if (sum1 >= base) sum1 -= base;
+        if (sum1 >= base) sum1 -= base;
+        if (sum2 >= (base << 1)) sum2 -= (base << 1);
+        if (sum2 >= base) sum2 -= base;
+        return sum1 | (sum2 << 16);
+    }
+
+    uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0xFFFFFFFFu) {
+        const Tables& t = tables();
+        for (size_t i = 0; i < size; i++) {
+            crc = t.crc[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+    void putBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+        out.push_back(static_cast<unsigned char>(value >> 24));
+        out.push_back(static_cast<unsigned char>(value >> 16));
+        out.push_back(static_cast<unsigned char>(value >> 8));
+        out.push_back(static_cast<unsigned char>(value));
+    }
+
+    // Wraps data starting at `offset` of `chunk` into a PNG chunk in place: `chunk` must hold 8
+    // reserved bytes before it for the length and type
+    void sealChunk(std::vector<unsigned char>& chunk, const char* type) {
+        uint32_t length = static_cast<uint32_t>(chunk.size() - 8);
+        for (int i = 0; i < 4; i++) {
+            chunk[i] = static_cast<unsigned char>(length >> (24 - 8 * i));
+            chunk[4 + i] = static_cast<unsigned char>(type[i]);
+        }
+        uint32_t crc = crc32(chunk.data() + 4, chunk.size() - 4) ^ 0xFFFFFFFFu;
+        putBigEndian(chunk, crc);
+    }
+
+    // Filter type byte and filtered bytes of one row; `previous` is the unfiltered row above. The
+    // first pixel has no left neighbour, so the loops over the rest need no branches.
+    void filterRow(int type, const unsigned char* row, const unsigned char* previous, size_t rowBytes, int bpp, unsigned char* out) {
+        out[0] = static_cast<unsigned char>(type);
+        unsigned char* filtered = out + 1;
+        size_t first = std::min(static_cast<size_t>(bpp), rowBytes);
+        switch (type) {
+        case 0:
+            std::copy(row, row + rowBytes, filtered);
+            break;
+        case 1:
+            std::copy(row, row + first, filtered);
+            for (size_t i = first; i < rowBytes; i++) filtered[i] = row[i] - row[i - bpp];
+            break;
+        case 2:
+            for (size_t i = 0; i < rowBytes; i++) filtered[i] = row[i] - previous[i];
+            break;
+        case 3:
+            for (size_t i = 0; i < first; i++) filtered[i] = row[i] - (previous[i] >> 1);
+            for (size_t i = first; i < rowBytes; i++) filtered[i] = row[i] - ((row[i - bpp] + previous[i]) >> 1);
+            break;
+        default:
+            for (size_t i = 0; i < first; i++) filtered[i] = row[i] - previous[i];
+            for (size_t i = first; i < rowBytes; i++) {
+                int a = row[i - bpp], b = previous[i], c = previous[i - bpp];
+                int pa = std::abs(b - c);
+                int pb = std::abs(a - c);
+                int pc = std::abs(a + b - 2 * c);
+                int predicted = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                filtered[i] = static_cast<unsigned char>(row[i] - predicted);
+            }
+            break;
+        }
+    }
+
+    // The usual heuristic: the smallest sum of the filtered bytes taken as signed
+    uint64_t filterCost(const unsigned char* filtered, size_t rowBytes) {
+        uint64_t cost = 0;
+        for (size_t i = 1; i <= rowBytes; i++) cost += std::abs(static_cast<int>(static_cast<signed char>(filtered[i])));
+        return cost;
+    }
+
+    struct Band {
+        // A complete IDAT chunk
+        std::vector<unsigned char> chunk;
+        uint32_t adler = 1;
+        size_t filteredBytes = 0;
+    };
+
+    void encodeBand(const Image& image, int rowBegin, int rowEnd, const Png::Options& options, bool first, Band& band) {
+        Trace::Zone zone("Png::encodeBand");
+        size_t rowBytes = image.getStride();
+        int bpp = image.getChannels();
+        size_t stride = rowBytes + 1;
+        const unsigned char* pixels = image.getData();
+
+        std::vector<unsigned char> filtered(stride * (rowEnd - rowBegin));
+        MemoryAccounting::Scoped counted(MemoryAccounting::Category::Temporaries, filtered.size());
+        std::vector<unsigned char> zeros(rowBegin == 0 ? rowBytes : 0, 0);
+        std::vector<unsigned char> candidate(options.filter == Png::Filter::Adaptive ? stride : 0);
+
+        for (int y = rowBegin; y < rowEnd; y++) {
+            const unsigned char* row = pixels + y * rowBytes;
+            const unsigned char* previous = y > 0 ? row - rowBytes : zeros.data();
+            unsigned char* out = filtered.data() + (y - rowBegin) * stride;
+            if (options.filter != Png::Filter::Adaptive) {
+                filterRow(static_cast<int>(options.filter) - 1, row, previous, rowBytes, bpp, out);
+                continue;
+            }
+            filterRow(0, row, previous, rowBytes, bpp, out);
+            uint64_t best = filterCost(out, rowBytes);
+            for (int type = 1; type <= 4; type++) {
+                filterRow(type, row, previous, rowBytes, bpp, candidate.data());
+                uint64_t cost = filterCost(candidate.data(), rowBytes);
+                if (cost < best) {
+                    best = cost;
+                    std::copy(candidate.begin(), candidate.end(), out);
+                }
+            }
+        }
+
+        band.chunk.assign(8, 0);
+        band.chunk.reserve(8 + filtered.size() / (options.level == 0 ? 1 : 2) + 64);
+        if (first) {
+            // zlib header: deflate with a 32 KB window, no preset dictionary
+            band.chunk.push_back(0x78);
+            band.chunk.push_back(0x01);
+        }
+        deflateBand(filtered.data(), filtered.size(), options.level, band.chunk);
+        sealChunk(band.chunk, "IDAT");
+        band.adler = adler32(filtered.data(), filtered.size());
+        band.filteredBytes = filtered.size();
+    }
+}
+
+bool Png::write(FILE* out, const Image& image, const Options& options) {
+    Trace::Zone zone("Png::write");
+    int width = image.getWidth();
+    int height = image.getHeight();
+    int channels = image.getChannels();
+    if (!image.getData() || width <= 0 || height <= 0 || channels < 1 || channels > 4) return false;
+
+    Options settings = options;
+    settings.level = std::clamp(settings.level, 0, 9);
+    // Filters only help compression; stored pixels are as large either way
+    if (settings.level == 0) settings.filter = Filter::None;
+    int threads = settings.threads > 0 ? settings.threads : hardwareThreads();
+
+    size_t stride = static_cast<size_t>(width) * channels + 1;
+    size_t bandRows = (height + threads - 1) / threads;
+    bandRows = std::max(bandRows, (kMinBandBytes + stride - 1) / stride);
+    bandRows = std::min(bandRows, std::max<size_t>(1, kMaxBandBytes / stride));
+    int bandCount = static_cast<int>((height + bandRows - 1) / bandRows);
+
+    std::vector<Band> bands(bandCount);
+    parallelFor(0, bandCount, [&](int first, int last) {
+        for (int b = first; b < last; b++) {
+            int rowBegin = static_cast<int>(b * bandRows);
+            int rowEnd = static_cast<int>(std::min<size_t>(height, rowBegin + bandRows));
+            encodeBand(image, rowBegin, rowEnd, settings, b == 0, bands[b]);
+        }
+    }, 1, threads);
+
+    uint32_t adler = bands[0].adler;
+    for (int b = 1; b < bandCount; b++) {
+        adler = combineAdler32(adler, bands[b].adler, bands[b].filteredBytes);
+    }
+
+    static const unsigned char kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    static const unsigned char kColorType[5] = {0, 0, 4, 2, 6};
+    std::vector<unsigned char> header(8);
+    putBigEndian(header, static_cast<uint32_t>(width));
+    putBigEndian(header, static_cast<uint32_t>(height));
+    header.push_back(8);
+    header.push_back(kColorType[channels]);
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+    sealChunk(header, "IHDR");
+
+    // The final block, empty, and the checksum of everything the bands deflated
+    std::vector<unsigned char> last(8);
+    last.push_back(0x03);
+    last.push_back(0x00);
+    putBigEndian(last, adler);
+    sealChunk(last, "IDAT");
+
+    std::vector<unsigned char> end(8);
+    sealChunk(end, "IEND");
+
+    bool ok = std::fwrite(kSignature, 1, sizeof(kSignature), out) == sizeof(kSignature) &&
+              std::fwrite(header.data(), 1, header.size(), out) == header.size();
+    for (const Band& band : bands) {
+        ok = ok && std::fwrite(band.chunk.data(), 1, band.chunk.size(), out) == band.chunk.size();
+    }
+    ok = ok && std::fwrite(last.data(), 1, last.size(), out) == last.size() &&
+         std::fwrite(end.data(), 1, end.size(), out) == end.size();
+    return ok;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "Image.h"
+#include <cstdio>
+
+// PNG encoder that splits the image into bands of rows and filters and deflates them on separate
+// threads. Each band ends its deflate data on a byte boundary (a sync flush, as pigz does) and goes
+// into its own IDAT chunk, so the bands are encoded independently and written in order. Bands do
+// not share a dictionary, which costs a little compression compared with one stream.
+class Png {
+public:
+    enum class Filter { Adaptive, None, Sub, Up, Average, Paeth };
+
+    struct Options {
+        // 0 stores the pixels uncompressed, 1 is fastest and 9 smallest
+        int level = 6;
+        // Adaptive picks, per row, the filter that leaves the smallest differences
+        Filter filter = Filter::Adaptive;
+        // Bands encoded at once; 0 uses every hardware thread
+        int threads = 0;
+    };
+
+    static bool write(FILE* out, const Image& image, const Options& options);
+};
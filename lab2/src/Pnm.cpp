@@ -0,0 +1,152 @@
+#include "Pnm.h"
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    const int kMaxHeaderValue = 1 << 20;
+
+    // Skips whitespace and '#' comments; returns the first other character.
+    int skipSpace(FILE* in) {
+        int c;
+        while ((c = getc(in)) != EOF) {
+            if (c == '#') {
+                while ((c = getc(in)) != EOF && c != '\n') {}
+            } else if (!std::isspace(c)) {
+                return c;
+            }
+        }
+        return EOF;
+    }
+
+    // Reads a decimal header field and the single whitespace character that ends it.
+    int readNumber(FILE* in) {
+        int c = skipSpace(in);
+        if (c == EOF || !std::isdigit(c)) throw std::runtime_error("malformed PNM header");
+
+        int value = 0;
+        while (c != EOF && std::isdigit(c)) {
+            value = value * 10 + (c - '0');
+            if (value > kMaxHeaderValue) throw std::runtime_error("PNM header value out of range");
+            c = getc(in);
+        }
+        if (c != EOF && !std::isspace(c)) throw std::runtime_error("malformed PNM header");
+        return value;
+    }
+
+    // Reads a whitespace-delimited PAM header token into a fixed buffer.
+    void readToken(FILE* in, char* token, size_t size) {
+        int c = skipSpace(in);
+        size_t length = 0;
+        while (c != EOF && !std::isspace(c)) {
+            if (length + 1 < size) token[length++] = static_cast<char>(c);
+            c = getc(in);
+        }
+        token[length] = '\0';
+        if (length == 0) throw std::runtime_error("truncated PAM header");
+    }
+
+    const char* defaultTupleType(int channels) {
+        switch (channels) {
+        case 1: return "GRAYSCALE";
+        case 2: return "GRAYSCALE_ALPHA";
+        case 3: return "RGB";
+        default: return "RGB_ALPHA";
+        }
+    }
+}
+
+bool Pnm::readHeader(FILE* in, Header& header) {
+    int c = skipSpace(in);
+    if (c == EOF) return false;
+
+    int kind = getc(in);
+    if (c != 'P' || (kind != '5' && kind != '6' && kind != '7')) {
+        throw std::runtime_error("not a binary PGM/PPM/PAM frame");
+    }
+
+    int width = 0, height = 0, channels = 0, maxValue = 0;
+    Format& format = header.format;
+    if (kind == '7') {
+        format.kind = Kind::PAM;
+        format.tupleType.clear();
+        char token[64];
+        while (true) {
+            readToken(in, token, sizeof(token));
+            if (std::strcmp(token, "ENDHDR") == 0) break;
+
+            if (std::strcmp(token, "WIDTH") == 0) width = readNumber(in);
+            else if (std::strcmp(token, "HEIGHT") == 0) height = readNumber(in);
+            else if (std::strcmp(token, "DEPTH") == 0) channels = readNumber(in);
+            else if (std::strcmp(token, "MAXVAL") == 0) maxValue = readNumber(in);
+            else if (std::strcmp(token, "TUPLTYPE") == 0) {
+                readToken(in, token, sizeof(token));
+                format.tupleType = token;
+            } else {
+                throw std::runtime_error(std::string("unknown PAM header field ") + token);
+            }
+        }
+    } else {
+        format.kind = kind == '5' ? Kind::PGM : Kind::PPM;
+        format.tupleType.clear();
+        channels = kind == '5' ? 1 : 3;
+        width = readNumber(in);
+        height = readNumber(in);
+        maxValue = readNumber(in);
+    }
+
+    if (width <= 0 || height <= 0 || channels < 1 || channels > 4) {
+        throw std::runtime_error("unsupported PNM frame size");
+    }
+    if (maxValue != 255) {
+        throw std::runtime_error("only 8-bit PNM frames (maxval 255) are supported");
+    }
+
+    header.width = width;
+    header.height = height;
+    header.channels = channels;
+    return true;
+}
+
+bool Pnm::writeHeader(FILE* out, const Header& header) {
+    Kind kind = header.format.kind;
+    if ((kind == Kind::PGM && header.channels != 1) || (kind == Kind::PPM && header.channels != 3)) {
+        kind = Kind::PAM;
+    }
+
+    int written;
+    if (kind == Kind::PAM) {
+        const char* tupleType = header.format.kind == Kind::PAM && !header.format.tupleType.empty()
+            ? header.format.tupleType.c_str() : defaultTupleType(header.channels);
+        written = std::fprintf(out, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL 255\nTUPLTYPE %s\nENDHDR\n",
+                               header.width, header.height, header.channels, tupleType);
+    } else {
+        written = std::fprintf(out, "P%c\n%d %d\n255\n", kind == Kind::PGM ? '5' : '6', header.width, header.height);
+    }
+    return written >= 0;
+}
+
+bool Pnm::read(FILE* in, Image& frame, Format& format) {
+    Header header;
+    if (!readHeader(in, header)) return false;
+    format = header.format;
+
+    frame.resize(header.width, header.height, header.channels);
+    size_t size = frame.getByteSize();
+    if (std::fread(frame.getData(), 1, size, in) != size) {
+        throw std::runtime_error("truncated PNM frame");
+    }
+    return true;
+}
+
+bool Pnm::write(FILE* out, const Image& frame, const Format& format) {
+    Header header;
+    header.width = frame.getWidth();
+    header.height = frame.getHeight();
+    header.channels = frame.getChannels();
+    header.format = format;
+    if (!writeHeader(out, header)) return false;
+
+    size_t size = frame.getByteSize();
+    return std::fwrite(frame.getData(), 1, size, out) == size;
+}
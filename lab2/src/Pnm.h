@@ -0,0 +1,39 @@
+#pragma once
+#include "Image.h"
+#include <cstdio>
+#include <string>
+
+// Binary Netpbm frames (PGM "P5", PPM "P6" and PAM "P7", 8 bits per sample) on C streams.
+// Streams of frames are simply frames back to back, as ffmpeg writes them with
+// `-f image2pipe -c:v ppm`.
+class Pnm {
+public:
+    enum class Kind { PGM, PPM, PAM };
+
+    struct Format {
+        Kind kind = Kind::PPM;
+        // PAM only, e.g. "RGB_ALPHA"
+        std::string tupleType;
+    };
+
+    struct Header {
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        Format format;
+    };
+
+    // Reads the next frame into `frame`, reusing its buffer when the size is unchanged. Returns false
+    // at the end of the stream; throws std::runtime_error for a malformed or unsupported frame.
+    static bool read(FILE* in, Image& frame, Format& format);
+
+    // Writes `frame` in `format`, switching to PAM when the channel count does not fit PGM/PPM.
+    static bool write(FILE* out, const Image& frame, const Format& format);
+
+    // Header alone, leaving the stream at the first pixel byte, for readers that take the pixels a
+    // strip at a time.
+    static bool readHeader(FILE* in, Header& header);
+    // Header for `header.format` or PAM when the channel count does not fit it; the caller writes
+    // width * height * channels pixel bytes after it.
+    static bool writeHeader(FILE* out, const Header& header);
+};
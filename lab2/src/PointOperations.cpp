@@ -1,91 +1,41 @@
 #include "PointOperations.h"
+#include "Cancellation.h"
+#include "Kernels.h"
+#include "Trace.h"
 #include <algorithm>
 #include <cmath>
-#include <vector>
 
 Image PointOperations::linearContrast(const Image& img, float minPercentile, float maxPercentile) {
-    std::vector<unsigned char> intensities;
-    intensities.reserve(img.getWidth() * img.getHeight());
-    
+    Trace::Zone zone("PointOperations::linearContrast");
+    Histogram::Counts hist = {0};
+
     for (int y = 0; y < img.getHeight(); y++) {
+        Cancellation::checkpoint(y, img.getHeight());
         for (int x = 0; x < img.getWidth(); x++) {
             if (img.getChannels() >= 3) {
                 glm::vec3 rgb = img.getPixelRGB(x, y);
                 unsigned char intensity = static_cast<unsigned char>(
                     (0.299f * rgb.r + 0.587f * rgb.g + 0.114f * rgb.b) * 255
                 );
-                intensities.push_back(intensity);
+                hist[intensity]++;
             } else {
-                intensities.push_back(img.getPixel(x, y, 0));
+                hist[img.getPixel(x, y, 0)]++;
             }
         }
     }
 
-    std::sort(intensities.begin(), intensities.end());
-    
-    int minIdx = static_cast<int>(intensities.size() * minPercentile / 100.0f);
-    int maxIdx = static_cast<int>(intensities.size() * maxPercentile / 100.0f);
-    
-    unsigned char minVal = intensities[minIdx];
-    unsigned char maxVal = intensities[maxIdx];
-    
-    return linearContrastManual(img, minVal, maxVal);
+    return applyLUT(img, percentileContrastLUT(hist, minPercentile, maxPercentile));
 }
 
 Image PointOperations::linearContrastManual(const Image& img, unsigned char minIn, unsigned char maxIn,
                                            unsigned char minOut, unsigned char maxOut) {
-    Image result = img.clone();
-    
-    if (minIn >= maxIn) {
-        return result;
-    }
-    
-    float scale = static_cast<float>(maxOut - minOut) / (maxIn - minIn);
-    
-    for (int y = 0; y < img.getHeight(); y++) {
-        for (int x = 0; x < img.getWidth(); x++) {
-            for (int c = 0; c < img.getChannels(); c++) {
-                unsigned char val = img.getPixel(x, y, c);
-                
-                int newVal;
-                if (val <= minIn) {
-                    newVal = minOut;
-                } else if (val >= maxIn) {
-                    newVal = maxOut;
-                } else {
-                    newVal = static_cast<int>(minOut + (val - minIn) * scale);
-                }
-                
-                result.setPixel(x, y, c, glm::clamp(newVal, 0, 255));
-            }
-        }
-    }
-    
-    result.updateTexture();
-    return result;
+    Trace::Zone zone("PointOperations::linearContrastManual");
+    return applyLUT(img, linearContrastLUT(minIn, maxIn, minOut, maxOut));
 }
 
 Image PointOperations::adjustBrightnessContrast(const Image& img, float brightness, float contrast) {
-    Image result = img.clone();
-
-    float factor = (259.0f * (contrast + 255.0f)) / (255.0f * (259.0f - contrast));
-    
-    for (int y = 0; y < img.getHeight(); y++) {
-        for (int x = 0; x < img.getWidth(); x++) {
-            for (int c = 0; c < img.getChannels(); c++) {
-                unsigned char val = img.getPixel(x, y, c);
-
-                float newVal = factor * (val - 128.0f) + 128.0f;
-
-                newVal += brightness;
-                
-                result.setPixel(x, y, c, glm::clamp(static_cast<int>(newVal), 0, 255));
-            }
-        }
-    }
-    
-    result.updateTexture();
-    return result;
+    Trace::Zone zone("PointOperations::adjustBrightnessContrast");
+    return applyLUT(img, brightnessContrastLUT(brightness, contrast));
 }
 
 unsigned char PointOperations::applyGamma(unsigned char value, float gamma) {
@@ -95,196 +45,258 @@ unsigned char PointOperations::applyGamma(unsigned char value, float gamma) {
 }
 
 Image PointOperations::gammaCorrection(const Image& img, float gamma) {
-    Image result = img.clone();
+    Trace::Zone zone("PointOperations::gammaCorrection");
+    return applyLUT(img, gammaLUT(gamma));
+}
+
+unsigned char PointOperations::applyLog(unsigned char value, float c) {
+    float result = c * std::log(1.0f + value);
+    return static_cast<unsigned char>(glm::clamp(result, 0.0f, 255.0f));
+}
+
+Image PointOperations::logarithmicTransform(const Image& img, float c) {
+    Trace::Zone zone("PointOperations::logarithmicTransform");
+    return applyLUT(img, logarithmicLUT(c));
+}
+
+Image PointOperations::powerTransform(const Image& img, float power, float c) {
+    Trace::Zone zone("PointOperations::powerTransform");
+    return applyLUT(img, powerLUT(power, c));
+}
+
+Image PointOperations::invert(const Image& img) {
+    Trace::Zone zone("PointOperations::invert");
+    return applyLUT(img, invertLUT());
+}
+
+Image PointOperations::clipBrightness(const Image& img, unsigned char minVal, unsigned char maxVal) {
+    Trace::Zone zone("PointOperations::clipBrightness");
+    return applyLUT(img, clipLUT(minVal, maxVal));
+}
+
+Image PointOperations::quantize(const Image& img, int levels) {
+    Trace::Zone zone("PointOperations::quantize");
+    return applyLUT(img, quantizeLUT(levels));
+}
 
-    unsigned char lut[256];
+PointOperations::LUT PointOperations::identityLUT() {
+    LUT lut;
     for (int i = 0; i < 256; i++) {
-        lut[i] = applyGamma(i, gamma);
+        lut[i] = static_cast<unsigned char>(i);
     }
-    
-    for (int y = 0; y < img.getHeight(); y++) {
-        for (int x = 0; x < img.getWidth(); x++) {
-            for (int c = 0; c < img.getChannels(); c++) {
-                unsigned char val = img.getPixel(x, y, c);
-                result.setPixel(x, y, c, lut[val]);
-            }
+    return lut;
+}
+
+PointOperations::LUT PointOperations::linearContrastLUT(unsigned char minIn, unsigned char maxIn,
+                                                        unsigned char minOut, unsigned char maxOut) {
+    if (minIn >= maxIn) {
+        return identityLUT();
+    }
+
+    float scale = static_cast<float>(maxOut - minOut) / (maxIn - minIn);
+
+    LUT lut;
+    for (int val = 0; val < 256; val++) {
+        int newVal;
+        if (val <= minIn) {
+            newVal = minOut;
+        } else if (val >= maxIn) {
+            newVal = maxOut;
+        } else {
+            newVal = static_cast<int>(minOut + (val - minIn) * scale);
         }
+        lut[val] = static_cast<unsigned char>(glm::clamp(newVal, 0, 255));
     }
-    
-    result.updateTexture();
-    return result;
+    return lut;
 }
 
-unsigned char PointOperations::applyLog(unsigned char value, float c) {
-    float result = c * std::log(1.0f + value);
-    return static_cast<unsigned char>(glm::clamp(result, 0.0f, 255.0f));
+PointOperations::LUT PointOperations::percentileContrastLUT(const Histogram::Counts& intensityHistogram,
+                                                            float minPercentile, float maxPercentile) {
+    uint64_t total = 0;
+    for (uint64_t count : intensityHistogram) {
+        total += count;
+    }
+    if (total == 0) return identityLUT();
+
+    // Value at a position of the sorted intensities, read off the cumulative histogram
+    auto valueAt = [&](float percentile) {
+        float position = std::clamp(total * percentile / 100.0f, 0.0f, static_cast<float>(total - 1));
+        uint64_t index = std::min(static_cast<uint64_t>(position), total - 1);
+        uint64_t seen = 0;
+        for (int v = 0; v < 256; v++) {
+            seen += intensityHistogram[v];
+            if (seen > index) return static_cast<unsigned char>(v);
+        }
+        return static_cast<unsigned char>(255);
+    };
+
+    return linearContrastLUT(valueAt(minPercentile), valueAt(maxPercentile));
 }
 
-Image PointOperations::logarithmicTransform(const Image& img, float c) {
-    Image result = img.clone();
+PointOperations::LUT PointOperations::brightnessContrastLUT(float brightness, float contrast) {
+    float factor = (259.0f * (contrast + 255.0f)) / (255.0f * (259.0f - contrast));
 
+    LUT lut;
+    for (int val = 0; val < 256; val++) {
+        float newVal = factor * (val - 128.0f) + 128.0f;
+        newVal += brightness;
+        lut[val] = static_cast<unsigned char>(glm::clamp(static_cast<int>(newVal), 0, 255));
+    }
+    return lut;
+}
+
+PointOperations::LUT PointOperations::gammaLUT(float gamma) {
+    LUT lut;
+    for (int i = 0; i < 256; i++) {
+        lut[i] = applyGamma(i, gamma);
+    }
+    return lut;
+}
+
+PointOperations::LUT PointOperations::logarithmicLUT(float c) {
     float maxLog = std::log(256.0f);
     float normalizedC = 255.0f / maxLog * c;
-    
-    unsigned char lut[256];
+
+    LUT lut;
     for (int i = 0; i < 256; i++) {
         lut[i] = applyLog(i, normalizedC);
     }
-    
-    for (int y = 0; y < img.getHeight(); y++) {
-        for (int x = 0; x < img.getWidth(); x++) {
-            for (int c = 0; c < img.getChannels(); c++) {
-                unsigned char val = img.getPixel(x, y, c);
-                result.setPixel(x, y, c, lut[val]);
-            }
-        }
-    }
-    
-    result.updateTexture();
-    return result;
+    return lut;
 }
 
-Image PointOperations::powerTransform(const Image& img, float power, float c) {
-    Image result = img.clone();
-    
-    unsigned char lut[256];
+PointOperations::LUT PointOperations::powerLUT(float power, float c) {
+    LUT lut;
     for (int i = 0; i < 256; i++) {
         float normalized = i / 255.0f;
         float transformed = c * std::pow(normalized, power);
         lut[i] = static_cast<unsigned char>(glm::clamp(transformed * 255.0f, 0.0f, 255.0f));
     }
-    
-    for (int y = 0; y < img.getHeight(); y++) {
-        for (int x = 0; x < img.getWidth(); x++) {
-            for (int c = 0; c < img.getChannels(); c++) {
-                unsigned char val = img.getPixel(x, y, c);
-                result.setPixel(x, y, c, lut[val]);
-            }
-        }
-    }
-    
-    result.updateTexture();
-    return result;
+    return lut;
 }
 
-Image PointOperations::invert(const Image& img) {
-    Image result = img.clone();
-    
-    for (int y = 0; y < img.getHeight(); y++) {
-        for (int x = 0; x < img.getWidth(); x++) {
-            for (int c = 0; c < img.getChannels(); c++) {
-                unsigned char val = img.getPixel(x, y, c);
-                result.setPixel(x, y, c, 255 - val);
-            }
-        }
+PointOperations::LUT PointOperations::invertLUT() {
+    LUT lut;
+    for (int i = 0; i < 256; i++) {
+        lut[i] = static_cast<unsigned char>(255 - i);
     }
-    
-    result.updateTexture();
-    return result;
+    return lut;
 }
 
-Image PointOperations::clipBrightness(const Image& img, unsigned char minVal, unsigned char maxVal) {
-    Image result = img.clone();
-    
-    for (int y = 0; y < img.getHeight(); y++) {
-        for (int x = 0; x < img.getWidth(); x++) {
-            for (int c = 0; c < img.getChannels(); c++) {
-                unsigned char val = img.getPixel(x, y, c);
-                result.setPixel(x, y, c, glm::clamp(val, minVal, maxVal));
-            }
-        }
+PointOperations::LUT PointOperations::clipLUT(unsigned char minVal, unsigned char maxVal) {
+    LUT lut;
+    for (int i = 0; i < 256; i++) {
+        lut[i] = glm::clamp(static_cast<unsigned char>(i), minVal, maxVal);
     }
-    
-    result.updateTexture();
-    return result;
+    return lut;
 }
 
-Image PointOperations::quantize(const Image& img, int levels) {
-    Image result = img.clone();
-    
+PointOperations::LUT PointOperations::quantizeLUT(int levels) {
     if (levels <= 1) levels = 2;
     if (levels > 256) levels = 256;
-    
+
     float step = 255.0f / (levels - 1);
-    
-    for (int y = 0; y < img.getHeight(); y++) {
-        for (int x = 0; x < img.getWidth(); x++) {
-            for (int c = 0; c < img.getChannels(); c++) {
-                unsigned char val = img.getPixel(x, y, c);
-                int level = static_cast<int>(std::round(val / step));
-                unsigned char newVal = static_cast<unsigned char>(level * step);
-                result.setPixel(x, y, c, newVal);
-            }
-        }
+
+    LUT lut;
+    for (int val = 0; val < 256; val++) {
+        int level = static_cast<int>(std::round(val / step));
+        lut[val] = static_cast<unsigned char>(level * step);
     }
-    
-    result.updateTexture();
-    return result;
+    return lut;
 }
 
-Image PointOperations::bitwiseAND(const Image& img1, const Image& img2) {
-    if (img1.getWidth() != img2.getWidth() || img1.getHeight() != img2.getHeight()) {
-        return img1.clone();
-    }
-    
-    Image result = img1.clone();
-    
-    for (int y = 0; y < img1.getHeight(); y++) {
-        for (int x = 0; x < img1.getWidth(); x++) {
-            for (int c = 0; c < std::min(img1.getChannels(), img2.getChannels()); c++) {
-                unsigned char val1 = img1.getPixel(x, y, c);
-                unsigned char val2 = img2.getPixel(x, y, c);
-                result.setPixel(x, y, c, val1 & val2);
-            }
-        }
+PointOperations::LUT PointOperations::composeLUT(const LUT& first, const LUT& second) {
+    LUT lut;
+    for (int i = 0; i < 256; i++) {
+        lut[i] = second[first[i]];
     }
-    
-    result.updateTexture();
+    return lut;
+}
+
+Image PointOperations::applyLUT(const Image& img, const LUT& lut) {
+    Trace::Zone zone("PointOperations::applyLUT");
+    Image result(img.getWidth(), img.getHeight(), img.getChannels());
+    if (!img.getData()) return result;
+
+    applyLUT(img, lut, result);
     return result;
 }
 
-Image PointOperations::bitwiseOR(const Image& img1, const Image& img2) {
-    if (img1.getWidth() != img2.getWidth() || img1.getHeight() != img2.getHeight()) {
-        return img1.clone();
+void PointOperations::applyLUT(const Image& img, const LUT& lut, Image& result) {
+    Trace::Zone zone("PointOperations::applyLUT");
+    if (&result != &img) {
+        result.resize(img.getWidth(), img.getHeight(), img.getChannels());
     }
-    
-    Image result = img1.clone();
-    
-    for (int y = 0; y < img1.getHeight(); y++) {
-        for (int x = 0; x < img1.getWidth(); x++) {
-            for (int c = 0; c < std::min(img1.getChannels(), img2.getChannels()); c++) {
-                unsigned char val1 = img1.getPixel(x, y, c);
-                unsigned char val2 = img2.getPixel(x, y, c);
-                result.setPixel(x, y, c, val1 | val2);
+    if (!img.getData()) return;
+
+    size_t rowSize = static_cast<size_t>(img.getWidth()) * img.getChannels();
+    Kernels::forRows(img.getHeight(), [&](int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; y++) {
+            Cancellation::checkpoint(y - rowBegin, rowEnd - rowBegin);
+            const unsigned char* src = img.getData() + y * rowSize;
+            unsigned char* dst = result.getData() + y * rowSize;
+            for (size_t i = 0; i < rowSize; i++) {
+                dst[i] = lut[src[i]];
             }
         }
-    }
-    
+    });
+
     result.updateTexture();
-    return result;
 }
 
-Image PointOperations::bitwiseXOR(const Image& img1, const Image& img2) {
-    if (img1.getWidth() != img2.getWidth() || img1.getHeight() != img2.getHeight()) {
-        return img1.clone();
-    }
-    
-    Image result = img1.clone();
-    
-    for (int y = 0; y < img1.getHeight(); y++) {
-        for (int x = 0; x < img1.getWidth(); x++) {
-            for (int c = 0; c < std::min(img1.getChannels(), img2.getChannels()); c++) {
-                unsigned char val1 = img1.getPixel(x, y, c);
-                unsigned char val2 = img2.getPixel(x, y, c);
-                result.setPixel(x, y, c, val1 ^ val2);
-            }
+namespace {
+    // Combines the channels both images have; any further channels of img1 are kept
+    Image bitwiseCombine(const Image& img1, const Image& img2, const Kernels::Kernel<Kernels::BinaryFn>& kernel) {
+        if (img1.getWidth() != img2.getWidth() || img1.getHeight() != img2.getHeight()) {
+            return img1.clone();
         }
+
+        Image result = img1.clone();
+        if (!img1.getData() || !img2.getData()) return result;
+
+        int width = img1.getWidth();
+        int channels1 = img1.getChannels();
+        int channels2 = img2.getChannels();
+        int common = std::min(channels1, channels2);
+        size_t rowSize1 = static_cast<size_t>(width) * channels1;
+        size_t rowSize2 = static_cast<size_t>(width) * channels2;
+
+        Kernels::forRows(img1.getHeight(), [&](int rowBegin, int rowEnd) {
+            for (int y = rowBegin; y < rowEnd; y++) {
+                Cancellation::checkpoint(y - rowBegin, rowEnd - rowBegin);
+                const unsigned char* row1 = img1.getData() + y * rowSize1;
+                const unsigned char* row2 = img2.getData() + y * rowSize2;
+                unsigned char* out = result.getData() + y * rowSize1;
+                if (channels1 == channels2) {
+                    kernel(row1, row2, out, rowSize1);
+                    continue;
+                }
+                for (int x = 0; x < width; x++) {
+                    kernel(row1 + x * channels1, row2 + x * channels2, out + x * channels1, static_cast<size_t>(common));
+                }
+            }
+        });
+
+        result.updateTexture();
+        return result;
     }
-    
-    result.updateTexture();
-    return result;
+}
+
+Image PointOperations::bitwiseAND(const Image& img1, const Image& img2) {
+    Trace::Zone zone("PointOperations::bitwiseAND");
+    return bitwiseCombine(img1, img2, Kernels::active().bitwiseAnd);
+}
+
+Image PointOperations::bitwiseOR(const Image& img1, const Image& img2) {
+    Trace::Zone zone("PointOperations::bitwiseOR");
+    return bitwiseCombine(img1, img2, Kernels::active().bitwiseOr);
+}
+
+Image PointOperations::bitwiseXOR(const Image& img1, const Image& img2) {
+    Trace::Zone zone("PointOperations::bitwiseXOR");
+    return bitwiseCombine(img1, img2, Kernels::active().bitwiseXor);
 }
 
 Image PointOperations::bitwiseNOT(const Image& img) {
+    Trace::Zone zone("PointOperations::bitwiseNOT");
     return invert(img);
 }
\ No newline at end of file
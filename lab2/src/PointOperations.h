@@ -1,8 +1,12 @@
 #pragma once
+#include "Histogram.h"
 #include "Image.h"
+#include <array>
 
 class PointOperations {
 public:
+    using LUT = std::array<unsigned char, 256>;
+
     static Image linearContrast(const Image& img, float minPercentile = 2.0f, float maxPercentile = 98.0f);
     static Image linearContrastManual(const Image& img, unsigned char minIn, unsigned char maxIn,
                                       unsigned char minOut = 0, unsigned char maxOut = 255);
@@ -19,6 +23,28 @@ public:
     static Image bitwiseOR(const Image& img1, const Image& img2);
     static Image bitwiseXOR(const Image& img1, const Image& img2);
     static Image bitwiseNOT(const Image& img);
+
+    // Value maps behind the per-pixel operations above; chains of them are fused with composeLUT
+    // and applied in a single pass.
+    static LUT identityLUT();
+    static LUT linearContrastLUT(unsigned char minIn, unsigned char maxIn,
+                                 unsigned char minOut = 0, unsigned char maxOut = 255);
+    // Stretches the given percentiles of an intensity histogram to the full range, as linearContrast does
+    static LUT percentileContrastLUT(const Histogram::Counts& intensityHistogram,
+                                     float minPercentile, float maxPercentile);
+    static LUT brightnessContrastLUT(float brightness, float contrast);
+    static LUT gammaLUT(float gamma);
+    static LUT logarithmicLUT(float c = 1.0f);
+    static LUT powerLUT(float power, float c = 1.0f);
+    static LUT invertLUT();
+    static LUT clipLUT(unsigned char minVal, unsigned char maxVal);
+    static LUT quantizeLUT(int levels);
+
+    // lut[i] = second[first[i]]
+    static LUT composeLUT(const LUT& first, const LUT& second);
+    static Image applyLUT(const Image& img, const LUT& lut);
+    // Writes into `result`, reusing its buffer when the size matches; `result` may be `img` itself.
+    static void applyLUT(const Image& img, const LUT& lut, Image& result);
     
 private:
     static unsigned char applyGamma(unsigned char value, float gamma);
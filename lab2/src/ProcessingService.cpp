@@ -0,0 +1,224 @@
+#include "ProcessingService.h"
+#include "ContentHash.h"
+#include "PipelineScript.h"
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+
+namespace {
+    const size_t kLatencyWindow = 4096;
+
+    size_t imageBytes(const Image& image) {
+        return image.getByteSize();
+    }
+
+    ServiceProtocol::Response failure(const std::string& message) {
+        ServiceProtocol::Response response;
+        response.ok = false;
+        response.text = message;
+        return response;
+    }
+}
+
+ProcessingService::ProcessingService(const Options& options)
+    : options(options),
+      pool(options.threads),
+      plans(options.planCacheSize),
+      histograms(options.histogramCacheSize),
+      latencies(kLatencyWindow) {
+    dispatcher = std::thread(&ProcessingService::dispatchLoop, this);
+}
+
+ProcessingService::~ProcessingService() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueChanged.notify_all();
+    dispatcher.join();
+    pool.wait();
+}
+
+std::future<ServiceProtocol::Response> ProcessingService::submit(std::string pipeline, Image image) {
+    auto job = std::make_unique<Job>();
+    job->pipeline = std::move(pipeline);
+    job->image = std::move(image);
+    job->received = Clock::now();
+    auto future = job->promise.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        size_t bytes = imageBytes(job->image);
+        if (bytes <= options.smallRequestBytes) queuedSmallBytes += bytes;
+        queue.push_back(std::move(job));
+    }
+    queueChanged.notify_one();
+    return future;
+}
+
+void ProcessingService::dispatchLoop() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    while (true) {
+        queueChanged.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) return;
+
+        // A small request at the front waits out the batch window for company, unless a full
+        // batch is already queued
+        if (imageBytes(queue.front()->image) <= options.smallRequestBytes) {
+            auto deadline = queue.front()->received + options.batchWindow;
+            queueChanged.wait_until(lock, deadline, [this] {
+                return stopping || queuedSmallBytes >= options.batchBytes;
+            });
+        }
+
+        std::deque<std::unique_ptr<Job>> taken;
+        taken.swap(queue);
+        queuedSmallBytes = 0;
+        lock.unlock();
+
+        std::vector<std::shared_ptr<Batch>> ready;
+        auto small = std::make_shared<Batch>();
+        size_t smallBytes = 0;
+        for (auto& job : taken) {
+            size_t bytes = imageBytes(job->image);
+            if (bytes > options.smallRequestBytes) {
+                auto single = std::make_shared<Batch>();
+                single->push_back(std::move(job));
+                ready.push_back(single);
+                continue;
+            }
+            if (!small->empty() && smallBytes + bytes > options.batchBytes) {
+                ready.push_back(small);
+                small = std::make_shared<Batch>();
+                smallBytes = 0;
+            }
+            smallBytes += bytes;
+            small->push_back(std::move(job));
+        }
+        if (!small->empty()) ready.push_back(small);
+
+        {
+            std::lock_guard<std::mutex> statsLock(statsMutex);
+            batches += ready.size();
+        }
+        // std::function needs a copyable task, hence the shared batches
+        for (auto& batch : ready) {
+            pool.submit([this, batch]() { runBatch(*batch); });
+        }
+
+        lock.lock();
+    }
+}
+
+void ProcessingService::runBatch(Batch& batch) {
+    for (auto& job : batch) {
+        ServiceProtocol::Response response;
+        try {
+            response = process(*job);
+        } catch (const std::exception& e) {
+            response = failure(e.what());
+        }
+        recordLatency(job->received, response.ok);
+        job->promise.set_value(std::move(response));
+        // Release the pixels now rather than when the whole batch is done
+        job.reset();
+    }
+}
+
+ServiceProtocol::Response ProcessingService::process(Job& job) {
+    if (!job.image.getData()) return failure("request has no image");
+
+    std::string error;
+    auto plan = compiledPlan(job.pipeline, error);
+    if (!plan) return failure(error);
+
+    const bool measures = plan->usesHistogram(job.image.getChannels());
+    PipelinePlan::SourceHistogram histogram;
+    uint64_t key = 0;
+    bool cached = false;
+    if (measures) {
+        key = ContentHash::image(job.image);
+        std::lock_guard<std::mutex> lock(histogramMutex);
+        if (auto* found = histograms.find(key)) {
+            histogram = *found;
+            cached = true;
+        }
+    }
+
+    plan->run(job.image, job.image, measures ? &histogram : nullptr);
+
+    if (measures) {
+        if (!cached && histogram.known) {
+            std::lock_guard<std::mutex> lock(histogramMutex);
+            histograms.insert(key, histogram);
+        }
+        std::lock_guard<std::mutex> lock(statsMutex);
+        (cached ? histogramHits : histogramMisses)++;
+    }
+
+    ServiceProtocol::Response response;
+    response.image = std::move(job.image);
+    return response;
+}
+
+std::shared_ptr<const PipelinePlan> ProcessingService::compiledPlan(const std::string& pipeline, std::string& error) {
+    {
+        std::lock_guard<std::mutex> lock(planMutex);
+        if (auto* found = plans.find(pipeline)) {
+            std::lock_guard<std::mutex> statsLock(statsMutex);
+            planHits++;
+            return *found;
+        }
+    }
+
+    // Compiled outside the lock; two requests racing on a new pipeline both compile it
+    std::vector<PipelineScript::Error> errors;
+    auto steps = PipelineScript::parse(pipeline, errors);
+    if (!errors.empty()) {
+        for (const auto& e : errors) {
+            if (!error.empty()) error += "\n";
+            error += PipelineScript::describe(e);
+        }
+        return nullptr;
+    }
+    auto plan = std::make_shared<const PipelinePlan>(PipelinePlan::compile(steps));
+
+    std::lock_guard<std::mutex> lock(planMutex);
+    plans.insert(pipeline, plan);
+    std::lock_guard<std::mutex> statsLock(statsMutex);
+    planMisses++;
+    return plan;
+}
+
+void ProcessingService::recordLatency(Clock::time_point received, bool ok) {
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - received).count();
+    std::lock_guard<std::mutex> lock(statsMutex);
+    latencies[latencyCount++ % latencies.size()] = ms;
+    requests++;
+    if (!ok) failures++;
+}
+
+std::string ProcessingService::stats() const {
+    std::lock_guard<std::mutex> lock(statsMutex);
+
+    std::vector<double> recent(latencies.begin(), latencies.begin() + std::min(latencyCount, latencies.size()));
+    std::sort(recent.begin(), recent.end());
+    auto percentile = [&](double p) {
+        if (recent.empty()) return 0.0;
+        size_t index = static_cast<size_t>(p / 100.0 * (recent.size() - 1) + 0.5);
+        return recent[index];
+    };
+
+    char text[512];
+    std::snprintf(text, sizeof(text),
+                  "requests %llu (%llu failed) in %llu batches on %d threads\n"
+                  "latency ms over last %zu: p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n"
+                  "plan cache: %llu hits, %llu misses\n"
+                  "histogram cache: %llu hits, %llu misses\n",
+                  static_cast<unsigned long long>(requests), static_cast<unsigned long long>(failures),
+                  static_cast<unsigned long long>(batches), pool.getThreadCount(),
+                  recent.size(), percentile(50), percentile(90), percentile(99), recent.empty() ? 0.0 : recent.back(),
+                  static_cast<unsigned long long>(planHits), static_cast<unsigned long long>(planMisses),
+                  static_cast<unsigned long long>(histogramHits), static_cast<unsigned long long>(histogramMisses));
+    return text;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "Image.h"
+#include "LruCache.h"
+#include "PipelinePlan.h"
+#include "ServiceProtocol.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Request processing behind lab2_service. Requests from all connections go through one queue: a
+// dispatcher collects them for a short window and hands small images to the shared worker pool in
+// batches, so a burst of thumbnails costs a few tasks instead of one each, while large images get a
+// task of their own. Compiled pipelines and source histograms are kept between requests.
+class ProcessingService {
+public:
+    struct Options {
+        int threads = hardwareThreads();
+        // Images up to this size are batched; a batch holds up to batchBytes of pixels
+        size_t smallRequestBytes = 256 << 10;
+        size_t batchBytes = 4 << 20;
+        // How long the first small request waits for others to join its batch
+        std::chrono::microseconds batchWindow{500};
+        size_t planCacheSize = 64;
+        size_t histogramCacheSize = 256;
+    };
+
+    explicit ProcessingService(const Options& options);
+    // Finishes the queued requests before returning.
+    ~ProcessingService();
+
+    ProcessingService(const ProcessingService&) = delete;
+    ProcessingService& operator=(const ProcessingService&) = delete;
+
+    // Runs `pipeline` (PipelineScript text) on `image`. Errors come back as a response with
+    // ok == false and the message in text.
+    std::future<ServiceProtocol::Response> submit(std::string pipeline, Image image);
+
+    // Request counts, latency percentiles over the recent requests and cache hit rates
+    std::string stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Job {
+        std::string pipeline;
+        Image image;
+        std::promise<ServiceProtocol::Response> promise;
+        Clock::time_point received;
+    };
+    using Batch = std::vector<std::unique_ptr<Job>>;
+
+    void dispatchLoop();
+    void runBatch(Batch& batch);
+    ServiceProtocol::Response process(Job& job);
+    std::shared_ptr<const PipelinePlan> compiledPlan(const std::string& pipeline, std::string& error);
+    void recordLatency(Clock::time_point received, bool ok);
+
+    Options options;
+    ThreadPool pool;
+
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<std::unique_ptr<Job>> queue;
+    size_t queuedSmallBytes = 0;
+    bool stopping = false;
+
+    std::mutex planMutex;
+    LruCache<std::string, std::shared_ptr<const PipelinePlan>> plans;
+    std::mutex histogramMutex;
+    LruCache<uint64_t, PipelinePlan::SourceHistogram> histograms;
+
+    mutable std::mutex statsMutex;
+    std::vector<double> latencies;
+    size_t latencyCount = 0;
+    uint64_t requests = 0;
+    uint64_t failures = 0;
+    uint64_t batches = 0;
+    uint64_t planHits = 0;
+    uint64_t planMisses = 0;
+    uint64_t histogramHits = 0;
+    uint64_t histogramMisses = 0;
+
+    std::thread dispatcher;
+};
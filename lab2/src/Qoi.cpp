@@ -0,0 +1,202 @@
+#include "Qoi.h"
+#include "Trace.h"
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    const unsigned char kOpIndex = 0x00;
+    const unsigned char kOpDiff = 0x40;
+    const unsigned char kOpLuma = 0x80;
+    const unsigned char kOpRun = 0xC0;
+    const unsigned char kOpRGB = 0xFE;
+    const unsigned char kOpRGBA = 0xFF;
+    const unsigned char kMask = 0xC0;
+    const unsigned char kEnd[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    const size_t kHeaderBytes = 14;
+    const size_t kFlushBytes = 1 << 20;
+
+    struct Pixel {
+        unsigned char r = 0, g = 0, b = 0, a = 0;
+        bool operator==(const Pixel& other) const { return r == other.r && g == other.g && b == other.b && a == other.a; }
+        bool operator!=(const Pixel& other) const { return !(*this == other); }
+    };
+
+    int slot(const Pixel& p) {
+        return (p.r * 3 + p.g * 5 + p.b * 7 + p.a * 11) % 64;
+    }
+
+    uint32_t readBigEndian(const unsigned char* p) {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+    }
+
+    void putBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+        out.push_back(static_cast<unsigned char>(value >> 24));
+        out.push_back(static_cast<unsigned char>(value >> 16));
+        out.push_back(static_cast<unsigned char>(value >> 8));
+        out.push_back(static_cast<unsigned char>(value));
+    }
+}
+
+bool Qoi::readHeader(FILE* in, int& width, int& height, int& channels) {
+    unsigned char header[kHeaderBytes];
+    if (std::fread(header, 1, kHeaderBytes, in) != kHeaderBytes || std::memcmp(header, "qoif", 4) != 0) return false;
+
+    uint32_t w = readBigEndian(header + 4);
+    uint32_t h = readBigEndian(header + 8);
+    channels = header[12];
+    if (w == 0 || h == 0 || (channels != 3 && channels != 4)) {
+        throw std::runtime_error("malformed QOI header");
+    }
+    if (w > INT_MAX || h > INT_MAX) {
+        throw std::runtime_error("QOI image too large");
+    }
+    width = static_cast<int>(w);
+    height = static_cast<int>(h);
+    return true;
+}
+
+bool Qoi::read(FILE* in, Image& image) {
+    Trace::Zone zone("Qoi::read");
+    int width, height, channels;
+    if (!readHeader(in, width, height, channels)) return false;
+
+    std::vector<unsigned char> encoded;
+    unsigned char buffer[1 << 16];
+    size_t count;
+    while ((count = std::fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        encoded.insert(encoded.end(), buffer, buffer + count);
+    }
+
+    image.resize(width, height, channels);
+    unsigned char* out = image.getData();
+    size_t pixels = static_cast<size_t>(width) * height;
+    Pixel index[64];
+    Pixel pixel;
+    pixel.a = 255;
+    int run = 0;
+    size_t p = 0;
+    for (size_t i = 0; i < pixels; i++) {
+        if (run > 0) {
+            run--;
+        } else {
+            if (p >= encoded.size()) throw std::runtime_error("truncated QOI image");
+            unsigned char op = encoded[p++];
+            if (op == kOpRGB || op == kOpRGBA) {
+                size_t bytes = op == kOpRGB ? 3 : 4;
+                if (p + bytes > encoded.size()) throw std::runtime_error("truncated QOI image");
+                pixel.r = encoded[p];
+                pixel.g = encoded[p + 1];
+                pixel.b = encoded[p + 2];
+                if (op == kOpRGBA) pixel.a = encoded[p + 3];
+                p += bytes;
+            } else if ((op & kMask) == kOpIndex) {
+                pixel = index[op];
+            } else if ((op & kMask) == kOpDiff) {
+                pixel.r += ((op >> 4) & 3) - 2;
+                pixel.g += ((op >> 2) & 3) - 2;
+                pixel.b += (op & 3) - 2;
+            } else if ((op & kMask) == kOpLuma) {
+                if (p >= encoded.size()) throw std::runtime_error("truncated QOI image");
+                unsigned char second = encoded[p++];
+                int dg = (op & 0x3F) - 32;
+                pixel.r += dg - 8 + ((second >> 4) & 0x0F);
+                pixel.g += dg;
+                pixel.b += dg - 8 + (second & 0x0F);
+            } else {
+                run = op & 0x3F;
+            }
+            index[slot(pixel)] = pixel;
+        }
+
+        unsigned char* px = out + i * channels;
+        px[0] = pixel.r;
+        px[1] = pixel.g;
+        px[2] = pixel.b;
+        if (channels == 4) px[3] = pixel.a;
+    }
+    image.updateTexture();
+    return true;
+}
+
+bool Qoi::write(FILE* out, const Image& image) {
+    Trace::Zone zone("Qoi::write");
+    int channels = image.getChannels();
+    if (!image.getData() || channels < 1 || channels > 4) return false;
+    // Gray expands to RGB; its alpha, if any, is kept
+    bool alpha = channels == 2 || channels == 4;
+    bool gray = channels < 3;
+
+    std::vector<unsigned char> encoded;
+    encoded.reserve(kFlushBytes + 64);
+    encoded.insert(encoded.end(), {'q', 'o', 'i', 'f'});
+    putBigEndian(encoded, static_cast<uint32_t>(image.getWidth()));
+    putBigEndian(encoded, static_cast<uint32_t>(image.getHeight()));
+    encoded.push_back(alpha ? 4 : 3);
+    encoded.push_back(0);
+
+    auto flush = [&]() {
+        bool written = std::fwrite(encoded.data(), 1, encoded.size(), out) == encoded.size();
+        encoded.clear();
+        return written;
+    };
+
+    const unsigned char* data = image.getData();
+    size_t pixels = static_cast<size_t>(image.getWidth()) * image.getHeight();
+    Pixel index[64];
+    Pixel previous;
+    previous.a = 255;
+    int run = 0;
+    for (size_t i = 0; i < pixels; i++) {
+        const unsigned char* px = data + i * channels;
+        Pixel pixel;
+        pixel.r = px[0];
+        pixel.g = gray ? px[0] : px[1];
+        pixel.b = gray ? px[0] : px[2];
+        pixel.a = alpha ? px[channels - 1] : 255;
+
+        if (pixel == previous) {
+            run++;
+            if (run == 62 || i + 1 == pixels) {
+                encoded.push_back(kOpRun | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            encoded.push_back(kOpRun | (run - 1));
+            run = 0;
+        }
+
+        int s = slot(pixel);
+        if (index[s] == pixel) {
+            encoded.push_back(kOpIndex | s);
+        } else {
+            index[s] = pixel;
+            if (pixel.a == previous.a) {
+                signed char dr = static_cast<signed char>(pixel.r - previous.r);
+                signed char dg = static_cast<signed char>(pixel.g - previous.g);
+                signed char db = static_cast<signed char>(pixel.b - previous.b);
+                int drg = dr - dg;
+                int dbg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    encoded.push_back(kOpDiff | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+                } else if (drg >= -8 && drg <= 7 && dg >= -32 && dg <= 31 && dbg >= -8 && dbg <= 7) {
+                    encoded.push_back(kOpLuma | (dg + 32));
+                    encoded.push_back(static_cast<unsigned char>(((drg + 8) << 4) | (dbg + 8)));
+                } else {
+                    encoded.insert(encoded.end(), {kOpRGB, pixel.r, pixel.g, pixel.b});
+                }
+            } else {
+                encoded.insert(encoded.end(), {kOpRGBA, pixel.r, pixel.g, pixel.b, pixel.a});
+            }
+        }
+        previous = pixel;
+
+        if (encoded.size() >= kFlushBytes && !flush()) return false;
+    }
+    encoded.insert(encoded.end(), kEnd, kEnd + sizeof(kEnd));
+    return flush();
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "Image.h"
+#include <cstdio>
+
+// QOI ("Quite OK Image") files: lossless like PNG, at a fraction of its encode and decode time and
+// usually somewhat larger. The format holds RGB or RGBA only, so gray images are written as RGB and
+// gray with alpha as RGBA.
+class Qoi {
+public:
+    // Returns false when the stream does not start with a QOI header; throws std::runtime_error for
+    // a truncated or oversized image.
+    static bool read(FILE* in, Image& image);
+    // Header alone, for sizing a buffer before decoding; the same errors as read().
+    static bool readHeader(FILE* in, int& width, int& height, int& channels);
+    static bool write(FILE* out, const Image& image);
+};
@@ -0,0 +1,243 @@
+#include "Resampling.h"
+#include "Parallel.h"
+#include "../../lab1/utils/MemoryAccounting.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RESAMPLING_SSE2 1
+#endif
+
+namespace {
+const int kWeightBits = 14;
+const int kWeightOne = 1 << kWeightBits;
+const double kPi = 3.14159265358979323846;
+
+unsigned char clampToByte(int value) {
+    return static_cast<unsigned char>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+double sinc(double x) {
+    if (x == 0.0) return 1.0;
+    x *= kPi;
+    return std::sin(x) / x;
+}
+}
+
+const char* Resampling::filterName(Filter filter) {
+    switch (filter) {
+        case Filter::Box: return "Box";
+        case Filter::Bilinear: return "Bilinear";
+        case Filter::Bicubic: return "Bicubic";
+        case Filter::Lanczos3: return "Lanczos-3";
+    }
+    return "Unknown";
+}
+
+double Resampling::filterSupport(Filter filter) {
+    switch (filter) {
+        case Filter::Box: return 0.5;
+        case Filter::Bilinear: return 1.0;
+        case Filter::Bicubic: return 2.0;
+        case Filter::Lanczos3: return 3.0;
+    }
+    return 1.0;
+}
+
+double Resampling::filterKernel(Filter filter, double x) {
+    x = std::fabs(x);
+    switch (filter) {
+        case Filter::Box:
+            return x <= 0.5 ? 1.0 : 0.0;
+        case Filter::Bilinear:
+            return x < 1.0 ? 1.0 - x : 0.0;
+        case Filter::Bicubic: {
+            const double a = -0.5;
+            if (x < 1.0) return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+            if (x < 2.0) return (((x - 5.0) * x + 8.0) * x - 4.0) * a;
+            return 0.0;
+        }
+        case Filter::Lanczos3:
+            return x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+    return 0.0;
+}
+
+Resampling::WeightTable Resampling::buildWeights(int srcSize, int dstSize, Filter filter) {
+    WeightTable table;
+    double scale = static_cast<double>(srcSize) / dstSize;
+    double filterScale = std::max(scale, 1.0);
+    double support = filterSupport(filter) * filterScale;
+
+    table.taps = static_cast<int>(std::ceil(support)) * 2 + 1;
+    table.start.resize(dstSize);
+    table.count.resize(dstSize);
+    table.weights.assign(static_cast<size_t>(dstSize) * table.taps, 0);
+
+    std::vector<double> w(table.taps);
+    for (int i = 0; i < dstSize; i++) {
+        double center = (i + 0.5) * scale;
+        int first = std::max(static_cast<int>(center - support + 0.5), 0);
+        int last = std::min(static_cast<int>(center + support + 0.5), srcSize);
+        int count = std::min(last - first, table.taps);
+
+        double sum = 0.0;
+        for (int t = 0; t < count; t++) {
+            w[t] = filterKernel(filter, (first + t - center + 0.5) / filterScale);
+            sum += w[t];
+        }
+        if (count <= 0 || sum == 0.0) {
+            first = std::min(static_cast<int>(center), srcSize - 1);
+            count = 1;
+            w[0] = sum = 1.0;
+        }
+
+        int16_t* dst = &table.weights[static_cast<size_t>(i) * table.taps];
+        int total = 0;
+        int largest = 0;
+        for (int t = 0; t < count; t++) {
+            dst[t] = static_cast<int16_t>(std::lround(w[t] / sum * kWeightOne));
+            total += dst[t];
+            if (dst[t] > dst[largest]) largest = t;
+        }
+        dst[largest] = static_cast<int16_t>(dst[largest] + (kWeightOne - total));
+
+        table.start[i] = first;
+        table.count[i] = count;
+    }
+
+    return table;
+}
+
+namespace {
+template <int C>
+void horizontalRows(const unsigned char* data, int srcWidth, unsigned char* dst, int dstWidth,
+                    const int16_t* weights, int taps, const int* starts, const int* counts, int rowBegin, int rowEnd) {
+    for (int y = rowBegin; y < rowEnd; y++) {
+        const unsigned char* in = data + static_cast<size_t>(y) * srcWidth * C;
+        unsigned char* out = dst + static_cast<size_t>(y) * dstWidth * C;
+
+        for (int x = 0; x < dstWidth; x++) {
+            const int16_t* w = weights + static_cast<size_t>(x) * taps;
+            const unsigned char* p = in + starts[x] * C;
+            int count = counts[x];
+
+            int acc[C];
+            for (int c = 0; c < C; c++) acc[c] = kWeightOne / 2;
+            for (int t = 0; t < count; t++) {
+                for (int c = 0; c < C; c++) {
+                    acc[c] += p[t * C + c] * w[t];
+                }
+            }
+            for (int c = 0; c < C; c++) {
+                out[x * C + c] = clampToByte(acc[c] >> kWeightBits);
+            }
+        }
+    }
+}
+}
+
+void Resampling::horizontalPass(const Image& src, unsigned char* dst, int dstWidth, const WeightTable& table) {
+    int channels = src.getChannels();
+    int srcWidth = src.getWidth();
+    const unsigned char* data = src.getData();
+
+    parallelFor(0, src.getHeight(), [&](int rowBegin, int rowEnd) {
+        const int16_t* w = table.weights.data();
+        const int* starts = table.start.data();
+        const int* counts = table.count.data();
+        switch (channels) {
+            case 1: horizontalRows<1>(data, srcWidth, dst, dstWidth, w, table.taps, starts, counts, rowBegin, rowEnd); break;
+            case 2: horizontalRows<2>(data, srcWidth, dst, dstWidth, w, table.taps, starts, counts, rowBegin, rowEnd); break;
+            case 3: horizontalRows<3>(data, srcWidth, dst, dstWidth, w, table.taps, starts, counts, rowBegin, rowEnd); break;
+            default: horizontalRows<4>(data, srcWidth, dst, dstWidth, w, table.taps, starts, counts, rowBegin, rowEnd); break;
+        }
+    });
+}
+
+void Resampling::verticalPass(const unsigned char* src, int width, int channels, Image& dst, const WeightTable& table) {
+    size_t rowLen = static_cast<size_t>(width) * channels;
+    unsigned char* out = dst.getData();
+
+    parallelFor(0, dst.getHeight(), [&](int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; y++) {
+            const int16_t* w = &table.weights[static_cast<size_t>(y) * table.taps];
+            const unsigned char* first = src + table.start[y] * rowLen;
+            int count = table.count[y];
+            unsigned char* row = out + y * rowLen;
+            size_t x = 0;
+
+#ifdef RESAMPLING_SSE2
+            // Pairs of source rows are interleaved as 16-bit lanes so one madd applies two taps.
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i rounding = _mm_set1_epi32(kWeightOne / 2);
+            for (; x + 8 <= rowLen; x += 8) {
+                __m128i accLo = rounding;
+                __m128i accHi = rounding;
+                for (int t = 0; t < count; t += 2) {
+                    const unsigned char* a = first + t * rowLen + x;
+                    bool pair = t + 1 < count;
+                    const unsigned char* b = pair ? a + rowLen : a;
+                    int16_t wb = pair ? w[t + 1] : 0;
+
+                    __m128i pa = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a)), zero);
+                    __m128i pb = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(b)), zero);
+                    __m128i weights = _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(static_cast<uint16_t>(wb)) << 16) |
+                                                                       static_cast<uint16_t>(w[t])));
+
+                    accLo = _mm_add_epi32(accLo, _mm_madd_epi16(_mm_unpacklo_epi16(pa, pb), weights));
+                    accHi = _mm_add_epi32(accHi, _mm_madd_epi16(_mm_unpackhi_epi16(pa, pb), weights));
+                }
+                accLo = _mm_srai_epi32(accLo, kWeightBits);
+                accHi = _mm_srai_epi32(accHi, kWeightBits);
+                __m128i packed = _mm_packus_epi16(_mm_packs_epi32(accLo, accHi), zero);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(row + x), packed);
+            }
+#endif
+            for (; x < rowLen; x++) {
+                int acc = kWeightOne / 2;
+                for (int t = 0; t < count; t++) {
+                    acc += first[t * rowLen + x] * w[t];
+                }
+                row[x] = clampToByte(acc >> kWeightBits);
+            }
+        }
+    }, 8);
+}
+
+Image Resampling::resize(const Image& img, int newWidth, int newHeight, Filter filter) {
+    int channels = img.getChannels();
+    if (!img.getData() || newWidth <= 0 || newHeight <= 0 || channels > 4) {
+        return img.clone();
+    }
+    if (newWidth == img.getWidth() && newHeight == img.getHeight()) {
+        return img.clone();
+    }
+
+    WeightTable horizontal = buildWeights(img.getWidth(), newWidth, filter);
+    WeightTable vertical = buildWeights(img.getHeight(), newHeight, filter);
+
+    std::vector<unsigned char> intermediate(static_cast<size_t>(newWidth) * img.getHeight() * channels);
+    MemoryAccounting::Scoped counted(MemoryAccounting::Category::Temporaries, intermediate.size());
+    horizontalPass(img, intermediate.data(), newWidth, horizontal);
+
+    Image result(newWidth, newHeight, channels);
+    verticalPass(intermediate.data(), newWidth, channels, result, vertical);
+
+    result.updateTexture();
+    return result;
+}
+
+Image Resampling::fitWithin(const Image& img, int maxWidth, int maxHeight, Filter filter) {
+    if (!img.getData() || (img.getWidth() <= maxWidth && img.getHeight() <= maxHeight)) {
+        return img.clone();
+    }
+
+    double scale = std::min(static_cast<double>(maxWidth) / img.getWidth(),
+                            static_cast<double>(maxHeight) / img.getHeight());
+    int width = std::max(1, static_cast<int>(std::lround(img.getWidth() * scale)));
+    int height = std::max(1, static_cast<int>(std::lround(img.getHeight() * scale)));
+    return resize(img, width, height, filter);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "Image.h"
+#include <cstdint>
+#include <vector>
+
+class Resampling {
+public:
+    enum class Filter { Box, Bilinear, Bicubic, Lanczos3 };
+
+    static Image resize(const Image& img, int newWidth, int newHeight, Filter filter = Filter::Bilinear);
+    static Image fitWithin(const Image& img, int maxWidth, int maxHeight, Filter filter = Filter::Bilinear);
+
+    static const char* filterName(Filter filter);
+
+private:
+    // Fixed-point (1 << 14) weights, `taps` entries per output sample, precomputed once per axis.
+    struct WeightTable {
+        int taps = 0;
+        std::vector<int> start;
+        std::vector<int> count;
+        std::vector<int16_t> weights;
+    };
+
+    static WeightTable buildWeights(int srcSize, int dstSize, Filter filter);
+    static double filterSupport(Filter filter);
+    static double filterKernel(Filter filter, double x);
+
+    static void horizontalPass(const Image& src, unsigned char* dst, int dstWidth, const WeightTable& table);
+    static void verticalPass(const unsigned char* src, int width, int channels, Image& dst, const WeightTable& table);
+};
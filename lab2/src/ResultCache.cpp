@@ -0,0 +1,195 @@
+#include "ResultCache.h"
+#include "ContentHash.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+    const char* const kExtension = ".raw";
+    const char* const kTemporaryExtension = ".tmp";
+
+    std::string hex(uint64_t value) {
+        char text[17];
+        std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+        return text;
+    }
+
+    std::string nameOf(const ResultCache::Key& key) {
+        return hex(key.input) + hex(key.operations);
+    }
+
+    // Forces the file's contents to disk, so the rename that publishes it cannot reach the disk first
+    bool syncFile(const std::string& path) {
+#ifdef _WIN32
+        HANDLE handle = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) return false;
+        bool synced = FlushFileBuffers(handle) != 0;
+        CloseHandle(handle);
+        return synced;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        bool synced = ::fsync(fd) == 0;
+        ::close(fd);
+        return synced;
+#endif
+    }
+}
+
+ResultCache::ResultCache(const std::string& directory, uint64_t limitBytes) : directory(directory), limit(limitBytes) {
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+
+    struct Found {
+        fs::file_time_type time;
+        Entry entry;
+    };
+    std::vector<Found> found;
+    for (const auto& file : fs::directory_iterator(directory, ec)) {
+        std::error_code fileError;
+        if (!file.is_regular_file(fileError)) continue;
+        const fs::path& path = file.path();
+        if (path.extension() == kTemporaryExtension) {
+            fs::remove(path, fileError);
+            continue;
+        }
+        std::string name = path.stem().string();
+        if (path.extension() != kExtension || name.size() != 32) continue;
+
+        uint64_t bytes = file.file_size(fileError);
+        fs::file_time_type time = file.last_write_time(fileError);
+        if (!fileError) found.push_back({time, {name, bytes}});
+    }
+
+    std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) { return a.time > b.time; });
+    for (auto& item : found) {
+        counters.bytes += item.entry.bytes;
+        entries.push_back(std::move(item.entry));
+        index[entries.back().name] = std::prev(entries.end());
+    }
+    counters.entries = entries.size();
+    evict();
+}
+
+ResultCache::Key ResultCache::key(const Image& input, const std::string& operations) {
+    Key key;
+    key.input = ContentHash::image(input);
+    key.operations = ContentHash::text(operations);
+    return key;
+}
+
+bool ResultCache::find(const Key& key, Image& result) {
+    Trace::Zone zone("ResultCache::find");
+    std::string name = nameOf(key);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(name);
+        if (it == index.end()) {
+            counters.misses++;
+            return false;
+        }
+        entries.splice(entries.begin(), entries, it->second);
+    }
+
+    std::string path = pathOf(name);
+    std::error_code ec;
+    // Removed behind our back, or damaged: forget it
+    if (!fs::exists(path, ec) || !result.load(path)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(name);
+        if (it != index.end()) {
+            counters.bytes -= it->second->bytes;
+            entries.erase(it->second);
+            index.erase(it);
+            counters.entries = entries.size();
+        }
+        counters.misses++;
+        fs::remove(path, ec);
+        return false;
+    }
+    // Keeps the recency for the next run
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.hits++;
+    return true;
+}
+
+bool ResultCache::insert(const Key& key, const Image& result) {
+    Trace::Zone zone("ResultCache::insert");
+    uint64_t bytes = result.getByteSize();
+    if (!result.getData() || bytes > limit) return false;
+
+    static std::atomic<uint64_t> sequence{0};
+    std::string name = nameOf(key);
+    std::string path = pathOf(name);
+    std::string temporary = (fs::path(directory) / (name + "." + hex(std::hash<std::thread::id>()(std::this_thread::get_id())) +
+                                                    hex(sequence++) + kTemporaryExtension)).string();
+
+    Image::SaveOptions raw;
+    raw.format = Image::SaveOptions::Format::Raw;
+    std::error_code ec;
+    if (!result.save(temporary, raw) || !syncFile(temporary)) {
+        fs::remove(temporary, ec);
+        return false;
+    }
+    fs::rename(temporary, path, ec);
+    if (ec) {
+        fs::remove(temporary, ec);
+        return false;
+    }
+    uint64_t fileBytes = fs::file_size(path, ec);
+    if (ec) fileBytes = bytes;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(name);
+    if (it != index.end()) {
+        // Another thread stored the same result; the rename replaced its file
+        counters.bytes -= it->second->bytes;
+        entries.erase(it->second);
+    }
+    entries.push_front({name, fileBytes});
+    index[name] = entries.begin();
+    counters.bytes += fileBytes;
+    evict();
+    counters.entries = entries.size();
+    return true;
+}
+
+ResultCache::Stats ResultCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+std::string ResultCache::pathOf(const std::string& name) const {
+    return (fs::path(directory) / (name + kExtension)).string();
+}
+
+void ResultCache::evict() {
+    while (counters.bytes > limit && !entries.empty()) {
+        const Entry& oldest = entries.back();
+        std::error_code ec;
+        fs::remove(pathOf(oldest.name), ec);
+        counters.bytes -= oldest.bytes;
+        counters.evictions++;
+        index.erase(oldest.name);
+        entries.pop_back();
+    }
+    counters.entries = entries.size();
+}
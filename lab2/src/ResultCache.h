@@ -0,0 +1,63 @@
+#pragma once
+#include "Image.h"
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Processed images on disk, keyed by a hash of the input pixels and one of the operations applied to
+// them, so a rerun of the same pipeline on the same inputs skips the work. Entries are raw files
+// (see Image::save), which find() maps rather than reads. The directory holds at most `limitBytes`;
+// beyond that the least recently used entries go, across runs too, since a hit touches the file's
+// modification time. Entries are written to a temporary file, flushed to disk and renamed into place,
+// so a crash or power loss never leaves a partial one. One process at a time per directory.
+// Thread-safe.
+class ResultCache {
+public:
+    struct Key {
+        uint64_t input = 0;
+        uint64_t operations = 0;
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t bytes = 0;
+        size_t entries = 0;
+    };
+
+    // Indexes what earlier runs left in `directory`, creating it if needed, and removes temporary
+    // files of interrupted writes.
+    ResultCache(const std::string& directory, uint64_t limitBytes);
+
+    // `operations` is the serialized operation chain with its arguments, e.g. PipelineScript::format()
+    static Key key(const Image& input, const std::string& operations);
+
+    // Loads the result stored for `key` into `result`; false on a miss.
+    bool find(const Key& key, Image& result);
+    // Stores `result`, then evicts least recently used entries until the directory fits the limit.
+    // Results larger than the whole limit are not stored.
+    bool insert(const Key& key, const Image& result);
+
+    Stats stats() const;
+
+private:
+    struct Entry {
+        std::string name;
+        uint64_t bytes;
+    };
+
+    std::string pathOf(const std::string& name) const;
+    // Called with the mutex held
+    void evict();
+
+    std::string directory;
+    uint64_t limit;
+    mutable std::mutex mutex;
+    // Most recently used first
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    Stats counters;
+};
@@ -0,0 +1,175 @@
+#include "ServiceProtocol.h"
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    const uint32_t kMagic = 0x324C4142;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t code;
+        uint32_t width;
+        uint32_t height;
+        uint32_t channels;
+        uint32_t textLength;
+    };
+
+    // False when the connection closed before the first byte; throws when it closed mid-message.
+    bool readFully(int fd, void* buffer, size_t size) {
+        char* out = static_cast<char*>(buffer);
+        size_t done = 0;
+        while (done < size) {
+            ssize_t n = ::recv(fd, out + done, size - done, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                if (done == 0) return false;
+                throw std::runtime_error("connection closed mid-message");
+            }
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool writeFully(int fd, const void* buffer, size_t size) {
+        const char* in = static_cast<const char*>(buffer);
+        size_t done = 0;
+        while (done < size) {
+            ssize_t n = ::send(fd, in + done, size - done, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool readMessage(int fd, uint32_t& code, std::string& text, Image& image) {
+        Header header;
+        if (!readFully(fd, &header, sizeof(header))) return false;
+        if (header.magic != kMagic) throw std::runtime_error("bad message magic");
+        if (header.textLength > ServiceProtocol::kMaxTextLength) throw std::runtime_error("message text too long");
+
+        size_t pixels = 0;
+        if (header.width > INT_MAX || header.height > INT_MAX || header.channels > 4 ||
+            !Image::byteSize(static_cast<int>(header.width), static_cast<int>(header.height),
+                             static_cast<int>(header.channels), pixels) ||
+            pixels > ServiceProtocol::kMaxImageBytes) {
+            throw std::runtime_error("message image too large");
+        }
+
+        code = header.code;
+        text.resize(header.textLength);
+        if (header.textLength && !readFully(fd, &text[0], text.size())) {
+            throw std::runtime_error("connection closed mid-message");
+        }
+
+        if (pixels == 0) {
+            image = Image();
+            return true;
+        }
+        image.resize(static_cast<int>(header.width), static_cast<int>(header.height), static_cast<int>(header.channels));
+        if (!readFully(fd, image.getData(), pixels)) throw std::runtime_error("connection closed mid-message");
+        return true;
+    }
+
+    bool writeMessage(int fd, uint32_t code, const std::string& text, const Image& image) {
+        Header header;
+        header.magic = kMagic;
+        header.code = code;
+        header.width = image.getData() ? static_cast<uint32_t>(image.getWidth()) : 0;
+        header.height = image.getData() ? static_cast<uint32_t>(image.getHeight()) : 0;
+        header.channels = image.getData() ? static_cast<uint32_t>(image.getChannels()) : 0;
+        header.textLength = static_cast<uint32_t>(text.size());
+
+        size_t pixels = image.getData() ? image.getByteSize() : 0;
+        return writeFully(fd, &header, sizeof(header)) &&
+               writeFully(fd, text.data(), text.size()) &&
+               writeFully(fd, image.getData(), pixels);
+    }
+
+    bool makeAddress(const std::string& path, sockaddr_un& address) {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+}
+
+bool ServiceProtocol::readRequest(int fd, Request& request) {
+    uint32_t code;
+    if (!readMessage(fd, code, request.pipeline, request.image)) return false;
+    if (code != static_cast<uint32_t>(Type::Process) && code != static_cast<uint32_t>(Type::Stats)) {
+        throw std::runtime_error("unknown request type");
+    }
+    request.type = static_cast<Type>(code);
+    return true;
+}
+
+bool ServiceProtocol::readResponse(int fd, Response& response) {
+    uint32_t code;
+    if (!readMessage(fd, code, response.text, response.image)) return false;
+    response.ok = code == 0;
+    return true;
+}
+
+bool ServiceProtocol::writeRequest(int fd, const Request& request) {
+    return writeMessage(fd, static_cast<uint32_t>(request.type), request.pipeline, request.image);
+}
+
+bool ServiceProtocol::writeResponse(int fd, const Response& response) {
+    return writeMessage(fd, response.ok ? 0 : 1, response.text, response.image);
+}
+
+int ServiceProtocol::listen(const std::string& path) {
+    sockaddr_un address;
+    if (!makeAddress(path, address)) return -1;
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    // A socket file left behind by a previous run would make bind fail. It is removed only when
+    // nothing accepts connections on it any more; a running service keeps its socket, and anything
+    // else at the path is left alone, so bind fails with EADDRINUSE.
+    struct stat status;
+    if (::lstat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) {
+        int probe = connect(path);
+        if (probe >= 0) {
+            ::close(probe);
+            ::close(fd);
+            errno = EADDRINUSE;
+            return -1;
+        }
+        if (errno == ECONNREFUSED) ::unlink(path.c_str());
+    }
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(fd, 64) < 0) {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+int ServiceProtocol::connect(const std::string& path) {
+    sockaddr_un address;
+    if (!makeAddress(path, address)) return -1;
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "Image.h"
+#include <cstdint>
+#include <string>
+
+// Framing of the local processing service (lab2_service) on a Unix domain socket. Every message is
+// a fixed header followed by a text part and raw pixels:
+//
+//   request:  magic, type, width, height, channels, text length | pipeline text | pixels
+//   response: magic, status, width, height, channels, text length | error or stats | pixels
+//
+// Fields are 32-bit in host byte order; both ends run on the same machine. A connection carries
+// any number of requests, each answered before the next is read.
+class ServiceProtocol {
+public:
+    enum class Type : uint32_t { Process = 1, Stats = 2 };
+
+    struct Request {
+        Type type = Type::Process;
+        std::string pipeline;
+        Image image;
+    };
+
+    struct Response {
+        bool ok = true;
+        // Error message, or the statistics for a Stats request
+        std::string text;
+        Image image;
+    };
+
+    static const size_t kMaxTextLength = 1 << 16;
+    static const size_t kMaxImageBytes = size_t(1) << 30;
+
+    // Return false when the peer closed the connection; throw std::runtime_error for malformed
+    // messages.
+    static bool readRequest(int fd, Request& request);
+    static bool readResponse(int fd, Response& response);
+    static bool writeRequest(int fd, const Request& request);
+    static bool writeResponse(int fd, const Response& response);
+
+    // Socket descriptors, or -1 with errno set.
+    static int listen(const std::string& path);
+    static int connect(const std::string& path);
+};
@@ -0,0 +1,123 @@
+#include "Strips.h"
+#include "Trace.h"
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+namespace {
+    const size_t kFileBuffer = 1 << 20;
+
+    // Offsets past 2 GB, which long cannot hold on Windows
+    int64_t tell(FILE* file) {
+#ifdef _WIN32
+        return _ftelli64(file);
+#else
+        return static_cast<int64_t>(ftello(file));
+#endif
+    }
+
+    bool seek(FILE* file, int64_t offset) {
+#ifdef _WIN32
+        return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+        return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+    }
+}
+
+StripReader::StripReader(const std::string& path)
+    : file(nullptr), ownsFile(path != "-"), seekable(false), dataOffset(0), nextRow(0), buffer(ownsFile ? kFileBuffer : 0) {
+    file = ownsFile ? std::fopen(path.c_str(), "rb") : stdin;
+    if (!file) throw std::runtime_error("cannot open " + path);
+    // stdin and stdout outlive this object, so they keep their own buffers
+    if (ownsFile) std::setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+
+    try {
+        if (!Pnm::readHeader(file, header)) throw std::runtime_error("empty file");
+    } catch (const std::runtime_error& e) {
+        if (ownsFile) std::fclose(file);
+        throw std::runtime_error(path + ": " + e.what());
+    }
+    dataOffset = tell(file);
+    seekable = ownsFile && dataOffset >= 0;
+}
+
+StripReader::~StripReader() {
+    if (ownsFile) std::fclose(file);
+}
+
+int StripReader::read(Image& strip, int rows) {
+    Trace::Zone zone("StripReader::read");
+    int count = std::min(rows, header.height - nextRow);
+    if (count <= 0) return 0;
+
+    strip.resize(header.width, count, header.channels);
+    size_t size = static_cast<size_t>(header.width) * count * header.channels;
+    if (std::fread(strip.getData(), 1, size, file) != size) {
+        throw std::runtime_error("truncated PNM image at row " + std::to_string(nextRow));
+    }
+    nextRow += count;
+    return count;
+}
+
+void StripReader::rewind() {
+    if (!seekable || !seek(file, dataOffset)) {
+        throw std::runtime_error("this plan reads the image more than once and needs a seekable input");
+    }
+    nextRow = 0;
+}
+
+StripWriter::StripWriter(const std::string& path, const Pnm::Header& header)
+    : file(nullptr), ownsFile(path != "-"), path(path), partial(ownsFile ? path + ".part" : std::string()),
+      header(header), rowsWritten(0), buffer(ownsFile ? kFileBuffer : 0) {
+    file = ownsFile ? std::fopen(partial.c_str(), "wb") : stdout;
+    if (!file) throw std::runtime_error("cannot create " + (ownsFile ? partial : path));
+    if (ownsFile) std::setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+    if (!Pnm::writeHeader(file, header)) {
+        if (ownsFile) {
+            std::fclose(file);
+            std::remove(partial.c_str());
+        }
+        throw std::runtime_error("cannot write " + path);
+    }
+}
+
+StripWriter::~StripWriter() {
+    if (!ownsFile) {
+        std::fflush(file);
+    } else if (file) {
+        // finish() was not reached
+        std::fclose(file);
+        std::remove(partial.c_str());
+    }
+}
+
+void StripWriter::write(const Image& strip) {
+    Trace::Zone zone("StripWriter::write");
+    if (strip.getWidth() != header.width || strip.getChannels() != header.channels ||
+        rowsWritten + strip.getHeight() > header.height) {
+        throw std::runtime_error("strip does not fit the output image");
+    }
+    size_t size = strip.getByteSize();
+    if (std::fwrite(strip.getData(), 1, size, file) != size) {
+        throw std::runtime_error("write failed at row " + std::to_string(rowsWritten));
+    }
+    rowsWritten += strip.getHeight();
+}
+
+void StripWriter::finish() {
+    if (rowsWritten != header.height) {
+        throw std::runtime_error("output has " + std::to_string(rowsWritten) + " of " + std::to_string(header.height) + " rows");
+    }
+    if (std::fflush(file) != 0) throw std::runtime_error("write failed");
+    if (!ownsFile) return;
+
+    int closed = std::fclose(file);
+    file = nullptr;
+    std::error_code ec;
+    if (closed == 0) std::filesystem::rename(partial, path, ec);
+    if (closed != 0 || ec) {
+        std::remove(partial.c_str());
+        throw std::runtime_error("cannot write " + path);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "Image.h"
+#include "Pnm.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Bands of rows of binary PGM/PPM/PAM files, for images too large to hold in memory. Pixels are
+// stored uncompressed and row by row there, so any strip can be read or written on its own.
+
+class StripReader {
+public:
+    // "-" reads stdin, which allows a single pass only. Throws std::runtime_error when the file
+    // cannot be opened or its header is not a binary 8-bit PNM one.
+    explicit StripReader(const std::string& path);
+    ~StripReader();
+
+    StripReader(const StripReader&) = delete;
+    StripReader& operator=(const StripReader&) = delete;
+
+    const Pnm::Header& getHeader() const { return header; }
+    int getWidth() const { return header.width; }
+    int getHeight() const { return header.height; }
+    int getChannels() const { return header.channels; }
+    bool isSeekable() const { return seekable; }
+
+    // Reads the next (at most) `rows` rows into `strip`, reusing its buffer; returns the number of
+    // rows read, 0 after the last one. Throws std::runtime_error for a truncated file.
+    int read(Image& strip, int rows);
+    // Starts over at the first row for another pass; throws when the input is not seekable
+    void rewind();
+
+private:
+    FILE* file;
+    bool ownsFile;
+    bool seekable;
+    Pnm::Header header;
+    int64_t dataOffset;
+    int nextRow;
+    std::vector<char> buffer;
+};
+
+class StripWriter {
+public:
+    // "-" writes stdout. Writes the header right away; throws std::runtime_error on failure. A file
+    // is written under a temporary name and only replaces `path` in finish(), so `path` may also be
+    // the file being read.
+    StripWriter(const std::string& path, const Pnm::Header& header);
+    ~StripWriter();
+
+    StripWriter(const StripWriter&) = delete;
+    StripWriter& operator=(const StripWriter&) = delete;
+
+    // Appends the rows of `strip`, which must have the width and channels of the header
+    void write(const Image& strip);
+    // Checks that every row was written, flushes and moves the file into place; throws
+    // std::runtime_error otherwise. Without it the temporary file is removed.
+    void finish();
+
+private:
+    FILE* file;
+    bool ownsFile;
+    std::string path;
+    std::string partial;
+    Pnm::Header header;
+    int rowsWritten;
+    std::vector<char> buffer;
+};
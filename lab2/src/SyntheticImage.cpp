@@ -0,0 +1,216 @@
+#include "SyntheticImage.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    uint64_t splitMix(uint64_t x) {
+        x += 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    // xorshift64*
+    struct RowRandom {
+        uint64_t state;
+
+        RowRandom(uint64_t seed, int row) : state(splitMix(seed ^ splitMix(static_cast<uint64_t>(row))) | 1) {}
+
+        uint64_t next() {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            return state * 0x2545F4914F6CDD1Dull;
+        }
+    };
+
+    // Values of a clamped normal distribution indexed by a uniform 16-bit draw (inverse CDF), so
+    // a 64-bit draw gives four channels with one lookup each
+    using NormalTable = std::array<unsigned char, 65536>;
+
+    NormalTable normalTable(double mean, double sigma) {
+        NormalTable table;
+        size_t filled = 0;
+        for (int v = 0; v < 256; v++) {
+            double cdf = v == 255 ? 1.0 : 0.5 * std::erfc(-(v + 0.5 - mean) / (sigma * std::sqrt(2.0)));
+            size_t end = static_cast<size_t>(std::lround(cdf * table.size()));
+            for (; filled < end; filled++) {
+                table[filled] = static_cast<unsigned char>(v);
+            }
+        }
+        return table;
+    }
+
+    const NormalTable& normal128() {
+        static const NormalTable table = normalTable(128.0, 32.0);
+        return table;
+    }
+    const NormalTable& normal64() {
+        static const NormalTable table = normalTable(64.0, 16.0);
+        return table;
+    }
+    const NormalTable& normal192() {
+        static const NormalTable table = normalTable(192.0, 16.0);
+        return table;
+    }
+
+    // Channels of the noise patterns are independent, so a row is filled as one stream of bytes
+    // and every 64-bit draw is used up: eight uniform bytes, or four 16-bit table indices.
+    void fillUniform(RowRandom& random, unsigned char* out, size_t count) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            uint64_t bits = random.next();
+            std::memcpy(out + i, &bits, 8);
+        }
+        uint64_t bits = random.next();
+        for (; i < count; i++, bits >>= 8) {
+            out[i] = static_cast<unsigned char>(bits);
+        }
+    }
+
+    void fillNormal(RowRandom& random, const NormalTable& table, unsigned char* out, size_t count) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            uint64_t bits = random.next();
+            out[i] = table[bits & 0xFFFF];
+            out[i + 1] = table[(bits >> 16) & 0xFFFF];
+            out[i + 2] = table[(bits >> 32) & 0xFFFF];
+            out[i + 3] = table[bits >> 48];
+        }
+        uint64_t bits = random.next();
+        for (; i < count; i++, bits >>= 16) {
+            out[i] = table[bits & 0xFFFF];
+        }
+    }
+
+    // Channel c ramps like channel c % 3: horizontal, vertical, diagonal
+    template <int Channels>
+    void gradientRow(const std::vector<unsigned char>& ramp, unsigned char vertical, int width, unsigned char* row) {
+        for (int x = 0; x < width; x++) {
+            unsigned char horizontal = ramp[x];
+            unsigned char diagonal = static_cast<unsigned char>((horizontal + vertical) / 2);
+            const unsigned char pixel[4] = {horizontal, vertical, diagonal, horizontal};
+            std::memcpy(row + static_cast<size_t>(x) * Channels, pixel, Channels);
+        }
+    }
+
+    void gradientRow(const std::vector<unsigned char>& ramp, unsigned char vertical, int width, int channels, unsigned char* row) {
+        for (int x = 0; x < width; x++) {
+            unsigned char horizontal = ramp[x];
+            unsigned char diagonal = static_cast<unsigned char>((horizontal + vertical) / 2);
+            const unsigned char pixel[3] = {horizontal, vertical, diagonal};
+            unsigned char* out = row + static_cast<size_t>(x) * channels;
+            for (int c = 0; c < channels; c++) {
+                out[c] = pixel[c % 3];
+            }
+        }
+    }
+
+    void fillRow(SyntheticImage::Pattern pattern, int y, int width, int height, int channels, uint64_t seed,
+                 const std::vector<unsigned char>& ramp, unsigned char* row) {
+        using Pattern = SyntheticImage::Pattern;
+        RowRandom random(seed, y);
+        const size_t rowBytes = static_cast<size_t>(width) * channels;
+
+        switch (pattern) {
+        case Pattern::Gradient: {
+            unsigned char vertical = static_cast<unsigned char>(height > 1 ? y * 255 / (height - 1) : 0);
+            switch (channels) {
+            case 1: std::memcpy(row, ramp.data(), width); break;
+            case 2: gradientRow<2>(ramp, vertical, width, row); break;
+            case 3: gradientRow<3>(ramp, vertical, width, row); break;
+            case 4: gradientRow<4>(ramp, vertical, width, row); break;
+            default: gradientRow(ramp, vertical, width, channels, row); break;
+            }
+            break;
+        }
+
+        case Pattern::UniformNoise:
+            fillUniform(random, row, rowBytes);
+            break;
+
+        case Pattern::GaussianNoise:
+            fillNormal(random, normal128(), row, rowBytes);
+            break;
+
+        case Pattern::Bimodal:
+            // Runs of 48 pixels, alternating dark, dark, bright and shifted by one every 48 rows
+            for (int x = 0; x < width; x += 48) {
+                int run = std::min(48, width - x);
+                const NormalTable& table = (x / 48 + y / 48) % 3 == 0 ? normal192() : normal64();
+                fillNormal(random, table, row + static_cast<size_t>(x) * channels, static_cast<size_t>(run) * channels);
+            }
+            break;
+
+        case Pattern::Checkerboard:
+            for (int x = 0; x < width; x += 32) {
+                int run = std::min(32, width - x);
+                unsigned char value = ((x >> 5) ^ (y >> 5)) & 1 ? 255 : 0;
+                std::memset(row + static_cast<size_t>(x) * channels, value, static_cast<size_t>(run) * channels);
+            }
+            break;
+
+        case Pattern::NearConstant:
+            fillUniform(random, row, rowBytes);
+            for (size_t i = 0; i < rowBytes; i++) {
+                row[i] = static_cast<unsigned char>(127 + ((row[i] * 3) >> 8));
+            }
+            break;
+        }
+    }
+}
+
+Image SyntheticImage::generate(Pattern pattern, int width, int height, int channels, uint64_t seed) {
+    Image image;
+    generate(pattern, width, height, channels, seed, image);
+    return image;
+}
+
+void SyntheticImage::generate(Pattern pattern, int width, int height, int channels, uint64_t seed, Image& image) {
+    image.resize(width, height, channels);
+    unsigned char* data = image.getData();
+    if (!data) return;
+
+    std::vector<unsigned char> ramp(width);
+    for (int x = 0; x < width; x++) {
+        ramp[x] = static_cast<unsigned char>(width > 1 ? x * 255 / (width - 1) : 0);
+    }
+
+    const size_t stride = static_cast<size_t>(width) * channels;
+    parallelFor(0, height, [&](int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; y++) {
+            fillRow(pattern, y, width, height, channels, seed, ramp, data + y * stride);
+        }
+    });
+    image.updateTexture();
+}
+
+std::vector<SyntheticImage::Pattern> SyntheticImage::patterns() {
+    return {Pattern::Gradient, Pattern::UniformNoise, Pattern::GaussianNoise,
+            Pattern::Checkerboard, Pattern::Bimodal, Pattern::NearConstant};
+}
+
+std::string SyntheticImage::name(Pattern pattern) {
+    switch (pattern) {
+    case Pattern::Gradient: return "gradient";
+    case Pattern::UniformNoise: return "noise";
+    case Pattern::GaussianNoise: return "gaussian";
+    case Pattern::Checkerboard: return "checkerboard";
+    case Pattern::Bimodal: return "bimodal";
+    case Pattern::NearConstant: return "constant";
+    }
+    return "";
+}
+
+bool SyntheticImage::parse(const std::string& text, Pattern& pattern) {
+    for (Pattern candidate : patterns()) {
+        if (name(candidate) == text) {
+            pattern = candidate;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "Image.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Reproducible test images of any size for benchmarks and comparisons. Every row draws from its own
+// generator seeded by (seed, row), so the pixels depend only on the seed and the dimensions, never on
+// how many threads filled them.
+class SyntheticImage {
+public:
+    enum class Pattern {
+        // Channel 0 ramps left to right, 1 top to bottom, 2 diagonally
+        Gradient,
+        // Independent uniform values in every channel
+        UniformNoise,
+        // Mean 128, standard deviation 32, clamped
+        GaussianNoise,
+        // 32-pixel black and white squares
+        Checkerboard,
+        // Dark (64) background with bright (192) blocks covering a third of the image, both with
+        // noise: two well separated histogram peaks of unequal weight for otsu and triangle
+        Bimodal,
+        // 128 +- 1: all pixels fall into three histogram bins
+        NearConstant,
+    };
+
+    static Image generate(Pattern pattern, int width, int height, int channels, uint64_t seed = 1);
+    // Same, reusing the buffer of `image` when the size matches
+    static void generate(Pattern pattern, int width, int height, int channels, uint64_t seed, Image& image);
+
+    static std::vector<Pattern> patterns();
+    static std::string name(Pattern pattern);
+    // False for an unknown name
+    static bool parse(const std::string& name, Pattern& pattern);
+};
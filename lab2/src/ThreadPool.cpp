@@ -0,0 +1,65 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+ThreadPool::ThreadPool(int threadCount) : active(0), stopping(false) {
+    for (int i = 0; i < std::max(1, threadCount); i++) {
+        threads.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    taskAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return tasks.empty() && active == 0; });
+}
+
+void ThreadPool::workerLoop() {
+    Trace::setThreadName("pool worker");
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) return;
+
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            active++;
+        }
+
+        try {
+            task();
+        } catch (const std::exception& e) {
+            std::cerr << "Task failed: " << e.what() << std::endl;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        active--;
+        if (tasks.empty() && active == 0) {
+            idle.notify_all();
+        }
+    }
+}
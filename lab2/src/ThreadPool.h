@@ -0,0 +1,36 @@
+#pragma once
+#include "Parallel.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running queued tasks in submission order.
+class ThreadPool {
+public:
+    explicit ThreadPool(int threadCount = hardwareThreads());
+    // Finishes the queued tasks before returning.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    // Blocks until every submitted task, including ones submitted by tasks, has finished.
+    void wait();
+
+    int getThreadCount() const { return static_cast<int>(threads.size()); }
+
+private:
+    void workerLoop();
+
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable idle;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::thread> threads;
+    int active;
+    bool stopping;
+};
@@ -1,41 +1,76 @@
 #include "ThresholdProcessing.h"
+#include "Cancellation.h"
+#include "Kernels.h"
+#include "Trace.h"
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <mutex>
+#include <vector>
+
+namespace {
+    // Intensities of row y: the weighted sum of R, G and B, or channel 0 of gray images
+    void rowIntensity(const Image& img, int y, unsigned char* out) {
+        int width = img.getWidth();
+        int channels = img.getChannels();
+        const unsigned char* row = img.getData() + y * static_cast<size_t>(width) * channels;
+        if (channels >= 3) {
+            Kernels::active().intensity(row, channels, out, static_cast<size_t>(width));
+            return;
+        }
+        for (int x = 0; x < width; x++) {
+            out[x] = row[x * channels];
+        }
+    }
+}
 
-std::array<int, 256> ThresholdProcessing::computeHistogram(const Image& img) {
-    std::array<int, 256> hist = {0};
-    
-    for (int y = 0; y < img.getHeight(); y++) {
-        for (int x = 0; x < img.getWidth(); x++) {
-            if (img.getChannels() >= 3) {
-                glm::vec3 rgb = img.getPixelRGB(x, y);
-                int intensity = static_cast<int>((0.299f * rgb.r + 0.587f * rgb.g + 0.114f * rgb.b) * 255);
-                intensity = glm::clamp(intensity, 0, 255);
-                hist[intensity]++;
-            } else {
-                hist[img.getPixel(x, y, 0)]++;
+Histogram::Counts ThresholdProcessing::computeHistogram(const Image& img) {
+    Trace::Zone zone("ThresholdProcessing::computeHistogram");
+    Histogram::Counts hist = {0};
+    if (!img.getData()) return hist;
+
+    // Each band counts into its own histogram and adds it to the total at the end
+    std::mutex histMutex;
+    Kernels::forRows(img.getHeight(), [&](int rowBegin, int rowEnd) {
+        Histogram::Counts bandHist = {0};
+        std::vector<unsigned char> intensity(img.getWidth());
+        for (int y = rowBegin; y < rowEnd; y++) {
+            Cancellation::checkpoint(y - rowBegin, rowEnd - rowBegin);
+            rowIntensity(img, y, intensity.data());
+            for (unsigned char value : intensity) {
+                bandHist[value]++;
             }
         }
-    }
+        std::lock_guard<std::mutex> lock(histMutex);
+        for (int i = 0; i < 256; i++) hist[i] += bandHist[i];
+    });
     
     return hist;
 }
 
 unsigned char ThresholdProcessing::calculateOtsuThreshold(const Image& img) {
-    auto hist = computeHistogram(img);
-    int totalPixels = img.getWidth() * img.getHeight();
+    Trace::Zone zone("ThresholdProcessing::calculateOtsuThreshold");
+    return calculateOtsuThreshold(computeHistogram(img));
+}
+
+unsigned char ThresholdProcessing::calculateOtsuThreshold(const Histogram::Counts& hist) {
+    uint64_t totalPixels = 0;
+    for (uint64_t count : hist) {
+        totalPixels += count;
+    }
     
-    float sum = 0;
+    // In double: float stops resolving single pixels past 2^24 of them, and the integer product
+    // of the class weights overflows
+    double sum = 0;
     for (int i = 0; i < 256; i++) {
-        sum += i * hist[i];
+        sum += static_cast<double>(i) * hist[i];
     }
     
-    float sumB = 0;
-    int wB = 0;
-    int wF = 0;
+    double sumB = 0;
+    uint64_t wB = 0;
+    uint64_t wF = 0;
     
-    float maxVariance = 0;
+    double maxVariance = 0;
     unsigned char threshold = 0;
     
     for (int t = 0; t < 256; t++) {
@@ -45,12 +80,11 @@ unsigned char ThresholdProcessing::calculateOtsuThreshold(const Image& img) {
         wF = totalPixels - wB;
         if (wF == 0) break;
 
-        sumB += t * hist[t];
+        sumB += static_cast<double>(t) * hist[t];
 
-        float mB = sumB / wB;
-        float mF = (sum - sumB) / wF;
-
-        float variance = wB * wF * (mB - mF) * (mB - mF);
+        double mB = sumB / wB;
+        double mF = (sum - sumB) / wF;
+        double variance = static_cast<double>(wB) * static_cast<double>(wF) * (mB - mF) * (mB - mF);
         
         if (variance > maxVariance) {
             maxVariance = variance;
@@ -62,15 +96,20 @@ unsigned char ThresholdProcessing::calculateOtsuThreshold(const Image& img) {
 }
 
 Image ThresholdProcessing::otsuThreshold(const Image& img) {
+    Trace::Zone zone("ThresholdProcessing::otsuThreshold");
     unsigned char threshold = calculateOtsuThreshold(img);
     return fixedThreshold(img, threshold);
 }
 
 unsigned char ThresholdProcessing::calculateTriangleThreshold(const Image& img) {
-    auto hist = computeHistogram(img);
+    Trace::Zone zone("ThresholdProcessing::calculateTriangleThreshold");
+    return calculateTriangleThreshold(computeHistogram(img));
+}
+
+unsigned char ThresholdProcessing::calculateTriangleThreshold(const Histogram::Counts& hist) {
 
     int maxIdx = 0;
-    int maxVal = hist[0];
+    uint64_t maxVal = hist[0];
     for (int i = 1; i < 256; i++) {
         if (hist[i] > maxVal) {
             maxVal = hist[i];
@@ -100,15 +139,15 @@ unsigned char ThresholdProcessing::calculateTriangleThreshold(const Image& img)
     float maxDistance = 0;
     int threshold = maxIdx;
 
+    // Signed 64-bit: products of counts and bin distances overflow int on large images
+    int64_t dx = lineEnd - lineStart;
+    int64_t dy = static_cast<int64_t>(maxVal) - static_cast<int64_t>(hist[lineStart]);
+    float length = std::sqrt(static_cast<float>(static_cast<double>(dx) * dx + static_cast<double>(dy) * dy));
+
     for (int i = std::min(lineStart, lineEnd); i <= std::max(lineStart, lineEnd); i++) {
-        float distance = std::abs(
-            static_cast<float>((lineEnd - lineStart) * hist[i] - 
-            (maxVal - hist[lineStart]) * (i - lineStart) - 
-            (lineEnd - lineStart) * hist[lineStart])
-        ) / std::sqrt(
-            static_cast<float>((lineEnd - lineStart) * (lineEnd - lineStart) + 
-            (maxVal - hist[lineStart]) * (maxVal - hist[lineStart]))
-        );
+        float distance = std::abs(static_cast<float>(
+            dx * static_cast<int64_t>(hist[i]) - dy * (i - lineStart) - dx * static_cast<int64_t>(hist[lineStart])
+        )) / length;
         
         if (distance > maxDistance) {
             maxDistance = distance;
@@ -120,74 +159,70 @@ unsigned char ThresholdProcessing::calculateTriangleThreshold(const Image& img)
 }
 
 Image ThresholdProcessing::triangleThreshold(const Image& img) {
+    Trace::Zone zone("ThresholdProcessing::triangleThreshold");
     unsigned char threshold = calculateTriangleThreshold(img);
     return fixedThreshold(img, threshold);
 }
 
 Image ThresholdProcessing::fixedThreshold(const Image& img, unsigned char threshold) {
-    Image result = img.clone();
-    
-    for (int y = 0; y < img.getHeight(); y++) {
-        for (int x = 0; x < img.getWidth(); x++) {
-            unsigned char intensity;
-            
-            if (img.getChannels() >= 3) {
-                glm::vec3 rgb = img.getPixelRGB(x, y);
-                intensity = static_cast<unsigned char>((0.299f * rgb.r + 0.587f * rgb.g + 0.114f * rgb.b) * 255);
-            } else {
-                intensity = img.getPixel(x, y, 0);
-            }
-            
-            unsigned char value = (intensity >= threshold) ? 255 : 0;
-
-            for (int c = 0; c < img.getChannels(); c++) {
-                result.setPixel(x, y, c, value);
-            }
+    Trace::Zone zone("ThresholdProcessing::fixedThreshold");
+    if (!img.getData()) return img.clone();
+    Image result(img.getWidth(), img.getHeight(), img.getChannels());
+
+    const Kernels::Table& kernels = Kernels::active();
+    int width = img.getWidth();
+    size_t rowSize = static_cast<size_t>(width) * img.getChannels();
+    Kernels::forRows(img.getHeight(), [&](int rowBegin, int rowEnd) {
+        std::vector<unsigned char> values(width);
+        for (int y = rowBegin; y < rowEnd; y++) {
+            Cancellation::checkpoint(y - rowBegin, rowEnd - rowBegin);
+            rowIntensity(img, y, values.data());
+            kernels.threshold(values.data(), values.data(), values.size(), threshold);
+            kernels.broadcast(values.data(), img.getChannels(), result.getData() + y * rowSize, values.size());
         }
-    }
+    });
     
     result.updateTexture();
     return result;
 }
 
 Image ThresholdProcessing::doubleThreshold(const Image& img, unsigned char lowThreshold, unsigned char highThreshold) {
-    Image result = img.clone();
-    
-    for (int y = 0; y < img.getHeight(); y++) {
-        for (int x = 0; x < img.getWidth(); x++) {
-            unsigned char intensity;
-            
-            if (img.getChannels() >= 3) {
-                glm::vec3 rgb = img.getPixelRGB(x, y);
-                intensity = static_cast<unsigned char>((0.299f * rgb.r + 0.587f * rgb.g + 0.114f * rgb.b) * 255);
-            } else {
-                intensity = img.getPixel(x, y, 0);
-            }
-            
-            unsigned char value;
-            if (intensity >= highThreshold) {
-                value = 255;
-            } else if (intensity >= lowThreshold) {
-                value = 128;
-            } else {
-                value = 0;
-            }
-            
-            for (int c = 0; c < img.getChannels(); c++) {
-                result.setPixel(x, y, c, value);
+    Trace::Zone zone("ThresholdProcessing::doubleThreshold");
+    if (!img.getData()) return img.clone();
+    Image result(img.getWidth(), img.getHeight(), img.getChannels());
+
+    const Kernels::Table& kernels = Kernels::active();
+    int width = img.getWidth();
+    size_t rowSize = static_cast<size_t>(width) * img.getChannels();
+    Kernels::forRows(img.getHeight(), [&](int rowBegin, int rowEnd) {
+        std::vector<unsigned char> values(width);
+        for (int y = rowBegin; y < rowEnd; y++) {
+            Cancellation::checkpoint(y - rowBegin, rowEnd - rowBegin);
+            rowIntensity(img, y, values.data());
+            for (unsigned char& value : values) {
+                if (value >= highThreshold) {
+                    value = 255;
+                } else if (value >= lowThreshold) {
+                    value = 128;
+                } else {
+                    value = 0;
+                }
             }
+            kernels.broadcast(values.data(), img.getChannels(), result.getData() + y * rowSize, values.size());
         }
-    }
+    });
     
     result.updateTexture();
     return result;
 }
 
 float ThresholdProcessing::calculateImageIntensity(const Image& img) {
+    Trace::Zone zone("ThresholdProcessing::calculateImageIntensity");
     float sum = 0;
-    int count = img.getWidth() * img.getHeight();
+    uint64_t count = static_cast<uint64_t>(img.getWidth()) * img.getHeight();
     
     for (int y = 0; y < img.getHeight(); y++) {
+        Cancellation::checkpoint(y, img.getHeight());
         for (int x = 0; x < img.getWidth(); x++) {
             if (img.getChannels() >= 3) {
                 glm::vec3 rgb = img.getPixelRGB(x, y);
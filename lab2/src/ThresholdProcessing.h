@@ -1,4 +1,5 @@
 #pragma once
+#include "Histogram.h"
 #include "Image.h"
 #include <array>
 
@@ -6,13 +7,15 @@ class ThresholdProcessing {
 public:
     static Image otsuThreshold(const Image& img);
     static unsigned char calculateOtsuThreshold(const Image& img);
+    static unsigned char calculateOtsuThreshold(const Histogram::Counts& hist);
 
     static Image triangleThreshold(const Image& img);
     static unsigned char calculateTriangleThreshold(const Image& img);
+    static unsigned char calculateTriangleThreshold(const Histogram::Counts& hist);
 
     static Image fixedThreshold(const Image& img, unsigned char threshold);
     static Image doubleThreshold(const Image& img, unsigned char lowThreshold, unsigned char highThreshold);
-    static std::array<int, 256> computeHistogram(const Image& img);
+    static Histogram::Counts computeHistogram(const Image& img);
 
 private:
     static float calculateImageIntensity(const Image& img);
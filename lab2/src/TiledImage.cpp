@@ -0,0 +1,109 @@
+#include "TiledImage.h"
+#include "Cancellation.h"
+#include "Kernels.h"
+#include <algorithm>
+#include <cstring>
+
+TiledImage::TiledImage() : width(0), height(0), channels(0), tileSize(kDefaultTileSize), tilesX(0), tilesY(0) {}
+
+TiledImage::TiledImage(int w, int h, int c, int size)
+    : width(w), height(h), channels(c), tileSize(std::max(1, size)),
+      tilesX((w + tileSize - 1) / tileSize), tilesY((h + tileSize - 1) / tileSize),
+      data(static_cast<size_t>(tilesX) * tilesY * tileSize * tileSize * c) {}
+
+TiledImage TiledImage::fromImage(const Image& img, int tileSize) {
+    TiledImage tiled(img.getWidth(), img.getHeight(), img.getChannels(), tileSize);
+    const unsigned char* src = img.getData();
+    if (!src) return tiled;
+
+    int size = tiled.tileSize;
+    size_t stride = img.getStride();
+    size_t tileStride = tiled.getTileStride();
+    Kernels::forRows(tiled.tilesY, [&](int tileBegin, int tileEnd) {
+        for (int tileY = tileBegin; tileY < tileEnd; tileY++) {
+            Cancellation::checkpoint(tileY - tileBegin, tileEnd - tileBegin);
+            int rows = std::min(size, tiled.height - tileY * size);
+            for (int tileX = 0; tileX < tiled.tilesX; tileX++) {
+                int x0 = tileX * size;
+                size_t bytes = static_cast<size_t>(std::min(size, tiled.width - x0)) * tiled.channels;
+                unsigned char* tile = tiled.getTile(tileX, tileY);
+                for (int row = 0; row < rows; row++) {
+                    const unsigned char* line = src + static_cast<size_t>(tileY * size + row) * stride;
+                    std::memcpy(tile + row * tileStride, line + static_cast<size_t>(x0) * tiled.channels, bytes);
+                }
+            }
+        }
+    });
+    return tiled;
+}
+
+Image TiledImage::toImage() const {
+    Image result;
+    toImage(result);
+    return result;
+}
+
+void TiledImage::toImage(Image& result) const {
+    result.resize(width, height, channels);
+    unsigned char* dst = result.getData();
+    if (!dst || data.empty()) return;
+
+    size_t stride = result.getStride();
+    size_t tileStride = getTileStride();
+    Kernels::forRows(tilesY, [&](int tileBegin, int tileEnd) {
+        for (int tileY = tileBegin; tileY < tileEnd; tileY++) {
+            Cancellation::checkpoint(tileY - tileBegin, tileEnd - tileBegin);
+            int rows = std::min(tileSize, height - tileY * tileSize);
+            for (int row = 0; row < rows; row++) {
+                unsigned char* line = dst + static_cast<size_t>(tileY * tileSize + row) * stride;
+                for (int tileX = 0; tileX < tilesX; tileX++) {
+                    int x0 = tileX * tileSize;
+                    size_t bytes = static_cast<size_t>(std::min(tileSize, width - x0)) * channels;
+                    std::memcpy(line + static_cast<size_t>(x0) * channels, getTile(tileX, tileY) + row * tileStride, bytes);
+                }
+            }
+        }
+    });
+    result.updateTexture();
+}
+
+unsigned char TiledImage::getPixel(int x, int y, int channel) const {
+    if (x < 0 || x >= width || y < 0 || y >= height || channel < 0 || channel >= channels) return 0;
+    const unsigned char* tile = getTile(x / tileSize, y / tileSize);
+    return tile[(y % tileSize) * getTileStride() + (x % tileSize) * channels + channel];
+}
+
+void TiledImage::setPixel(int x, int y, int channel, unsigned char value) {
+    if (x < 0 || x >= width || y < 0 || y >= height || channel < 0 || channel >= channels) return;
+    unsigned char* tile = getTile(x / tileSize, y / tileSize);
+    tile[(y % tileSize) * getTileStride() + (x % tileSize) * channels + channel] = value;
+}
+
+void TiledImage::readRegion(int x, int y, int w, int h, unsigned char fill, unsigned char* out) const {
+    size_t rowBytes = static_cast<size_t>(w) * channels;
+    size_t tileStride = getTileStride();
+    // Columns of the region inside the image
+    int begin = std::clamp(x, 0, width);
+    int end = std::clamp(x + w, 0, width);
+
+    for (int row = 0; row < h; row++) {
+        unsigned char* dst = out + row * rowBytes;
+        int sy = y + row;
+        if (sy < 0 || sy >= height || begin >= end) {
+            std::memset(dst, fill, rowBytes);
+            continue;
+        }
+
+        std::memset(dst, fill, static_cast<size_t>(begin - x) * channels);
+        const size_t offsetY = (sy % tileSize) * tileStride;
+        for (int sx = begin; sx < end;) {
+            int inX = sx % tileSize;
+            int run = std::min(end - sx, tileSize - inX);
+            std::memcpy(dst + static_cast<size_t>(sx - x) * channels,
+                        getTile(sx / tileSize, sy / tileSize) + offsetY + static_cast<size_t>(inX) * channels,
+                        static_cast<size_t>(run) * channels);
+            sx += run;
+        }
+        std::memset(dst + static_cast<size_t>(end - x) * channels, fill, static_cast<size_t>(x + w - end) * channels);
+    }
+}
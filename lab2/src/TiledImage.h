@@ -0,0 +1,56 @@
+#pragma once
+#include "Image.h"
+#include <cstddef>
+#include <vector>
+
+// Pixels in square tiles, each stored contiguously row by row and the tiles themselves row by row.
+// Work that walks down columns (the vertical pass of a separable filter) then stays inside a few KB
+// instead of striding across whole image rows, which for wide images evicts every line it touched
+// before the next column needs it. Edge tiles are stored full size; what lies past the image in them
+// is unspecified. Convert with fromImage() and toImage(); nothing else in the program reads tiles.
+class TiledImage {
+public:
+    static constexpr int kDefaultTileSize = 64;
+
+    TiledImage();
+    TiledImage(int width, int height, int channels, int tileSize = kDefaultTileSize);
+
+    static TiledImage fromImage(const Image& img, int tileSize = kDefaultTileSize);
+    Image toImage() const;
+    // Same, writing into `result` and reusing its buffer when the byte size matches
+    void toImage(Image& result) const;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getChannels() const { return channels; }
+    int getTileSize() const { return tileSize; }
+    int getTilesX() const { return tilesX; }
+    int getTilesY() const { return tilesY; }
+    // Bytes per tile row and per tile
+    size_t getTileStride() const { return static_cast<size_t>(tileSize) * channels; }
+    size_t getTileBytes() const { return getTileStride() * tileSize; }
+    size_t getByteSize() const { return data.size(); }
+
+    unsigned char* getTile(int tileX, int tileY) {
+        return data.data() + (static_cast<size_t>(tileY) * tilesX + tileX) * getTileBytes();
+    }
+    const unsigned char* getTile(int tileX, int tileY) const {
+        return data.data() + (static_cast<size_t>(tileY) * tilesX + tileX) * getTileBytes();
+    }
+
+    unsigned char getPixel(int x, int y, int channel) const;
+    void setPixel(int x, int y, int channel, unsigned char value);
+
+    // Copies the pixels of [x, x + w) x [y, y + h) into `out`, `w * channels` bytes per row; pixels
+    // outside the image read as `fill`. Neighbourhood operations fetch a tile with its halo this way.
+    void readRegion(int x, int y, int w, int h, unsigned char fill, unsigned char* out) const;
+
+private:
+    int width;
+    int height;
+    int channels;
+    int tileSize;
+    int tilesX;
+    int tilesY;
+    std::vector<unsigned char> data;
+};
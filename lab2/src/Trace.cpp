@@ -0,0 +1,175 @@
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Trace::enabled{true};
+
+namespace {
+    // One per live thread. parallelFor starts new threads on every call, so a buffer is handed to
+    // the next new thread when its owner exits instead of growing one buffer per thread ever created;
+    // the track then continues with the new owner.
+    struct ThreadBuffer {
+        int id = 0;
+        bool inUse = false;
+        std::string name;
+        // Locked by the owner for every event and by clear/export, so practically never contended
+        std::mutex mutex;
+        std::vector<Trace::Event> events;
+        uint64_t written = 0;
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    };
+
+    // Never destroyed: threads may still record while static objects are torn down at exit
+    Registry& registry() {
+        static Registry* instance = new Registry();
+        return *instance;
+    }
+
+    struct ThreadSlot {
+        ThreadBuffer* buffer = nullptr;
+
+        ~ThreadSlot() {
+            if (!buffer) return;
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            buffer->inUse = false;
+        }
+    };
+
+    thread_local ThreadSlot slot;
+
+    ThreadBuffer& threadBuffer() {
+        if (slot.buffer) return *slot.buffer;
+
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (auto& buffer : reg.buffers) {
+            if (!buffer->inUse) {
+                slot.buffer = buffer.get();
+                break;
+            }
+        }
+        if (!slot.buffer) {
+            auto buffer = std::make_unique<ThreadBuffer>();
+            buffer->id = static_cast<int>(reg.buffers.size()) + 1;
+            buffer->events.resize(Trace::kEventsPerThread);
+            slot.buffer = buffer.get();
+            reg.buffers.push_back(std::move(buffer));
+        }
+        slot.buffer->inUse = true;
+        return *slot.buffer;
+    }
+
+    void writeEscaped(std::ostream& out, const std::string& text) {
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out << '\\' << c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out << escaped;
+            } else {
+                out << c;
+            }
+        }
+    }
+
+    // Microseconds with nanosecond precision, as the trace event format expects
+    void writeMicroseconds(std::ostream& out, uint64_t nanoseconds) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%llu.%03llu",
+                      static_cast<unsigned long long>(nanoseconds / 1000),
+                      static_cast<unsigned long long>(nanoseconds % 1000));
+        out << text;
+    }
+}
+
+void Trace::record(const char* name, uint64_t start, uint64_t end) {
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events[buffer.written % kEventsPerThread] = {name, start, end};
+    buffer.written++;
+}
+
+void Trace::setThreadName(const std::string& name) {
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.name = name;
+}
+
+void Trace::clear() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (auto& buffer : reg.buffers) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        buffer->written = 0;
+    }
+}
+
+void Trace::writeChrome(std::ostream& out) {
+    struct Track {
+        int id;
+        std::string name;
+        std::vector<Event> events;
+    };
+
+    // Copy out under the locks, format afterwards
+    std::vector<Track> tracks;
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (auto& buffer : reg.buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            Track track{buffer->id, buffer->name, {}};
+            uint64_t count = std::min<uint64_t>(buffer->written, kEventsPerThread);
+            for (uint64_t i = buffer->written - count; i < buffer->written; i++) {
+                track.events.push_back(buffer->events[i % kEventsPerThread]);
+            }
+            tracks.push_back(std::move(track));
+        }
+    }
+
+    // Timestamps relative to the first event keep the numbers short
+    uint64_t origin = UINT64_MAX;
+    for (const auto& track : tracks) {
+        for (const auto& event : track.events) origin = std::min(origin, event.start);
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto separator = [&]() {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+    for (const auto& track : tracks) {
+        separator();
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track.id << ",\"args\":{\"name\":\"";
+        writeEscaped(out, track.name.empty() ? "thread " + std::to_string(track.id) : track.name);
+        out << "\"}}";
+        for (const auto& event : track.events) {
+            separator();
+            out << "{\"name\":\"";
+            writeEscaped(out, event.name);
+            out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << track.id << ",\"ts\":";
+            writeMicroseconds(out, event.start - origin);
+            out << ",\"dur\":";
+            writeMicroseconds(out, event.end - event.start);
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+}
+
+bool Trace::exportChrome(const std::string& path) {
+    std::ofstream file(path);
+    if (!file) return false;
+    writeChrome(file);
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Timeline of scoped zones for chrome://tracing and ui.perfetto.dev. Every thread appends to its own
+// ring buffer, so recording never contends with other threads and memory stays bounded: a thread keeps
+// its last kEventsPerThread zones. Recording is on by default: a zone costs two clock reads and an
+// uncontended lock, negligible next to any operation on a whole image.
+//
+//   void Image::save(...) {
+//       Trace::Zone zone("Image::save");
+//       ...
+//   }
+class Trace {
+public:
+    static constexpr size_t kEventsPerThread = 16384;
+
+    struct Event {
+        // Must outlive the trace: a string literal
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    class Zone {
+    public:
+        explicit Zone(const char* name) : name(isEnabled() ? name : nullptr), start(this->name ? now() : 0) {}
+        ~Zone() {
+            if (name) record(name, start, now());
+        }
+
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+    private:
+        const char* name;
+        uint64_t start;
+    };
+
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+
+    // Nanoseconds on the steady clock
+    static uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static void record(const char* name, uint64_t start, uint64_t end);
+    // Track name of the calling thread in the exported trace; unnamed threads show as "thread N"
+    static void setThreadName(const std::string& name);
+
+    // Drops every recorded event
+    static void clear();
+    // Chrome trace event format (JSON object with "traceEvents"), which Perfetto also loads
+    static void writeChrome(std::ostream& out);
+    static bool exportChrome(const std::string& path);
+
+private:
+    static std::atomic<bool> enabled;
+};
@@ -0,0 +1,144 @@
+#include "VideoIO.h"
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    const size_t kMaxHeaderLine = 1024;
+    const int kMaxDimension = 1 << 14;
+
+    // Reads up to and including '\n' into `line` (without the newline); false at a clean end of stream.
+    bool readLine(FILE* in, char* line, size_t size) {
+        size_t length = 0;
+        int c;
+        while ((c = getc(in)) != EOF && c != '\n') {
+            if (length + 1 >= size) throw std::runtime_error("Y4M header line too long");
+            line[length++] = static_cast<char>(c);
+        }
+        line[length] = '\0';
+        if (c == EOF) {
+            if (length == 0) return false;
+            throw std::runtime_error("truncated Y4M header");
+        }
+        return true;
+    }
+
+    void planeSize(VideoIO::Layout layout, int width, int height, int plane, int& planeWidth, int& planeHeight) {
+        planeWidth = width;
+        planeHeight = height;
+        if (plane == 0) return;
+        if (layout == VideoIO::Layout::YUV420 || layout == VideoIO::Layout::YUV422) planeWidth = (width + 1) / 2;
+        if (layout == VideoIO::Layout::YUV420) planeHeight = (height + 1) / 2;
+    }
+
+    int planeCount(VideoIO::Layout layout) {
+        return VideoIO::isPlanarYUV(layout) ? 3 : 1;
+    }
+
+    size_t planeBytes(const Image& plane) {
+        return plane.getByteSize();
+    }
+}
+
+bool VideoIO::isPlanarYUV(Layout layout) {
+    return layout == Layout::YUV420 || layout == Layout::YUV422 || layout == Layout::YUV444;
+}
+
+VideoIO::Format VideoIO::readHeader(FILE* in) {
+    char line[kMaxHeaderLine];
+    if (!readLine(in, line, sizeof(line)) || std::strncmp(line, "YUV4MPEG2", 9) != 0) {
+        throw std::runtime_error("not a YUV4MPEG2 stream");
+    }
+
+    Format format;
+    format.y4m = true;
+    format.header = line;
+    format.layout = Layout::YUV420;
+
+    std::istringstream params(line + 9);
+    std::string param;
+    while (params >> param) {
+        if (param[0] == 'W') {
+            format.width = std::atoi(param.c_str() + 1);
+        } else if (param[0] == 'H') {
+            format.height = std::atoi(param.c_str() + 1);
+        } else if (param[0] == 'C') {
+            std::string chroma = param.substr(1);
+            if (chroma == "420jpeg" || chroma == "420paldv" || chroma == "420mpeg2" || chroma == "420") {
+                format.layout = Layout::YUV420;
+            } else if (chroma == "422") {
+                format.layout = Layout::YUV422;
+            } else if (chroma == "444") {
+                format.layout = Layout::YUV444;
+            } else if (chroma == "mono") {
+                format.layout = Layout::Gray;
+            } else {
+                throw std::runtime_error("unsupported Y4M colour space C" + chroma + " (8-bit 420/422/444/mono only)");
+            }
+        }
+    }
+
+    if (format.width <= 0 || format.height <= 0 || format.width > kMaxDimension || format.height > kMaxDimension) {
+        throw std::runtime_error("invalid Y4M frame size");
+    }
+    return format;
+}
+
+VideoIO::Format VideoIO::rawFormat(const std::string& pixelFormat, int width, int height) {
+    Format format;
+    format.y4m = false;
+    format.width = width;
+    format.height = height;
+
+    if (pixelFormat == "gray") format.layout = Layout::Gray;
+    else if (pixelFormat == "yuv420p") format.layout = Layout::YUV420;
+    else if (pixelFormat == "yuv422p") format.layout = Layout::YUV422;
+    else if (pixelFormat == "yuv444p") format.layout = Layout::YUV444;
+    else if (pixelFormat == "rgb24") format.layout = Layout::RGB24;
+    else throw std::invalid_argument("unsupported raw pixel format '" + pixelFormat + "'");
+
+    if (width <= 0 || height <= 0 || width > kMaxDimension || height > kMaxDimension) {
+        throw std::invalid_argument("invalid raw frame size");
+    }
+    return format;
+}
+
+bool VideoIO::writeHeader(FILE* out, const Format& format) {
+    if (!format.y4m) return true;
+    return std::fprintf(out, "%s\n", format.header.c_str()) >= 0;
+}
+
+bool VideoIO::readFrame(FILE* in, const Format& format, Frame& frame) {
+    if (format.y4m) {
+        char line[kMaxHeaderLine];
+        if (!readLine(in, line, sizeof(line))) return false;
+        if (std::strncmp(line, "FRAME", 5) != 0) {
+            throw std::runtime_error("missing Y4M FRAME marker");
+        }
+    }
+
+    frame.planeCount = planeCount(format.layout);
+    for (int p = 0; p < frame.planeCount; p++) {
+        int width, height;
+        planeSize(format.layout, format.width, format.height, p, width, height);
+        Image& plane = frame.planes[p];
+        plane.resize(width, height, format.layout == Layout::RGB24 ? 3 : 1);
+
+        size_t size = planeBytes(plane);
+        size_t read = std::fread(plane.getData(), 1, size, in);
+        if (read == 0 && p == 0 && !format.y4m) return false;
+        if (read != size) throw std::runtime_error("truncated video frame");
+    }
+    return true;
+}
+
+bool VideoIO::writeFrame(FILE* out, const Format& format, const Frame& frame) {
+    if (format.y4m && std::fputs("FRAME\n", out) < 0) return false;
+
+    for (int p = 0; p < frame.planeCount; p++) {
+        const Image& plane = frame.planes[p];
+        if (std::fwrite(plane.getData(), 1, planeBytes(plane), out) != planeBytes(plane)) return false;
+    }
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "Image.h"
+#include <cstdio>
+#include <string>
+
+// 8-bit video frames on C streams: YUV4MPEG2 (.y4m) or headerless raw frames of a given size.
+// Planar formats keep one single-channel Image per plane, so luma-only processing runs on the Y plane
+// directly; interleaved RGB is one three-channel Image.
+class VideoIO {
+public:
+    enum class Layout { Gray, YUV420, YUV422, YUV444, RGB24 };
+
+    struct Format {
+        bool y4m = true;
+        Layout layout = Layout::YUV420;
+        int width = 0;
+        int height = 0;
+        // Y4M stream header as read, written back unchanged
+        std::string header;
+    };
+
+    struct Frame {
+        // Y, U, V for planar layouts; planes[0] holds the whole frame for Gray and RGB24
+        Image planes[3];
+        int planeCount = 0;
+    };
+
+    // Reads the YUV4MPEG2 stream header; throws std::runtime_error for unsupported streams.
+    static Format readHeader(FILE* in);
+    // Raw stream of `width` x `height` frames in an ffmpeg pixel format: gray, yuv420p, yuv422p,
+    // yuv444p or rgb24. Throws std::invalid_argument for anything else.
+    static Format rawFormat(const std::string& pixelFormat, int width, int height);
+
+    static bool writeHeader(FILE* out, const Format& format);
+
+    // Reads the next frame, reusing the plane buffers of `frame`. Returns false at the end of the
+    // stream; throws std::runtime_error for a truncated frame.
+    static bool readFrame(FILE* in, const Format& format, Frame& frame);
+    static bool writeFrame(FILE* out, const Format& format, const Frame& frame);
+
+    static bool isPlanarYUV(Layout layout);
+};
@@ -1,5 +1,8 @@
+// Replaces operator new to count allocations for the overlay; must precede every include
+#define PROFILER_IMPLEMENTATION
 #include "gui.h"
 #include <iostream>
+#include <algorithm>
 #include <glad/glad.h>
 
 #include "imgui.h"
@@ -9,13 +12,20 @@
 #include "render/thresholdControls.h"
 #include "render/pointOperationsControls.h"
 #include "render/imageDisplay.h"
+#include "render/sessionControls.h"
+#include "Kernels.h"
+#include "Resampling.h"
+#include "Trace.h"
+#include "../../lab1/utils/PerformanceOverlay.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
 }
 
 ImageProcessorGUI::ImageProcessorGUI() 
-    : window(nullptr), windowWidth(1600), windowHeight(900), currentTab(0) {}
+    : window(nullptr), windowWidth(1600), windowHeight(900),
+      exportScale(100), exportFilter(static_cast<int>(Resampling::Filter::Lanczos3)),
+      saveFormat(static_cast<int>(Image::SaveOptions::Format::PNG)), pngLevel(Image::SaveOptions().pngLevel), currentTab(0) {}
 
 ImageProcessorGUI::~ImageProcessorGUI() {
     ImGui_ImplOpenGL3_Shutdown();
@@ -72,25 +82,51 @@ void ImageProcessorGUI::run() {
     }
 
     initializeImGui();
+    Trace::setThreadName("main");
+    // One edit at a time runs in the background, so each may use every core
+    Kernels::setThreads(hardwareThreads());
 
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-        
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-        
-        renderGUI();
-        
-        ImGui::Render();
-        glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
-        glViewport(0, 0, windowWidth, windowHeight);
-        
-        glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-        glfwSwapBuffers(window);
+        Trace::Zone frameZone("Frame");
+        {
+            Trace::Zone zone("glfwPollEvents");
+            glfwPollEvents();
+        }
+        {
+            Trace::Zone zone("ImGui::NewFrame");
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+        }
+        {
+            Trace::Zone zone("renderGUI");
+            renderGUI();
+            PerformanceOverlay::render(Profiler::isEnabled() ? static_cast<int64_t>(session.getImageMemory()) : 0);
+        }
+        // F4 writes the timeline recorded so far, for chrome://tracing or ui.perfetto.dev
+        if (ImGui::IsKeyPressed(ImGuiKey_F4, false)) {
+            const char* tracePath = "lab2_trace.json";
+            if (Trace::exportChrome(tracePath)) {
+                std::cout << "Trace written to " << tracePath << std::endl;
+            } else {
+                std::cerr << "Failed to write " << tracePath << std::endl;
+            }
+        }
+        {
+            Trace::Zone zone("ImGui::Render");
+            ImGui::Render();
+            glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+            glViewport(0, 0, windowWidth, windowHeight);
+
+            glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+        {
+            Trace::Zone zone("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
     }
 }
 
@@ -104,6 +140,9 @@ void ImageProcessorGUI::renderGUI() {
     static char loadPath[512] = "";
     static char savePath[512] = "";
 
+    // Swap in whatever the background jobs finished since the last frame.
+    session.poll();
+
     ImGui::Text("Load Image:");
     ImGui::SameLine();
     ImGui::PushItemWidth(400);
@@ -114,7 +153,7 @@ void ImageProcessorGUI::renderGUI() {
     ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.2f, 0.5f, 0.8f, 1.0f));
     if (ImGui::Button("Load", ImVec2(80, 0))) {
         if (loadPath[0] != '\0') {
-            loadImage(std::string(loadPath));
+            session.load(std::string(loadPath));
         }
     }
     ImGui::PopStyleColor();
@@ -128,39 +167,79 @@ void ImageProcessorGUI::renderGUI() {
 
     ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.2f, 0.7f, 0.3f, 1.0f));
     if (ImGui::Button("Save", ImVec2(80, 0))) {
-        if (processedImage.getData() && savePath[0] != '\0') {
+        if (session.hasResult() && savePath[0] != '\0') {
+            Image::SaveOptions options;
+            options.format = static_cast<Image::SaveOptions::Format>(saveFormat);
+            options.pngLevel = pngLevel;
             std::string path = savePath;
-            if (path.find(".png") == std::string::npos) {
-                path += ".png";
+            if (Image::formatFor(path) != options.format) {
+                path += Image::extension(options.format, session.getProcessedView().getChannels());
             }
-            saveImage(path);
+            session.save(path, exportScale, static_cast<Resampling::Filter>(exportFilter), options);
         }
     }
     ImGui::PopStyleColor();
+
+    ImGui::SameLine();
+    ImGui::PushItemWidth(120);
+    ImGui::SliderInt("##ExportScale", &exportScale, 5, 100, "Export %d%%");
+    ImGui::SameLine();
+    ImGui::Combo("##ExportFilter", &exportFilter, "Box\0Bilinear\0Bicubic\0Lanczos-3\0");
+    ImGui::SameLine();
+    // Same order as Image::SaveOptions::Format, which starts with Auto
+    int formatIndex = saveFormat - 1;
+    if (ImGui::Combo("##SaveFormat", &formatIndex, "PNG\0PNM/PAM\0QOI\0Raw\0")) {
+        saveFormat = formatIndex + 1;
+    }
+    if (saveFormat == static_cast<int>(Image::SaveOptions::Format::PNG)) {
+        ImGui::SameLine();
+        ImGui::SliderInt("##PngLevel", &pngLevel, 0, 9, "Compression %d");
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("0 writes fastest and largest, 9 smallest and slowest");
+        }
+    }
+    ImGui::PopItemWidth();
     
     ImGui::SameLine();
     
     ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.8f, 0.5f, 0.2f, 1.0f));
     if (ImGui::Button("Reset", ImVec2(120, 30))) {
-        if (originalImage.getData()) {
-            processedImage = originalImage.clone();
-        }
+        session.reset();
     }
     ImGui::PopStyleColor();
+
+    // Ctrl+Z/Ctrl+Y belong to the text fields while one of them is being edited
+    bool shortcuts = !ImGui::GetIO().WantTextInput;
+    ImGui::SameLine();
+    ImGui::BeginDisabled(!session.canUndo());
+    if (ImGui::Button("Undo", ImVec2(60, 30)) || (shortcuts && session.canUndo() && ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_Z))) {
+        session.undo();
+    }
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    ImGui::BeginDisabled(!session.canRedo());
+    if (ImGui::Button("Redo", ImVec2(60, 30)) || (shortcuts && session.canRedo() && ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_Y))) {
+        session.redo();
+    }
+    ImGui::EndDisabled();
     
     ImGui::SameLine();
     ImGui::Spacing();
     ImGui::SameLine();
     
-    if (!currentImagePath.empty()) {
-        ImGui::Text("File: %s", currentImagePath.c_str());
-        if (originalImage.getData()) {
-            ImGui::SameLine();
-            ImGui::Text("| Size: %dx%d", originalImage.getWidth(), originalImage.getHeight());
-        }
+    if (session.hasImage()) {
+        ImGui::Text("File: %s", session.getImageName().c_str());
+        ImGui::SameLine();
+        ImGui::Text("| Size: %dx%d", session.getWidth(), session.getHeight());
     } else {
         ImGui::TextColored(ImVec4(1, 1, 0, 1), "No image loaded");
     }
+
+    if (session.hasImage()) {
+        renderHistoryBudget(session);
+        renderMemoryBudget();
+    }
+    renderJobProgress(session);
     
     ImGui::Separator();
 
@@ -171,8 +250,10 @@ void ImageProcessorGUI::renderGUI() {
             ImGui::SetColumnWidth(0, 400);
 
             ImGui::BeginChild("ThresholdControls", ImVec2(0, -1), true);
-            if (originalImage.getData()) {
-                renderThresholdControls(originalImage, processedImage);
+            if (session.hasImage()) {
+                renderPipelineStack(session);
+                ImGui::Spacing();
+                renderThresholdControls(session);
             } else {
                 ImGui::TextWrapped("Load an image to start processing");
                 ImGui::Spacing();
@@ -183,17 +264,8 @@ void ImageProcessorGUI::renderGUI() {
             ImGui::NextColumn();
 
             ImGui::BeginChild("ThresholdImages", ImVec2(0, -1), true);
-            if (originalImage.getData()) {
-                float imageWidth = ImGui::GetContentRegionAvail().x - 20;
-                renderImageDisplay(originalImage, "Original Image", imageWidth);
-                
-                ImGui::Spacing();
-                ImGui::Separator();
-                ImGui::Spacing();
-                
-                if (processedImage.getData()) {
-                    renderImageDisplay(processedImage, "Processed Image", imageWidth);
-                }
+            if (session.hasImage()) {
+                renderImagePanel(ImGui::GetContentRegionAvail().x - 20);
             } else {
                 ImGui::TextWrapped("No image loaded.\n\nClick 'Load Image' to get started.");
             }
@@ -208,8 +280,10 @@ void ImageProcessorGUI::renderGUI() {
             ImGui::SetColumnWidth(0, 400);
 
             ImGui::BeginChild("PointControls", ImVec2(0, -1), true);
-            if (originalImage.getData()) {
-                renderPointOperationsControls(originalImage, processedImage);
+            if (session.hasImage()) {
+                renderPipelineStack(session);
+                ImGui::Spacing();
+                renderPointOperationsControls(session);
             } else {
                 ImGui::TextWrapped("Load an image to start processing");
                 ImGui::Spacing();
@@ -220,17 +294,8 @@ void ImageProcessorGUI::renderGUI() {
             ImGui::NextColumn();
 
             ImGui::BeginChild("PointImages", ImVec2(0, -1), true);
-            if (originalImage.getData()) {
-                float imageWidth = ImGui::GetContentRegionAvail().x - 20;
-                renderImageDisplay(originalImage, "Original Image", imageWidth);
-                
-                ImGui::Spacing();
-                ImGui::Separator();
-                ImGui::Spacing();
-                
-                if (processedImage.getData()) {
-                    renderImageDisplay(processedImage, "Processed Image", imageWidth);
-                }
+            if (session.hasImage()) {
+                renderImagePanel(ImGui::GetContentRegionAvail().x - 20);
             } else {
                 ImGui::TextWrapped("No image loaded.\n\nClick 'Load Image' to get started.");
             }
@@ -261,10 +326,12 @@ void ImageProcessorGUI::renderGUI() {
             ImGui::TextWrapped("Instructions:");
             ImGui::BulletText("Load an image using the 'Load Image' button");
             ImGui::BulletText("Select a processing tab (Threshold or Point Operations)");
-            ImGui::BulletText("Choose a method and adjust parameters");
-            ImGui::BulletText("Click 'Apply' to process the image");
+            ImGui::BulletText("Choose a method and adjust parameters (live preview on a reduced copy)");
+            ImGui::BulletText("Click 'Apply' to add the operation to the stack");
+            ImGui::BulletText("Select a stack step to tune it, untick it to skip it");
             ImGui::BulletText("Save the result using 'Save Result' button");
-            ImGui::BulletText("Use 'Reset' to restore the original image");
+            ImGui::BulletText("Use 'Reset' to clear the stack and restore the original image");
+            ImGui::BulletText("Undo/Redo (Ctrl+Z / Ctrl+Y) step through stack changes");
             
             ImGui::EndTabItem();
         }
@@ -275,20 +342,19 @@ void ImageProcessorGUI::renderGUI() {
     ImGui::End();
 }
 
-void ImageProcessorGUI::loadImage(const std::string& filepath) {
-    if (originalImage.load(filepath)) {
-        processedImage = originalImage.clone();
+void ImageProcessorGUI::renderImagePanel(float imageWidth) {
+    renderSessionImage(session.getOriginalView(), "Original Image",
+                       session.getWidth(), session.getHeight(), imageWidth, originalProxy);
 
-        size_t lastSlash = filepath.find_last_of("/\\");
-        currentImagePath = (lastSlash != std::string::npos) ?
-                          filepath.substr(lastSlash + 1) : filepath;
-    }
-}
+    ImGui::Spacing();
+    ImGui::Separator();
+    ImGui::Spacing();
 
-void ImageProcessorGUI::saveImage(const std::string& filepath) {
-    if (processedImage.save(filepath)) {
-        std::cout << "Image saved successfully: " << filepath << std::endl;
+    if (session.isPreviewActive()) {
+        renderSessionImage(session.getPreviewView(), "Processed Image - preview",
+                           session.getWidth(), session.getHeight(), imageWidth, processedProxy);
     } else {
-        std::cerr << "Failed to save image: " << filepath << std::endl;
+        renderSessionImage(session.getProcessedView(), "Processed Image",
+                           session.getWidth(), session.getHeight(), imageWidth, processedProxy);
     }
-}
\ No newline at end of file
+}
@@ -1,7 +1,8 @@
 #pragma once
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
-#include "Image.h"
+#include "EditSession.h"
+#include "render/imageDisplay.h"
 #include <string>
 
 class ImageProcessorGUI {
@@ -15,15 +16,19 @@ public:
 
 private:
     void renderGUI();
-    void loadImage(const std::string& filepath);
-    void saveImage(const std::string& filepath);
+    void renderImagePanel(float imageWidth);
     
     GLFWwindow* window;
     int windowWidth, windowHeight;
     
-    Image originalImage;
-    Image processedImage;
+    EditSession session;
+    DisplayProxy originalProxy;
+    DisplayProxy processedProxy;
+
+    int exportScale;
+    int exportFilter;
+    int saveFormat;
+    int pngLevel;
     
     int currentTab;
-    std::string currentImagePath;
 };
\ No newline at end of file
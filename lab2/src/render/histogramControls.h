@@ -4,8 +4,8 @@
 #include "../../third_party/imgui/imgui.h"
 #include <array>
 
-inline void renderHistogram(const std::array<int, 256>& hist, const char* label) {
-    int maxVal = *std::max_element(hist.begin(), hist.end());
+inline void renderHistogram(const Histogram::Counts& hist, const char* label) {
+    uint64_t maxVal = *std::max_element(hist.begin(), hist.end());
     if (maxVal == 0) maxVal = 1;
     
     ImGui::Text("%s", label);
@@ -17,7 +17,7 @@ inline void renderHistogram(const std::array<int, 256>& hist, const char* label)
     draw_list->AddRectFilled(p, ImVec2(p.x + histSize.x, p.y + histSize.y), IM_COL32(40, 40, 40, 255));
     
     for (int i = 0; i < 256; i++) {
-        float height = (hist[i] / (float)maxVal) * histSize.y;
+        float height = (static_cast<float>(hist[i]) / static_cast<float>(maxVal)) * histSize.y;
         draw_list->AddLine(
             ImVec2(p.x + i, p.y + histSize.y),
             ImVec2(p.x + i, p.y + histSize.y - height),
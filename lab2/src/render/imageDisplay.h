@@ -1,18 +1,28 @@
 #pragma once
 #include "../Image.h"
-#include "../../third_party/imgui/imgui.h"
+#include "../Resampling.h"
+#include <algorithm>
 
-inline void renderImageDisplay(const Image& img, const char* label, float maxWidth) {
-    if (!img.getData()) return;
-    
-    ImGui::Text("%s (%dx%d)", label, img.getWidth(), img.getHeight());
-    
-    float aspectRatio = static_cast<float>(img.getHeight()) / img.getWidth();
-    float displayWidth = std::min(maxWidth, static_cast<float>(img.getWidth()));
-    float displayHeight = displayWidth * aspectRatio;
-    
-    ImGui::Image(
-        (void*)(intptr_t)img.getTextureID(),
-        ImVec2(displayWidth, displayHeight)
-    );
-}
\ No newline at end of file
+// Display-size copy of an image; rebuilt only when the source pixels (their generation) or the
+// target width change.
+struct DisplayProxy {
+    Image image;
+    uint64_t sourceGeneration = 0;
+    int targetWidth = 0;
+};
+
+inline const Image& updateDisplayProxy(DisplayProxy& proxy, const Image& img, float maxWidth) {
+    // Rounded up to 64 px so that resizing the window does not rebuild the proxy every frame.
+    int targetWidth = ((static_cast<int>(maxWidth) + 63) / 64) * 64;
+    if (img.getWidth() <= targetWidth) {
+        return img;
+    }
+
+    if (proxy.sourceGeneration != img.getGeneration() || proxy.targetWidth != targetWidth) {
+        int targetHeight = std::max(1, static_cast<int>(static_cast<long long>(img.getHeight()) * targetWidth / img.getWidth()));
+        proxy.image = Resampling::resize(img, targetWidth, targetHeight, Resampling::Filter::Bilinear);
+        proxy.sourceGeneration = img.getGeneration();
+        proxy.targetWidth = targetWidth;
+    }
+    return proxy.image;
+}
@@ -1,22 +1,37 @@
 #pragma once
-#include "../Image.h"
+#include "../EditSession.h"
 #include "../PointOperations.h"
+#include "../Pipeline.h"
+#include "sessionControls.h"
 #include "../../third_party/imgui/imgui.h"
 
-inline void renderPointOperationsControls(Image& original, Image& result) {
+inline void renderPointOperationsControls(EditSession& session) {
     ImGui::Text("Point Operations + Linear Contrast");
     ImGui::Separator();
+    renderPreviewToggle(session);
+    ImGui::Spacing();
     
     if (ImGui::CollapsingHeader("Linear Contrast Enhancement", ImGuiTreeNodeFlags_DefaultOpen)) {
         static float minPercentile = 2.0f;
         static float maxPercentile = 98.0f;
         
         ImGui::Text("Automatic (Percentile-based):");
-        ImGui::SliderFloat("Min Percentile", &minPercentile, 0.0f, 50.0f, "%.1f%%");
-        ImGui::SliderFloat("Max Percentile", &maxPercentile, 50.0f, 100.0f, "%.1f%%");
+        bool autoChanged = ImGui::SliderFloat("Min Percentile", &minPercentile, 0.0f, 50.0f, "%.1f%%");
+        autoChanged |= ImGui::SliderFloat("Max Percentile", &maxPercentile, 50.0f, 100.0f, "%.1f%%");
+        
+        // Percentiles depend on the input, so this one is not a fixed value map
+        auto autoContrast = [=]() {
+            return PipelineNode::fromOperation(nodeLabel("Auto contrast %.1f-%.1f%%", minPercentile, maxPercentile),
+                [minP = minPercentile, maxP = maxPercentile](const Image& img) {
+                    return PointOperations::linearContrast(img, minP, maxP);
+                });
+        };
+        if (autoChanged) {
+            session.preview(autoContrast());
+        }
         
         if (ImGui::Button("Apply Auto Contrast", ImVec2(-1, 0))) {
-            result = PointOperations::linearContrast(original, minPercentile, maxPercentile);
+            session.apply(autoContrast());
         }
         
         ImGui::Spacing();
@@ -27,13 +42,21 @@ inline void renderPointOperationsControls(Image& original, Image& result) {
         static int minOut = 0, maxOut = 255;
         
         ImGui::Text("Manual:");
-        ImGui::SliderInt("Input Min", &minIn, 0, 255);
-        ImGui::SliderInt("Input Max", &maxIn, 0, 255);
-        ImGui::SliderInt("Output Min", &minOut, 0, 255);
-        ImGui::SliderInt("Output Max", &maxOut, 0, 255);
+        bool manualChanged = ImGui::SliderInt("Input Min", &minIn, 0, 255);
+        manualChanged |= ImGui::SliderInt("Input Max", &maxIn, 0, 255);
+        manualChanged |= ImGui::SliderInt("Output Min", &minOut, 0, 255);
+        manualChanged |= ImGui::SliderInt("Output Max", &maxOut, 0, 255);
+        
+        auto manualContrast = [=]() {
+            return PipelineNode::fromLUT(nodeLabel("Contrast %d-%d -> %d-%d", minIn, maxIn, minOut, maxOut),
+                PointOperations::linearContrastLUT(minIn, maxIn, minOut, maxOut));
+        };
+        if (manualChanged) {
+            session.preview(manualContrast());
+        }
         
         if (ImGui::Button("Apply Manual Contrast", ImVec2(-1, 0))) {
-            result = PointOperations::linearContrastManual(original, minIn, maxIn, minOut, maxOut);
+            session.apply(manualContrast());
         }
     }
     
@@ -43,17 +66,27 @@ inline void renderPointOperationsControls(Image& original, Image& result) {
         static float brightness = 0.0f;
         static float contrast = 0.0f;
         
-        ImGui::SliderFloat("Brightness", &brightness, -100.0f, 100.0f, "%.0f");
-        ImGui::SliderFloat("Contrast", &contrast, -100.0f, 100.0f, "%.0f");
+        bool changed = ImGui::SliderFloat("Brightness", &brightness, -100.0f, 100.0f, "%.0f");
+        changed |= ImGui::SliderFloat("Contrast", &contrast, -100.0f, 100.0f, "%.0f");
+        
+        auto brightnessContrast = [=]() {
+            return PipelineNode::fromLUT(nodeLabel("Brightness %.0f, contrast %.0f", brightness, contrast),
+                PointOperations::brightnessContrastLUT(brightness, contrast));
+        };
         
         if (ImGui::Button("Apply", ImVec2(-1, 0))) {
-            result = PointOperations::adjustBrightnessContrast(original, brightness, contrast);
+            session.apply(brightnessContrast());
         }
         
         ImGui::SameLine();
         if (ImGui::Button("Reset")) {
             brightness = 0.0f;
             contrast = 0.0f;
+            changed = true;
+        }
+        
+        if (changed) {
+            session.preview(brightnessContrast());
         }
     }
     
@@ -62,11 +95,18 @@ inline void renderPointOperationsControls(Image& original, Image& result) {
     if (ImGui::CollapsingHeader("Gamma Correction")) {
         static float gamma = 1.0f;
         
-        ImGui::SliderFloat("Gamma", &gamma, 0.1f, 5.0f, "%.2f");
+        bool changed = ImGui::SliderFloat("Gamma", &gamma, 0.1f, 5.0f, "%.2f");
         ImGui::TextWrapped("< 1.0: Brightens dark areas\n> 1.0: Darkens bright areas");
         
+        auto gammaOp = [=]() {
+            return PipelineNode::fromLUT(nodeLabel("Gamma %.2f", gamma), PointOperations::gammaLUT(gamma));
+        };
+        if (changed) {
+            session.preview(gammaOp());
+        }
+        
         if (ImGui::Button("Apply Gamma", ImVec2(-1, 0))) {
-            result = PointOperations::gammaCorrection(original, gamma);
+            session.apply(gammaOp());
         }
     }
     
@@ -75,11 +115,18 @@ inline void renderPointOperationsControls(Image& original, Image& result) {
     if (ImGui::CollapsingHeader("Logarithmic Transform")) {
         static float logC = 1.0f;
         
-        ImGui::SliderFloat("Constant C", &logC, 0.1f, 3.0f, "%.2f");
+        bool changed = ImGui::SliderFloat("Constant C", &logC, 0.1f, 3.0f, "%.2f");
         ImGui::TextWrapped("Enhances dark regions, compresses bright regions");
         
+        auto logOp = [=]() {
+            return PipelineNode::fromLUT(nodeLabel("Log C=%.2f", logC), PointOperations::logarithmicLUT(logC));
+        };
+        if (changed) {
+            session.preview(logOp());
+        }
+        
         if (ImGui::Button("Apply Log Transform", ImVec2(-1, 0))) {
-            result = PointOperations::logarithmicTransform(original, logC);
+            session.apply(logOp());
         }
     }
     
@@ -89,11 +136,18 @@ inline void renderPointOperationsControls(Image& original, Image& result) {
         static float power = 1.0f;
         static float powerC = 1.0f;
         
-        ImGui::SliderFloat("Power", &power, 0.1f, 5.0f, "%.2f");
-        ImGui::SliderFloat("Scale C", &powerC, 0.1f, 3.0f, "%.2f");
+        bool changed = ImGui::SliderFloat("Power", &power, 0.1f, 5.0f, "%.2f");
+        changed |= ImGui::SliderFloat("Scale C", &powerC, 0.1f, 3.0f, "%.2f");
+        
+        auto powerOp = [=]() {
+            return PipelineNode::fromLUT(nodeLabel("Power %.2f, C=%.2f", power, powerC), PointOperations::powerLUT(power, powerC));
+        };
+        if (changed) {
+            session.preview(powerOp());
+        }
         
         if (ImGui::Button("Apply Power Transform", ImVec2(-1, 0))) {
-            result = PointOperations::powerTransform(original, power, powerC);
+            session.apply(powerOp());
         }
     }
     
@@ -101,32 +155,46 @@ inline void renderPointOperationsControls(Image& original, Image& result) {
     
     if (ImGui::CollapsingHeader("Other Operations")) {
         if (ImGui::Button("Invert (Negative)", ImVec2(-1, 0))) {
-            result = PointOperations::invert(original);
+            session.apply(PipelineNode::fromLUT("Invert", PointOperations::invertLUT()));
         }
         
         ImGui::Spacing();
         
         static int clipMin = 0, clipMax = 255;
         ImGui::Text("Brightness Clipping:");
-        ImGui::SliderInt("Min Value", &clipMin, 0, 255);
-        ImGui::SliderInt("Max Value", &clipMax, 0, 255);
+        bool clipChanged = ImGui::SliderInt("Min Value", &clipMin, 0, 255);
+        clipChanged |= ImGui::SliderInt("Max Value", &clipMax, 0, 255);
+        
+        auto clipOp = [=]() {
+            return PipelineNode::fromLUT(nodeLabel("Clip %d-%d", clipMin, clipMax), PointOperations::clipLUT(clipMin, clipMax));
+        };
+        if (clipChanged) {
+            session.preview(clipOp());
+        }
         
         if (ImGui::Button("Apply Clipping", ImVec2(-1, 0))) {
-            result = PointOperations::clipBrightness(original, clipMin, clipMax);
+            session.apply(clipOp());
         }
         
         ImGui::Spacing();
         
         static int quantLevels = 8;
         ImGui::Text("Quantization:");
-        ImGui::SliderInt("Levels", &quantLevels, 2, 64);
+        bool quantChanged = ImGui::SliderInt("Levels", &quantLevels, 2, 64);
+        
+        auto quantOp = [=]() {
+            return PipelineNode::fromLUT(nodeLabel("Quantize %d", quantLevels), PointOperations::quantizeLUT(quantLevels));
+        };
+        if (quantChanged) {
+            session.preview(quantOp());
+        }
         
         if (ImGui::Button("Apply Quantization", ImVec2(-1, 0))) {
-            result = PointOperations::quantize(original, quantLevels);
+            session.apply(quantOp());
         }
     }
     
     ImGui::Spacing();
     ImGui::Separator();
     ImGui::TextWrapped("Point operations modify each pixel independently based on its value, without considering neighboring pixels.");
-}   
\ No newline at end of file
+}
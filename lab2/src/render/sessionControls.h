@@ -0,0 +1,166 @@
+#pragma once
+#include "../EditSession.h"
+#include "../PipelineScript.h"
+#include "imageDisplay.h"
+#include "../../third_party/imgui/imgui.h"
+#include "../../../lab1/utils/MemoryAccounting.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+
+inline void renderPreviewToggle(EditSession& session) {
+    bool enabled = session.isPreviewEnabled();
+    if (ImGui::Checkbox("Live preview", &enabled)) {
+        session.setPreviewEnabled(enabled);
+    }
+    ImGui::SameLine();
+    ImGui::TextDisabled("(?)");
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Sliders update a display-size preview; Apply or Save processes the full image");
+    }
+}
+
+// Stack entry label including the operation's parameters, e.g. "Gamma 1.20"
+inline std::string nodeLabel(const char* format, ...) {
+    char buffer[128];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return buffer;
+}
+
+// Replaces the stack with the steps of a pipeline description file, the same format the
+// lab2_batch tool reads with -f.
+inline void renderPipelineFile(EditSession& session) {
+    static char pipelinePath[512] = "";
+    static std::string message;
+
+    ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x - 110);
+    ImGui::InputText("##PipelinePath", pipelinePath, sizeof(pipelinePath));
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    if (ImGui::Button("Load Pipeline", ImVec2(100, 0)) && pipelinePath[0] != '\0') {
+        std::vector<PipelineScript::Error> errors;
+        auto steps = PipelineScript::load(pipelinePath, errors);
+        if (errors.empty()) {
+            session.setPipeline(PipelineScript::toNodes(steps));
+            message = "Loaded " + std::to_string(steps.size()) + " step(s)";
+        } else {
+            message.clear();
+            for (const auto& error : errors) {
+                message += PipelineScript::describe(error) + "\n";
+            }
+        }
+    }
+    if (!message.empty()) {
+        ImGui::TextWrapped("%s", message.c_str());
+    }
+}
+
+// The operation stack shared by the processing tabs. Selecting a step makes the tab controls
+// preview and apply in its place; adjacent per-pixel steps are fused and run as one pass.
+inline void renderPipelineStack(EditSession& session) {
+    if (!ImGui::CollapsingHeader("Operation Stack", ImGuiTreeNodeFlags_DefaultOpen)) return;
+
+    renderPipelineFile(session);
+
+    const auto& nodes = session.getPipeline().getNodes();
+    if (nodes.empty()) {
+        ImGui::TextDisabled("Empty - applied operations are stacked here");
+        return;
+    }
+
+    int removeIndex = -1;
+    for (int i = 0; i < static_cast<int>(nodes.size()); i++) {
+        ImGui::PushID(i);
+        bool enabled = nodes[i].enabled;
+        if (ImGui::Checkbox("##enabled", &enabled)) {
+            session.setNodeEnabled(i, enabled);
+        }
+        ImGui::SameLine();
+        bool selected = session.getSelectedNode() == i;
+        std::string text = std::to_string(i + 1) + ". " + nodes[i].label + (nodes[i].pointwise ? "  [LUT]" : "");
+        if (ImGui::Selectable(text.c_str(), selected, 0, ImVec2(ImGui::GetContentRegionAvail().x - 30, 0))) {
+            session.selectNode(selected ? -1 : i);
+        }
+        ImGui::SameLine();
+        if (ImGui::SmallButton("x")) {
+            removeIndex = i;
+        }
+        ImGui::PopID();
+    }
+    if (removeIndex >= 0) {
+        session.removeNode(removeIndex);
+    }
+
+    if (session.getSelectedNode() >= 0) {
+        ImGui::TextColored(ImVec4(1, 1, 0, 1), "Apply replaces step %d", session.getSelectedNode() + 1);
+    } else {
+        ImGui::TextDisabled("Apply appends a new step");
+    }
+}
+
+// Undo history size; steps beyond the budget are moved to a temporary file.
+inline void renderHistoryBudget(EditSession& session) {
+    const History& history = session.getHistory();
+    static int budgetMB = static_cast<int>(History::kDefaultBudget >> 20);
+
+    ImGui::PushItemWidth(150);
+    if (ImGui::SliderInt("History budget", &budgetMB, 16, 4096, "%d MB")) {
+        session.setHistoryBudget(static_cast<size_t>(budgetMB) << 20);
+    }
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    ImGui::TextDisabled("%zu undo / %zu redo, %.1f MB in memory, %.1f MB on disk",
+                        history.undoCount(), history.redoCount(),
+                        history.getMemoryUsage() / (1024.0 * 1024.0), history.getSpilledBytes() / (1024.0 * 1024.0));
+}
+
+// Soft limit on the memory the program tracks; above it, cached pipeline stages are dropped between frames.
+inline void renderMemoryBudget() {
+    static int budgetMB = 0;
+
+    ImGui::PushItemWidth(150);
+    if (ImGui::SliderInt("Memory budget", &budgetMB, 0, 16384, budgetMB == 0 ? "off" : "%d MB")) {
+        MemoryAccounting::setBudget(static_cast<uint64_t>(budgetMB) << 20);
+    }
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    MemoryAccounting::Usage tracked = MemoryAccounting::total();
+    ImGui::TextDisabled("%.1f MB tracked, peak %.1f MB", tracked.current / (1024.0 * 1024.0), tracked.peak / (1024.0 * 1024.0));
+}
+
+// One progress bar per queued or running background job, each with its own Cancel button.
+inline void renderJobProgress(EditSession& session) {
+    for (const auto& job : session.getJobStatus()) {
+        ImGui::PushID(static_cast<int>(job.id));
+        char overlay[128];
+        snprintf(overlay, sizeof(overlay), "%s%s", job.label.c_str(), job.running ? "..." : " (queued)");
+        ImGui::ProgressBar(job.progress, ImVec2(300, 0), overlay);
+        ImGui::SameLine();
+        if (ImGui::SmallButton("Cancel")) {
+            session.cancelJob(job.id);
+        }
+        ImGui::PopID();
+    }
+}
+
+// Shows a display-size view of an image, labelled with the size of the full-resolution image.
+inline void renderSessionImage(const Image& view, const char* label, int fullWidth, int fullHeight,
+                               float maxWidth, DisplayProxy& proxy) {
+    if (!view.getData()) return;
+
+    ImGui::Text("%s (%dx%d)", label, fullWidth, fullHeight);
+
+    const Image& shown = updateDisplayProxy(proxy, view, maxWidth);
+    float aspectRatio = static_cast<float>(fullHeight) / fullWidth;
+    float displayWidth = std::min(maxWidth, static_cast<float>(fullWidth));
+    float displayHeight = displayWidth * aspectRatio;
+
+    ImGui::Image(
+        (void*)(intptr_t)shown.getTextureID(),
+        ImVec2(displayWidth, displayHeight)
+    );
+}
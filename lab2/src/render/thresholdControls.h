@@ -1,11 +1,15 @@
 #pragma once
-#include "../Image.h"
+#include "../EditSession.h"
 #include "../ThresholdProcessing.h"
+#include "../Morphology.h"
+#include "../Pipeline.h"
+#include "sessionControls.h"
 #include "../../third_party/imgui/imgui.h"
 #include <array>
+#include <functional>
 
-inline void renderThresholdHistogram(const std::array<int, 256>& hist, unsigned char threshold, const char* label) {
-    int maxVal = *std::max_element(hist.begin(), hist.end());
+inline void renderThresholdHistogram(const Histogram::Counts& hist, unsigned char threshold, const char* label) {
+    uint64_t maxVal = *std::max_element(hist.begin(), hist.end());
     if (maxVal == 0) maxVal = 1;
     
     ImGui::Text("%s (Threshold: %d)", label, threshold);
@@ -17,7 +21,7 @@ inline void renderThresholdHistogram(const std::array<int, 256>& hist, unsigned
     draw_list->AddRectFilled(p, ImVec2(p.x + histSize.x, p.y + histSize.y), IM_COL32(40, 40, 40, 255));
 
     for (int i = 0; i < 256; i++) {
-        float height = (hist[i] / (float)maxVal) * histSize.y;
+        float height = (static_cast<float>(hist[i]) / static_cast<float>(maxVal)) * histSize.y;
         ImU32 color = (i < threshold) ? IM_COL32(100, 100, 255, 200) : IM_COL32(255, 100, 100, 200);
         draw_list->AddLine(
             ImVec2(p.x + i, p.y + histSize.y),
@@ -36,34 +40,35 @@ inline void renderThresholdHistogram(const std::array<int, 256>& hist, unsigned
     ImGui::Dummy(histSize);
 }
 
-inline void renderThresholdControls(Image& original, Image& result) {
+inline void renderThresholdControls(EditSession& session) {
     ImGui::Text("Global Threshold Processing");
     ImGui::Separator();
+    renderPreviewToggle(session);
     
     static int method = 0;
     ImGui::Text("Select Method:");
-    ImGui::RadioButton("Otsu Method (Automatic)", &method, 0);
+    bool changed = ImGui::RadioButton("Otsu Method (Automatic)", &method, 0);
     ImGui::SameLine();
     ImGui::TextDisabled("(?)");
     if (ImGui::IsItemHovered()) {
         ImGui::SetTooltip("Automatically finds optimal threshold by maximizing inter-class variance");
     }
     
-    ImGui::RadioButton("Triangle Method", &method, 1);
+    changed |= ImGui::RadioButton("Triangle Method", &method, 1);
     ImGui::SameLine();
     ImGui::TextDisabled("(?)");
     if (ImGui::IsItemHovered()) {
         ImGui::SetTooltip("Good for images with one dominant peak in histogram");
     }
     
-    ImGui::RadioButton("Fixed Threshold", &method, 2);
+    changed |= ImGui::RadioButton("Fixed Threshold", &method, 2);
     ImGui::SameLine();
     ImGui::TextDisabled("(?)");
     if (ImGui::IsItemHovered()) {
         ImGui::SetTooltip("Manual threshold selection");
     }
     
-    ImGui::RadioButton("Double Threshold", &method, 3);
+    changed |= ImGui::RadioButton("Double Threshold", &method, 3);
     ImGui::SameLine();
     ImGui::TextDisabled("(?)");
     if (ImGui::IsItemHovered()) {
@@ -76,62 +81,145 @@ inline void renderThresholdControls(Image& original, Image& result) {
     static int lowThreshold = 50;
     static int highThreshold = 150;
     
+    // Applied Otsu and Triangle nodes compute the threshold from their input, so the stack keeps
+    // working on the next image loaded. The preview of a step on the original uses the full-resolution
+    // analysis instead, so the proxy is binarized exactly where Apply will binarize the original.
+    const EditSession::Analysis& analysis = session.getAnalysis();
+    bool onOriginal = session.editsOriginal();
+    std::function<PipelineNode(bool preview)> makeNode;
     if (method == 0) {
+        unsigned char otsuThresh = analysis.otsuThreshold;
+        makeNode = [=](bool preview) {
+            if (!preview || !onOriginal) {
+                return PipelineNode::fromOperation("Otsu threshold", ThresholdProcessing::otsuThreshold);
+            }
+            return PipelineNode::fromOperation(nodeLabel("Otsu threshold %d", otsuThresh),
+                [otsuThresh](const Image& img) { return ThresholdProcessing::fixedThreshold(img, otsuThresh); });
+        };
+
         if (ImGui::Button("Apply Otsu Method", ImVec2(-1, 0))) {
-            result = ThresholdProcessing::otsuThreshold(original);
+            session.apply(makeNode(false));
         }
         
-        if (original.getData()) {
-            unsigned char otsuThresh = ThresholdProcessing::calculateOtsuThreshold(original);
+        if (onOriginal) {
             ImGui::Text("Calculated threshold: %d", otsuThresh);
         }
         
     } else if (method == 1) {
+        unsigned char triThresh = analysis.triangleThreshold;
+        makeNode = [=](bool preview) {
+            if (!preview || !onOriginal) {
+                return PipelineNode::fromOperation("Triangle threshold", ThresholdProcessing::triangleThreshold);
+            }
+            return PipelineNode::fromOperation(nodeLabel("Triangle threshold %d", triThresh),
+                [triThresh](const Image& img) { return ThresholdProcessing::fixedThreshold(img, triThresh); });
+        };
+
         if (ImGui::Button("Apply Triangle Method", ImVec2(-1, 0))) {
-            result = ThresholdProcessing::triangleThreshold(original);
+            session.apply(makeNode(false));
         }
         
-        if (original.getData()) {
-            unsigned char triThresh = ThresholdProcessing::calculateTriangleThreshold(original);
+        if (onOriginal) {
             ImGui::Text("Calculated threshold: %d", triThresh);
         }
         
     } else if (method == 2) {
-        ImGui::SliderInt("Threshold", &fixedThreshold, 0, 255);
+        changed |= ImGui::SliderInt("Threshold", &fixedThreshold, 0, 255);
+        makeNode = [](bool) {
+            int threshold = fixedThreshold;
+            return PipelineNode::fromOperation(nodeLabel("Fixed threshold %d", threshold),
+                [threshold](const Image& img) { return ThresholdProcessing::fixedThreshold(img, threshold); });
+        };
         
         if (ImGui::Button("Apply Fixed Threshold", ImVec2(-1, 0))) {
-            result = ThresholdProcessing::fixedThreshold(original, fixedThreshold);
+            session.apply(makeNode(false));
         }
         
     } else if (method == 3) {
-        ImGui::SliderInt("Low Threshold", &lowThreshold, 0, 255);
-        ImGui::SliderInt("High Threshold", &highThreshold, 0, 255);
+        changed |= ImGui::SliderInt("Low Threshold", &lowThreshold, 0, 255);
+        changed |= ImGui::SliderInt("High Threshold", &highThreshold, 0, 255);
         
         if (lowThreshold > highThreshold) {
             lowThreshold = highThreshold;
         }
+        makeNode = [](bool) {
+            int low = lowThreshold, high = highThreshold;
+            return PipelineNode::fromOperation(nodeLabel("Double threshold %d-%d", low, high),
+                [low, high](const Image& img) { return ThresholdProcessing::doubleThreshold(img, low, high); });
+        };
         
         if (ImGui::Button("Apply Double Threshold", ImVec2(-1, 0))) {
-            result = ThresholdProcessing::doubleThreshold(original, lowThreshold, highThreshold);
+            session.apply(makeNode(false));
         }
         
         ImGui::TextColored(ImVec4(1, 1, 0, 1), "White: Strong edges");
         ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1), "Gray: Weak edges");
         ImGui::TextColored(ImVec4(0, 0, 0, 1), "Black: Non-edges");
     }
+
+    if (changed && makeNode) {
+        session.preview(makeNode(true));
+    }
     
+    ImGui::Spacing();
+
+    if (ImGui::CollapsingHeader("Morphology (Mask Cleanup)")) {
+        static int morphOp = 0;
+        static int kernelWidth = 3;
+        static int kernelHeight = 3;
+        static bool bitPacked = true;
+
+        ImGui::RadioButton("Erode", &morphOp, 0);
+        ImGui::SameLine();
+        ImGui::RadioButton("Dilate", &morphOp, 1);
+        ImGui::SameLine();
+        ImGui::RadioButton("Open", &morphOp, 2);
+        ImGui::SameLine();
+        ImGui::RadioButton("Close", &morphOp, 3);
+
+        ImGui::SliderInt("Element Width", &kernelWidth, 1, 101);
+        ImGui::SliderInt("Element Height", &kernelHeight, 1, 101);
+        ImGui::Checkbox("Binary mask (bit-packed)", &bitPacked);
+
+        if (ImGui::Button("Apply Morphology", ImVec2(-1, 0))) {
+            int op = morphOp, kw = kernelWidth, kh = kernelHeight;
+            bool packed = bitPacked;
+            const char* names[] = {"Erode", "Dilate", "Open", "Close"};
+            std::string label = nodeLabel("%s %dx%d%s", names[op], kw, kh, packed ? " (mask)" : "");
+            session.apply(PipelineNode::fromOperation(label, [=](const Image& result) {
+                if (packed) {
+                    BinaryMask mask = BinaryMask::fromImage(result);
+                    switch (op) {
+                        case 0: mask = Morphology::erode(mask, kw, kh); break;
+                        case 1: mask = Morphology::dilate(mask, kw, kh); break;
+                        case 2: mask = Morphology::open(mask, kw, kh); break;
+                        default: mask = Morphology::close(mask, kw, kh); break;
+                    }
+                    return mask.toImage(result.getChannels());
+                }
+                switch (op) {
+                    case 0: return Morphology::erode(result, kw, kh);
+                    case 1: return Morphology::dilate(result, kw, kh);
+                    case 2: return Morphology::open(result, kw, kh);
+                    default: return Morphology::close(result, kw, kh);
+                }
+            }));
+        }
+        ImGui::TextWrapped("Stacked after the current steps, e.g. to remove specks from a thresholded mask");
+    }
+
     ImGui::Spacing();
     ImGui::Separator();
     ImGui::Spacing();
 
-    if (original.getData()) {
-        auto hist = ThresholdProcessing::computeHistogram(original);
+    if (session.hasImage()) {
+        const auto& hist = analysis.histogram;
         unsigned char thresh = 127;
         
         if (method == 0) {
-            thresh = ThresholdProcessing::calculateOtsuThreshold(original);
+            thresh = analysis.otsuThreshold;
         } else if (method == 1) {
-            thresh = ThresholdProcessing::calculateTriangleThreshold(original);
+            thresh = analysis.triangleThreshold;
         } else if (method == 2) {
             thresh = fixedThreshold;
         }
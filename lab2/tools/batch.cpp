@@ -0,0 +1,352 @@
+// Headless batch processing: applies an operation chain to image files on a thread pool.
+//
+//   lab2_batch -o out/ -p linearContrast:2,98 -p gamma:0.8 -p otsu photos/ extra.jpg
+//   lab2_batch -o out/ -f contrast.pipeline photos/
+#include "Image.h"
+#include "ImageLoader.h"
+#include "Kernels.h"
+#include "Operations.h"
+#include "PipelinePlan.h"
+#include "PipelineScript.h"
+#include "ResultCache.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "../../lab1/utils/MemoryAccounting.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+    struct Options {
+        std::vector<std::string> inputs;
+        std::string outputDir;
+        std::vector<PipelineScript::Step> steps;
+        int threads = hardwareThreads();
+        std::string tracePath;
+        Image::SaveOptions save;
+        std::string cacheDir;
+        uint64_t cacheBytes = uint64_t(1) << 30;
+        int tileSize = 0;
+    };
+
+    struct Stats {
+        std::atomic<int> processed{0};
+        std::atomic<int> failed{0};
+        std::atomic<uint64_t> pixelBytes{0};
+        std::atomic<uint64_t> fileBytes{0};
+    };
+
+    // Limits how many images are being processed or saved at once, so they cannot pile up behind
+    // a slow encoder.
+    class InFlightLimit {
+    public:
+        explicit InFlightLimit(int limit) : available(limit) {}
+
+        void acquire() {
+            std::unique_lock<std::mutex> lock(mutex);
+            released.wait(lock, [this] { return available > 0; });
+            available--;
+        }
+
+        void release() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                available++;
+            }
+            released.notify_one();
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable released;
+        int available;
+    };
+
+    void printUsage() {
+        std::cout << "Usage: lab2_batch -o <output dir> [-p op[:arg,arg...]]... [-f file.pipeline] [-j threads] [-l list.txt]\n"
+                  << "                  [--format png|pnm|qoi|raw] [--png-level 0-9] [--cache dir] [--cache-size MB]\n"
+                  << "                  [--tiles size] [--trace trace.json] <inputs...>\n"
+                  << "Inputs are image files or directories. Results are written as PNG unless --format says otherwise;\n"
+                  << "--png-level trades file size (9) against encode time (1, or 0 for none). Results are named after\n"
+                  << "their inputs' stems, keeping the source extension where two stems match.\n"
+                  << "Steps from -p and -f run in the order given.\n"
+                  << "--cache keeps results in a directory, keyed by input pixels and steps, so reruns skip the\n"
+                  << "processing; --cache-size caps it (default 1024 MB), dropping the least recently used.\n"
+                  << "--tiles runs consecutive morphology steps on square tiles of that size (e.g. 64) instead of\n"
+                  << "rows, converting once for the whole run of them.\n"
+                  << "--trace writes a timeline of the run for chrome://tracing or ui.perfetto.dev.\n\n"
+                  << "Operations:\n";
+        for (const auto& info : Operations::list()) {
+            std::cout << "  " << info.usage << "\n";
+        }
+    }
+
+    // Adds the steps of a -p option ("gamma:0.8") or a -f file; throws with every problem found.
+    void addSteps(std::vector<PipelineScript::Step> steps, const std::vector<PipelineScript::Error>& errors,
+                  const std::string& source, Options& options) {
+        if (!errors.empty()) {
+            std::string message;
+            for (const auto& error : errors) {
+                message += "\n  " + source + ": " + PipelineScript::describe(error);
+            }
+            throw std::invalid_argument("invalid pipeline" + message);
+        }
+        options.steps.insert(options.steps.end(), steps.begin(), steps.end());
+    }
+
+    std::string lowercase(std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+        return text;
+    }
+
+    bool isImageFile(const fs::path& path) {
+        std::string ext = lowercase(path.extension().string());
+        for (const char* known : {".png", ".jpg", ".jpeg", ".bmp", ".tga", ".gif", ".psd", ".hdr", ".pnm", ".pgm", ".ppm", ".pam", ".qoi", ".raw"}) {
+            if (ext == known) return true;
+        }
+        return false;
+    }
+
+    std::vector<fs::path> collectFiles(const std::vector<std::string>& inputs) {
+        std::vector<fs::path> files;
+        for (const auto& input : inputs) {
+            std::error_code ec;
+            if (fs::is_directory(input, ec)) {
+                std::vector<fs::path> found;
+                for (const auto& entry : fs::directory_iterator(input, ec)) {
+                    if (entry.is_regular_file() && isImageFile(entry.path())) {
+                        found.push_back(entry.path());
+                    }
+                }
+                std::sort(found.begin(), found.end());
+                files.insert(files.end(), found.begin(), found.end());
+            } else {
+                files.emplace_back(input);
+            }
+        }
+        return files;
+    }
+
+    // Output path of each file, without the extension the format adds. Files are named after their
+    // stem; where stems clash (x.jpg next to x.png) the source extension is kept too. Files that
+    // would still share a name, like a/x.png and b/x.png, are an error: they would overwrite each
+    // other. Names are compared ignoring case, as some file systems do.
+    std::vector<fs::path> outputPaths(const std::vector<fs::path>& files, const fs::path& dir) {
+        std::map<std::string, std::vector<size_t>> byStem;
+        for (size_t i = 0; i < files.size(); i++) {
+            byStem[lowercase(files[i].stem().string())].push_back(i);
+        }
+
+        std::vector<std::string> names(files.size());
+        std::map<std::string, std::vector<size_t>> byName;
+        for (const auto& group : byStem) {
+            for (size_t i : group.second) {
+                names[i] = (group.second.size() == 1 ? files[i].stem() : files[i].filename()).string();
+                byName[lowercase(names[i])].push_back(i);
+            }
+        }
+
+        std::string message;
+        for (const auto& group : byName) {
+            if (group.second.size() < 2) continue;
+            message += "\n  " + names[group.second[0]] + ":";
+            for (size_t i : group.second) {
+                message += " " + files[i].string();
+            }
+        }
+        if (!message.empty()) throw std::invalid_argument("inputs would be written to the same output file" + message);
+
+        std::vector<fs::path> paths;
+        for (const auto& name : names) {
+            paths.push_back(dir / name);
+        }
+        return paths;
+    }
+
+    bool parseArguments(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::invalid_argument("missing value after " + arg);
+                return argv[++i];
+            };
+
+            if (arg == "-h" || arg == "--help") {
+                return false;
+            } else if (arg == "-o" || arg == "--output") {
+                options.outputDir = next();
+            } else if (arg == "-p" || arg == "--op") {
+                std::string spec = next();
+                std::vector<PipelineScript::Error> errors;
+                auto steps = PipelineScript::parse(spec, errors);
+                addSteps(std::move(steps), errors, "-p " + spec, options);
+            } else if (arg == "-f" || arg == "--pipeline") {
+                std::string path = next();
+                std::vector<PipelineScript::Error> errors;
+                auto steps = PipelineScript::load(path, errors);
+                addSteps(std::move(steps), errors, path, options);
+            } else if (arg == "-j" || arg == "--threads") {
+                options.threads = std::max(1, std::stoi(next()));
+            } else if (arg == "--format") {
+                std::string format = next();
+                options.save.format = Image::formatFor("." + format);
+                if (format != "png" && options.save.format == Image::SaveOptions::Format::PNG) {
+                    throw std::invalid_argument("unknown format " + format);
+                }
+            } else if (arg == "--png-level") {
+                options.save.pngLevel = std::clamp(std::stoi(next()), 0, 9);
+            } else if (arg == "--cache") {
+                options.cacheDir = next();
+            } else if (arg == "--cache-size") {
+                options.cacheBytes = static_cast<uint64_t>(std::max(0LL, std::stoll(next()))) << 20;
+            } else if (arg == "--tiles") {
+                options.tileSize = std::max(0, std::stoi(next()));
+            } else if (arg == "--trace") {
+                options.tracePath = next();
+            } else if (arg == "-l" || arg == "--list") {
+                std::ifstream list(next());
+                std::string line;
+                while (std::getline(list, line)) {
+                    if (!line.empty()) options.inputs.push_back(line);
+                }
+            } else {
+                options.inputs.push_back(arg);
+            }
+        }
+        return !options.outputDir.empty() && !options.inputs.empty();
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    try {
+        if (!parseArguments(argc, argv, options)) {
+            printUsage();
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::vector<fs::path> files = collectFiles(options.inputs);
+    std::vector<fs::path> outputs;
+    try {
+        outputs = outputPaths(files, options.outputDir);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    // Files are already encoded side by side, one per thread
+    options.save.threads = 1;
+    std::error_code ec;
+    fs::create_directories(options.outputDir, ec);
+
+    const PipelinePlan plan = PipelinePlan::compile(options.steps, options.tileSize);
+    std::cout << "Processing " << files.size() << " image(s) on " << options.threads << " thread(s), "
+              << plan.passCount() << " pass(es):" << std::endl;
+    for (const auto& line : plan.describe()) {
+        std::cout << "  " << line << std::endl;
+    }
+    std::cout << "Kernels: " << Kernels::describe(Kernels::active()) << std::endl;
+
+    Trace::setEnabled(!options.tracePath.empty());
+    Trace::setThreadName("main");
+    std::unique_ptr<ResultCache> cache;
+    if (!options.cacheDir.empty()) cache = std::make_unique<ResultCache>(options.cacheDir, options.cacheBytes);
+    const std::string operations = PipelineScript::format(options.steps);
+
+    Stats stats;
+    auto start = std::chrono::steady_clock::now();
+    {
+        // Files decode on the loader's threads, a few ahead of the pool, which runs process -> save
+        // as separate tasks, so disk, decode, processing and encode overlap.
+        std::vector<std::string> paths;
+        for (const auto& file : files) paths.push_back(file.string());
+        ImageLoader loader(std::move(paths), options.threads, options.threads * 2);
+        ThreadPool pool(options.threads);
+        InFlightLimit limit(options.threads * 2);
+
+        ImageLoader::Item item;
+        while (loader.next(item)) {
+            const fs::path& file = files[item.index];
+            if (!item.image) {
+                std::cerr << "Failed to load " << item.path << ": " << item.error << std::endl;
+                stats.failed++;
+                continue;
+            }
+            std::error_code sizeError;
+            uintmax_t size = fs::file_size(file, sizeError);
+            if (!sizeError) stats.fileBytes += size;
+
+            limit.acquire();
+            const fs::path& output = outputs[item.index];
+            std::shared_ptr<const Image> image = std::move(item.image);
+
+            pool.submit([&, image, file, output]() {
+                auto result = std::make_shared<Image>();
+                ResultCache::Key key;
+                bool cached = false;
+                try {
+                    if (cache) {
+                        key = ResultCache::key(*image, operations);
+                        cached = cache->find(key, *result);
+                    }
+                    if (!cached) *result = plan.run(*image);
+                } catch (const std::exception& e) {
+                    std::cerr << "Failed to process " << file.string() << ": " << e.what() << std::endl;
+                    stats.failed++;
+                    limit.release();
+                    return;
+                }
+                stats.pixelBytes += image->getByteSize();
+
+                pool.submit([&, result, key, cached, file, output]() {
+                    if (cache && !cached) cache->insert(key, *result);
+                    fs::path path = output;
+                    path += Image::extension(options.save.format, result->getChannels());
+                    if (result->save(path.string(), options.save)) {
+                        stats.processed++;
+                    } else {
+                        std::cerr << "Failed to save " << path.string() << std::endl;
+                        stats.failed++;
+                    }
+                    limit.release();
+                });
+            });
+        }
+        pool.wait();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double mb = 1024.0 * 1024.0;
+    std::printf("%d processed, %d failed in %.2f s\n", stats.processed.load(), stats.failed.load(), seconds);
+    std::printf("Throughput: %.2f images/s, %.1f MB/s decoded pixels, %.1f MB/s read from disk\n",
+                stats.processed / seconds, stats.pixelBytes / mb / seconds, stats.fileBytes / mb / seconds);
+    std::printf("Peak memory: %.1f MB of pixel buffers, %.1f MB of temporaries\n",
+                MemoryAccounting::usage(MemoryAccounting::Category::PixelBuffers).peak / mb,
+                MemoryAccounting::usage(MemoryAccounting::Category::Temporaries).peak / mb);
+    if (cache) {
+        ResultCache::Stats cacheStats = cache->stats();
+        std::printf("Cache: %llu hit(s), %llu miss(es), %llu evicted, %.1f MB in %zu result(s)\n",
+                    static_cast<unsigned long long>(cacheStats.hits), static_cast<unsigned long long>(cacheStats.misses),
+                    static_cast<unsigned long long>(cacheStats.evictions), cacheStats.bytes / mb, cacheStats.entries);
+    }
+    if (!options.tracePath.empty() && !Trace::exportChrome(options.tracePath)) {
+        std::cerr << "Failed to write " << options.tracePath << std::endl;
+    }
+    return stats.failed > 0 ? 2 : 0;
+}
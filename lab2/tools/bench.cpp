@@ -0,0 +1,437 @@
+// Microbenchmarks for the image operations: times every public function of PointOperations,
+// Histogram and ThresholdProcessing, Morphology on scanlines and on tiles, plus Image::clone/load/save
+// over a matrix of image sizes and channel counts, headless:
+//
+//   lab2_bench                                   all sizes (VGA to 100 MP), 1/3/4 channels
+//   lab2_bench --sizes vga,4k --channels 3 --filter gamma
+//   lab2_bench --sizes 4k --patterns noise,constant --filter Histogram
+//   lab2_bench --json before.json                one result per line, for diffing two builds
+#include "Histogram.h"
+#include "Image.h"
+#include "Morphology.h"
+#include "Parallel.h"
+#include "Pnm.h"
+#include "PointOperations.h"
+#include "SyntheticImage.h"
+#include "ThresholdProcessing.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+    struct Size {
+        const char* name;
+        int width;
+        int height;
+    };
+
+    const Size kSizes[] = {
+        {"vga", 640, 480},
+        {"hd", 1280, 720},
+        {"fhd", 1920, 1080},
+        {"4k", 3840, 2160},
+        {"24mp", 6000, 4000},
+        {"100mp", 12000, 8400},
+    };
+
+    // Bytes moved per pixel byte, for GB/s: operations reading one image and writing another move
+    // two, reductions (histograms, threshold searches) one, binary operations three.
+    enum class Traffic { Map = 2, Reduce = 1, Binary = 3 };
+
+    struct Benchmark {
+        std::string name;
+        Traffic traffic;
+        std::function<void(const Image& a, const Image& b)> run;
+    };
+
+    // Benchmarks on 256-entry tables and histograms, independent of the image size
+    struct TableBenchmark {
+        std::string name;
+        std::function<void()> run;
+    };
+
+    struct Options {
+        std::vector<Size> sizes;
+        std::vector<int> channels;
+        std::vector<SyntheticImage::Pattern> patterns;
+        std::string filter;
+        std::string jsonPath;
+        double minTime = 0.25;
+        int maxIterations = 1000;
+    };
+
+    struct Result {
+        std::string name;
+        std::string size;
+        std::string pattern;
+        int width;
+        int height;
+        int channels;
+        int iterations;
+        double medianNs;
+        double minNs;
+        double bytes;
+    };
+
+    // Keeps results observable so the calls are not optimised away
+    volatile unsigned sink;
+
+    void consume(const Image& image) {
+        sink += image.getData() ? image.getData()[0] : 0;
+    }
+
+    template <typename T>
+    void consume(const T& value) {
+        sink += static_cast<unsigned>(value[0]);
+    }
+
+    void consume(unsigned char value) {
+        sink += value;
+    }
+
+    std::vector<Benchmark> imageBenchmarks(const std::string& scratchFile, const std::string& pnmFile) {
+        using PO = PointOperations;
+        using TP = ThresholdProcessing;
+        const PO::LUT gamma = PO::gammaLUT(0.8f);
+
+        return {
+            {"PointOperations::linearContrast", Traffic::Map, [](const Image& a, const Image&) { consume(PO::linearContrast(a)); }},
+            {"PointOperations::linearContrastManual", Traffic::Map, [](const Image& a, const Image&) { consume(PO::linearContrastManual(a, 20, 220)); }},
+            {"PointOperations::adjustBrightnessContrast", Traffic::Map, [](const Image& a, const Image&) { consume(PO::adjustBrightnessContrast(a, 10.0f, 1.2f)); }},
+            {"PointOperations::gammaCorrection", Traffic::Map, [](const Image& a, const Image&) { consume(PO::gammaCorrection(a, 0.8f)); }},
+            {"PointOperations::logarithmicTransform", Traffic::Map, [](const Image& a, const Image&) { consume(PO::logarithmicTransform(a)); }},
+            {"PointOperations::powerTransform", Traffic::Map, [](const Image& a, const Image&) { consume(PO::powerTransform(a, 1.5f)); }},
+            {"PointOperations::invert", Traffic::Map, [](const Image& a, const Image&) { consume(PO::invert(a)); }},
+            {"PointOperations::clipBrightness", Traffic::Map, [](const Image& a, const Image&) { consume(PO::clipBrightness(a, 30, 200)); }},
+            {"PointOperations::quantize", Traffic::Map, [](const Image& a, const Image&) { consume(PO::quantize(a, 8)); }},
+            {"PointOperations::bitwiseAND", Traffic::Binary, [](const Image& a, const Image& b) { consume(PO::bitwiseAND(a, b)); }},
+            {"PointOperations::bitwiseOR", Traffic::Binary, [](const Image& a, const Image& b) { consume(PO::bitwiseOR(a, b)); }},
+            {"PointOperations::bitwiseXOR", Traffic::Binary, [](const Image& a, const Image& b) { consume(PO::bitwiseXOR(a, b)); }},
+            {"PointOperations::bitwiseNOT", Traffic::Map, [](const Image& a, const Image&) { consume(PO::bitwiseNOT(a)); }},
+            {"PointOperations::applyLUT", Traffic::Map, [gamma](const Image& a, const Image&) { consume(PO::applyLUT(a, gamma)); }},
+            {"PointOperations::applyLUT(into)", Traffic::Map, [gamma](const Image& a, const Image&) {
+                static Image result;
+                PO::applyLUT(a, gamma, result);
+                consume(result);
+            }},
+
+            {"Histogram::compute", Traffic::Reduce, [](const Image& a, const Image&) { consume(Histogram::compute(a)); }},
+            {"Histogram::compute(channel)", Traffic::Reduce, [](const Image& a, const Image&) { consume(Histogram::compute(a, 0)); }},
+            {"Histogram::computeLuminance", Traffic::Reduce, [](const Image& a, const Image&) { consume(Histogram::computeLuminance(a)); }},
+            {"Histogram::equalizeRGB", Traffic::Map, [](const Image& a, const Image&) { consume(Histogram::equalizeRGB(a)); }},
+            {"Histogram::equalizeHSV", Traffic::Map, [](const Image& a, const Image&) { consume(Histogram::equalizeHSV(a)); }},
+            {"Histogram::linearContrast", Traffic::Map, [](const Image& a, const Image&) { consume(Histogram::linearContrast(a)); }},
+            {"Histogram::linearContrastManual", Traffic::Map, [](const Image& a, const Image&) { consume(Histogram::linearContrastManual(a, 20, 220)); }},
+
+            {"ThresholdProcessing::otsuThreshold", Traffic::Map, [](const Image& a, const Image&) { consume(TP::otsuThreshold(a)); }},
+            {"ThresholdProcessing::calculateOtsuThreshold", Traffic::Reduce, [](const Image& a, const Image&) { consume(TP::calculateOtsuThreshold(a)); }},
+            {"ThresholdProcessing::triangleThreshold", Traffic::Map, [](const Image& a, const Image&) { consume(TP::triangleThreshold(a)); }},
+            {"ThresholdProcessing::calculateTriangleThreshold", Traffic::Reduce, [](const Image& a, const Image&) { consume(TP::calculateTriangleThreshold(a)); }},
+            {"ThresholdProcessing::fixedThreshold", Traffic::Map, [](const Image& a, const Image&) { consume(TP::fixedThreshold(a, 128)); }},
+            {"ThresholdProcessing::doubleThreshold", Traffic::Map, [](const Image& a, const Image&) { consume(TP::doubleThreshold(a, 80, 170)); }},
+            {"ThresholdProcessing::computeHistogram", Traffic::Reduce, [](const Image& a, const Image&) { consume(TP::computeHistogram(a)); }},
+
+            {"Morphology::open", Traffic::Map, [](const Image& a, const Image&) { consume(Morphology::open(a, 5, 5)); }},
+            {"Morphology::open(31x31)", Traffic::Map, [](const Image& a, const Image&) { consume(Morphology::open(a, 31, 31)); }},
+            // Including both conversions, as PipelinePlan pays them for a run of tiled steps
+            {"Morphology::open(tiles)", Traffic::Map, [](const Image& a, const Image&) {
+                consume(Morphology::open(TiledImage::fromImage(a), 5, 5).toImage());
+            }},
+            {"Morphology::open(tiles, 31x31)", Traffic::Map, [](const Image& a, const Image&) {
+                consume(Morphology::open(TiledImage::fromImage(a), 31, 31).toImage());
+            }},
+
+            {"Image::clone", Traffic::Map, [](const Image& a, const Image&) { consume(a.clone()); }},
+            // PNG at the default level, so these measure the codec more than the copy
+            {"Image::save", Traffic::Reduce, [scratchFile](const Image& a, const Image&) {
+                if (!a.save(scratchFile)) throw std::runtime_error("cannot write " + scratchFile);
+            }},
+            {"Image::load", Traffic::Reduce, [scratchFile](const Image&, const Image&) {
+                Image loaded;
+                if (!loaded.load(scratchFile)) throw std::runtime_error("cannot read " + scratchFile);
+                consume(loaded);
+            }},
+            // Mapped, so the pixels are read only when touched; one byte per page pays for all of them
+            {"Image::load(PNM)", Traffic::Reduce, [pnmFile](const Image&, const Image&) {
+                Image loaded;
+                if (!loaded.load(pnmFile)) throw std::runtime_error("cannot read " + pnmFile);
+                size_t bytes = loaded.getByteSize();
+                unsigned sum = 0;
+                for (size_t i = 0; i < bytes; i += 4096) sum += loaded.getData()[i];
+                consume(static_cast<unsigned char>(sum));
+            }},
+        };
+    }
+
+    void writePnm(const std::string& path, const Image& image) {
+        FILE* file = std::fopen(path.c_str(), "wb");
+        bool written = file && Pnm::write(file, image, Pnm::Format());
+        if (file && std::fclose(file) != 0) written = false;
+        if (!written) throw std::runtime_error("cannot write " + path);
+    }
+
+    std::vector<TableBenchmark> tableBenchmarks() {
+        using PO = PointOperations;
+        Histogram::Counts hist;
+        for (int i = 0; i < 256; i++) {
+            // Two humps, the shape threshold searches are made for
+            hist[i] = 1000 + 800 * ((i / 32) % 4 == 1) + 1200 * ((i / 32) % 4 == 2);
+        }
+        const PO::LUT gamma = PO::gammaLUT(0.8f);
+        const PO::LUT invert = PO::invertLUT();
+
+        return {
+            {"PointOperations::identityLUT", []() { consume(PO::identityLUT()); }},
+            {"PointOperations::linearContrastLUT", []() { consume(PO::linearContrastLUT(20, 220)); }},
+            {"PointOperations::percentileContrastLUT", [hist]() { consume(PO::percentileContrastLUT(hist, 2.0f, 98.0f)); }},
+            {"PointOperations::brightnessContrastLUT", []() { consume(PO::brightnessContrastLUT(10.0f, 1.2f)); }},
+            {"PointOperations::gammaLUT", []() { consume(PO::gammaLUT(0.8f)); }},
+            {"PointOperations::logarithmicLUT", []() { consume(PO::logarithmicLUT()); }},
+            {"PointOperations::powerLUT", []() { consume(PO::powerLUT(1.5f)); }},
+            {"PointOperations::invertLUT", []() { consume(PO::invertLUT()); }},
+            {"PointOperations::clipLUT", []() { consume(PO::clipLUT(30, 200)); }},
+            {"PointOperations::quantizeLUT", []() { consume(PO::quantizeLUT(8)); }},
+            {"PointOperations::composeLUT", [gamma, invert]() { consume(PO::composeLUT(gamma, invert)); }},
+            {"Histogram::equalizationLUT", [hist]() { consume(Histogram::equalizationLUT(hist)); }},
+            {"ThresholdProcessing::calculateOtsuThreshold(hist)", [hist]() { consume(ThresholdProcessing::calculateOtsuThreshold(hist)); }},
+            {"ThresholdProcessing::calculateTriangleThreshold(hist)", [hist]() { consume(ThresholdProcessing::calculateTriangleThreshold(hist)); }},
+        };
+    }
+
+    // Runs `body` until minTime has passed (at least once, at most maxIterations times); the first
+    // run is a warm-up unless it alone took longer than minTime.
+    template <typename Body>
+    std::vector<double> measure(const Options& options, Body body) {
+        using Clock = std::chrono::steady_clock;
+        std::vector<double> samples;
+        double total = 0.0;
+        while (samples.size() < static_cast<size_t>(options.maxIterations) && (samples.empty() || total < options.minTime)) {
+            auto start = Clock::now();
+            body();
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            samples.push_back(seconds * 1e9);
+            total += seconds;
+        }
+        if (samples.size() > 2) samples.erase(samples.begin());
+        std::sort(samples.begin(), samples.end());
+        return samples;
+    }
+
+    Result summarize(const std::string& name, const std::string& size, int width, int height, int channels,
+                     double bytes, std::vector<double> samples) {
+        Result result;
+        result.name = name;
+        result.size = size;
+        result.width = width;
+        result.height = height;
+        result.channels = channels;
+        result.iterations = static_cast<int>(samples.size());
+        result.medianNs = samples[samples.size() / 2];
+        result.minNs = samples.front();
+        result.bytes = bytes;
+        return result;
+    }
+
+    void printResult(FILE* out, const Result& r) {
+        double pixels = static_cast<double>(r.width) * r.height;
+        double gbps = r.bytes / r.medianNs;
+        std::fprintf(out, "%-52s %6s %-12s %2d %6d %12.3f %10.3f %9.2f\n", r.name.c_str(), r.size.c_str(), r.pattern.c_str(), r.channels,
+                    r.iterations, r.medianNs / 1e6, r.medianNs / pixels, gbps);
+        std::fflush(out);
+    }
+
+    std::string jsonString(const std::string& s) {
+        std::string out = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    }
+
+    // One result per line with fixed key order, so two runs can be compared with diff
+    bool writeJson(const std::string& path, const std::vector<Result>& results) {
+        std::ostringstream out;
+        out << "{\n  \"tool\": \"lab2_bench\",\n"
+#ifdef __VERSION__
+            << "  \"compiler\": " << jsonString(__VERSION__) << ",\n"
+#endif
+#ifdef NDEBUG
+            << "  \"assertions\": false,\n"
+#else
+            << "  \"assertions\": true,\n"
+#endif
+            << "  \"hardware_threads\": " << hardwareThreads() << ",\n"
+            << "  \"results\": [\n";
+
+        char line[512];
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& r = results[i];
+            double pixels = static_cast<double>(r.width) * r.height;
+            std::snprintf(line, sizeof(line),
+                          "    {\"name\": %s, \"size\": \"%s\", \"pattern\": \"%s\", \"width\": %d, \"height\": %d, \"channels\": %d, "
+                          "\"iterations\": %d, \"median_ns\": %.0f, \"min_ns\": %.0f, \"ns_per_pixel\": %.4f, \"gb_per_s\": %.3f}%s\n",
+                          jsonString(r.name).c_str(), r.size.c_str(), r.pattern.c_str(), r.width, r.height, r.channels, r.iterations,
+                          r.medianNs, r.minNs, r.medianNs / pixels, r.bytes / r.medianNs,
+                          i + 1 < results.size() ? "," : "");
+            out << line;
+        }
+        out << "  ]\n}\n";
+
+        if (path == "-") {
+            std::cout << out.str();
+            return true;
+        }
+        std::ofstream file(path);
+        file << out.str();
+        return static_cast<bool>(file);
+    }
+
+    void printUsage() {
+        std::cerr << "Usage: lab2_bench [--sizes vga,hd,fhd,4k,24mp,100mp] [--channels 1,3,4] [--filter text]\n"
+                  << "                  [--patterns name,...] [--min-time seconds] [--json file|-]\n"
+                  << "Times the image operations on generated images and reports ns/pixel and GB/s.\n"
+                  << "Patterns:";
+        for (auto pattern : SyntheticImage::patterns()) {
+            std::cerr << " " << SyntheticImage::name(pattern);
+        }
+        std::cerr << " (default noise)\n";
+    }
+
+    std::vector<std::string> split(const std::string& list) {
+        std::vector<std::string> items;
+        std::stringstream stream(list);
+        std::string item;
+        while (std::getline(stream, item, ',')) {
+            if (!item.empty()) items.push_back(item);
+        }
+        return items;
+    }
+
+    bool parseArguments(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) return false;
+            std::string value = argv[++i];
+
+            if (arg == "--sizes") {
+                for (const auto& name : split(value)) {
+                    auto it = std::find_if(std::begin(kSizes), std::end(kSizes),
+                                           [&](const Size& size) { return name == size.name; });
+                    if (it == std::end(kSizes)) {
+                        std::cerr << "Error: unknown size '" << name << "'" << std::endl;
+                        return false;
+                    }
+                    options.sizes.push_back(*it);
+                }
+            } else if (arg == "--channels") {
+                for (const auto& channels : split(value)) {
+                    int c = std::atoi(channels.c_str());
+                    if (c < 1 || c > 4) return false;
+                    options.channels.push_back(c);
+                }
+            } else if (arg == "--patterns") {
+                for (const auto& name : split(value)) {
+                    SyntheticImage::Pattern pattern;
+                    if (!SyntheticImage::parse(name, pattern)) {
+                        std::cerr << "Error: unknown pattern '" << name << "'" << std::endl;
+                        return false;
+                    }
+                    options.patterns.push_back(pattern);
+                }
+            } else if (arg == "--filter") {
+                options.filter = value;
+            } else if (arg == "--min-time") {
+                options.minTime = std::max(0.0, std::atof(value.c_str()));
+            } else if (arg == "--json") {
+                options.jsonPath = value;
+            } else {
+                return false;
+            }
+        }
+        if (options.sizes.empty()) options.sizes.assign(std::begin(kSizes), std::end(kSizes));
+        if (options.channels.empty()) options.channels = {1, 3, 4};
+        if (options.patterns.empty()) options.patterns = {SyntheticImage::Pattern::UniformNoise};
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    // With JSON on stdout the table goes to stderr
+    FILE* table = options.jsonPath == "-" ? stderr : stdout;
+
+    std::string scratchFile = (fs::temp_directory_path() / ("lab2_bench_" + std::to_string(getpid()) + ".png")).string();
+    std::string pnmFile = (fs::temp_directory_path() / ("lab2_bench_" + std::to_string(getpid()) + ".pnm")).string();
+    auto selected = [&](const std::string& name) {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    };
+
+    std::vector<Result> results;
+    std::fprintf(table, "%-52s %6s %-12s %2s %6s %12s %10s %9s\n", "operation", "size", "pattern", "ch", "iters", "median ms", "ns/pixel", "GB/s");
+
+    for (const auto& lookup : tableBenchmarks()) {
+        if (!selected(lookup.name)) continue;
+        results.push_back(summarize(lookup.name, "table", 256, 1, 1, 256.0, measure(options, lookup.run)));
+        results.back().pattern = "-";
+        printResult(table, results.back());
+    }
+
+    auto benchmarks = imageBenchmarks(scratchFile, pnmFile);
+    int status = 0;
+    for (const Size& size : options.sizes) {
+        for (int channels : options.channels) {
+            for (auto pattern : options.patterns) {
+                Image a = SyntheticImage::generate(pattern, size.width, size.height, channels, 1);
+                Image b = SyntheticImage::generate(pattern, size.width, size.height, channels, 2);
+                double imageBytes = static_cast<double>(size.width) * size.height * channels;
+                bool scratchWritten = false;
+
+                for (const auto& benchmark : benchmarks) {
+                    if (!selected(benchmark.name)) continue;
+                    try {
+                        if (benchmark.name == "Image::load" && !scratchWritten && !a.save(scratchFile)) {
+                            throw std::runtime_error("cannot write " + scratchFile);
+                        }
+                        if (benchmark.name == "Image::load(PNM)") writePnm(pnmFile, a);
+                        auto samples = measure(options, [&]() { benchmark.run(a, b); });
+                        if (benchmark.name == "Image::save") scratchWritten = true;
+                        results.push_back(summarize(benchmark.name, size.name, size.width, size.height, channels,
+                                                    imageBytes * static_cast<int>(benchmark.traffic), std::move(samples)));
+                        results.back().pattern = SyntheticImage::name(pattern);
+                        printResult(table, results.back());
+                    } catch (const std::exception& e) {
+                        std::cerr << "Error: " << benchmark.name << ": " << e.what() << std::endl;
+                        status = 2;
+                    }
+                }
+            }
+        }
+    }
+    std::remove(scratchFile.c_str());
+    std::remove(pnmFile.c_str());
+
+    if (!options.jsonPath.empty() && !writeJson(options.jsonPath, results)) {
+        std::cerr << "Error: cannot write " << options.jsonPath << std::endl;
+        return 2;
+    }
+    return status;
+}
@@ -0,0 +1,437 @@
+// Conformance check for the kernel backends: runs every image function of PointOperations, Histogram
+// and ThresholdProcessing, plus the fused PipelinePlan passes and tiled morphology, on random images
+// with each instruction set the CPU supports and with rows split over several threads, and compares
+// every output byte for byte with the scalar, single-threaded one. Then times each backend against
+// scalar.
+//
+//   lab2_conformance                              200 random cases, seed 1, timed on FHD
+//   lab2_conformance --cases 2000 --seed 42 --filter Threshold
+//   lab2_conformance --time-size 0                compare only
+//   lab2_conformance --large                      64-bit checks on an image past 2 GB instead
+//
+// Exits with status 1 when any backend disagrees with scalar or a large-image check fails.
+#include "Histogram.h"
+#include "Image.h"
+#include "Kernels.h"
+#include "Parallel.h"
+#include "PipelinePlan.h"
+#include "PipelineScript.h"
+#include "PointOperations.h"
+#include "SyntheticImage.h"
+#include "ThresholdProcessing.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    using Output = std::vector<unsigned char>;
+
+    struct Case {
+        std::string name;
+        std::function<Output(const Image& a, const Image& b)> run;
+    };
+
+    struct Backend {
+        std::string name;
+        Kernels::ISA isa;
+        int threads;
+    };
+
+    struct Options {
+        int cases = 200;
+        uint64_t seed = 1;
+        std::string filter;
+        int timeWidth = 1920;
+        int timeHeight = 1080;
+        int timeChannels = 3;
+        double minTime = 0.2;
+        bool large = false;
+    };
+
+    // Dimensions and channel count first, so images that differ only in shape still differ
+    Output bytes(const Image& image) {
+        Output out;
+        for (int value : {image.getWidth(), image.getHeight(), image.getChannels()}) {
+            out.insert(out.end(), reinterpret_cast<const unsigned char*>(&value), reinterpret_cast<const unsigned char*>(&value) + sizeof(value));
+        }
+        if (image.getData()) {
+            out.insert(out.end(), image.getData(), image.getData() + image.getByteSize());
+        }
+        return out;
+    }
+
+    template <typename T>
+    Output bytes(const T& value) {
+        const unsigned char* begin = reinterpret_cast<const unsigned char*>(&value);
+        return Output(begin, begin + sizeof(value));
+    }
+
+    PipelinePlan plan(const std::string& script, int tileSize = 0) {
+        std::vector<PipelineScript::Error> errors;
+        return PipelinePlan::compile(PipelineScript::parse(script, errors), tileSize);
+    }
+
+    std::vector<Case> cases() {
+        using PO = PointOperations;
+        using TP = ThresholdProcessing;
+        const PO::LUT gamma = PO::gammaLUT(0.8f);
+        // LUT passes feeding a histogram or a threshold, which PipelinePlan fuses into one pass
+        const PipelinePlan gammaStretch = plan("gamma 0.8 -> linearContrast");
+        const PipelinePlan gammaOtsu = plan("gamma 0.8 -> otsu");
+        const PipelinePlan invertTriangle = plan("invert -> triangle");
+        // Tiles smaller than most test images, so bands of tiles and halos across them are exercised
+        const PipelinePlan tiledOpenDilate = plan("open 5 3 -> dilate 7 9", 16);
+
+        return {
+            {"PointOperations::linearContrast", [](const Image& a, const Image&) { return bytes(PO::linearContrast(a)); }},
+            {"PointOperations::linearContrastManual", [](const Image& a, const Image&) { return bytes(PO::linearContrastManual(a, 20, 220)); }},
+            {"PointOperations::adjustBrightnessContrast", [](const Image& a, const Image&) { return bytes(PO::adjustBrightnessContrast(a, 10.0f, 1.2f)); }},
+            {"PointOperations::gammaCorrection", [](const Image& a, const Image&) { return bytes(PO::gammaCorrection(a, 0.8f)); }},
+            {"PointOperations::logarithmicTransform", [](const Image& a, const Image&) { return bytes(PO::logarithmicTransform(a)); }},
+            {"PointOperations::powerTransform", [](const Image& a, const Image&) { return bytes(PO::powerTransform(a, 1.5f)); }},
+            {"PointOperations::invert", [](const Image& a, const Image&) { return bytes(PO::invert(a)); }},
+            {"PointOperations::clipBrightness", [](const Image& a, const Image&) { return bytes(PO::clipBrightness(a, 30, 200)); }},
+            {"PointOperations::quantize", [](const Image& a, const Image&) { return bytes(PO::quantize(a, 8)); }},
+            {"PointOperations::bitwiseAND", [](const Image& a, const Image& b) { return bytes(PO::bitwiseAND(a, b)); }},
+            {"PointOperations::bitwiseOR", [](const Image& a, const Image& b) { return bytes(PO::bitwiseOR(a, b)); }},
+            {"PointOperations::bitwiseXOR", [](const Image& a, const Image& b) { return bytes(PO::bitwiseXOR(a, b)); }},
+            {"PointOperations::bitwiseNOT", [](const Image& a, const Image&) { return bytes(PO::bitwiseNOT(a)); }},
+            {"PointOperations::applyLUT", [gamma](const Image& a, const Image&) { return bytes(PO::applyLUT(a, gamma)); }},
+            {"PointOperations::applyLUT(in place)", [gamma](const Image& a, const Image&) {
+                Image result = a.clone();
+                PO::applyLUT(result, gamma, result);
+                return bytes(result);
+            }},
+
+            {"Histogram::compute", [](const Image& a, const Image&) { return bytes(Histogram::compute(a)); }},
+            {"Histogram::compute(channel)", [](const Image& a, const Image&) { return bytes(Histogram::compute(a, a.getChannels() - 1)); }},
+            {"Histogram::computeLuminance", [](const Image& a, const Image&) { return bytes(Histogram::computeLuminance(a)); }},
+            {"Histogram::equalizeRGB", [](const Image& a, const Image&) { return bytes(Histogram::equalizeRGB(a)); }},
+            {"Histogram::equalizeHSV", [](const Image& a, const Image&) { return bytes(Histogram::equalizeHSV(a)); }},
+            {"Histogram::linearContrast", [](const Image& a, const Image&) { return bytes(Histogram::linearContrast(a)); }},
+            {"Histogram::linearContrastManual", [](const Image& a, const Image&) { return bytes(Histogram::linearContrastManual(a, 20, 220)); }},
+
+            {"ThresholdProcessing::otsuThreshold", [](const Image& a, const Image&) { return bytes(TP::otsuThreshold(a)); }},
+            {"ThresholdProcessing::calculateOtsuThreshold", [](const Image& a, const Image&) { return bytes(TP::calculateOtsuThreshold(a)); }},
+            {"ThresholdProcessing::triangleThreshold", [](const Image& a, const Image&) { return bytes(TP::triangleThreshold(a)); }},
+            {"ThresholdProcessing::calculateTriangleThreshold", [](const Image& a, const Image&) { return bytes(TP::calculateTriangleThreshold(a)); }},
+            {"ThresholdProcessing::fixedThreshold", [](const Image& a, const Image&) { return bytes(TP::fixedThreshold(a, 128)); }},
+            {"ThresholdProcessing::doubleThreshold", [](const Image& a, const Image&) { return bytes(TP::doubleThreshold(a, 80, 170)); }},
+            {"ThresholdProcessing::computeHistogram", [](const Image& a, const Image&) { return bytes(TP::computeHistogram(a)); }},
+
+            {"PipelinePlan(gamma -> linearContrast)", [gammaStretch](const Image& a, const Image&) { return bytes(gammaStretch.run(a)); }},
+            {"PipelinePlan(gamma -> otsu)", [gammaOtsu](const Image& a, const Image&) { return bytes(gammaOtsu.run(a)); }},
+            {"PipelinePlan(invert -> triangle)", [invertTriangle](const Image& a, const Image&) { return bytes(invertTriangle.run(a)); }},
+            {"PipelinePlan(tiles: open -> dilate)", [tiledOpenDilate](const Image& a, const Image&) { return bytes(tiledOpenDilate.run(a)); }},
+        };
+    }
+
+    // Scalar on one thread is the reference; the threaded backend uses the best instruction set and
+    // at least four bands, so band boundaries are exercised on machines with fewer cores as well.
+    std::vector<Backend> backends() {
+        std::vector<Backend> list;
+        for (Kernels::ISA isa : Kernels::supported()) {
+            list.push_back({Kernels::name(isa), isa, 1});
+        }
+        int threads = std::max(4, hardwareThreads());
+        list.push_back({list.back().name + " x" + std::to_string(threads), list.back().isa, threads});
+        return list;
+    }
+
+    void use(const Backend& backend) {
+        Kernels::select(backend.isa);
+        Kernels::setThreads(backend.threads);
+    }
+
+    // An exception is an output too, so a backend that throws where scalar does not is a mismatch
+    Output run(const Case& c, const Image& a, const Image& b) {
+        try {
+            return c.run(a, b);
+        } catch (const std::exception& e) {
+            std::string message = std::string("exception: ") + e.what();
+            return Output(message.begin(), message.end());
+        }
+    }
+
+    struct Shape {
+        int width;
+        int height;
+    };
+
+    // Fixed shapes first: single pixels, single rows and columns, widths around the vector lengths
+    // and heights that split into uneven bands. Random shapes up to 300x200 follow.
+    Shape shape(int index, std::mt19937_64& random) {
+        static const Shape fixed[] = {
+            {1, 1}, {2, 3}, {7, 5}, {15, 1}, {1, 17}, {16, 16}, {31, 33}, {33, 17}, {63, 64}, {65, 40},
+            {101, 63}, {127, 97}, {129, 65}, {257, 129},
+        };
+        const int fixedCount = static_cast<int>(sizeof(fixed) / sizeof(fixed[0]));
+        if (index < fixedCount) return fixed[index];
+        return {1 + static_cast<int>(random() % 300), 1 + static_cast<int>(random() % 200)};
+    }
+
+    size_t firstDifference(const Output& a, const Output& b) {
+        size_t common = std::min(a.size(), b.size());
+        size_t i = 0;
+        while (i < common && a[i] == b[i]) i++;
+        return i;
+    }
+
+    bool matches(const std::string& name, const std::string& filter) {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+
+    // Returns the number of mismatching (case, image, backend) triples
+    int compare(const Options& options, const std::vector<Case>& list, const std::vector<Backend>& backendList) {
+        const int channelChoices[] = {1, 3, 4};
+        const std::vector<SyntheticImage::Pattern> patterns = SyntheticImage::patterns();
+        std::mt19937_64 random(options.seed);
+        int mismatches = 0;
+        int comparisons = 0;
+
+        for (int i = 0; i < options.cases; i++) {
+            Shape size = shape(i, random);
+            int channels = channelChoices[random() % 3];
+            // The second operand of the bitwise operations has its own channel count
+            int channelsB = channelChoices[random() % 3];
+            SyntheticImage::Pattern pattern = patterns[random() % patterns.size()];
+            uint64_t seed = random();
+            Image a = SyntheticImage::generate(pattern, size.width, size.height, channels, seed);
+            Image b = SyntheticImage::generate(SyntheticImage::Pattern::UniformNoise, size.width, size.height, channelsB, seed + 1);
+
+            for (const Case& c : list) {
+                if (!matches(c.name, options.filter)) continue;
+                use(backendList[0]);
+                Output reference = run(c, a, b);
+                for (size_t k = 1; k < backendList.size(); k++) {
+                    use(backendList[k]);
+                    Output output = run(c, a, b);
+                    comparisons++;
+                    if (output == reference) continue;
+
+                    mismatches++;
+                    size_t at = firstDifference(reference, output);
+                    std::fprintf(stdout, "MISMATCH %s [%s] %dx%dx%d (b: %d channels) %s seed %llu: ", c.name.c_str(),
+                                 backendList[k].name.c_str(), size.width, size.height, channels, channelsB,
+                                 SyntheticImage::name(pattern).c_str(), static_cast<unsigned long long>(seed));
+                    if (at < reference.size() && at < output.size()) {
+                        std::fprintf(stdout, "byte %zu is %d, scalar %d\n", at, output[at], reference[at]);
+                    } else {
+                        std::fprintf(stdout, "%zu bytes, scalar %zu\n", output.size(), reference.size());
+                    }
+                }
+            }
+        }
+
+        std::printf("%d comparisons over %d images, %d mismatches\n", comparisons, options.cases, mismatches);
+        return mismatches;
+    }
+
+    // Median milliseconds per call, running for at least minTime
+    double time(const Options& options, const Case& c, const Image& a, const Image& b) {
+        using Clock = std::chrono::steady_clock;
+        std::vector<double> samples;
+        double total = 0.0;
+        while (samples.empty() || (total < options.minTime && samples.size() < 1000)) {
+            auto start = Clock::now();
+            run(c, a, b);
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            samples.push_back(seconds * 1e3);
+            total += seconds;
+        }
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+
+    void timeBackends(const Options& options, const std::vector<Case>& list, const std::vector<Backend>& backendList) {
+        Image a = SyntheticImage::generate(SyntheticImage::Pattern::UniformNoise, options.timeWidth, options.timeHeight, options.timeChannels, options.seed);
+        Image b = SyntheticImage::generate(SyntheticImage::Pattern::UniformNoise, options.timeWidth, options.timeHeight, options.timeChannels, options.seed + 1);
+
+        std::printf("\n%dx%dx%d, ms per call and speedup over scalar\n%-52s", options.timeWidth, options.timeHeight,
+                    options.timeChannels, "operation");
+        for (const Backend& backend : backendList) {
+            std::printf(" %18s", backend.name.c_str());
+        }
+        std::printf("\n");
+
+        for (const Case& c : list) {
+            if (!matches(c.name, options.filter)) continue;
+            std::printf("%-52s", c.name.c_str());
+            double scalar = 0.0;
+            for (const Backend& backend : backendList) {
+                use(backend);
+                double ms = time(options, c, a, b);
+                if (scalar == 0.0) scalar = ms;
+                std::printf(" %9.3f (%5.1fx)", ms, scalar / ms);
+            }
+            std::printf("\n");
+            std::fflush(stdout);
+        }
+    }
+
+    // Every row of the large image holds one value, so the expected histogram follows from the rows
+    unsigned char largeRowValue(int y) {
+        return static_cast<unsigned char>(y % 3 == 0 ? 180 + (y / 3) % 40 : 30 + y % 50);
+    }
+
+    // The 64-bit paths on a single-channel image of 2^31 + 64K bytes: histogram totals, thresholds
+    // from counts past 2^32, an in-place LUT up to the last byte, and a raw save mapped back in.
+    // Returns the number of failed checks.
+    int checkLarge(const std::vector<Backend>& backendList) {
+        using PO = PointOperations;
+        using TP = ThresholdProcessing;
+        // A power of two, so the image's counts are the per-row counts scaled exactly and the
+        // thresholds must come out the same as from the rows
+        const int width = 1 << 16;
+        const int height = (1 << 15) + 1;
+        int failures = 0;
+        auto check = [&](bool ok, const std::string& what) {
+            std::printf("%-64s %s\n", what.c_str(), ok ? "ok" : "FAILED");
+            std::fflush(stdout);
+            if (!ok) failures++;
+        };
+
+        Image image(width, height, 1);
+        Histogram::Counts rows = {0};
+        for (int y = 0; y < height; y++) {
+            unsigned char value = largeRowValue(y);
+            std::memset(image.getData() + static_cast<size_t>(y) * width, value, width);
+            rows[value]++;
+        }
+        Histogram::Counts expected = {0};
+        for (int i = 0; i < 256; i++) {
+            expected[i] = rows[i] * width;
+        }
+        const unsigned char otsu = TP::calculateOtsuThreshold(rows);
+        const unsigned char triangle = TP::calculateTriangleThreshold(rows);
+        std::printf("%dx%dx1, %zu bytes; thresholds from the rows: otsu %d, triangle %d\n", width, height,
+                    image.getByteSize(), otsu, triangle);
+
+        // Counts past 2^32 in every occupied bin
+        Histogram::Counts huge = {0};
+        for (int i = 0; i < 256; i++) {
+            huge[i] = rows[i] << 24;
+        }
+        check(TP::calculateOtsuThreshold(huge) == otsu, "calculateOtsuThreshold(counts past 2^32)");
+        check(TP::calculateTriangleThreshold(huge) == triangle, "calculateTriangleThreshold(counts past 2^32)");
+
+        // Per pixel, without kernels, so once is enough
+        Histogram::Counts hist = Histogram::compute(image, 0);
+        uint64_t total = 0;
+        for (uint64_t count : hist) total += count;
+        check(total == static_cast<uint64_t>(width) * height, "Histogram::compute(channel) total");
+        check(hist == expected, "Histogram::compute(channel) counts");
+
+        for (const Backend& backend : backendList) {
+            use(backend);
+            const std::string suffix = " [" + backend.name + "]";
+            Histogram::Counts counts = TP::computeHistogram(image);
+            check(counts == expected, "ThresholdProcessing::computeHistogram" + suffix);
+            check(TP::calculateOtsuThreshold(counts) == otsu, "ThresholdProcessing::calculateOtsuThreshold" + suffix);
+            check(TP::calculateTriangleThreshold(counts) == triangle, "ThresholdProcessing::calculateTriangleThreshold" + suffix);
+        }
+
+        // In place with the last backend; the first and last byte of every row, the image's last included
+        const PO::LUT invert = PO::invertLUT();
+        PO::applyLUT(image, invert, image);
+        bool inverted = true;
+        for (int y = 0; y < height && inverted; y++) {
+            const unsigned char* row = image.getData() + static_cast<size_t>(y) * width;
+            unsigned char value = invert[largeRowValue(y)];
+            inverted = row[0] == value && row[width - 1] == value;
+        }
+        check(inverted, "PointOperations::applyLUT(in place) [" + backendList.back().name + "]");
+        check(image.getData()[image.getByteSize() - 1] == invert[largeRowValue(height - 1)], "PointOperations::applyLUT last byte");
+        use(backendList[0]);
+
+        const std::string path = (std::filesystem::temp_directory_path() / "lab2_conformance_large.raw").string();
+        Image::SaveOptions raw;
+        raw.format = Image::SaveOptions::Format::Raw;
+        bool saved = image.save(path, raw);
+        check(saved, "Image::save raw");
+        if (saved) {
+            Image mapped;
+            bool loaded = mapped.load(path);
+            check(loaded && mapped.isMapped(), "Image::load maps the raw file");
+            check(loaded && mapped.getWidth() == width && mapped.getHeight() == height && mapped.getChannels() == 1 &&
+                  std::memcmp(mapped.getData(), image.getData(), image.getByteSize()) == 0,
+                  "mapped pixels equal the saved ones");
+        }
+        std::remove(path.c_str());
+
+        std::printf("%d large-image check(s) failed\n", failures);
+        return failures;
+    }
+
+    void printUsage() {
+        std::cerr << "Usage: lab2_conformance [--cases n] [--seed n] [--filter text] [--time-size WxH[xC]|0] [--min-time seconds]\n"
+                  << "       lab2_conformance --large\n"
+                  << "Compares every kernel backend with scalar on random images and times them on one large image.\n"
+                  << "--large checks the 64-bit paths on a 2 GB image instead; it needs that much memory and disk.\n";
+    }
+
+    bool parseArguments(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--large") {
+                options.large = true;
+                continue;
+            }
+            if (i + 1 >= argc) return false;
+            std::string value = argv[++i];
+
+            if (arg == "--cases") {
+                options.cases = std::max(0, std::atoi(value.c_str()));
+            } else if (arg == "--seed") {
+                options.seed = std::strtoull(value.c_str(), nullptr, 10);
+            } else if (arg == "--filter") {
+                options.filter = value;
+            } else if (arg == "--time-size") {
+                options.timeWidth = options.timeHeight = 0;
+                options.timeChannels = 3;
+                if (value != "0" && std::sscanf(value.c_str(), "%dx%dx%d", &options.timeWidth, &options.timeHeight, &options.timeChannels) < 2) {
+                    return false;
+                }
+                if (options.timeChannels < 1 || options.timeChannels > 4) return false;
+            } else if (arg == "--min-time") {
+                options.minTime = std::max(0.0, std::atof(value.c_str()));
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+
+    const std::vector<Case> list = cases();
+    const std::vector<Backend> backendList = backends();
+    std::cout << "Backends:";
+    for (const Backend& backend : backendList) {
+        std::cout << " " << backend.name;
+    }
+    std::cout << " (reference " << backendList[0].name << ")" << std::endl;
+    if (options.large) return checkLarge(backendList) == 0 ? 0 : 1;
+
+    int mismatches = compare(options, list, backendList);
+    if (options.timeWidth > 0 && options.timeHeight > 0) {
+        timeBackends(options, list, backendList);
+    }
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+// Local processing service: keeps a worker pool and its caches warm and takes requests (image
+// pixels plus pipeline text) on a Unix domain socket, so short-lived callers skip process start-up
+// and pipeline compilation:
+//
+//   lab2_service --socket /tmp/lab2.sock -j 8 &
+//   lab2_service --client /tmp/lab2.sock -p linearContrast -p otsu in.png out.png
+//   lab2_service --client /tmp/lab2.sock --bench 2000 -c 16 -p equalizeRGB thumb.png
+//   lab2_service --client /tmp/lab2.sock --stats
+#include "Image.h"
+#include "Operations.h"
+#include "Parallel.h"
+#include "PipelineScript.h"
+#include "ProcessingService.h"
+#include "ServiceProtocol.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+    struct Options {
+        std::string socketPath;
+        bool client = false;
+        bool stats = false;
+        int threads = hardwareThreads();
+        int requests = 0;
+        int connections = 4;
+        std::vector<PipelineScript::Step> steps;
+        std::vector<std::string> files;
+    };
+
+    // Removed on SIGINT/SIGTERM; a fixed buffer since the handler may not allocate
+    char socketPathToRemove[108];
+
+    void printUsage() {
+        std::cerr << "Usage: lab2_service --socket path [-j threads]\n"
+                  << "       lab2_service --client path [-p op[:arg,arg...]]... [-f file.pipeline] input output\n"
+                  << "       lab2_service --client path --bench requests [-c connections] [-p ...] input\n"
+                  << "       lab2_service --client path --stats\n\n"
+                  << "Operations:\n";
+        for (const auto& info : Operations::list()) {
+            std::cerr << "  " << info.usage << "\n";
+        }
+    }
+
+    bool parseArguments(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--stats") {
+                options.stats = true;
+                continue;
+            }
+            if (arg.empty() || arg[0] != '-') {
+                options.files.push_back(arg);
+                continue;
+            }
+            if (i + 1 >= argc) return false;
+            std::string value = argv[++i];
+
+            if (arg == "--socket") {
+                options.socketPath = value;
+            } else if (arg == "--client") {
+                options.socketPath = value;
+                options.client = true;
+            } else if (arg == "-j" || arg == "--threads") {
+                options.threads = std::max(1, std::atoi(value.c_str()));
+            } else if (arg == "--bench") {
+                options.requests = std::max(1, std::atoi(value.c_str()));
+            } else if (arg == "-c" || arg == "--connections") {
+                options.connections = std::max(1, std::atoi(value.c_str()));
+            } else if (arg == "-p" || arg == "--op" || arg == "-f" || arg == "--pipeline") {
+                std::vector<PipelineScript::Error> errors;
+                auto parsed = (arg == "-f" || arg == "--pipeline")
+                    ? PipelineScript::load(value, errors)
+                    : PipelineScript::parse(value, errors);
+                for (const auto& error : errors) {
+                    std::cerr << "Error: " << value << ": " << PipelineScript::describe(error) << std::endl;
+                }
+                if (!errors.empty()) return false;
+                options.steps.insert(options.steps.end(), parsed.begin(), parsed.end());
+            } else {
+                return false;
+            }
+        }
+        return !options.socketPath.empty();
+    }
+
+    void serveConnection(ProcessingService& service, int fd) {
+        try {
+            ServiceProtocol::Request request;
+            while (ServiceProtocol::readRequest(fd, request)) {
+                ServiceProtocol::Response response;
+                if (request.type == ServiceProtocol::Type::Stats) {
+                    response.text = service.stats();
+                } else {
+                    response = service.submit(std::move(request.pipeline), std::move(request.image)).get();
+                }
+                if (!ServiceProtocol::writeResponse(fd, response)) break;
+            }
+        } catch (const std::exception& e) {
+            // Malformed request: report it and drop the connection, the stream is out of sync
+            ServiceProtocol::Response response;
+            response.ok = false;
+            response.text = e.what();
+            ServiceProtocol::writeResponse(fd, response);
+        }
+        ::close(fd);
+    }
+
+    void onSignal(int) {
+        ::unlink(socketPathToRemove);
+        std::_Exit(0);
+    }
+
+    int runServer(const Options& options) {
+        int listener = ServiceProtocol::listen(options.socketPath);
+        if (listener < 0) {
+            std::cerr << "Error: cannot listen on " << options.socketPath << ": " << std::strerror(errno) << std::endl;
+            return 2;
+        }
+        std::strncpy(socketPathToRemove, options.socketPath.c_str(), sizeof(socketPathToRemove) - 1);
+        std::signal(SIGINT, onSignal);
+        std::signal(SIGTERM, onSignal);
+        std::signal(SIGPIPE, SIG_IGN);
+
+        ProcessingService::Options serviceOptions;
+        serviceOptions.threads = options.threads;
+        ProcessingService service(serviceOptions);
+        std::cerr << "Listening on " << options.socketPath << " with " << options.threads << " worker(s)" << std::endl;
+
+        while (true) {
+            int fd = ::accept(listener, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                std::cerr << "Error: accept: " << std::strerror(errno) << std::endl;
+                return 2;
+            }
+            // Connections mostly wait on the service; a thread each keeps the protocol blocking
+            std::thread(serveConnection, std::ref(service), fd).detach();
+        }
+    }
+
+    bool roundTrip(int fd, const ServiceProtocol::Request& request, ServiceProtocol::Response& response) {
+        if (!ServiceProtocol::writeRequest(fd, request)) return false;
+        return ServiceProtocol::readResponse(fd, response);
+    }
+
+    int runBenchmark(const Options& options, const ServiceProtocol::Request& request) {
+        std::atomic<int> remaining{options.requests};
+        std::atomic<int> failed{0};
+        std::vector<std::vector<double>> latencies(options.connections);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> clients;
+        for (int c = 0; c < options.connections; c++) {
+            clients.emplace_back([&, c]() {
+                int fd = ServiceProtocol::connect(options.socketPath);
+                if (fd < 0) {
+                    int left = remaining.exchange(0);
+                    if (left > 0) failed += left;
+                    return;
+                }
+                ServiceProtocol::Response response;
+                while (remaining-- > 0) {
+                    auto sent = std::chrono::steady_clock::now();
+                    if (!roundTrip(fd, request, response) || !response.ok) {
+                        failed++;
+                        continue;
+                    }
+                    latencies[c].push_back(std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - sent).count());
+                }
+                ::close(fd);
+            });
+        }
+        for (auto& client : clients) {
+            client.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<double> all;
+        for (const auto& connection : latencies) {
+            all.insert(all.end(), connection.begin(), connection.end());
+        }
+        std::sort(all.begin(), all.end());
+        auto percentile = [&](double p) {
+            return all.empty() ? 0.0 : all[static_cast<size_t>(p / 100.0 * (all.size() - 1) + 0.5)];
+        };
+        std::printf("%zu request(s) (%d failed) over %d connection(s) in %.2f s: %.1f requests/s\n",
+                    all.size(), failed.load(), options.connections, seconds, seconds > 0 ? all.size() / seconds : 0.0);
+        std::printf("latency ms: p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+                    percentile(50), percentile(90), percentile(99), all.empty() ? 0.0 : all.back());
+        return failed ? 2 : 0;
+    }
+
+    int runClient(const Options& options) {
+        ServiceProtocol::Request request;
+        if (options.stats) {
+            request.type = ServiceProtocol::Type::Stats;
+        } else {
+            size_t expected = options.requests > 0 ? 1 : 2;
+            if (options.files.size() != expected) {
+                printUsage();
+                return 1;
+            }
+            if (!request.image.load(options.files[0])) {
+                std::cerr << "Error: cannot load " << options.files[0] << std::endl;
+                return 2;
+            }
+            request.pipeline = PipelineScript::format(options.steps);
+            if (options.requests > 0) return runBenchmark(options, request);
+        }
+
+        int fd = ServiceProtocol::connect(options.socketPath);
+        if (fd < 0) {
+            std::cerr << "Error: cannot connect to " << options.socketPath << ": " << std::strerror(errno) << std::endl;
+            return 2;
+        }
+        ServiceProtocol::Response response;
+        bool answered = roundTrip(fd, request, response);
+        ::close(fd);
+        if (!answered) {
+            std::cerr << "Error: no response from " << options.socketPath << std::endl;
+            return 2;
+        }
+        if (!response.ok) {
+            std::cerr << "Error: " << response.text << std::endl;
+            return 2;
+        }
+
+        if (options.stats) {
+            std::cout << response.text;
+            return 0;
+        }
+        if (!response.image.save(options.files[1])) {
+            std::cerr << "Error: cannot save " << options.files[1] << std::endl;
+            return 2;
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    try {
+        return options.client ? runClient(options) : runServer(options);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 2;
+    }
+}
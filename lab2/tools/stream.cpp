@@ -0,0 +1,140 @@
+// Streaming processing: reads PGM/PPM/PAM frames from stdin, applies an operation chain and
+// writes the frames to stdout, for use in pipelines next to ffmpeg:
+//
+//   ffmpeg -i in.mp4 -f image2pipe -c:v ppm - | lab2_stream -p linearContrast -p gamma:0.8 |
+//       ffmpeg -f image2pipe -c:v ppm -i - out.mp4
+#include "BoundedQueue.h"
+#include "Image.h"
+#include "Operations.h"
+#include "PipelinePlan.h"
+#include "PipelineScript.h"
+#include "Pnm.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    // Frames in flight: one being read, one processed, one written and one spare
+    const int kFrameSlots = 4;
+    const size_t kStreamBuffer = 1 << 20;
+
+    struct FrameSlot {
+        Image input;
+        Image output;
+        Pnm::Format format;
+    };
+
+    void printUsage() {
+        std::cerr << "Usage: lab2_stream [-p op[:arg,arg...]]... [-f file.pipeline] < frames > frames\n"
+                  << "Reads binary PGM/PPM/PAM frames from stdin and writes the processed frames to stdout.\n\n"
+                  << "Operations:\n";
+        for (const auto& info : Operations::list()) {
+            std::cerr << "  " << info.usage << "\n";
+        }
+    }
+
+    bool parseArguments(int argc, char** argv, std::vector<PipelineScript::Step>& steps) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc || (arg != "-p" && arg != "--op" && arg != "-f" && arg != "--pipeline")) {
+                return false;
+            }
+
+            std::string value = argv[++i];
+            std::vector<PipelineScript::Error> errors;
+            auto parsed = (arg == "-f" || arg == "--pipeline")
+                ? PipelineScript::load(value, errors)
+                : PipelineScript::parse(value, errors);
+            for (const auto& error : errors) {
+                std::cerr << "Error: " << value << ": " << PipelineScript::describe(error) << std::endl;
+            }
+            if (!errors.empty()) return false;
+            steps.insert(steps.end(), parsed.begin(), parsed.end());
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<PipelineScript::Step> steps;
+    if (!parseArguments(argc, argv, steps)) {
+        printUsage();
+        return 1;
+    }
+    const PipelinePlan plan = PipelinePlan::compile(steps);
+
+    std::vector<char> inBuffer(kStreamBuffer), outBuffer(kStreamBuffer);
+    std::setvbuf(stdin, inBuffer.data(), _IOFBF, inBuffer.size());
+    std::setvbuf(stdout, outBuffer.data(), _IOFBF, outBuffer.size());
+
+    // Slots circulate free -> read -> processed -> written -> free, so each keeps its buffers and
+    // nothing is allocated per frame once the first frames have sized them.
+    std::vector<FrameSlot> slots(kFrameSlots);
+    BoundedQueue<int> freeSlots(kFrameSlots);
+    BoundedQueue<int> readSlots(kFrameSlots);
+    BoundedQueue<int> processedSlots(kFrameSlots);
+    for (int i = 0; i < kFrameSlots; i++) {
+        freeSlots.push(i);
+    }
+
+    std::atomic<bool> failed{false};
+    auto fail = [&](const char* stage, const std::exception& e) {
+        std::cerr << "Error while " << stage << ": " << e.what() << std::endl;
+        failed = true;
+        freeSlots.close();
+        readSlots.close();
+        processedSlots.close();
+    };
+
+    std::thread reader([&]() {
+        try {
+            int slot;
+            while (freeSlots.pop(slot)) {
+                if (!Pnm::read(stdin, slots[slot].input, slots[slot].format)) break;
+                readSlots.push(slot);
+            }
+        } catch (const std::exception& e) {
+            fail("reading", e);
+        }
+        readSlots.close();
+    });
+
+    std::thread processor([&]() {
+        try {
+            int slot;
+            while (readSlots.pop(slot)) {
+                plan.run(slots[slot].input, slots[slot].output);
+                processedSlots.push(slot);
+            }
+        } catch (const std::exception& e) {
+            fail("processing", e);
+        }
+        processedSlots.close();
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    long frames = 0;
+    int slot;
+    while (processedSlots.pop(slot)) {
+        if (!Pnm::write(stdout, slots[slot].output, slots[slot].format)) {
+            fail("writing", std::runtime_error("stdout closed"));
+            break;
+        }
+        frames++;
+        freeSlots.push(slot);
+    }
+    std::fflush(stdout);
+    freeSlots.close();
+
+    processor.join();
+    reader.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::fprintf(stderr, "%ld frame(s) in %.2f s (%.1f fps)\n", frames, seconds, seconds > 0 ? frames / seconds : 0.0);
+    return failed ? 2 : 0;
+}
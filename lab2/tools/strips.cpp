@@ -0,0 +1,118 @@
+// Strip processing for images larger than memory: reads a binary PGM/PPM/PAM file a band of rows at
+// a time, applies an operation chain and writes each band as soon as it is done.
+//
+//   lab2_strips -p linearContrast -p gamma:0.8 orthophoto.ppm out.ppm
+//   lab2_strips -f mask.pipeline --rows 64 big.pgm - | pnmtotiff > out.tif
+//
+// Value maps and thresholds stream in one pass; every histogram-driven step (linearContrast, otsu,
+// triangle, equalizeRGB on gray images) reads the input once more, so those need a file, not stdin.
+#include "Kernels.h"
+#include "Operations.h"
+#include "Parallel.h"
+#include "PipelinePlan.h"
+#include "PipelineScript.h"
+#include "Strips.h"
+#include "../../lab1/utils/MemoryAccounting.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+    const int kDefaultRows = 256;
+
+    struct Options {
+        std::vector<PipelineScript::Step> steps;
+        int rows = kDefaultRows;
+        std::string input;
+        std::string output;
+    };
+
+    void printUsage() {
+        std::cerr << "Usage: lab2_strips [-p op[:arg,arg...]]... [-f file.pipeline] [--rows n] <input.pnm|-> <output.pnm|->\n"
+                  << "Processes a binary PGM/PPM/PAM image " << kDefaultRows << " rows at a time (--rows), with memory\n"
+                  << "independent of the image size. Morphology and equalizeHSV need the whole image and are refused.\n\n"
+                  << "Operations:\n";
+        for (const auto& info : Operations::list()) {
+            std::cerr << "  " << info.usage << "\n";
+        }
+    }
+
+    bool parseArguments(int argc, char** argv, Options& options) {
+        std::vector<std::string> files;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "-" || arg.empty() || arg[0] != '-') {
+                files.push_back(arg);
+                continue;
+            }
+            if (i + 1 >= argc) return false;
+            std::string value = argv[++i];
+
+            if (arg == "--rows") {
+                options.rows = std::atoi(value.c_str());
+                if (options.rows < 1) return false;
+            } else if (arg == "-p" || arg == "--op" || arg == "-f" || arg == "--pipeline") {
+                std::vector<PipelineScript::Error> errors;
+                auto parsed = (arg == "-f" || arg == "--pipeline")
+                    ? PipelineScript::load(value, errors)
+                    : PipelineScript::parse(value, errors);
+                for (const auto& error : errors) {
+                    std::cerr << "Error: " << value << ": " << PipelineScript::describe(error) << std::endl;
+                }
+                if (!errors.empty()) return false;
+                options.steps.insert(options.steps.end(), parsed.begin(), parsed.end());
+            } else {
+                return false;
+            }
+        }
+        if (files.size() != 2) return false;
+        options.input = files[0];
+        options.output = files[1];
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    const PipelinePlan plan = PipelinePlan::compile(options.steps);
+    // One strip at a time, so its rows are split over every core
+    Kernels::setThreads(hardwareThreads());
+
+    try {
+        StripReader in(options.input);
+        std::string blocked = plan.unstreamableStep(in.getChannels());
+        if (!blocked.empty()) {
+            std::cerr << "Error: '" << blocked << "' needs the whole image and cannot run on strips" << std::endl;
+            return 1;
+        }
+
+        if (!in.isSeekable() && plan.usesHistogram(in.getChannels())) {
+            std::cerr << "Error: the plan measures a histogram first and needs a file as input, not stdin" << std::endl;
+            return 1;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        StripWriter out(options.output, in.getHeader());
+        plan.runStrips(in, out, options.rows);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double mb = 1024.0 * 1024.0;
+        double imageMb = static_cast<double>(in.getWidth()) * in.getHeight() * in.getChannels() / mb;
+        std::fprintf(stderr, "%dx%dx%d (%.0f MB) in %.2f s, %.1f MB/s; peak %.1f MB of pixel buffers\n",
+                     in.getWidth(), in.getHeight(), in.getChannels(), imageMb, seconds, seconds > 0 ? imageMb / seconds : 0.0,
+                     MemoryAccounting::usage(MemoryAccounting::Category::PixelBuffers).peak / mb);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+// Video processing: reads Y4M (or raw frames) from stdin, applies an operation chain to every
+// frame and writes the same format to stdout:
+//
+//   ffmpeg -i in.mp4 -f yuv4mpegpipe - | lab2_video -p linearContrast -p otsu |
+//       ffmpeg -f yuv4mpegpipe -i - out.mp4
+//   lab2_video --raw 3840x2160:yuv420p -p gamma:0.8 < in.yuv > out.yuv
+//
+// YUV frames are processed on the Y plane only; the chroma planes are kept, or set to neutral gray
+// when the chain ends in a threshold or mask.
+#include "BoundedQueue.h"
+#include "Image.h"
+#include "Operations.h"
+#include "Parallel.h"
+#include "PipelinePlan.h"
+#include "PipelineScript.h"
+#include "VideoIO.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    const size_t kStreamBuffer = 4 << 20;
+
+    struct Options {
+        std::vector<PipelineScript::Step> steps;
+        std::string rawFormat;
+        int width = 0;
+        int height = 0;
+        int threads = std::max(1, hardwareThreads() - 2);
+    };
+
+    struct FrameSlot {
+        VideoIO::Frame frame;
+        long sequence = 0;
+    };
+
+    void printUsage() {
+        std::cerr << "Usage: lab2_video [-p op[:arg,arg...]]... [-f file.pipeline] [-j threads] [--raw WxH:pixfmt] < in > out\n"
+                  << "Reads YUV4MPEG2 from stdin (or raw gray, yuv420p, yuv422p, yuv444p or rgb24 frames with --raw)\n"
+                  << "and writes the processed frames to stdout in the same format.\n\n"
+                  << "Operations:\n";
+        for (const auto& info : Operations::list()) {
+            std::cerr << "  " << info.usage << "\n";
+        }
+    }
+
+    bool parseArguments(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) return false;
+            std::string value = argv[++i];
+
+            if (arg == "-j" || arg == "--threads") {
+                options.threads = std::max(1, std::atoi(value.c_str()));
+            } else if (arg == "--raw") {
+                // 1920x1080:yuv420p
+                size_t x = value.find('x');
+                size_t colon = value.find(':');
+                if (x == std::string::npos || colon == std::string::npos || colon < x) return false;
+                options.width = std::atoi(value.c_str());
+                options.height = std::atoi(value.c_str() + x + 1);
+                options.rawFormat = value.substr(colon + 1);
+            } else if (arg == "-p" || arg == "--op" || arg == "-f" || arg == "--pipeline") {
+                std::vector<PipelineScript::Error> errors;
+                auto parsed = (arg == "-f" || arg == "--pipeline")
+                    ? PipelineScript::load(value, errors)
+                    : PipelineScript::parse(value, errors);
+                for (const auto& error : errors) {
+                    std::cerr << "Error: " << value << ": " << PipelineScript::describe(error) << std::endl;
+                }
+                if (!errors.empty()) return false;
+                options.steps.insert(options.steps.end(), parsed.begin(), parsed.end());
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void processFrame(const PipelinePlan& plan, const VideoIO::Format& format, VideoIO::Frame& frame) {
+        // In place: luma (or the whole RGB frame) through the plan, chroma kept or neutralised
+        plan.run(frame.planes[0], frame.planes[0]);
+        if (VideoIO::isPlanarYUV(format.layout) && plan.producesGray()) {
+            for (int p = 1; p < frame.planeCount; p++) {
+                Image& plane = frame.planes[p];
+                std::memset(plane.getData(), 128, static_cast<size_t>(plane.getWidth()) * plane.getHeight());
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    const PipelinePlan plan = PipelinePlan::compile(options.steps);
+
+    std::vector<char> inBuffer(kStreamBuffer), outBuffer(kStreamBuffer);
+    std::setvbuf(stdin, inBuffer.data(), _IOFBF, inBuffer.size());
+    std::setvbuf(stdout, outBuffer.data(), _IOFBF, outBuffer.size());
+
+    VideoIO::Format format;
+    try {
+        format = options.rawFormat.empty()
+            ? VideoIO::readHeader(stdin)
+            : VideoIO::rawFormat(options.rawFormat, options.width, options.height);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    if (!VideoIO::writeHeader(stdout, format)) return 2;
+
+    // Frames are processed concurrently, one per worker, and written in their original order.
+    // Slots circulate free -> read -> processed -> written -> free; their number bounds the frames
+    // in flight, and the buffers they keep are reused for every frame.
+    const int slotCount = options.threads * 2 + 2;
+    std::vector<FrameSlot> slots(slotCount);
+    BoundedQueue<int> freeSlots(slotCount);
+    BoundedQueue<int> readSlots(slotCount);
+    BoundedQueue<int> processedSlots(slotCount);
+    for (int i = 0; i < slotCount; i++) {
+        freeSlots.push(i);
+    }
+
+    std::atomic<bool> failed{false};
+    auto fail = [&](const char* stage, const std::exception& e) {
+        std::cerr << "Error while " << stage << ": " << e.what() << std::endl;
+        failed = true;
+        freeSlots.close();
+        readSlots.close();
+        processedSlots.close();
+    };
+
+    std::thread reader([&]() {
+        try {
+            int slot;
+            long sequence = 0;
+            while (freeSlots.pop(slot)) {
+                if (!VideoIO::readFrame(stdin, format, slots[slot].frame)) break;
+                slots[slot].sequence = sequence++;
+                readSlots.push(slot);
+            }
+        } catch (const std::exception& e) {
+            fail("reading", e);
+        }
+        readSlots.close();
+    });
+
+    std::atomic<int> activeWorkers{options.threads};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < options.threads; t++) {
+        workers.emplace_back([&]() {
+            try {
+                int slot;
+                while (readSlots.pop(slot)) {
+                    processFrame(plan, format, slots[slot].frame);
+                    processedSlots.push(slot);
+                }
+            } catch (const std::exception& e) {
+                fail("processing", e);
+            }
+            if (--activeWorkers == 0) processedSlots.close();
+        });
+    }
+
+    // Frames finish out of order; at most slotCount are in flight, so sequence % slotCount is a
+    // free position in the reorder ring.
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int> reorder(slotCount, -1);
+    long next = 0;
+    int slot;
+    while (!failed && processedSlots.pop(slot)) {
+        reorder[slots[slot].sequence % slotCount] = slot;
+        while (reorder[next % slotCount] >= 0) {
+            int ready = reorder[next % slotCount];
+            reorder[next % slotCount] = -1;
+            if (!VideoIO::writeFrame(stdout, format, slots[ready].frame)) {
+                fail("writing", std::runtime_error("stdout closed"));
+                break;
+            }
+            next++;
+            freeSlots.push(ready);
+        }
+    }
+    std::fflush(stdout);
+    freeSlots.close();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    reader.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::fprintf(stderr, "%ld frame(s) of %dx%d in %.2f s (%.1f fps) on %d worker(s)\n",
+                 next, format.width, format.height, seconds, seconds > 0 ? next / seconds : 0.0, options.threads);
+    return failed ? 2 : 0;
+}